@@ -19,22 +19,33 @@
  * 							 If right after an erasure, do an overlap add with the synthetic signal.
  * 							 Add the frame to history buffer.
  * 
+ * g711plc_batch_frame: .... Conceal one frame of many streams in lockstep, bit exact with
+ * 							 g711plc_dofe / g711plc_addtohistory per stream. The history is a
+ * 							 ring of rows x lanes, the gain decay and the end of erasure OLA run
+ * 							 over the compacted lanes, the pitch search stays per stream.
+ * 
  * @copyright Copyright (c) 2023
  * 
  */
 
 // external reference : https://github.com/openitu/STL
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 #include "config.h"
 #include "LowcFE.h"
 #include "arch.h"
 #include "config.h"
+#include "dspKernel.h"
 
 /*-------------------- INTERNAL FUNCTIONS --------------------*/
 static void g711plc_scalespeech(LowcFE_c *, sint16_t *out);
 static void g711plc_getfespeech(LowcFE_c *, sint16_t *out, sint32_t sz);
+static void g711plc_getfespeech_gain(LowcFE_c *, sint16_t *out, sint32_t sz, Float g, Float dg);
 static void g711plc_savespeech(LowcFE_c *, sint16_t *s);
 static sint32_t g711plc_findpitch(LowcFE_c *);
+static sint32_t g711plc_findpitch_coarse(LowcFE_c *);
+static sint32_t g711plc_findpitch_fine(LowcFE_c *, sint32_t bestmatch);
 static void g711plc_overlapadd(Float * l, Float * r, Float * o, sint32_t cnt);
 static void g711plc_overlapadds(sint16_t *l, sint16_t *r, sint16_t *o, sint32_t cnt);
 static void g711plc_overlapaddatend(LowcFE_c *, sint16_t *s, sint16_t *f, sint32_t cnt);
@@ -43,35 +54,45 @@ static void g711plc_convertfs(Float * f, sint16_t *t, sint32_t cnt);
 static void g711plc_copyf(Float * f, Float * t, sint32_t cnt);
 static void g711plc_copys(sint16_t *f, sint16_t *t, sint32_t cnt);
 static void g711plc_zeros(sint16_t *s, sint32_t cnt);
+static void g711plc_onset(LowcFE_c *, sint16_t *out);
+static void g711plc_synth(LowcFE_c *, sint16_t *out);
+static void g711plc_endfe(LowcFE_c *, sint16_t *s);
 
 /**
  * @brief 
- * Get samples from the circular pitch buffer. Update poffset so
- * when subsequent frames are erased the signal continues.
+ * Get samples from the circular pitch buffer, scaled by the gain g - i * dg of sample i.
+ * Update poffset so when subsequent frames are erased the signal continues.
  */
-static void g711plc_getfespeech(LowcFE_c * lc, sint16_t *out, sint32_t sz) {
+static void g711plc_getfespeech_gain(LowcFE_c * lc, sint16_t *out, sint32_t sz, Float g, Float dg) {
+	sint32_t done = 0;
 	while (sz) {
 		sint32_t cnt = lc->pitchblen - lc->poffset;
 		if (cnt > sz) {
 			cnt = sz;
 		}
-		g711plc_convertfs(&lc->pitchbufstart[lc->poffset], out, cnt);
+		gDspKernel.gain_ramp(out, &lc->pitchbufstart[lc->poffset], cnt, g, dg, done);
 		lc->poffset += cnt;
 		if (lc->poffset == lc->pitchblen) {
 			lc->poffset = 0;
 		}
 		out += cnt;
+		done += cnt;
 		sz -= cnt;
 	}
 }
 
+/**
+ * @brief 
+ * Get samples from the circular pitch buffer. Update poffset so
+ * when subsequent frames are erased the signal continues.
+ */
+static void g711plc_getfespeech(LowcFE_c * lc, sint16_t *out, sint32_t sz) {
+	g711plc_getfespeech_gain(lc, out, sz, (Float) 1., (Float) 0.);
+}
+
 static void g711plc_scalespeech(LowcFE_c * lc, sint16_t *out) {
-	sint32_t i;
 	Float g = (Float) 1. - (lc->erasecnt - 1) * ATTENFAC;
-	for (i = 0; i < FRAMESZ; i++) {
-		out[i] = (sint16_t) (out[i] * g);
-		g -= ATTENINCR;
-	}
+	gDspKernel.gain_ramp(out, NULL, FRAMESZ, g, ATTENINCR, 0);
 }
 
 /**
@@ -94,29 +115,11 @@ static void g711plc_savespeech(LowcFE_c * lc, sint16_t *s) {
  * Scale the synthetic speech by the gain factor before the OLA.
  */
 static void g711plc_overlapaddatend(LowcFE_c * lc, sint16_t *s, sint16_t *f, sint32_t cnt) {
-	sint32_t i;
-	Float incrg;
-	Float lw, rw;
-	Float t;
-	Float incr = (Float) 1. / cnt;
 	Float gain = (Float) 1. - (lc->erasecnt - 1) * ATTENFAC;
 	if (gain < 0.) {
 		gain = (Float) 0.;
 	}
-	incrg = incr * gain;
-	lw = ((Float) 1. - incr) * gain;
-	rw = incr;
-	for (i = 0; i < cnt; i++) {
-		t = lw * f[i] + rw * s[i];
-		if (t > 32767.) {
-			t = (Float) 32767.;
-		} else if (t < -32768.) {
-			t = (Float) - 32768.;
-		}
-		s[i] = (sint16_t) t;
-		lw -= incrg;
-		rw += incr;
-	}
+	gDspKernel.ola_s16(s, f, s, cnt, gain);
 }
 
 /**
@@ -124,53 +127,15 @@ static void g711plc_overlapaddatend(LowcFE_c * lc, sint16_t *s, sint16_t *f, sin
  * Overlapp add left and right sides
  */
 static void g711plc_overlapadd(Float * l, Float * r, Float * o, sint32_t cnt) {
-	sint32_t i;
-	Float incr, lw, rw, t;
-
-	if (cnt == 0) {
-		return;
-	}
-	incr = (Float) 1. / cnt;
-	lw = (Float) 1. - incr;
-	rw = incr;
-	for (i = 0; i < cnt; i++) {
-		t = lw * l[i] + rw * r[i];
-		if (t > (Float) 32767.) {
-			t = (Float) 32767.;
-		} else if (t < (Float) - 32768.) {
-			t = (Float) - 32768.;
-		}
-		o[i] = t;
-		lw -= incr;
-		rw += incr;
-	}
+	gDspKernel.ola(o, l, r, cnt);
 }
 
 /**
  * @brief 
  * Overlapp add left and right sides
  */
-static void g711plc_overlapadds(sint16_t *l, sint16_t *r, sint16_t *o, int cnt) {
-	int i;
-	Float incr, lw, rw, t;
-
-	if (cnt == 0) {
-		return;
-	}
-	incr = (Float) 1. / cnt;
-	lw = (Float) 1. - incr;
-	rw = incr;
-	for (i = 0; i < cnt; i++) {
-		t = lw * l[i] + rw * r[i];
-		if (t > (Float) 32767.) {
-			t = (Float) 32767.;
-		} else if (t < (Float) - 32768.) {
-			t = (Float) - 32768.;
-		}
-		o[i] = (sint16_t) t;
-		lw -= incr;
-		rw += incr;
-	}
+static void g711plc_overlapadds(sint16_t *l, sint16_t *r, sint16_t *o, sint32_t cnt) {
+	gDspKernel.ola_s16(o, l, r, cnt, (Float) 1.);
 }
 
 /**
@@ -181,50 +146,85 @@ static void g711plc_overlapadds(sint16_t *l, sint16_t *r, sint16_t *o, int cnt)
  * @return sint32_t 
  */
 static sint32_t g711plc_findpitch(LowcFE_c *lc) {
+	return g711plc_findpitch_fine(lc, g711plc_findpitch_coarse(lc));
+}
 
-	sint32_t i, j, k;
+/**
+ * @brief 
+ * Normalized cross-correlation search, shared with the WSOLA engine.
+ * l - segment to match, len samples.
+ * r - candidate at lag 0, the candidates are r + lag for lag lo, lo + dec, .. hi.
+ * Every dec-th sample of the segments is correlated (len a multiple of dec), the energy of the
+ * candidate slides with the lag and is floored to minpower.
+ * @return sint32_t best lag, the last of equal scores when last_tie
+ */
+sint32_t g711plc_xcorr_search(const Float *l, const Float *r, sint32_t lo, sint32_t hi, sint32_t len, sint32_t dec, Float minpower, bool last_tie) {
+
+	sint32_t i, j;
 	sint32_t bestmatch;
 	Float bestcorr;
 	Float corr;		/* correlation */
 	Float energy;	/* running energy */
 	Float scale;	/* scale correlation by average power */
-	Float *rp;		/* segment to match */
-	Float *l = lc->pitchbufend - CORRLEN;
-	Float *r = lc->pitchbufend - CORRBUFLEN;
+	const Float *rp;	/* segment to match */
 
-	rp = r;
-	/* coarse search initial run at position 0 */
+	rp = r + lo;
+	/* initial run at position lo */
 	energy = (Float) 0.;
 	corr = (Float) 0.;
-	for (i = 0; i < CORRLEN; i += NDEC) {
+	for (i = 0; i < len; i += dec) {
 		energy += rp[i] * rp[i];
 		corr += rp[i] * l[i];
 	}
-	scale = (energy < CORRMINPOWER)? CORRMINPOWER : energy;
+	scale = (energy < minpower)? minpower : energy;
 	corr = corr / (Float) sqrt (scale);
 	bestcorr = corr;
-	bestmatch = 0;
+	bestmatch = lo;
 
-	/* coarse search */
-	for (j = NDEC; j <= PITCHDIFF; j += NDEC) {
+	for (j = lo + dec; j <= hi; j += dec) {
 		energy -= rp[0] * rp[0];
 #if SRC_FIX_ME
-		energy += rp[CORRLEN] * rp[CORRLEN];
+		energy += rp[len] * rp[len];
 #else
-		energy += rp[CORRLEN-1+NDEC] * rp[CORRLEN-1+NDEC];
+		energy += rp[len-1+dec] * rp[len-1+dec];
 #endif
-		rp += NDEC;
+		rp += dec;
 		corr = 0.f;
-		for (i = 0; i < CORRLEN; i += NDEC) {
+		for (i = 0; i < len; i += dec) {
 			corr += rp[i] * l[i];
 		}
-		scale = (energy < CORRMINPOWER)? CORRMINPOWER : energy;
-		corr /= (Float) sqrt (scale);
-		if (corr >= bestcorr) {
+		scale = (energy < minpower)? minpower : energy;
+		corr = corr / (Float) sqrt (scale);
+		if (corr > bestcorr || (last_tie && corr == bestcorr)) {
 			bestcorr = corr;
 			bestmatch = j;
 		}
 	}
+	return bestmatch;
+}
+
+/**
+ * @brief 
+ * Coarse search of the best match, 2:1 decimated.
+ * @return sint32_t offset of the best match from r
+ */
+static sint32_t g711plc_findpitch_coarse(LowcFE_c *lc) {
+	Float *l = lc->pitchbufend - CORRLEN;
+	Float *r = lc->pitchbufend - CORRBUFLEN;
+
+	return g711plc_xcorr_search(l, r, 0, PITCHDIFF, CORRLEN, NDEC, CORRMINPOWER, true);
+}
+
+/**
+ * @brief 
+ * Fine search around the coarse best match, full rate.
+ * @return sint32_t the pitch
+ */
+static sint32_t g711plc_findpitch_fine(LowcFE_c *lc, sint32_t bestmatch) {
+
+	sint32_t j, k;
+	Float *l = lc->pitchbufend - CORRLEN;
+	Float *r = lc->pitchbufend - CORRBUFLEN;
 
 	/* fine search initial run at position coarse search best position */
 	j = bestmatch - (NDEC - 1);
@@ -235,36 +235,8 @@ static sint32_t g711plc_findpitch(LowcFE_c *lc) {
 	if (k > PITCHDIFF) {
 		k = PITCHDIFF;
 	}
-	rp = &r[j];
-	energy = 0.f;
-	corr = 0.f;
-	for (i = 0; i < CORRLEN; i++) {
-		energy += rp[i] * rp[i];
-		corr += rp[i] * l[i];
-	}
-	scale = (energy < CORRMINPOWER)? CORRMINPOWER : energy;
-	corr = corr / (Float) sqrt (scale);
-	bestcorr = corr;
-	bestmatch = j;
 
-	/* fine search */
-	for (j++; j <= k; j++) {
-		energy -= rp[0] * rp[0];
-		energy += rp[CORRLEN] * rp[CORRLEN];
-		rp++;
-		corr = 0.f;
-		for (i = 0; i < CORRLEN; i++) {
-			corr += rp[i] * l[i];
-		}
-		scale = (energy < CORRMINPOWER)? CORRMINPOWER : energy;
-		corr = corr / (Float) sqrt (scale);
-		if (corr > bestcorr) {
-			bestcorr = corr;
-			bestmatch = j;
-		}
-	}
-
-	return PITCH_MAX - bestmatch;
+	return PITCH_MAX - g711plc_xcorr_search(l, r, j, k, CORRLEN, 1, CORRMINPOWER, false);
 
 }
 
@@ -276,10 +248,7 @@ static void g711plc_convertsf(sint16_t *f, Float * t, sint32_t cnt) {
 }
 
 static void g711plc_convertfs(Float * f, sint16_t *t, sint32_t cnt) {
-	sint32_t i;
-	for (i = 0; i < cnt; i++) {
-		t[i] = (sint16_t) f[i];
-	}
+	gDspKernel.gain_ramp(t, f, cnt, (Float) 1., (Float) 0., 0);
 }
 
 static void g711plc_copyf(Float * f, Float * t, sint32_t cnt) {
@@ -303,40 +272,35 @@ static void g711plc_zeros(sint16_t *s, sint32_t cnt) {
 	}
 }
 
-/*-------------------- FUNCTIONS --------------------*/
-void g711plc_construct(LowcFE_c * lc) {
-	lc->erasecnt = 0;
-	lc->pitchbufend = &lc->pitchbuf[HISTORYLEN];
-	g711plc_zeros(lc->history, HISTORYLEN);
+/**
+ * @brief 
+ * First erased frame, the pitch is known. Extract one period from
+ * the tail of the signal and OLA 1/4 of the pitch to smooth it.
+ */
+static void g711plc_onset(LowcFE_c * lc, sint16_t *out) {
+	lc->poverlap = lc->pitch >> 2;      /* OLA 1/4 wavelength */
+	/* save original last poverlap samples */
+	g711plc_copyf (lc->pitchbufend - lc->poverlap, lc->lastq, lc->poverlap);
+	lc->poffset = 0;            /* create pitch buffer with 1 period */
+	lc->pitchblen = lc->pitch;
+	lc->pitchbufstart = lc->pitchbufend - lc->pitchblen;
+	g711plc_overlapadd (lc->lastq, lc->pitchbufstart - lc->poverlap, lc->pitchbufend - lc->poverlap, lc->poverlap);
+	/* update last 1/4 wavelength in history buffer */
+	g711plc_convertfs (lc->pitchbufend - lc->poverlap, &lc->history[HISTORYLEN - lc->poverlap], lc->poverlap);
+	/* get synthesized speech */
+	g711plc_getfespeech (lc, out, FRAMESZ);
 }
 
 /**
  * @brief 
- * Generate the synthetic signal.
- * At the beginning of an erasure determine the pitch, and extract
- * one pitch period from the tail of the signal. Do an OLA for 1/4
- * of the pitch to smooth the signal. Then repeat the extracted signal
- * for the length of the erasure. If the erasure continues for more than
- * 10 msec, increase the number of periods in the pitchbuffer. At the end
- * of an erasure, do an OLA with the start of the first good frame.
- * The gain decays as the erasure gets longer.
+ * Synthesize one erased frame, g711plc_dofe without the history update.
  */
-void g711plc_dofe(LowcFE_c * lc, sint16_t *out) {
+static void g711plc_synth(LowcFE_c * lc, sint16_t *out) {
 	if (lc->erasecnt == 0) {
 		/* get history */
 		g711plc_convertsf(lc->history, lc->pitchbuf, HISTORYLEN);
 		lc->pitch = g711plc_findpitch (lc); /* find pitch */
-		lc->poverlap = lc->pitch >> 2;      /* OLA 1/4 wavelength */
-		/* save original last poverlap samples */
-		g711plc_copyf (lc->pitchbufend - lc->poverlap, lc->lastq, lc->poverlap);
-		lc->poffset = 0;            /* create pitch buffer with 1 period */
-		lc->pitchblen = lc->pitch;
-		lc->pitchbufstart = lc->pitchbufend - lc->pitchblen;
-		g711plc_overlapadd (lc->lastq, lc->pitchbufstart - lc->poverlap, lc->pitchbufend - lc->poverlap, lc->poverlap);
-		/* update last 1/4 wavelength in history buffer */
-		g711plc_convertfs (lc->pitchbufend - lc->poverlap, &lc->history[HISTORYLEN - lc->poverlap], lc->poverlap);
-		/* get synthesized speech */
-		g711plc_getfespeech (lc, out, FRAMESZ);
+		g711plc_onset (lc, out);
 	} else if (lc->erasecnt == 1 || lc->erasecnt == 2) {
 		/* tail of previous pitch estimate */
 		sint16_t tmp[POVERLAPMAX];
@@ -357,20 +321,17 @@ void g711plc_dofe(LowcFE_c * lc, sint16_t *out) {
 	} else if (lc->erasecnt > 5) {
 		g711plc_zeros (out, FRAMESZ);
 	} else {
-		g711plc_getfespeech (lc, out, FRAMESZ);
-		g711plc_scalespeech (lc, out);
+		g711plc_getfespeech_gain (lc, out, FRAMESZ, (Float) 1. - (lc->erasecnt - 1) * ATTENFAC, ATTENINCR);
 	}
 	lc->erasecnt++;
-	g711plc_savespeech (lc, out);
 }
 
 /**
  * @brief 
- * A good frame was received and decoded.
- * If right after an erasure, do an overlap add with the synthetic signal.
- * Add the frame to history buffer.
+ * OLA the first good frame after an erasure with the synthetic signal,
+ * g711plc_addtohistory without the history update.
  */
-void g711plc_addtohistory(LowcFE_c * lc, sint16_t *s) {
+static void g711plc_endfe(LowcFE_c * lc, sint16_t *s) {
 	if (lc->erasecnt) {
 		sint16_t overlapbuf[FRAMESZ];
 		/* 
@@ -386,5 +347,321 @@ void g711plc_addtohistory(LowcFE_c * lc, sint16_t *s) {
 		g711plc_overlapaddatend (lc, s, overlapbuf, olen);
 		lc->erasecnt = 0;
 	}
+}
+
+/*-------------------- FUNCTIONS --------------------*/
+void g711plc_construct(LowcFE_c * lc) {
+	lc->erasecnt = 0;
+	lc->pitchbufend = &lc->pitchbuf[HISTORYLEN];
+	g711plc_zeros(lc->history, HISTORYLEN);
+}
+
+/**
+ * @brief 
+ * Generate the synthetic signal.
+ * At the beginning of an erasure determine the pitch, and extract
+ * one pitch period from the tail of the signal. Do an OLA for 1/4
+ * of the pitch to smooth the signal. Then repeat the extracted signal
+ * for the length of the erasure. If the erasure continues for more than
+ * 10 msec, increase the number of periods in the pitchbuffer. At the end
+ * of an erasure, do an OLA with the start of the first good frame.
+ * The gain decays as the erasure gets longer.
+ */
+void g711plc_dofe(LowcFE_c * lc, sint16_t *out) {
+	g711plc_synth(lc, out);
+	g711plc_savespeech (lc, out);
+}
+
+/**
+ * @brief 
+ * A good frame was received and decoded.
+ * If right after an erasure, do an overlap add with the synthetic signal.
+ * Add the frame to history buffer.
+ */
+void g711plc_addtohistory(LowcFE_c * lc, sint16_t *s) {
+	g711plc_endfe(lc, s);
 	g711plc_savespeech (lc, s);
 }
+
+/*-------------------- BATCH --------------------*/
+#define LOWCFE_BLOCK (8) /* lanes of one lockstep block, rows of one transpose step */
+
+/**
+ * @brief 
+ * Row r of the history ring, r = 0 is the oldest sample of every stream.
+ */
+static sint16_t *g711plc_batch_row(LowcFE_batch_c *b, sint32_t r) {
+	return &b->history[((b->head + r) % HISTORYLEN) * b->lanes];
+}
+
+/**
+ * @brief 
+ * g711plc_findpitch_coarse of the onset lanes in lockstep, LOWCFE_BLOCK lanes at a time so a block
+ * stays in cache, the correlations in gDspKernel.dot_lanes. Best match of lane k in cnt[k].
+ * np : row stride of pitchbuf.
+ */
+static void g711plc_batch_coarse(LowcFE_batch_c *b, uint32_t np) {
+	uint32_t k0, k;
+	sint32_t j;
+
+	for (k0 = 0; k0 < np; k0 += LOWCFE_BLOCK) {
+		Float energy[LOWCFE_BLOCK];
+		Float corr[LOWCFE_BLOCK];
+		Float bestcorr[LOWCFE_BLOCK];
+		sint32_t bestmatch[LOWCFE_BLOCK];
+		Float *l = &b->pitchbuf[(HISTORYLEN - CORRLEN) * np + k0];
+		Float *r = &b->pitchbuf[(HISTORYLEN - CORRBUFLEN) * np + k0];
+
+		/* coarse search initial run at position 0 */
+		for (k = 0; k < LOWCFE_BLOCK; k++) {
+			energy[k] = (Float) 0.;
+			corr[k] = (Float) 0.;
+		}
+		gDspKernel.dot_lanes(energy, r, r, CORRLEN / NDEC, NDEC * np, NDEC * np, LOWCFE_BLOCK);
+		gDspKernel.dot_lanes(corr, r, l, CORRLEN / NDEC, NDEC * np, NDEC * np, LOWCFE_BLOCK);
+		for (k = 0; k < LOWCFE_BLOCK; k++) {
+			Float scale = (energy[k] < CORRMINPOWER)? CORRMINPOWER : energy[k];
+			bestcorr[k] = corr[k] / (Float) sqrt (scale);
+			bestmatch[k] = 0;
+		}
+
+		/* coarse search */
+		for (j = NDEC; j <= PITCHDIFF; j += NDEC) {
+			Float *rold = &r[(j - NDEC) * np];
+#if SRC_FIX_ME
+			Float *rnew = &r[(j - NDEC + CORRLEN) * np];
+#else
+			Float *rnew = &r[(j - NDEC + CORRLEN - 1 + NDEC) * np];
+#endif
+			for (k = 0; k < LOWCFE_BLOCK; k++) {
+				energy[k] -= rold[k] * rold[k];
+				energy[k] += rnew[k] * rnew[k];
+				corr[k] = 0.f;
+			}
+			gDspKernel.dot_lanes(corr, &r[j * np], l, CORRLEN / NDEC, NDEC * np, NDEC * np, LOWCFE_BLOCK);
+			for (k = 0; k < LOWCFE_BLOCK; k++) {
+				Float scale = (energy[k] < CORRMINPOWER)? CORRMINPOWER : energy[k];
+				Float c = corr[k] / (Float) sqrt (scale);
+				bestmatch[k] = (c >= bestcorr[k])? j : bestmatch[k];
+				bestcorr[k] = (c >= bestcorr[k])? c : bestcorr[k];
+			}
+		}
+		for (k = 0; k < LOWCFE_BLOCK; k++) {
+			b->cnt[k0 + k] = bestmatch[k];
+		}
+	}
+}
+
+int g711plc_batch_construct(LowcFE_batch_c *b, uint32_t streams) {
+	uint32_t j;
+	uint32_t lanes = (streams + LOWCFE_LANE_ALIGN - 1) / LOWCFE_LANE_ALIGN * LOWCFE_LANE_ALIGN;
+
+	memset(b, 0, sizeof(LowcFE_batch_c));
+	if (streams == 0) {
+		return -1;
+	}
+	b->streams = streams;
+	b->lanes = lanes;
+	b->lc = (LowcFE_c *) malloc(streams * sizeof(LowcFE_c));
+	b->history = (sint16_t *) calloc(HISTORYLEN * lanes, sizeof(sint16_t));
+	b->idx = (uint32_t *) malloc(lanes * sizeof(uint32_t));
+	b->onset = (uint32_t *) malloc(lanes * sizeof(uint32_t));
+	b->pitchbuf = (Float *) malloc(HISTORYLEN * lanes * sizeof(Float));
+	b->synth = (sint16_t *) calloc(FRAMESZ * lanes, sizeof(sint16_t));
+	b->good = (sint16_t *) calloc(FRAMESZ * lanes, sizeof(sint16_t));
+	b->lw = (Float *) malloc(lanes * sizeof(Float));
+	b->incr = (double *) malloc(lanes * sizeof(double));
+	b->cnt = (sint32_t *) malloc(lanes * sizeof(sint32_t));
+	if (!b->lc || !b->history || !b->idx || !b->onset || !b->pitchbuf || !b->synth || !b->good || !b->lw || !b->incr || !b->cnt) {
+		g711plc_batch_release(b);
+		return -1;
+	}
+	for (j = 0; j < streams; j++) {
+		g711plc_construct(&b->lc[j]);
+	}
+	return 0;
+}
+
+/**
+ * @brief 
+ * Conceal one frame of every stream, the same as g711plc_dofe on the erased streams and
+ * g711plc_addtohistory on the others. frame is [FRAMESZ][lanes], stream j in column j,
+ * the output is delayed by POVERLAPMAX like the scalar path.
+ */
+void g711plc_batch_frame(LowcFE_batch_c *b, sint16_t *frame, const uint8_t *erased) {
+	uint32_t lanes = b->lanes;
+	uint32_t j, k, m, n;
+	sint32_t i, olen, olen_max;
+	sint16_t col[FRAMESZ];
+	LowcFE_c *lc;
+
+	/* per stream paths, the onset and gain decay lanes are compacted for the lockstep loops */
+	m = 0;
+	n = 0;
+	for (j = 0; j < b->streams; j++) {
+		if (!erased[j]) {
+			continue;
+		}
+		lc = &b->lc[j];
+		b->erased++;
+		if (lc->erasecnt == 0) {
+			b->onset[n++] = j;
+			continue;
+		} else if (lc->erasecnt == 1 || lc->erasecnt == 2) {
+			g711plc_synth(lc, col);
+		} else if (lc->erasecnt > 5) {
+			g711plc_zeros(col, FRAMESZ);
+			lc->erasecnt++;
+		} else {
+			b->idx[m++] = j;
+			continue;
+		}
+		for (i = 0; i < FRAMESZ; i++) {
+			frame[i * lanes + j] = col[i];
+		}
+	}
+
+	/* erasure onset, coarse pitch search in lockstep on the gathered history, then per stream */
+	if (n) {
+		uint32_t np = (n + LOWCFE_BLOCK - 1) / LOWCFE_BLOCK * LOWCFE_BLOCK;
+		for (i = 0; i < HISTORYLEN; i++) {
+			sint16_t *row = g711plc_batch_row(b, i);
+			Float *p = &b->pitchbuf[i * np];
+			for (k = 0; k < n; k++) {
+				p[k] = (Float) row[b->onset[k]];
+			}
+			for (; k < np; k++) {
+				p[k] = (Float) 0.;
+			}
+		}
+		g711plc_batch_coarse(b, np);
+		/* transpose to the pitch buffer of every stream, a cache line of rows at a time */
+		for (i = 0; i < HISTORYLEN; i += LOWCFE_BLOCK) {
+			sint32_t rows = (HISTORYLEN - i < LOWCFE_BLOCK)? HISTORYLEN - i : LOWCFE_BLOCK;
+			for (k = 0; k < n; k++) {
+				Float *t = &b->lc[b->onset[k]].pitchbuf[i];
+				sint32_t ii;
+				for (ii = 0; ii < rows; ii++) {
+					t[ii] = b->pitchbuf[(i + ii) * np + k];
+				}
+			}
+		}
+		for (k = 0; k < n; k++) {
+			j = b->onset[k];
+			lc = &b->lc[j];
+			lc->pitch = g711plc_findpitch_fine(lc, b->cnt[k]);
+			g711plc_onset(lc, col);
+			lc->erasecnt++;
+			/* scatter back the updated 1/4 wavelength */
+			for (i = HISTORYLEN - lc->poverlap; i < HISTORYLEN; i++) {
+				g711plc_batch_row(b, i)[j] = lc->history[i];
+			}
+			for (i = 0; i < FRAMESZ; i++) {
+				frame[i * lanes + j] = col[i];
+			}
+		}
+		b->onsets += n;
+	}
+
+	/* gain decay, g711plc_scalespeech over the compacted lanes, rows of m lanes, the ramp in double like gDspKernel.gain_ramp */
+	if (m) {
+		for (k = 0; k < m; k++) {
+			lc = &b->lc[b->idx[k]];
+			g711plc_getfespeech(lc, col, FRAMESZ);
+			for (i = 0; i < FRAMESZ; i++) {
+				b->synth[i * m + k] = col[i];
+			}
+			b->lw[k] = (Float) 1. - (lc->erasecnt - 1) * ATTENFAC;
+			lc->erasecnt++;
+		}
+		for (i = 0; i < FRAMESZ; i++) {
+			sint16_t *w = &b->synth[i * m];
+			Float *g = b->lw;
+			for (k = 0; k < m; k++) {
+				w[k] = (sint16_t) (w[k] * ((double) g[k] - (double) i * ATTENINCR));
+			}
+		}
+		for (i = 0; i < FRAMESZ; i++) {
+			for (k = 0; k < m; k++) {
+				frame[i * lanes + b->idx[k]] = b->synth[i * m + k];
+			}
+		}
+	}
+
+	/* end of erasure, g711plc_overlapaddatend over the compacted lanes, rows of m lanes */
+	m = 0;
+	olen_max = 0;
+	for (j = 0; j < b->streams; j++) {
+		Float gain;
+		lc = &b->lc[j];
+		if (erased[j] || lc->erasecnt == 0) {
+			continue;
+		}
+		olen = lc->poverlap + (lc->erasecnt - 1) * EOVERLAPINCR;
+		if (olen > FRAMESZ) {
+			olen = FRAMESZ;
+		}
+		gain = (Float) 1. - (lc->erasecnt - 1) * ATTENFAC;
+		if (gain < 0.) {
+			gain = (Float) 0.;
+		}
+		b->cnt[m] = olen;
+		b->incr[m] = 1. / olen;
+		b->lw[m] = gain;
+		if (olen > olen_max) {
+			olen_max = olen;
+		}
+		b->idx[m++] = j;
+	}
+	if (m) {
+		for (k = 0; k < m; k++) {
+			j = b->idx[k];
+			lc = &b->lc[j];
+			g711plc_getfespeech(lc, col, b->cnt[k]);
+			lc->erasecnt = 0;
+			for (i = 0; i < olen_max; i++) {
+				b->synth[i * m + k] = (i < b->cnt[k])? col[i] : 0;
+				b->good[i * m + k] = frame[i * lanes + j];
+			}
+		}
+		for (i = 0; i < olen_max; i++) {
+			sint16_t *f = &b->synth[i * m];
+			sint16_t *s = &b->good[i * m];
+			for (k = 0; k < m; k++) {
+				double w = (double) (i + 1) * b->incr[k];
+				double t = (1. - w) * b->lw[k] * f[k] + w * s[k];
+				t = (t > 32767.)? 32767. : ((t < -32768.)? -32768. : t);
+				s[k] = (i < b->cnt[k])? (sint16_t) t : s[k];
+			}
+		}
+		for (i = 0; i < olen_max; i++) {
+			for (k = 0; k < m; k++) {
+				frame[i * lanes + b->idx[k]] = b->good[i * m + k];
+			}
+		}
+	}
+
+	/* g711plc_savespeech of every stream, the shift is a move of the ring head */
+	b->head = (b->head + FRAMESZ) % HISTORYLEN;
+	for (i = 0; i < FRAMESZ; i++) {
+		memcpy(g711plc_batch_row(b, HISTORYLEN - FRAMESZ + i), &frame[i * lanes], lanes * sizeof(sint16_t));
+	}
+	for (i = 0; i < FRAMESZ; i++) {
+		memcpy(&frame[i * lanes], g711plc_batch_row(b, HISTORYLEN - FRAMESZ - POVERLAPMAX + i), lanes * sizeof(sint16_t));
+	}
+	b->frames += b->streams;
+}
+
+void g711plc_batch_release(LowcFE_batch_c *b) {
+	free(b->lc);
+	free(b->history);
+	free(b->idx);
+	free(b->onset);
+	free(b->pitchbuf);
+	free(b->synth);
+	free(b->good);
+	free(b->lw);
+	free(b->incr);
+	free(b->cnt);
+	memset(b, 0, sizeof(LowcFE_batch_c));
+}
@@ -33,9 +33,38 @@ typedef struct _LowcFE_c {
 	sint16_t history[HISTORYLEN];	/* history buffer */
 } LowcFE_c;
 
+#define LOWCFE_LANE_ALIGN (16) /* lanes of the batch rounded up to a multiple, 32 bytes of sint16_t */
+
+// many streams concealed in lockstep, frame by frame, bit exact with a LowcFE_c per stream.
+// the history of all streams is one ring of HISTORYLEN rows x lanes, the savespeech shift becomes a moving head,
+// the coarse pitch search at an erasure onset, the gain and the end of erasure OLA run over the compacted lanes,
+// the fine pitch search and the pitch buffer extension of the first erased frames stay per stream
+typedef struct _LowcFE_batch_c {
+	uint32_t streams;
+	uint32_t lanes;					/* row stride, streams rounded up to LOWCFE_LANE_ALIGN */
+	uint32_t head;					/* ring row of the oldest history sample */
+	LowcFE_c *lc;					/* per stream state, its history only as scratch at an erasure onset */
+	sint16_t *history;				/* ring [HISTORYLEN][lanes] */
+	uint32_t *idx;					/* compacted lanes */
+	uint32_t *onset;				/* compacted lanes at an erasure onset */
+	Float *pitchbuf;				/* history of the onset lanes [HISTORYLEN][onsets rounded up] */
+	sint16_t *synth;				/* compacted frames [FRAMESZ][compacted lanes] */
+	sint16_t *good;
+	Float *lw;						/* per compacted lane, gain */
+	double *incr;					/* per compacted lane, OLA weight step, double like gDspKernel.ola_s16 */
+	sint32_t *cnt;					/* per compacted lane, OLA length or coarse pitch match */
+	uint64_t frames;				/* stream frames processed */
+	uint64_t erased;
+	uint64_t onsets;				/* erasure onsets, the pitch searches */
+} LowcFE_batch_c;
+
 /*-------------------- FUNCTIONS --------------------*/
 void g711plc_construct (LowcFE_c *); /* constructor */
 void g711plc_dofe (LowcFE_c *, short *s); /* synthesize speech for erasure */
 void g711plc_addtohistory (LowcFE_c *, short *s); /* add a good frame to history buffer */
+int g711plc_batch_construct (LowcFE_batch_c *, uint32_t streams); /* 0 success, -1 fail */
+void g711plc_batch_frame (LowcFE_batch_c *, sint16_t *frame, const uint8_t *erased); /* frame [FRAMESZ][lanes] in and delayed out, erased[streams] */
+void g711plc_batch_release (LowcFE_batch_c *);
+sint32_t g711plc_xcorr_search (const Float *l, const Float *r, sint32_t lo, sint32_t hi, sint32_t len, sint32_t dec, Float minpower, bool last_tie); /* best lag of r against l */
 
 #endif
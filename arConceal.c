@@ -0,0 +1,274 @@
+/**
+ * @file arConceal.c
+ * @author weiyuan.hsu
+ * @brief
+ * implement of the autoregressive concealment
+ *
+ * ar_burg_fit: ............ Burg's method on the context, the forward / backward prediction errors are kept
+ * 							 in two arrays and the backward one is stored one sample earlier every order,
+ * 							 so the reflection coefficient (the three sums of gDspKernel.dot3_double) and
+ * 							 the lattice update run on contiguous memory with SIMD. The sums and the
+ * 							 levinson step of the filter coefficients are double, at orders up to
+ * 							 AR_ORDER_MAX the poles of a nearly singular fit (pure tones) would follow the
+ * 							 summation order of a float sum, so the fit is the same on every set.
+ *
+ * ar_predict: ............. Runs the prediction filter over the gap, the coefficients are stored reversed
+ * 							 so every predicted sample is one dot_double with the last order samples.
+ * 							 The order follows the gap length, a one sample gap needs far less model
+ * 							 (and context) than a 2048 sample one.
+ *
+ * ar_conceal: ............. Each gap is predicted forward from the samples before it and backward from the
+ * 							 (time reversed) samples after it, the two predictions are cross faded with a
+ * 							 raised cosine. With a single side, the prediction is carried one sample past
+ * 							 the gap and its miss of the known sample there is ramped out over the gap.
+ * 							 A fit is reused for the gaps within AR_REUSE_MS, so thousands of small gaps
+ * 							 per second (interleave lost) cost only a few fits. The forward side is only
+ * 							 fitted when its context is mostly received (gaps at least order apart), the
+ * 							 recursion over concealed samples diverges, and the result is clamped to the
+ * 							 peak of the contexts. Without a side the gap is a line between its edges.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "arch.h"
+#include "config.h"
+#include "utility.h"
+#include "lostGap.h"
+#include "arConceal.h"
+#include "bufferPool.h"
+#include "dspKernel.h"
+
+/*-------------------- CONFIGURATION --------------------*/
+typedef struct _ar_model_c {
+	float coef[AR_ORDER_MAX];	/* reversed prediction filter, x[t] = sum coef[j] * x[t - order + j] */
+	uint32_t order;
+	uint32_t pos;				/* gap start of the fit */
+	bool valid;
+} ar_model_c;
+
+typedef struct _ar_work_c {
+	float *f, *b;				/* AR_CONTEXT_MAX, burg prediction errors */
+	float *ctx;					/* AR_CONTEXT_MAX, reversed context of the backward side */
+	float *fwd, *bwd;			/* AR_ORDER_MAX + gap + 1, history then prediction */
+} ar_work_c;
+
+/*-------------------- INTERNAL FUNCTIONS --------------------*/
+/**
+ * @brief
+ * burg fit of the given order on x[0, num), num > order
+ */
+static void ar_burg_fit(ar_work_c *w, const float *x, uint32_t num, uint32_t order, ar_model_c *model) {
+	double a[AR_ORDER_MAX + 1], rev[AR_ORDER_MAX + 1];
+	uint32_t m, j;
+
+	memset(a, 0x0, sizeof(a));
+	a[0] = 1.0;
+	memcpy(w->f, x, sizeof(float) * num);
+	memcpy(w->b, x, sizeof(float) * num);
+
+	/* order m pairs f[i] with the order m-1 backward error of i-1, kept at b[i - m] */
+	for( m=1; m<=order; m++ ) {
+		uint32_t len = num - m;
+		double sums[3], den_k, k;
+
+		gDspKernel.dot3_double(w->f + m, w->b, len, sums);
+		den_k = sums[1] + sums[2];
+		k = (den_k > 1e-20) ? -2.0 * sums[0] / den_k : 0.0;
+
+		if( (float)k == 0.0f ) {
+			break;
+		}
+		gDspKernel.lattice(w->f + m, w->b, (float)k, len);
+
+		/* a[j] += k a[m - j] */
+		for( j=0; j<=m; j++ ) {
+			rev[j] = a[m - j];
+		}
+		for( j=0; j<=m; j++ ) {
+			a[j] += k * rev[j];
+		}
+	}
+
+	for( j=0; j<order; j++ ) {
+		model->coef[j] = (float)-a[order - j];
+	}
+	model->order = order;
+	model->valid = true;
+}
+
+/**
+ * @brief
+ * predict num samples after the model->order history samples at buf
+ */
+static void ar_predict(const ar_model_c *model, float *buf, uint32_t num) {
+	uint32_t t;
+	for( t=0; t<num; t++ ) {
+		buf[model->order + t] = (float)gDspKernel.dot_double(model->coef, buf + t, model->order);
+	}
+}
+
+static uint32_t ar_order(uint32_t len) {
+	uint32_t order = (len / AR_ORDER_GAP_DIV + 7) & ~7u;
+	order = (order < AR_ORDER_MIN) ? AR_ORDER_MIN : order;
+	return (order > AR_ORDER_MAX) ? AR_ORDER_MAX : order;
+}
+
+/**
+ * @brief
+ * true when x[s - ctx, s) before gap g holds at least min_num received samples and its gaps are not closer together
+ * than order, the concealed samples of denser gaps would feed the predictions back into the fit and the history
+ */
+static bool ar_received(const lost_gap_list_c *list, uint32_t g, uint32_t s, uint32_t ctx, uint32_t order, uint32_t min_num) {
+	uint32_t lost = 0, gaps = 0;
+	while( g > 0 && list->gap[g-1].start + list->gap[g-1].len > s - ctx ) {
+		const lost_gap_c *p = &list->gap[--g];
+		lost += p->start + p->len - ((p->start > s - ctx) ? p->start : s - ctx);
+		gaps++;
+		if( gaps * order > ctx ) {
+			return false;
+		}
+	}
+	return (ctx - lost >= min_num);
+}
+
+/**
+ * @brief
+ * peak magnitude of x[0, num), the bound of the predictions fitted on it
+ */
+static float ar_peak(const float *x, uint32_t num) {
+	float min_val, max_val, sum_sq;
+	gDspKernel.reduce(x, num, &min_val, &max_val, &sum_sq);
+	return (-min_val > max_val) ? -min_val : max_val;
+}
+
+static void ar_line(float *x, uint32_t num, uint32_t s, uint32_t len) {
+	uint32_t j;
+	/* a gap at the channel edge stays muted */
+	if( s == 0 || s + len >= num ) {
+		memset(&x[s], 0x0, sizeof(float) * len);
+		return;
+	}
+	for( j=0; j<len; j++ ) {
+		x[s + j] = x[s - 1] + (x[s + len] - x[s - 1]) * (float)(j + 1) / (float)(len + 1);
+	}
+}
+
+static void ar_work_free(ar_work_c *w) {
+	bufpool_free(&gBufPool, w->f);
+	bufpool_free(&gBufPool, w->fwd);
+}
+
+static sint32_t ar_work_alloc(ar_work_c *w, uint32_t gap_max) {
+	memset(w, 0x0, sizeof(ar_work_c));
+	w->f = (float *)bufpool_alloc(&gBufPool, sizeof(float) * AR_CONTEXT_MAX * 3);
+	w->fwd = (float *)bufpool_alloc(&gBufPool, sizeof(float) * (AR_ORDER_MAX + gap_max + 1) * 2);
+	if( w->f == NULL || w->fwd == NULL ) {
+		ar_work_free(w);
+		return -1;
+	}
+	w->b = w->f + AR_CONTEXT_MAX;
+	w->ctx = w->b + AR_CONTEXT_MAX;
+	w->bwd = w->fwd + AR_ORDER_MAX + gap_max + 1;
+	return 0;
+}
+
+/*-------------------- FUNCTIONS --------------------*/
+/**
+ * @brief
+ * conceal every gap of the list in a single channel pcm buffer
+ */
+void ar_conceal(uint8_t *pBuf, uint16_t bit_per_sample, uint32_t sample_rate, lost_gap_list_c *list) {
+	uint32_t sample_bytes = bit_per_sample / 8;
+	uint32_t num = list->samples;
+	uint32_t reuse = (uint32_t)((uint64_t)sample_rate * AR_REUSE_MS / 1000);
+	uint32_t g, t, gap_max = 1;
+	ar_model_c fm, bm;
+	ar_work_c w;
+	float *x;
+
+	if( list->num == 0 ) {
+		return;
+	}
+	for( g=0; g<list->num; g++ ) {
+		gap_max = (list->gap[g].len > gap_max) ? list->gap[g].len : gap_max;
+	}
+	x = (float *)bufpool_alloc(&gBufPool, sizeof(float) * num);
+	if( x == NULL || ar_work_alloc(&w, gap_max) != 0 ) {
+		printf("Allocation memory error");
+		bufpool_free(&gBufPool, x);
+		return;
+	}
+	pcm_to_float(pBuf, bit_per_sample, sample_bytes, x, num);
+	memset(&fm, 0x0, sizeof(ar_model_c));
+	memset(&bm, 0x0, sizeof(ar_model_c));
+
+	for( g=0; g<list->num; g++ ) {
+		uint32_t s = list->gap[g].start, len = list->gap[g].len, e = s + len;
+		uint32_t next = (g + 1 < list->num) ? list->gap[g+1].start : num;
+		uint32_t order = ar_order(len);
+		uint32_t ctx_max = order * AR_CONTEXT_ORDERS;
+		/* gaps before are concealed already, gaps after are not */
+		uint32_t ctx_f = (s < ctx_max) ? s : ctx_max;
+		uint32_t ctx_b = (next - e < ctx_max) ? next - e : ctx_max;
+		bool use_f = false, use_b = false;
+		float peak = 0.0f;
+
+		if( ctx_f >= order * AR_CONTEXT_MIN_ORDERS && ar_received(list, g, s, ctx_f, order, order * AR_CONTEXT_MIN_ORDERS) ) {
+			if( !fm.valid || fm.order != order || s - fm.pos > reuse ) {
+				ar_burg_fit(&w, &x[s - ctx_f], ctx_f, order, &fm);
+				fm.pos = s;
+			}
+			memcpy(w.fwd, &x[s - order], sizeof(float) * order);
+			ar_predict(&fm, w.fwd, len + ((e < num) ? 1 : 0));
+			peak = ar_peak(&x[s - ctx_f], ctx_f);
+			use_f = true;
+		}
+		if( ctx_b >= order * AR_CONTEXT_MIN_ORDERS ) {
+			for( t=0; t<ctx_b; t++ ) {
+				w.ctx[t] = x[e + ctx_b - 1 - t];
+			}
+			if( !bm.valid || bm.order != order || s - bm.pos > reuse ) {
+				ar_burg_fit(&w, w.ctx, ctx_b, order, &bm);
+				bm.pos = s;
+			}
+			memcpy(w.bwd, &w.ctx[ctx_b - order], sizeof(float) * order);
+			ar_predict(&bm, w.bwd, len + ((s > 0) ? 1 : 0));
+			peak = fmaxf(peak, ar_peak(w.ctx, ctx_b));
+			use_b = true;
+		}
+
+		if( use_f && use_b ) {
+			for( t=0; t<len; t++ ) {
+				float c = sinf((float)M_PI * 0.5f * (float)(t + 1) / (float)(len + 1));
+				c *= c;
+				x[s + t] = (1.0f - c) * w.fwd[order + t] + c * w.bwd[order + len - 1 - t];
+			}
+		} else if( use_f ) {
+			float miss = (e < num) ? x[e] - w.fwd[order + len] : 0.0f;
+			for( t=0; t<len; t++ ) {
+				x[s + t] = w.fwd[order + t] + miss * (float)(t + 1) / (float)(len + 1);
+			}
+		} else if( use_b ) {
+			float miss = (s > 0) ? x[s - 1] - w.bwd[order + len] : 0.0f;
+			for( t=0; t<len; t++ ) {
+				x[s + t] = w.bwd[order + len - 1 - t] + miss * (float)(len - t) / (float)(len + 1);
+			}
+		} else {
+			ar_line(x, num, s, len);
+		}
+		if( use_f || use_b ) {
+			for( t=0; t<len; t++ ) {
+				x[s + t] = (x[s + t] > peak) ? peak : ((x[s + t] < -peak) ? -peak : x[s + t]);
+			}
+		}
+		float_to_pcm(&x[s], bit_per_sample, sample_bytes, pBuf + (size_t)s * sample_bytes, len);
+	}
+
+	ar_work_free(&w);
+	bufpool_free(&gBufPool, x);
+}
@@ -0,0 +1,21 @@
+#ifndef _H_ARCONCEAL_
+#define _H_ARCONCEAL_
+
+#include "arch.h"
+#include "lostGap.h"
+
+// autoregressive (burg) extrapolation of the lost gaps, for the sample level lost types
+
+/*-------------------- CONFIGURATION --------------------*/
+#define AR_ORDER_MIN (16)
+#define AR_ORDER_MAX (128)
+#define AR_ORDER_GAP_DIV (4) /* order = gap / 4 rounded up to 8, in [AR_ORDER_MIN, AR_ORDER_MAX] */
+#define AR_CONTEXT_ORDERS (32) /* fit on up to 32 * order samples on each side of a gap */
+#define AR_CONTEXT_MIN_ORDERS (4) /* a side with less than 4 * order clean samples is not fitted */
+#define AR_CONTEXT_MAX (AR_CONTEXT_ORDERS * AR_ORDER_MAX)
+#define AR_REUSE_MS (5) /* coefficients fitted within this distance are reused */
+
+/*-------------------- FUNCTIONS --------------------*/
+void ar_conceal(uint8_t *pBuf, uint16_t bit_per_sample, uint32_t sample_rate, lost_gap_list_c *list);
+
+#endif
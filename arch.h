@@ -1,16 +1,14 @@
 #ifndef _ARCH_H_
 #define _ARCH_H_
 
+#include <stdint.h>
 #include "config.h"
 
 // basic data type
-typedef unsigned char		uint8_t;  // 1 byte
+// uint8_t, uint16_t, uint32_t, uint64_t come from stdint.h, so system headers including it do not clash
 typedef char				sint8_t;  // 1 byte \ 8 bit
-typedef unsigned short		uint16_t; // 2 byte \ 16 bit
-typedef short				sint16_t;
-typedef unsigned int		uint32_t; // 4 byte \ 32 bit
-typedef int					sint32_t;
-typedef unsigned long long	uint64_t;
+typedef short				sint16_t; // 2 byte \ 16 bit
+typedef int					sint32_t; // 4 byte \ 32 bit
 typedef long long			sint64_t;
 
 #if USEDOUBLES
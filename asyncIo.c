@@ -0,0 +1,452 @@
+/**
+ * @file asyncIo.c
+ * @author weiyuan.hsu
+ * @brief
+ * implement of asynchronous read-ahead / write-behind file I/O
+ *
+ * aio_prefetch: ........... Queue a read of a whole input file. A worker thread reads it into a pool
+ * 							 buffer while the current file is processed.
+ *
+ * aio_fopen_read: ......... Wait for the prefetched file and hand it out as a FILE* on the memory
+ * 							 (fmemopen), so the RIFF parsing keeps its fread/fseek calls. Files which
+ * 							 were not prefetched are opened with plain fopen.
+ *
+ * aio_fopen_write: ........ Give a FILE* on a growing memory buffer (open_memstream). On
+ * aio_fclose_write: ....... close the buffer is queued and a worker writes it to disk in background.
+ *
+ * worker: ................. Each I/O thread owns an io_uring and splits a file in AIO_CHUNK_SIZE
+ * 							 requests, up to AIO_URING_DEPTH in flight. Without URING_EN (config.h, link
+ * 							 with -luring) or when the ring can not be created the thread uses pread/pwrite.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include "arch.h"
+#include "config.h"
+#include "bufferPool.h"
+#include "asyncIo.h"
+#if (URING_EN == 1)
+#include <liburing.h>
+#define AIO_HAVE_URING (1)
+#else
+#define AIO_HAVE_URING (0)
+#endif
+
+/*-------------------- CONFIGURATION --------------------*/
+enum {
+	AIOJOB_READ = 0,
+	AIOJOB_WRITE,
+};
+
+enum {
+	AIOSTATE_PENDING = 0,
+	AIOSTATE_RUNNING,
+	AIOSTATE_DONE,
+	AIOSTATE_FAIL,
+};
+
+typedef struct _aio_job_c {
+	uint8_t type;
+	uint8_t state;
+	char name[256];
+	uint8_t *buf;		/* read : pool buffer, write : memstream buffer */
+	size_t size;
+	struct _aio_job_c *next;
+} aio_job_c;
+
+typedef struct _aio_file_c {
+	FILE *fp;
+	uint8_t type;
+	char name[256];
+	char *buf;
+	size_t size;
+} aio_file_c;
+
+/*-------------------- GLOBAL PARAMETER --------------------*/
+static pthread_t aio_thread[AIO_THREAD_MAX];
+static uint8_t aio_thread_num = 0;
+static uint8_t aio_uring_num = 0;	/* threads running on io_uring */
+static pthread_mutex_t aio_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t aio_job_cond = PTHREAD_COND_INITIALIZER;	/* new job or exit */
+static pthread_cond_t aio_done_cond = PTHREAD_COND_INITIALIZER;	/* job finished */
+static aio_job_c *aio_job_head = NULL;	/* jobs in submission order */
+static uint32_t aio_write_inflight = 0;
+static uint32_t aio_write_fail = 0;
+static bool aio_quit = 0;
+static aio_file_c aio_file[AIO_FILE_MAX];
+
+/*-------------------- INTERNAL FUNCTIONS --------------------*/
+static void aio_job_append(aio_job_c *job) {
+	aio_job_c **pp = &aio_job_head;
+	while (*pp != NULL) {
+		pp = &(*pp)->next;
+	}
+	job->next = NULL;
+	*pp = job;
+}
+
+static void aio_job_unlink(aio_job_c *job) {
+	aio_job_c **pp = &aio_job_head;
+	while (*pp != NULL && *pp != job) {
+		pp = &(*pp)->next;
+	}
+	if (*pp != NULL) {
+		*pp = job->next;
+	}
+}
+
+static aio_job_c *aio_job_find(uint8_t type, char *name) {
+	aio_job_c *job;
+	for (job = aio_job_head; job != NULL; job = job->next) {
+		if (job->type == type && strcmp(job->name, name) == 0) {
+			return job;
+		}
+	}
+	return NULL;
+}
+
+static aio_file_c *aio_file_find(FILE *fp) {
+	sint32_t i;
+	for (i = 0; i < AIO_FILE_MAX; i++) {
+		if (aio_file[i].fp == fp) {
+			return &aio_file[i];
+		}
+	}
+	return NULL;
+}
+
+static bool aio_posix_transfer(sint32_t fd, uint8_t *buf, size_t size, off_t offset, bool is_write) {
+	while (size > 0) {
+		ssize_t ret = is_write ? pwrite(fd, buf, size, offset) : pread(fd, buf, size, offset);
+		if (ret <= 0) {
+			return 0;
+		}
+		buf += ret;
+		size -= ret;
+		offset += ret;
+	}
+	return 1;
+}
+
+#if AIO_HAVE_URING
+static bool aio_uring_transfer(struct io_uring *ring, sint32_t fd, uint8_t *buf, size_t size, bool is_write) {
+	size_t off = 0;
+	bool ok = 1;
+	while (off < size && ok) {
+		uint32_t n = 0, i;
+		while (n < AIO_URING_DEPTH && off < size) {
+			struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+			size_t len = (size - off > AIO_CHUNK_SIZE) ? AIO_CHUNK_SIZE : size - off;
+			if (sqe == NULL) {
+				break;
+			}
+			if (is_write) {
+				io_uring_prep_write(sqe, fd, buf + off, (unsigned)len, off);
+			} else {
+				io_uring_prep_read(sqe, fd, buf + off, (unsigned)len, off);
+			}
+			io_uring_sqe_set_data(sqe, (void *)(uintptr_t)off);
+			off += len;
+			n++;
+		}
+		if (io_uring_submit_and_wait(ring, n) < 0) {
+			return 0;
+		}
+		/* reap every completion, a short transfer is finished with pread/pwrite */
+		for (i = 0; i < n; i++) {
+			struct io_uring_cqe *cqe;
+			size_t coff, clen;
+			sint32_t res;
+			if (io_uring_wait_cqe(ring, &cqe) < 0) {
+				return 0;
+			}
+			res = cqe->res;
+			coff = (size_t)(uintptr_t)io_uring_cqe_get_data(cqe);
+			io_uring_cqe_seen(ring, cqe);
+			clen = (size - coff > AIO_CHUNK_SIZE) ? AIO_CHUNK_SIZE : size - coff;
+			if (res < 0) {
+				ok = 0;
+			} else if ((size_t)res < clen) {
+				ok = ok && aio_posix_transfer(fd, buf + coff + res, clen - res, coff + res, is_write);
+			}
+		}
+	}
+	return ok;
+}
+#endif
+
+static bool aio_do_job(aio_job_c *job, void *ring) {
+	struct stat st;
+	sint32_t fd;
+	bool ok;
+
+	if (job->type == AIOJOB_READ) {
+		fd = open(job->name, O_RDONLY);
+		if (fd < 0 || fstat(fd, &st) != 0) {
+			if (fd >= 0) {
+				close(fd);
+			}
+			return 0;
+		}
+		job->size = st.st_size;
+		job->buf = (uint8_t *)bufpool_alloc(&gBufPool, job->size ? job->size : 1);
+		if (job->buf == NULL) {
+			close(fd);
+			return 0;
+		}
+	} else {
+		fd = open(job->name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			return 0;
+		}
+	}
+#if AIO_HAVE_URING
+	if (ring != NULL) {
+		ok = aio_uring_transfer((struct io_uring *)ring, fd, job->buf, job->size, job->type == AIOJOB_WRITE);
+	} else
+#endif
+	{
+		ok = aio_posix_transfer(fd, job->buf, job->size, 0, job->type == AIOJOB_WRITE);
+	}
+	close(fd);
+	return ok;
+}
+
+static void *aio_worker(void *arg) {
+	void *ring = NULL;
+	aio_job_c *job;
+	bool ok;
+#if AIO_HAVE_URING
+	struct io_uring uring;
+	if (io_uring_queue_init(AIO_URING_DEPTH, &uring, 0) == 0) {
+		ring = &uring;
+		pthread_mutex_lock(&aio_lock);
+		aio_uring_num++;
+		pthread_mutex_unlock(&aio_lock);
+	}
+#endif
+
+	pthread_mutex_lock(&aio_lock);
+	while (1) {
+		for (job = aio_job_head; job != NULL && job->state != AIOSTATE_PENDING; job = job->next);
+		if (job == NULL) {
+			if (aio_quit) {
+				break;
+			}
+			pthread_cond_wait(&aio_job_cond, &aio_lock);
+			continue;
+		}
+		job->state = AIOSTATE_RUNNING;
+		pthread_mutex_unlock(&aio_lock);
+
+		ok = aio_do_job(job, ring);
+
+		pthread_mutex_lock(&aio_lock);
+		if (job->type == AIOJOB_WRITE) {
+			if (!ok) {
+				printf("Can't write %s in background.\n", job->name);
+				aio_write_fail++;
+			}
+			aio_write_inflight--;
+			aio_job_unlink(job);
+			free(job->buf);
+			free(job);
+		} else {
+			job->state = ok ? AIOSTATE_DONE : AIOSTATE_FAIL;
+		}
+		pthread_cond_broadcast(&aio_done_cond);
+	}
+	pthread_mutex_unlock(&aio_lock);
+
+#if AIO_HAVE_URING
+	if (ring != NULL) {
+		io_uring_queue_exit(&uring);
+	}
+#endif
+	return NULL;
+}
+
+/*-------------------- FUNCTIONS --------------------*/
+void aio_init(uint8_t threads) {
+	uint8_t i;
+	aio_quit = 0;
+	aio_thread_num = 0;
+	memset(aio_file, 0x0, sizeof(aio_file));
+	threads = (threads > AIO_THREAD_MAX) ? AIO_THREAD_MAX : threads;
+	for (i = 0; i < threads; i++) {
+		if (pthread_create(&aio_thread[aio_thread_num], NULL, aio_worker, NULL) == 0) {
+			aio_thread_num++;
+		}
+	}
+}
+
+void aio_exit(void) {
+	uint8_t i;
+	aio_job_c *job;
+	if (aio_thread_num == 0) {
+		return;
+	}
+	aio_drain();
+	pthread_mutex_lock(&aio_lock);
+	aio_quit = 1;
+	pthread_cond_broadcast(&aio_job_cond);
+	pthread_mutex_unlock(&aio_lock);
+	for (i = 0; i < aio_thread_num; i++) {
+		pthread_join(aio_thread[i], NULL);
+	}
+	aio_thread_num = 0;
+	aio_uring_num = 0;
+
+	/* prefetched files nobody opened */
+	while ((job = aio_job_head) != NULL) {
+		aio_job_head = job->next;
+		bufpool_free(&gBufPool, job->buf);
+		free(job);
+	}
+}
+
+const char *aio_backend_name(void) {
+	if (aio_thread_num == 0) {
+		return "blocking stdio";
+	}
+	return (aio_uring_num > 0) ? "io_uring" : "thread pool";
+}
+
+void aio_prefetch(char *name) {
+	aio_job_c *job;
+	if (aio_thread_num == 0) {
+		return;
+	}
+	pthread_mutex_lock(&aio_lock);
+	if (aio_job_find(AIOJOB_READ, name) == NULL && (job = (aio_job_c *)calloc(1, sizeof(aio_job_c))) != NULL) {
+		job->type = AIOJOB_READ;
+		job->state = AIOSTATE_PENDING;
+		strncpy(job->name, name, sizeof(job->name) - 1);
+		aio_job_append(job);
+		pthread_cond_signal(&aio_job_cond);
+	}
+	pthread_mutex_unlock(&aio_lock);
+}
+
+FILE *aio_fopen_read(char *name) {
+	aio_job_c *job;
+	aio_file_c *slot;
+	FILE *fp = NULL;
+
+	pthread_mutex_lock(&aio_lock);
+	job = aio_job_find(AIOJOB_READ, name);
+	if (job == NULL) {
+		pthread_mutex_unlock(&aio_lock);
+		return fopen(name, "rb");
+	}
+	while (job->state == AIOSTATE_PENDING || job->state == AIOSTATE_RUNNING) {
+		pthread_cond_wait(&aio_done_cond, &aio_lock);
+	}
+	aio_job_unlink(job);
+	slot = aio_file_find(NULL);
+	if (job->state == AIOSTATE_DONE && job->size > 0 && slot != NULL) {
+		fp = fmemopen(job->buf, job->size, "rb");
+	}
+	if (fp != NULL) {
+		slot->fp = fp;
+		slot->type = AIOJOB_READ;
+		slot->buf = (char *)job->buf;
+		slot->size = job->size;
+	} else {
+		bufpool_free(&gBufPool, job->buf);
+	}
+	pthread_mutex_unlock(&aio_lock);
+	free(job);
+
+	return (fp != NULL) ? fp : fopen(name, "rb");
+}
+
+void aio_fclose_read(FILE *fp) {
+	aio_file_c *slot;
+	char *buf = NULL;
+	pthread_mutex_lock(&aio_lock);
+	if ((slot = aio_file_find(fp)) != NULL) {
+		buf = slot->buf;
+		memset(slot, 0x0, sizeof(aio_file_c));
+	}
+	pthread_mutex_unlock(&aio_lock);
+	fclose(fp);
+	bufpool_free(&gBufPool, buf);
+}
+
+FILE *aio_fopen_write(char *name) {
+	aio_file_c *slot;
+	FILE *fp = NULL;
+	if (aio_thread_num == 0) {
+		return fopen(name, "wb");
+	}
+	pthread_mutex_lock(&aio_lock);
+	if ((slot = aio_file_find(NULL)) != NULL) {
+		slot->buf = NULL;
+		slot->size = 0;
+		fp = open_memstream(&slot->buf, &slot->size);
+		if (fp != NULL) {
+			slot->fp = fp;
+			slot->type = AIOJOB_WRITE;
+			strncpy(slot->name, name, sizeof(slot->name) - 1);
+		}
+	}
+	pthread_mutex_unlock(&aio_lock);
+	return (fp != NULL) ? fp : fopen(name, "wb");
+}
+
+/**
+ * @brief
+ * close a file from aio_fopen_write, the data is written in background
+ * @return int : 0 success (the write itself is checked by aio_drain), EOF fail
+ */
+int aio_fclose_write(FILE *fp) {
+	aio_file_c *slot;
+	aio_job_c *job;
+	pthread_mutex_lock(&aio_lock);
+	slot = aio_file_find(fp);
+	pthread_mutex_unlock(&aio_lock);
+	if (slot == NULL) {
+		return fclose(fp);
+	}
+	if (fclose(fp) != 0 || (job = (aio_job_c *)calloc(1, sizeof(aio_job_c))) == NULL) {
+		pthread_mutex_lock(&aio_lock);
+		free(slot->buf);
+		memset(slot, 0x0, sizeof(aio_file_c));
+		pthread_mutex_unlock(&aio_lock);
+		return EOF;
+	}
+
+	pthread_mutex_lock(&aio_lock);
+	job->type = AIOJOB_WRITE;
+	job->state = AIOSTATE_PENDING;
+	memcpy(job->name, slot->name, sizeof(job->name));
+	job->buf = (uint8_t *)slot->buf;
+	job->size = slot->size;
+	memset(slot, 0x0, sizeof(aio_file_c));
+	aio_job_append(job);
+	aio_write_inflight++;
+	pthread_cond_signal(&aio_job_cond);
+	pthread_mutex_unlock(&aio_lock);
+	return 0;
+}
+
+int aio_drain(void) {
+	int fail;
+	pthread_mutex_lock(&aio_lock);
+	while (aio_write_inflight > 0) {
+		pthread_cond_wait(&aio_done_cond, &aio_lock);
+	}
+	fail = aio_write_fail;
+	aio_write_fail = 0;
+	pthread_mutex_unlock(&aio_lock);
+	return fail;
+}
@@ -0,0 +1,27 @@
+#ifndef _H_ASYNCIO_
+#define _H_ASYNCIO_
+
+#include <stdio.h>
+#include "arch.h"
+
+// read-ahead of input files and write-behind of output files on background I/O threads,
+// the processing keeps using stdio FILE* (fmemopen / open_memstream)
+
+/*-------------------- CONFIGURATION --------------------*/
+#define AIO_THREAD_MAX (8)
+#define AIO_FILE_MAX (16) /* FILE* opened at the same time */
+#define AIO_CHUNK_SIZE (1 << 20) /* bytes per read/write request */
+#define AIO_URING_DEPTH (32)
+
+/*-------------------- FUNCTIONS --------------------*/
+void aio_init(uint8_t threads); /* 0 : disabled, every call falls back to blocking stdio */
+void aio_exit(void);
+const char *aio_backend_name(void);
+void aio_prefetch(char *name);
+FILE *aio_fopen_read(char *name);
+void aio_fclose_read(FILE *fp);
+FILE *aio_fopen_write(char *name);
+int aio_fclose_write(FILE *fp);
+int aio_drain(void); /* wait for queued writes, return the number of failed writes */
+
+#endif
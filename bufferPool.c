@@ -0,0 +1,179 @@
+/**
+ * @file bufferPool.c
+ * @author weiyuan.hsu
+ * @brief
+ * implement of the batch buffer pool
+ *
+ * bufpool_alloc: .......... Round the size up to a size class and take a cached buffer of that class,
+ * 							 or get a new 64 bytes aligned one from the system. A small header in front
+ * 							 of the buffer remembers the class.
+ *
+ * bufpool_free: ........... Put the buffer back to the free list of its class, buffers are only given
+ * 							 back to the system when the free list is full or the pool is destroyed,
+ * 							 so the next file or channel reuses memory which is already paged in. A cached
+ * 							 buffer carries BUFPOOL_MAGIC_FREE, a second free of it is refused.
+ *
+ * bufpool_show_stats: ..... Print the peak memory and the reuse rate of the batch.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arch.h"
+#include "config.h"
+#include "bufferPool.h"
+
+/*-------------------- CONFIGURATION --------------------*/
+#define BUFPOOL_MAGIC (0x42504f4c) /* "BPOL" */
+#define BUFPOOL_MAGIC_FREE (0x46504f4c) /* "FPOL", on a free list */
+#define BUFPOOL_CLASS_HUGE (-1) /* above the largest class, not cached */
+
+typedef struct _bufpool_header_c {
+	uint32_t magic;
+	sint32_t cls;
+	size_t size;	/* bytes reserved behind the header */
+} bufpool_header_c;
+
+/*-------------------- GLOBAL PARAMETER --------------------*/
+bufpool_c gBufPool;
+
+/*-------------------- INTERNAL FUNCTIONS --------------------*/
+static size_t bufpool_class_size(sint32_t cls) {
+	size_t base = (size_t)1 << (BUFPOOL_MIN_SHIFT + cls / BUFPOOL_SUB_CLASS);
+	return base + base / BUFPOOL_SUB_CLASS * (cls % BUFPOOL_SUB_CLASS);
+}
+
+static sint32_t bufpool_class(size_t size) {
+	sint32_t cls;
+	for( cls=0; cls<BUFPOOL_CLASS_NUM; cls++ ) {
+		if( size <= bufpool_class_size(cls) ) {
+			return cls;
+		}
+	}
+	return BUFPOOL_CLASS_HUGE;
+}
+
+static inline bufpool_header_c *bufpool_header(void *buf) {
+	return (bufpool_header_c *)((uint8_t *)buf - BUFPOOL_ALIGN);
+}
+
+static void bufpool_account(bufpool_c *pool) {
+	if( pool->bytes_in_use > pool->peak_in_use ) {
+		pool->peak_in_use = pool->bytes_in_use;
+	}
+	if( pool->bytes_reserved > pool->peak_reserved ) {
+		pool->peak_reserved = pool->bytes_reserved;
+	}
+}
+
+/*-------------------- FUNCTIONS --------------------*/
+void bufpool_init(bufpool_c *pool) {
+	memset(pool, 0x0, sizeof(bufpool_c));
+	pthread_mutex_init(&pool->lock, NULL);
+}
+
+void bufpool_destroy(bufpool_c *pool) {
+	sint32_t cls;
+	uint32_t i;
+	pthread_mutex_lock(&pool->lock);
+	for( cls=0; cls<BUFPOOL_CLASS_NUM; cls++ ) {
+		for( i=0; i<pool->freecnt[cls]; i++ ) {
+			bufpool_header_c *hdr = bufpool_header(pool->freelist[cls][i]);
+			pool->bytes_reserved -= hdr->size;
+			free(hdr);
+		}
+		pool->freecnt[cls] = 0;
+	}
+	pthread_mutex_unlock(&pool->lock);
+	pthread_mutex_destroy(&pool->lock);
+}
+
+/**
+ * @brief
+ * get a BUFPOOL_ALIGN aligned buffer of at least size bytes, content is not cleared
+ * @return void* : NULL if the system is out of memory
+ */
+void *bufpool_alloc(bufpool_c *pool, size_t size) {
+	sint32_t cls = bufpool_class(size);
+	size_t reserve = (cls == BUFPOOL_CLASS_HUGE) ? (size + BUFPOOL_ALIGN - 1) / BUFPOOL_ALIGN * BUFPOOL_ALIGN : bufpool_class_size(cls);
+	bufpool_header_c *hdr = NULL;
+	void *buf = NULL;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->alloc_cnt++;
+	if( cls != BUFPOOL_CLASS_HUGE && pool->freecnt[cls] > 0 ) {
+		buf = pool->freelist[cls][--pool->freecnt[cls]];
+		bufpool_header(buf)->magic = BUFPOOL_MAGIC;
+		pool->reuse_cnt++;
+		pool->bytes_in_use += reserve;
+		bufpool_account(pool);
+		pthread_mutex_unlock(&pool->lock);
+		return buf;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	hdr = (bufpool_header_c *)aligned_alloc(BUFPOOL_ALIGN, BUFPOOL_ALIGN + reserve);
+	if( hdr == NULL ) {
+		return NULL;
+	}
+	hdr->magic = BUFPOOL_MAGIC;
+	hdr->cls = cls;
+	hdr->size = reserve;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->system_cnt++;
+	pool->bytes_in_use += reserve;
+	pool->bytes_reserved += reserve;
+	bufpool_account(pool);
+	pthread_mutex_unlock(&pool->lock);
+	return (uint8_t *)hdr + BUFPOOL_ALIGN;
+}
+
+void *bufpool_calloc(bufpool_c *pool, size_t size) {
+	void *buf = bufpool_alloc(pool, size);
+	if( buf != NULL ) {
+		memset(buf, 0x0, size);
+	}
+	return buf;
+}
+
+void bufpool_free(bufpool_c *pool, void *buf) {
+	bufpool_header_c *hdr;
+	if( buf == NULL ) {
+		return;
+	}
+	hdr = bufpool_header(buf);
+
+	/* checked under the lock, two frees of the same buffer must not both pass */
+	pthread_mutex_lock(&pool->lock);
+	if( hdr->magic != BUFPOOL_MAGIC ) {
+		pthread_mutex_unlock(&pool->lock);
+		if( hdr->magic == BUFPOOL_MAGIC_FREE ) {
+			printf("bufpool : double free of a buffer\n");
+		} else {
+			printf("bufpool : free of a buffer not from the pool\n");
+		}
+		return;
+	}
+	pool->bytes_in_use -= hdr->size;
+	if( hdr->cls != BUFPOOL_CLASS_HUGE && pool->freecnt[hdr->cls] < BUFPOOL_FREE_MAX ) {
+		hdr->magic = BUFPOOL_MAGIC_FREE;
+		pool->freelist[hdr->cls][pool->freecnt[hdr->cls]++] = buf;
+		pthread_mutex_unlock(&pool->lock);
+		return;
+	}
+	pool->bytes_reserved -= hdr->size;
+	pthread_mutex_unlock(&pool->lock);
+	free(hdr);
+}
+
+void bufpool_show_stats(bufpool_c *pool) {
+	printf("-----[ buffer pool ]-----\n");
+	printf("alloc : %llu, reuse : %llu, system : %llu\n", (unsigned long long)pool->alloc_cnt, (unsigned long long)pool->reuse_cnt, (unsigned long long)pool->system_cnt);
+	printf("peak in use : %llu bytes\n", (unsigned long long)pool->peak_in_use);
+	printf("peak reserved : %llu bytes\n", (unsigned long long)pool->peak_reserved);
+	printf("reserved now : %llu bytes\n", (unsigned long long)pool->bytes_reserved);
+}
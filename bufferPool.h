@@ -0,0 +1,40 @@
+#ifndef _H_BUFFERPOOL_
+#define _H_BUFFERPOOL_
+
+#include <stddef.h>
+#include <pthread.h>
+#include "arch.h"
+
+// size-classed buffer pool, buffers are kept and reused across files and channels of a batch
+
+/*-------------------- CONFIGURATION --------------------*/
+#define BUFPOOL_ALIGN (64) /* cache line aligned buffer */
+#define BUFPOOL_MIN_SHIFT (12) /* smallest class 4 KB */
+#define BUFPOOL_SUB_CLASS (4) /* classes per power of two, size waste below 25% */
+#define BUFPOOL_CLASS_NUM (19 * BUFPOOL_SUB_CLASS) /* 4 KB .. 2 GB */
+#define BUFPOOL_FREE_MAX (16) /* cached buffers per class */
+
+typedef struct _bufpool_c {
+	void *freelist[BUFPOOL_CLASS_NUM][BUFPOOL_FREE_MAX];
+	uint32_t freecnt[BUFPOOL_CLASS_NUM];
+	uint64_t bytes_in_use;		/* class size of buffers handed out */
+	uint64_t bytes_reserved;	/* bytes held from the system, in use + cached */
+	uint64_t peak_in_use;
+	uint64_t peak_reserved;
+	uint64_t alloc_cnt;			/* bufpool_alloc calls */
+	uint64_t reuse_cnt;			/* served from the free list */
+	uint64_t system_cnt;		/* served by the system allocator */
+	pthread_mutex_t lock;
+} bufpool_c;
+
+extern bufpool_c gBufPool; /* pool of the batch, see main() */
+
+/*-------------------- FUNCTIONS --------------------*/
+void bufpool_init(bufpool_c *pool);
+void bufpool_destroy(bufpool_c *pool);
+void *bufpool_alloc(bufpool_c *pool, size_t size);
+void *bufpool_calloc(bufpool_c *pool, size_t size);
+void bufpool_free(bufpool_c *pool, void *buf);
+void bufpool_show_stats(bufpool_c *pool);
+
+#endif
@@ -0,0 +1,369 @@
+/**
+ * @file catalog.c
+ * @author weiyuan.hsu
+ * @brief
+ * implement of the header only corpus catalog, RUNMODE_CATALOG
+ *
+ * catalog_scan: ........... List the .wav files of the tree (any case of the extension, hidden entries are
+ * 							 skipped) into the path pool, sort them by path so the index does not depend on
+ * 							 the order of readdir(), then the reader threads take the files one at a time
+ * 							 and parse their headers with wav_read_header(), the same parser as the
+ * 							 processing flow. Only the headers are read, a file costs an open and a few
+ * 							 small reads (and a seek per chunk before the data chunk).
+ *
+ * catalog_write: .......... The binary index in one write, and the JSON index.
+ *
+ * catalog_load: ........... Read the binary index in one read, the entries and the pool point into it.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "arch.h"
+#include "config.h"
+#include "utility.h"
+#include "catalog.h"
+
+/*-------------------- CONFIGURATION --------------------*/
+#define CATALOG_PATH_MAX (1024)
+#define CATALOG_IO_BUFFER (4096) /* stdio buffer of a header read */
+
+/*-------------------- GLOBAL PARAMETER --------------------*/
+static const char *catalog_sort_pool; // qsort has no context argument, the listing runs on one thread
+
+/*-------------------- INTERNAL FUNCTIONS --------------------*/
+static double catalog_time_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static int catalog_add(catalog_c *cat, const char *path) {
+	uint32_t len = (uint32_t)strlen(path) + 1;
+
+	if( cat->head.files == cat->entry_cap ) {
+		uint32_t cap = ( cat->entry_cap != 0 ) ? cat->entry_cap * 2 : 256;
+		catalog_entry_c *pNew = (catalog_entry_c *)realloc(cat->entry, sizeof(catalog_entry_c) * cap);
+		if( pNew == NULL ) {
+			return -1;
+		}
+		cat->entry = pNew;
+		cat->entry_cap = cap;
+	}
+	if( cat->head.pool_size + len > cat->pool_cap ) {
+		uint32_t cap = ( cat->pool_cap != 0 ) ? cat->pool_cap : 16384;
+		char *pNew;
+		while( cap < cat->head.pool_size + len ) {
+			cap *= 2;
+		}
+		if( (pNew = (char *)realloc(cat->pool, cap)) == NULL ) {
+			return -1;
+		}
+		cat->pool = pNew;
+		cat->pool_cap = cap;
+	}
+	memset(&cat->entry[cat->head.files], 0x0, sizeof(catalog_entry_c));
+	cat->entry[cat->head.files++].path = cat->head.pool_size;
+	memcpy(cat->pool + cat->head.pool_size, path, len);
+	cat->head.pool_size += len;
+	return 0;
+}
+
+static int catalog_list(catalog_c *cat, const char *dir, uint32_t depth) {
+	char path[CATALOG_PATH_MAX];
+	struct dirent *de;
+	struct stat st;
+	DIR *pDir;
+	int ret = 0;
+
+	if( depth >= CATALOG_DEPTH_MAX || (pDir = opendir(dir)) == NULL ) {
+		return 0;
+	}
+	while( ret == 0 && (de = readdir(pDir)) != NULL ) {
+		size_t len = strlen(de->d_name);
+		if( de->d_name[0] == '.' || snprintf(path, sizeof(path), "%s/%s", dir, de->d_name) >= (int)sizeof(path) ) {
+			continue;
+		}
+		if( stat(path, &st) != 0 ) {
+			continue;
+		}
+		if( S_ISDIR(st.st_mode) ) {
+			ret = catalog_list(cat, path, depth + 1);
+		} else if( S_ISREG(st.st_mode) && len > 4 && strcasecmp(de->d_name + len - 4, ".wav") == 0 ) {
+			ret = catalog_add(cat, path);
+		}
+	}
+	closedir(pDir);
+	return ret;
+}
+
+static int catalog_path_cmp(const void *a, const void *b) {
+	return strcmp(catalog_sort_pool + ((const catalog_entry_c *)a)->path, catalog_sort_pool + ((const catalog_entry_c *)b)->path);
+}
+
+static void catalog_parse(catalog_c *cat, catalog_entry_c *e) {
+	riff_chunk riff_file;
+	fmt_chunk_header fmt_file_header;
+	fmt_chunk_body fmt_file_body;
+	data_chunk data_file_header;
+	char io[CATALOG_IO_BUFFER];
+	struct stat st;
+	FILE *fp = fopen(cat->pool + e->path, "rb");
+
+	if( fp == NULL ) {
+		e->status = CATALOG_OPEN_FAIL;
+		return;
+	}
+	setvbuf(fp, io, _IOFBF, sizeof(io));
+	if( fstat(fileno(fp), &st) == 0 ) {
+		e->file_size = (uint64_t)st.st_size;
+		e->mtime = (sint64_t)st.st_mtime;
+	}
+	if( wav_read_header(fp, &riff_file, &fmt_file_header, &fmt_file_body, &data_file_header, 0) != 0 ) {
+		e->status = CATALOG_BAD_HEADER;
+		fclose(fp);
+		return;
+	}
+	e->data_offset = (uint64_t)ftell(fp);
+	e->format_tag = fmt_file_body.format_tag;
+	if( fmt_file_body.format_tag == WAVE_FORMAT_EXTENSIBLE && fmt_file_header.size >= 40 ) {
+		e->format_tag = *(uint16_t *)fmt_file_body.sub_format;
+		e->channel_mask = fmt_file_body.channel_mask;
+	}
+	e->channels = fmt_file_body.channels;
+	e->sample_rate = fmt_file_body.sample_rate;
+	e->bit_per_sample = fmt_file_body.bit_per_sample;
+	e->block_align = fmt_file_body.block_align;
+	e->data_size = data_file_header.size;
+	e->frames = ( e->block_align != 0 ) ? e->data_size / e->block_align : 0;
+	e->duration = ( e->sample_rate != 0 ) ? (double)e->frames / e->sample_rate : 0.0;
+	e->status = CATALOG_OK;
+	fclose(fp);
+}
+
+static void *catalog_reader(void *arg) {
+	catalog_c *cat = (catalog_c *)arg;
+	uint32_t i;
+
+	while( (i = __sync_fetch_and_add(&cat->next, 1)) < cat->head.files ) {
+		catalog_parse(cat, &cat->entry[i]);
+	}
+	return NULL;
+}
+
+static void catalog_json_string(FILE *fp, const char *s) {
+	fputc('"', fp);
+	for( ; *s != '\0'; s++ ) {
+		if( *s == '"' || *s == '\\' ) {
+			fprintf(fp, "\\%c", *s);
+		} else if( (unsigned char)*s < 0x20 ) {
+			fprintf(fp, "\\u%04x", (unsigned char)*s);
+		} else {
+			fputc(*s, fp);
+		}
+	}
+	fputc('"', fp);
+}
+
+static int catalog_write_json(catalog_c *cat, const char *name) {
+	FILE *fp = fopen(name, "w");
+	uint32_t i;
+	int ret;
+
+	if( fp == NULL ) {
+		printf("Can't open the catalog %s for write.\n", name);
+		return -1;
+	}
+	fprintf(fp, "[\n");
+	for( i=0; i<cat->head.files; i++ ) {
+		catalog_entry_c *e = &cat->entry[i];
+		fprintf(fp, "  {\"path\": ");
+		catalog_json_string(fp, cat->pool + e->path);
+		fprintf(fp, ", \"status\": %u, \"format_tag\": %u, \"sample_rate\": %u, \"channels\": %u, \"bit_per_sample\": %u, "
+			"\"block_align\": %u, \"channel_mask\": %u, \"frames\": %u, \"duration\": %.6f, \"data_offset\": %llu, "
+			"\"data_size\": %u, \"file_size\": %llu, \"mtime\": %lld}%s\n",
+			e->status, e->format_tag, e->sample_rate, e->channels, e->bit_per_sample, e->block_align, e->channel_mask,
+			e->frames, e->duration, (unsigned long long)e->data_offset, e->data_size, (unsigned long long)e->file_size,
+			(long long)e->mtime, ( i + 1 < cat->head.files ) ? "," : "");
+	}
+	fprintf(fp, "]\n");
+	ret = ( ferror(fp) != 0 ) ? -1 : 0;
+	if( fclose(fp) != 0 || ret != 0 ) {
+		printf("Can't write the catalog %s.\n", name);
+		return -1;
+	}
+	return 0;
+}
+
+static void catalog_report(catalog_c *cat, const char *path, double scan_ms, double load_ms) {
+	uint32_t parsed = 0;
+	double hours = 0.0;
+
+	for( uint32_t i=0; i<cat->head.files; i++ ) {
+		parsed += ( cat->entry[i].status == CATALOG_OK ) ? 1 : 0;
+		hours += cat->entry[i].duration / 3600.0;
+	}
+	printf("catalog %s : %u files, %u parsed, %u failed, %.2f h of audio, scan %.1f ms, load %.3f ms\n",
+		path, cat->head.files, parsed, cat->head.files - parsed, hours, scan_ms, load_ms);
+}
+
+/*-------------------- FUNCTIONS --------------------*/
+/**
+ * @brief
+ * list the wav files under root and parse their headers on threads reader threads
+ * @return int : 0 success, -1 fail
+ */
+int catalog_scan(catalog_c *cat, const char *root, uint8_t threads) {
+	pthread_t reader[CATALOG_THREAD_MAX];
+	bool started[CATALOG_THREAD_MAX];
+	uint8_t t;
+
+	catalog_release(cat);
+	memcpy(cat->head.id, "WCAT", 4);
+	cat->head.version = CATALOG_VERSION;
+	if( catalog_list(cat, root, 0) != 0 ) {
+		printf("Allocation memory error");
+		catalog_release(cat);
+		return -1;
+	}
+	catalog_sort_pool = cat->pool;
+	qsort(cat->entry, cat->head.files, sizeof(catalog_entry_c), catalog_path_cmp);
+
+	threads = ( threads == 0 ) ? 1 : ( threads < CATALOG_THREAD_MAX ) ? threads : CATALOG_THREAD_MAX;
+	threads = ( threads < cat->head.files ) ? threads : ( cat->head.files > 0 ) ? (uint8_t)cat->head.files : 1;
+	cat->next = 0;
+	for( t=1; t<threads; t++ ) {
+		started[t] = ( pthread_create(&reader[t], NULL, catalog_reader, cat) == 0 );
+	}
+	catalog_reader(cat);
+	for( t=1; t<threads; t++ ) {
+		if( started[t] ) {
+			pthread_join(reader[t], NULL);
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ * write <name>.bin, and <name>.json when json is set
+ * @return int : 0 success, -1 fail
+ */
+int catalog_write(catalog_c *cat, const char *name, uint8_t json) {
+	char path[CATALOG_PATH_MAX];
+	FILE *fp;
+	int ret = 0;
+
+	snprintf(path, sizeof(path), "%s.bin", name);
+	if( (fp = fopen(path, "wb")) == NULL ) {
+		printf("Can't open the catalog %s for write.\n", path);
+		return -1;
+	}
+	if( fwrite(&cat->head, sizeof(catalog_file_header), 1, fp) != 1 ||
+		fwrite(cat->entry, sizeof(catalog_entry_c), cat->head.files, fp) != cat->head.files ||
+		fwrite(cat->pool, 1, cat->head.pool_size, fp) != cat->head.pool_size ) {
+		ret = -1;
+	}
+	if( fclose(fp) != 0 || ret != 0 ) {
+		printf("Can't write the catalog %s.\n", path);
+		return -1;
+	}
+	if( json != 0 ) {
+		snprintf(path, sizeof(path), "%s.json", name);
+		ret = catalog_write_json(cat, path);
+	}
+	return ret;
+}
+
+/**
+ * @brief
+ * read a binary index written by catalog_write()
+ * @return int : 0 success, -1 fail
+ */
+int catalog_load(catalog_c *cat, const char *path) {
+	FILE *fp = fopen(path, "rb");
+	catalog_file_header *pHead;
+	long size;
+
+	catalog_release(cat);
+	if( fp == NULL ) {
+		printf("Can't open the catalog %s.\n", path);
+		return -1;
+	}
+	if( fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < (long)sizeof(catalog_file_header) || fseek(fp, 0, SEEK_SET) != 0 ||
+		(cat->image = (uint8_t *)malloc(size)) == NULL || fread(cat->image, 1, size, fp) != (size_t)size ) {
+		printf("Can't read the catalog %s.\n", path);
+		fclose(fp);
+		catalog_release(cat);
+		return -1;
+	}
+	fclose(fp);
+
+	pHead = (catalog_file_header *)cat->image;
+	if( memcmp(pHead->id, "WCAT", 4) != 0 || pHead->version != CATALOG_VERSION ||
+		(uint64_t)size != sizeof(catalog_file_header) + (uint64_t)pHead->files * sizeof(catalog_entry_c) + pHead->pool_size ||
+		(pHead->pool_size != 0 && cat->image[size - 1] != '\0') ) {
+		printf("%s is not a catalog of version %d.\n", path, CATALOG_VERSION);
+		catalog_release(cat);
+		return -1;
+	}
+	memcpy(&cat->head, pHead, sizeof(catalog_file_header));
+	cat->entry = (catalog_entry_c *)(cat->image + sizeof(catalog_file_header));
+	cat->pool = (char *)(cat->entry + cat->head.files);
+	for( uint32_t i=0; i<cat->head.files; i++ ) {
+		if( cat->entry[i].path >= cat->head.pool_size ) {
+			printf("%s is not a catalog of version %d.\n", path, CATALOG_VERSION);
+			catalog_release(cat);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+void catalog_release(catalog_c *cat) {
+	if( cat->image == NULL ) {
+		free(cat->entry);
+		free(cat->pool);
+	}
+	free(cat->image);
+	memset(cat, 0x0, sizeof(catalog_c));
+}
+
+/**
+ * @brief
+ * RUNMODE_CATALOG : scan root, write the index and load it back, with the time of each step
+ * @return int : 0 success, -1 fail
+ */
+int catalog_run(const char *root, uint8_t threads, const char *name, uint8_t json) {
+	catalog_c cat;
+	char path[CATALOG_PATH_MAX];
+	double t0, t_scan;
+
+	memset(&cat, 0x0, sizeof(catalog_c));
+	t0 = catalog_time_ms();
+	if( catalog_scan(&cat, root, threads) != 0 ) {
+		return -1;
+	}
+	t_scan = catalog_time_ms() - t0;
+	if( catalog_write(&cat, name, json) != 0 ) {
+		catalog_release(&cat);
+		return -1;
+	}
+
+	snprintf(path, sizeof(path), "%s.bin", name);
+	t0 = catalog_time_ms();
+	if( catalog_load(&cat, path) != 0 ) {
+		return -1;
+	}
+	catalog_report(&cat, path, t_scan, catalog_time_ms() - t0);
+	catalog_release(&cat);
+	return 0;
+}
@@ -0,0 +1,67 @@
+#ifndef _H_CATALOG_
+#define _H_CATALOG_
+
+#include "arch.h"
+
+// header only index of the wav files of a directory tree, RUNMODE_CATALOG. The tree is listed first, then the
+// reader threads parse the RIFF, fmt and chunk headers of the files with wav_read_header(), the pcm data is never
+// read. A later run (or wavparser.catalog()) loads the binary index with one read to select and order its work.
+//
+// binary index <name>.bin (little endian)
+// | catalog_file_header | catalog_entry_c entry[files], sorted by path | path pool, '\0' terminated |
+// JSON index <name>.json : the same fields, one object per file
+
+/*-------------------- CONFIGURATION --------------------*/
+#define CATALOG_THREAD_MAX (16)
+#define CATALOG_DEPTH_MAX (32) /* directory levels walked, links to a parent stop here */
+#define CATALOG_VERSION (1)
+
+enum {
+	CATALOG_OK = 0,
+	CATALOG_OPEN_FAIL,			/* the file can't be opened */
+	CATALOG_BAD_HEADER,			/* not a RIFF / WAVE file, or no data chunk */
+};
+
+typedef struct _catalog_file_header {
+	char id[4];					/* "WCAT" */
+	uint32_t version;
+	uint32_t files;
+	uint32_t pool_size;			/* bytes of the path pool */
+} catalog_file_header;
+
+typedef struct _catalog_entry_c {
+	uint64_t data_offset;		/* first byte of the data chunk */
+	uint64_t file_size;
+	sint64_t mtime;				/* seconds, a later run can tell a changed file */
+	double duration;			/* seconds */
+	uint32_t path;				/* offset in the path pool */
+	uint32_t sample_rate;
+	uint32_t channel_mask;		/* 0 without the extensible fmt */
+	uint32_t data_size;
+	uint32_t frames;			/* data_size / block_align */
+	uint16_t format_tag;		/* the format of the GUID for WAVE_FORMAT_EXTENSIBLE */
+	uint16_t channels;
+	uint16_t bit_per_sample;
+	uint16_t block_align;
+	uint16_t status;			/* CATALOG_OK, CATALOG_OPEN_FAIL, CATALOG_BAD_HEADER */
+	uint16_t reserved;
+} catalog_entry_c;
+
+typedef struct _catalog_c {
+	catalog_file_header head;
+	catalog_entry_c *entry;
+	char *pool;
+	uint32_t entry_cap;
+	uint32_t pool_cap;
+	uint32_t next;				/* next file for a reader thread */
+	uint8_t *image;				/* the loaded index, entry and pool point into it */
+} catalog_c;
+
+/*-------------------- FUNCTIONS --------------------*/
+int catalog_scan(catalog_c *cat, const char *root, uint8_t threads); /* 0 success, -1 fail */
+int catalog_write(catalog_c *cat, const char *name, uint8_t json); /* name without extension, 0 success, -1 fail */
+int catalog_load(catalog_c *cat, const char *path); /* path of the binary index, 0 success, -1 fail */
+void catalog_release(catalog_c *cat);
+int catalog_run(const char *root, uint8_t threads, const char *name, uint8_t json); /* RUNMODE_CATALOG, 0 success, -1 fail */
+
+#endif
@@ -0,0 +1,211 @@
+/**
+ * @file channelMixer.c
+ * @author weiyuan.hsu
+ * @brief
+ * implement of channel matrix mixer driven by the speaker mask
+ *
+ * mixer_build: ............ Build the gain matrix from the input speaker mask, each input channel
+ * 							 is mapped to its speaker by get_speaker_mask_idx() and takes the downmix
+ * 							 gains of that speaker. Rows are normalized so the output can not clip.
+ *
+ * mixer_build_remap: ...... Build a routing matrix, output channel o takes the input channel placed
+ * 							 at speaker out_speaker[o], or silence if the input has no such speaker.
+ *
+ * mixer_process: .......... Mix an interleaved buffer block by block. Each block is converted to a
+ * 							 planar float scratch once, every output channel is a multiply-accumulate
+ * 							 of the planar rows with a non zero gain, then written back interleaved.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+// external reference : ITU-R BS.775 downmix coefficients
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "arch.h"
+#include "config.h"
+#include "utility.h"
+#include "wave_type.h"
+#include "channelMixer.h"
+#include "bufferPool.h"
+#include "dspKernel.h"
+
+/*-------------------- GLOBAL PARAMETER --------------------*/
+#define MIX_M3DB (0.7071f)
+#define MIX_M6DB (0.5f)
+
+/* stereo downmix gain of each speaker, { left, right } */
+static const float mixer_stereo_gain[SPEAKER_NUM_MAX][2] = {
+	/* FRONT_LEFT            */ { 1.0f,     0.0f     },
+	/* FRONT_RIGHT           */ { 0.0f,     1.0f     },
+	/* FRONT_CENTER          */ { MIX_M3DB, MIX_M3DB },
+	/* LOW_FREQUENCY         */ { 0.0f,     0.0f     },
+	/* BACK_LEFT             */ { MIX_M3DB, 0.0f     },
+	/* BACK_RIGHT            */ { 0.0f,     MIX_M3DB },
+	/* FRONT_LEFT_OF_CENTER  */ { 0.9239f,  0.3827f  },
+	/* FRONT_RIGHT_OF_CENTER */ { 0.3827f,  0.9239f  },
+	/* BACK_CENTER           */ { MIX_M6DB, MIX_M6DB },
+	/* SIDE_LEFT             */ { MIX_M3DB, 0.0f     },
+	/* SIDE_RIGHT            */ { 0.0f,     MIX_M3DB },
+	/* TOP_CENTER            */ { MIX_M6DB, MIX_M6DB },
+	/* TOP_FRONT_LEFT        */ { MIX_M3DB, 0.0f     },
+	/* TOP_FRONT_CENTER      */ { MIX_M6DB, MIX_M6DB },
+	/* TOP_FRONT_RIGHT       */ { 0.0f,     MIX_M3DB },
+	/* TOP_BACK_LEFT         */ { MIX_M6DB, 0.0f     },
+	/* TOP_BACK_CENTER       */ { 0.3536f,  0.3536f  },
+	/* TOP_BACK_RIGHT        */ { 0.0f,     MIX_M6DB },
+};
+
+/*-------------------- INTERNAL FUNCTIONS --------------------*/
+static void mixer_reset(mixer_c *mixer, uint32_t in_mask, uint16_t in_channels) {
+	memset(mixer, 0x0, sizeof(mixer_c));
+	if( get_speaker_mask_num(in_mask) < in_channels ) {
+		in_mask = mixer_default_mask(in_channels);
+	}
+	mixer->in_mask = in_mask;
+	mixer->in_channels = (in_channels > MIXER_CH_MAX) ? MIXER_CH_MAX : in_channels;
+}
+
+static void mixer_normalize(mixer_c *mixer) {
+	uint16_t o, i;
+	for( o=0; o<mixer->out_channels; o++ ) {
+		float sum = 0.0f;
+		for( i=0; i<mixer->in_channels; i++ ) {
+			sum += fabsf(mixer->gain[o][i]);
+		}
+		if( sum > 1.0f ) {
+			for( i=0; i<mixer->in_channels; i++ ) {
+				mixer->gain[o][i] /= sum;
+			}
+		}
+	}
+}
+
+/*-------------------- FUNCTIONS --------------------*/
+/**
+ * @brief
+ * default speaker layout of WAVE_FORMAT_EXTENSIBLE for a channel count,
+ * used when the file has no (or a too short) channel mask
+ */
+uint32_t mixer_default_mask(uint16_t channels) {
+	switch( channels ) {
+		case 1: return MASK_SPEAKER_FRONT_CENTER;
+		case 2: return MASK_SPEAKER_FRONT_LEFT | MASK_SPEAKER_FRONT_RIGHT;
+		case 3: return MASK_SPEAKER_FRONT_LEFT | MASK_SPEAKER_FRONT_RIGHT | MASK_SPEAKER_FRONT_CENTER;
+		case 4: return MASK_SPEAKER_FRONT_LEFT | MASK_SPEAKER_FRONT_RIGHT | MASK_SPEAKER_BACK_LEFT | MASK_SPEAKER_BACK_RIGHT;
+		case 6: return MASK_SPEAKER_FRONT_LEFT | MASK_SPEAKER_FRONT_RIGHT | MASK_SPEAKER_FRONT_CENTER | MASK_SPEAKER_LOW_FREQUENCY |
+					   MASK_SPEAKER_BACK_LEFT | MASK_SPEAKER_BACK_RIGHT;
+		case 8: return MASK_SPEAKER_FRONT_LEFT | MASK_SPEAKER_FRONT_RIGHT | MASK_SPEAKER_FRONT_CENTER | MASK_SPEAKER_LOW_FREQUENCY |
+					   MASK_SPEAKER_BACK_LEFT | MASK_SPEAKER_BACK_RIGHT | MASK_SPEAKER_SIDE_LEFT | MASK_SPEAKER_SIDE_RIGHT;
+		default: return (channels >= 32) ? 0xffffffff : ((1u << channels) - 1);
+	}
+}
+
+void mixer_build(mixer_c *mixer, uint32_t in_mask, uint16_t in_channels, uint8_t mix_type) {
+	uint16_t i;
+	mixer_reset(mixer, in_mask, in_channels);
+	if( mix_type == MIXTYPE_STEREO ) {
+		mixer->out_channels = 2;
+		mixer->out_mask = MASK_SPEAKER_FRONT_LEFT | MASK_SPEAKER_FRONT_RIGHT;
+	} else if( mix_type == MIXTYPE_MONO ) {
+		mixer->out_channels = 1;
+		mixer->out_mask = MASK_SPEAKER_FRONT_CENTER;
+	} else {
+		return;
+	}
+	for( i=0; i<mixer->in_channels; i++ ) {
+		uint8_t spk = get_speaker_mask_idx(mixer->in_mask, (uint8_t)i);
+		if( spk >= SPEAKER_NUM_MAX ) {
+			continue; /* channel not assigned to a speaker */
+		}
+		if( mix_type == MIXTYPE_STEREO ) {
+			mixer->gain[0][i] = mixer_stereo_gain[spk][0];
+			mixer->gain[1][i] = mixer_stereo_gain[spk][1];
+		} else {
+			mixer->gain[0][i] = (mixer_stereo_gain[spk][0] + mixer_stereo_gain[spk][1]) * 0.5f;
+		}
+	}
+	/* a mono source is kept as it is */
+	if( mix_type == MIXTYPE_MONO && mixer->in_channels == 1 ) {
+		mixer->gain[0][0] = 1.0f;
+	}
+	mixer_normalize(mixer);
+}
+
+void mixer_build_remap(mixer_c *mixer, uint32_t in_mask, uint16_t in_channels, uint8_t *out_speaker, uint16_t out_channels) {
+	uint16_t o, i;
+	mixer_reset(mixer, in_mask, in_channels);
+	mixer->out_channels = (out_channels > MIXER_CH_MAX) ? MIXER_CH_MAX : out_channels;
+	for( o=0; o<mixer->out_channels; o++ ) {
+		if( out_speaker[o] >= SPEAKER_NUM_MAX ) {
+			continue;
+		}
+		mixer->out_mask |= channel_mask[out_speaker[o]];
+		for( i=0; i<mixer->in_channels; i++ ) {
+			if( get_speaker_mask_idx(mixer->in_mask, (uint8_t)i) == out_speaker[o] ) {
+				mixer->gain[o][i] = 1.0f;
+				break;
+			}
+		}
+	}
+}
+
+void mixer_set_gain(mixer_c *mixer, uint16_t out_ch, uint16_t in_ch, float gain) {
+	if( out_ch < MIXER_CH_MAX && in_ch < MIXER_CH_MAX ) {
+		mixer->gain[out_ch][in_ch] = gain;
+	}
+}
+
+/**
+ * @brief
+ * mix an interleaved buffer of in_channels into an interleaved buffer of out_channels,
+ * both with the same bit_per_sample
+ */
+void mixer_process(mixer_c *mixer, uint8_t *in, uint16_t bit_per_sample, uint32_t frames, uint8_t *out) {
+	uint32_t sample_bytes = bit_per_sample / 8;
+	uint32_t in_stride = sample_bytes * mixer->in_channels;
+	uint32_t out_stride = sample_bytes * mixer->out_channels;
+	uint32_t f0, n;
+	uint16_t o, i;
+	bool used[MIXER_CH_MAX];
+	float *planar = (float *)bufpool_alloc(&gBufPool, sizeof(float) * MIXER_BLOCK * (mixer->in_channels + 1));
+	float *acc;
+
+	if( planar == NULL ) {
+		printf("Allocation memory error");
+		return;
+	}
+	acc = planar + MIXER_BLOCK * mixer->in_channels;
+
+	for( i=0; i<mixer->in_channels; i++ ) {
+		used[i] = 0;
+		for( o=0; o<mixer->out_channels; o++ ) {
+			if( mixer->gain[o][i] != 0.0f ) {
+				used[i] = 1;
+			}
+		}
+	}
+
+	for( f0=0; f0<frames; f0+=n ) {
+		n = (frames - f0 > MIXER_BLOCK) ? MIXER_BLOCK : frames - f0;
+		/* deinterleave the block once */
+		for( i=0; i<mixer->in_channels; i++ ) {
+			if( used[i] ) {
+				pcm_to_float(in + (size_t)f0 * in_stride + i * sample_bytes, bit_per_sample, in_stride, planar + i * MIXER_BLOCK, n);
+			}
+		}
+		/* multiply-accumulate every output row while the block is hot */
+		for( o=0; o<mixer->out_channels; o++ ) {
+			memset(acc, 0x0, sizeof(float) * n);
+			for( i=0; i<mixer->in_channels; i++ ) {
+				if( mixer->gain[o][i] != 0.0f ) {
+					gDspKernel.axpy(acc, mixer->gain[o][i], planar + i * MIXER_BLOCK, n);
+				}
+			}
+			float_to_pcm(acc, bit_per_sample, out_stride, out + (size_t)f0 * out_stride + o * sample_bytes, n);
+		}
+	}
+	bufpool_free(&gBufPool, planar);
+}
@@ -0,0 +1,28 @@
+#ifndef _H_CHANNELMIXER_
+#define _H_CHANNELMIXER_
+
+#include "arch.h"
+#include "wave_type.h"
+
+// matrix mixer between speaker layouts, out[o] = sum of gain[o][i] * in[i]
+
+/*-------------------- CONFIGURATION --------------------*/
+#define MIXER_CH_MAX (SPEAKER_NUM_MAX)
+#define MIXER_BLOCK (1024) /* frames per block, planar scratch of all channels stays in L2 */
+
+typedef struct _mixer_c {
+	uint16_t in_channels;
+	uint16_t out_channels;
+	uint32_t in_mask;
+	uint32_t out_mask;
+	float gain[MIXER_CH_MAX][MIXER_CH_MAX]; /* [out][in] */
+} mixer_c;
+
+/*-------------------- FUNCTIONS --------------------*/
+uint32_t mixer_default_mask(uint16_t channels);
+void mixer_build(mixer_c *mixer, uint32_t in_mask, uint16_t in_channels, uint8_t mix_type);
+void mixer_build_remap(mixer_c *mixer, uint32_t in_mask, uint16_t in_channels, uint8_t *out_speaker, uint16_t out_channels);
+void mixer_set_gain(mixer_c *mixer, uint16_t out_ch, uint16_t in_ch, float gain);
+void mixer_process(mixer_c *mixer, uint8_t *in, uint16_t bit_per_sample, uint32_t frames, uint8_t *out);
+
+#endif
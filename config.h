@@ -7,10 +7,14 @@
  * SRC_FIX_ME : not sure if the code is right, need further check
  * USEDOUBLES : likely to be bit-exact between machines
  * PRINT_EN : enable log
+ * SIMD_EN : use the SIMD kernels the compiler target supports (SSE2/AVX2), 0 for scalar only
+ * URING_EN : io_uring for the async file I/O, needs liburing and -luring on the link line, 0 for pread/pwrite
  */
 #define SRC_FIX_ME (1)
 #define USEDOUBLES (1)
 #define PRINT_EN (0)
+#define SIMD_EN (1)
+#define URING_EN (0)
 
 #if (PRINT_EN == 0)
 #define printf(...)
@@ -0,0 +1,1036 @@
+/**
+ * @file dspKernel.c
+ * @author weiyuan.hsu
+ * @brief
+ * implement of the runtime dispatched float kernels
+ *
+ * dsp_cpu_isa: ............ Best instruction set of the running cpu, from cpuid (and xgetbv, so an AVX
+ * 							 state the os does not save is not reported), through the compiler builtins.
+ *
+ * dsp_kernel_init: ........ Bind gDspKernel to the kernels of one instruction set. Every variant is
+ * 							 compiled in the same binary with a target attribute, so the build does not
+ * 							 need -mavx2 and one binary runs on every x86 machine. A forced instruction set
+ * 							 (gSimdIsaForce) above the cpu is lowered to the cpu, the SSE2 / AVX2 variants
+ * 							 are the loops the modules had under the compile time SIMD_EN switch, forcing
+ * 							 them reproduces those builds bit exact.
+ *
+ * unpack / pack: .......... Contiguous pcm to float and back for the concealment modules, the rounding and
+ * 							 saturation of pack are done in double exactly like float_to_pcm(), so every
+ * 							 variant gives the same samples.
+ *
+ * dot_lanes: .............. Many independent Float dot products side by side (lane k of every row), the
+ * 							 vector runs across the lanes and each lane still sums its rows in order, so
+ * 							 every variant is bit exact with the scalar loop. Lockstep LowcFE pitch search.
+ * 							 The vectors are double, a USEDOUBLES 0 build binds the scalar loop in every row.
+ *
+ * ola / ola_s16 / gain_ramp: The LowcFE synthesis loops. The G.711 appendix accumulates the OLA weights
+ * 							 and the gain sample by sample, here they are computed from the index so the
+ * 							 samples are independent, the clamps are min / max or the saturation of the
+ * 							 16 bit pack, gain_ramp also converts the pitch buffer (convertfs) in the same
+ * 							 pass. Every variant is bit exact with the scalar one, which may move a sample
+ * 							 by one step against the accumulated ramps (see kernelCheck.c). ola and gain_ramp
+ * 							 read Float, like dot_lanes a USEDOUBLES 0 build binds their scalar loops.
+ *
+ * dot_double / dot3_double: Dot products of float samples summed in double. A product of two floats is
+ * 							 exact in double and every variant keeps the same DSP_DOT_DOUBLE_SUMS partial
+ * 							 sums folded in the same order, so the result is bit exact between the sets, for
+ * 							 the recursions which amplify the rounding of a reassociated sum (the Burg fit).
+ * 							 dot3_double converts x and y once for the three sums of a reflection
+ * 							 coefficient.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arch.h"
+#include "config.h"
+#include "utility.h"
+#include "dspKernel.h"
+
+#if (DSP_X86 == 1)
+#include <immintrin.h>
+#endif
+
+/*-------------------- INTERNAL FUNCTIONS --------------------*/
+static inline void dsp_butterfly_tail(float *ar, float *ai, float *br, float *bi, const float *wr, const float *wi, uint32_t j, uint32_t h) {
+	for( ; j<h; j++ ) {
+		float tr = br[j] * wr[j] - bi[j] * wi[j];
+		float ti = br[j] * wi[j] + bi[j] * wr[j];
+		br[j] = ar[j] - tr;
+		bi[j] = ai[j] - ti;
+		ar[j] += tr;
+		ai[j] += ti;
+	}
+}
+
+static inline void dsp_reduce_tail(const float *x, uint32_t i, uint32_t num, float *pMin, float *pMax, float *pSumSq) {
+	float vmin = *pMin, vmax = *pMax, sumsq = *pSumSq;
+	for( ; i<num; i++ ) {
+		vmin = (x[i] < vmin) ? x[i] : vmin;
+		vmax = (x[i] > vmax) ? x[i] : vmax;
+		sumsq += x[i] * x[i];
+	}
+	*pMin = vmin;
+	*pMax = vmax;
+	*pSumSq = sumsq;
+}
+
+/* LowcFE synthesis, the ramp weight of sample i is (i + 1) / num and the gain g - (i0 + i) * dg, from the index */
+static inline void dsp_ola_tail(Float *o, const Float *l, const Float *r, uint32_t i, uint32_t num) {
+	double incr = 1.0 / num;
+	for( ; i<num; i++ ) {
+		double w = (double)(i + 1) * incr;
+		double t = (1.0 - w) * l[i] + w * r[i];
+		o[i] = (Float)((t > 32767.0) ? 32767.0 : (t < -32768.0) ? -32768.0 : t);
+	}
+}
+
+static inline void dsp_ola_s16_tail(sint16_t *o, const sint16_t *l, const sint16_t *r, uint32_t i, uint32_t num, double gain) {
+	double incr = 1.0 / num;
+	for( ; i<num; i++ ) {
+		double w = (double)(i + 1) * incr;
+		double t = (1.0 - w) * gain * l[i] + w * r[i];
+		o[i] = (sint16_t)((t > 32767.0) ? 32767.0 : (t < -32768.0) ? -32768.0 : t);
+	}
+}
+
+static inline void dsp_gain_ramp_tail(sint16_t *o, const Float *f, uint32_t i, uint32_t num, double g, double dg, uint32_t i0) {
+	for( ; i<num; i++ ) {
+		double x = (f != NULL) ? (double)(sint32_t)f[i] : (double)o[i];
+		o[i] = (sint16_t)(x * (g - (double)(i0 + i) * dg));
+	}
+}
+
+/* pairwise, the same tree in every set */
+static inline double dsp_fold_double(double *acc) {
+	uint32_t i, n;
+	for( n=DSP_DOT_DOUBLE_SUMS/2; n>0; n/=2 ) {
+		for( i=0; i<n; i++ ) {
+			acc[i] += acc[i + n];
+		}
+	}
+	return acc[0];
+}
+
+static inline double dsp_dot_double_tail(const float *x, const float *y, uint32_t i, uint32_t num, double *acc) {
+	for( ; i<num; i++ ) {
+		acc[i % DSP_DOT_DOUBLE_SUMS] += (double)x[i] * y[i];
+	}
+	return dsp_fold_double(acc);
+}
+
+/* acc : [3][DSP_DOT_DOUBLE_SUMS], x y, x x and y y */
+static inline void dsp_dot3_double_tail(const float *x, const float *y, uint32_t i, uint32_t num, double *acc, double *pSums) {
+	for( ; i<num; i++ ) {
+		double vx = x[i], vy = y[i];
+		acc[i % DSP_DOT_DOUBLE_SUMS] += vx * vy;
+		acc[DSP_DOT_DOUBLE_SUMS + i % DSP_DOT_DOUBLE_SUMS] += vx * vx;
+		acc[2 * DSP_DOT_DOUBLE_SUMS + i % DSP_DOT_DOUBLE_SUMS] += vy * vy;
+	}
+	pSums[0] = dsp_fold_double(acc);
+	pSums[1] = dsp_fold_double(acc + DSP_DOT_DOUBLE_SUMS);
+	pSums[2] = dsp_fold_double(acc + 2 * DSP_DOT_DOUBLE_SUMS);
+}
+
+/*-------------------- SCALAR --------------------*/
+static float dsp_dot_scalar(const float *x, const float *y, uint32_t num) {
+	uint32_t i;
+	float acc = 0.0f;
+	for( i=0; i<num; i++ ) {
+		acc += x[i] * y[i];
+	}
+	return acc;
+}
+
+static void dsp_axpy_scalar(float *y, float k, const float *x, uint32_t num) {
+	uint32_t i;
+	for( i=0; i<num; i++ ) {
+		y[i] += k * x[i];
+	}
+}
+
+static void dsp_lattice_scalar(float *f, float *b, float k, uint32_t num) {
+	uint32_t i;
+	for( i=0; i<num; i++ ) {
+		float vf = f[i], vb = b[i];
+		f[i] = vf + k * vb;
+		b[i] = vb + k * vf;
+	}
+}
+
+static void dsp_fft_stage_scalar(float *re, float *im, const float *wr, const float *wi, uint32_t h, uint32_t m) {
+	uint32_t b;
+	for( b=0; b<m; b+=2*h ) {
+		dsp_butterfly_tail(re + b, im + b, re + b + h, im + b + h, wr, wi, 0, h);
+	}
+}
+
+static void dsp_reduce_scalar(const float *x, uint32_t num, float *pMin, float *pMax, float *pSumSq) {
+	*pMin = x[0];
+	*pMax = x[0];
+	*pSumSq = 0.0f;
+	dsp_reduce_tail(x, 0, num, pMin, pMax, pSumSq);
+}
+
+static void dsp_dot_lanes_scalar(Float *acc, const Float *x, const Float *y, uint32_t rows, uint32_t xs, uint32_t ys, uint32_t lanes) {
+	uint32_t k, r;
+	for( k=0; k<lanes; k++ ) {
+		Float a = acc[k];
+		for( r=0; r<rows; r++ ) {
+			a += x[(size_t)r * xs + k] * y[(size_t)r * ys + k];
+		}
+		acc[k] = a;
+	}
+}
+
+static uint32_t dsp_unpack_scalar(const uint8_t *pBuf, uint16_t bit_per_sample, float *pOut, uint32_t num) {
+	return 0;
+}
+
+static uint32_t dsp_pack_scalar(const float *pIn, uint16_t bit_per_sample, uint8_t *pBuf, uint32_t num) {
+	return 0;
+}
+
+static void dsp_ola_scalar(Float *o, const Float *l, const Float *r, uint32_t num) {
+	dsp_ola_tail(o, l, r, 0, num);
+}
+
+static void dsp_ola_s16_scalar(sint16_t *o, const sint16_t *l, const sint16_t *r, uint32_t num, double gain) {
+	dsp_ola_s16_tail(o, l, r, 0, num, gain);
+}
+
+static void dsp_gain_ramp_scalar(sint16_t *o, const Float *f, uint32_t num, double g, double dg, uint32_t i0) {
+	dsp_gain_ramp_tail(o, f, 0, num, g, dg, i0);
+}
+
+static double dsp_dot_double_scalar(const float *x, const float *y, uint32_t num) {
+	double acc[DSP_DOT_DOUBLE_SUMS] = { 0.0 };
+	return dsp_dot_double_tail(x, y, 0, num, acc);
+}
+
+static void dsp_dot3_double_scalar(const float *x, const float *y, uint32_t num, double *pSums) {
+	double acc[3 * DSP_DOT_DOUBLE_SUMS] = { 0.0 };
+	dsp_dot3_double_tail(x, y, 0, num, acc, pSums);
+}
+
+#if (DSP_X86 == 1)
+/*-------------------- SSE2 --------------------*/
+DSP_TARGET_SSE2 static float dsp_dot_sse2(const float *x, const float *y, uint32_t num) {
+	uint32_t i = 0;
+	float acc;
+	__m128 acc0 = _mm_setzero_ps();
+	for( ; i+4<=num; i+=4 ) {
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+	}
+	acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+	acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 1));
+	acc = _mm_cvtss_f32(acc0);
+	for( ; i<num; i++ ) {
+		acc += x[i] * y[i];
+	}
+	return acc;
+}
+
+DSP_TARGET_SSE2 static void dsp_axpy_sse2(float *y, float k, const float *x, uint32_t num) {
+	uint32_t i = 0;
+	__m128 vk = _mm_set1_ps(k);
+	for( ; i+4<=num; i+=4 ) {
+		_mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(vk, _mm_loadu_ps(x + i))));
+	}
+	for( ; i<num; i++ ) {
+		y[i] += k * x[i];
+	}
+}
+
+DSP_TARGET_SSE2 static void dsp_lattice_sse2(float *f, float *b, float k, uint32_t num) {
+	uint32_t i = 0;
+	__m128 vk = _mm_set1_ps(k);
+	for( ; i+4<=num; i+=4 ) {
+		__m128 vf = _mm_loadu_ps(f + i), vb = _mm_loadu_ps(b + i);
+		_mm_storeu_ps(f + i, _mm_add_ps(vf, _mm_mul_ps(vk, vb)));
+		_mm_storeu_ps(b + i, _mm_add_ps(vb, _mm_mul_ps(vk, vf)));
+	}
+	for( ; i<num; i++ ) {
+		float vf = f[i], vb = b[i];
+		f[i] = vf + k * vb;
+		b[i] = vb + k * vf;
+	}
+}
+
+DSP_TARGET_SSE2 static void dsp_fft_stage_sse2(float *re, float *im, const float *wr, const float *wi, uint32_t h, uint32_t m) {
+	uint32_t b, j;
+	for( b=0; b<m; b+=2*h ) {
+		float *ar = re + b, *ai = im + b, *br = re + b + h, *bi = im + b + h;
+		for( j=0; j+4<=h; j+=4 ) {
+			__m128 vwr = _mm_loadu_ps(wr + j), vwi = _mm_loadu_ps(wi + j);
+			__m128 vbr = _mm_loadu_ps(br + j), vbi = _mm_loadu_ps(bi + j);
+			__m128 var = _mm_loadu_ps(ar + j), vai = _mm_loadu_ps(ai + j);
+			__m128 tr = _mm_sub_ps(_mm_mul_ps(vbr, vwr), _mm_mul_ps(vbi, vwi));
+			__m128 ti = _mm_add_ps(_mm_mul_ps(vbr, vwi), _mm_mul_ps(vbi, vwr));
+			_mm_storeu_ps(br + j, _mm_sub_ps(var, tr));
+			_mm_storeu_ps(bi + j, _mm_sub_ps(vai, ti));
+			_mm_storeu_ps(ar + j, _mm_add_ps(var, tr));
+			_mm_storeu_ps(ai + j, _mm_add_ps(vai, ti));
+		}
+		dsp_butterfly_tail(ar, ai, br, bi, wr, wi, j, h);
+	}
+}
+
+DSP_TARGET_SSE2 static void dsp_reduce_sse2(const float *x, uint32_t num, float *pMin, float *pMax, float *pSumSq) {
+	uint32_t i = 0;
+	*pMin = x[0];
+	*pMax = x[0];
+	*pSumSq = 0.0f;
+	if( num >= 4 ) {
+		__m128 mn = _mm_loadu_ps(x), mx = mn, sq = _mm_setzero_ps();
+		for( ; i+4<=num; i+=4 ) {
+			__m128 v = _mm_loadu_ps(x + i);
+			mn = _mm_min_ps(mn, v);
+			mx = _mm_max_ps(mx, v);
+			sq = _mm_add_ps(sq, _mm_mul_ps(v, v));
+		}
+		mn = _mm_min_ps(mn, _mm_movehl_ps(mn, mn));
+		mn = _mm_min_ss(mn, _mm_shuffle_ps(mn, mn, 1));
+		mx = _mm_max_ps(mx, _mm_movehl_ps(mx, mx));
+		mx = _mm_max_ss(mx, _mm_shuffle_ps(mx, mx, 1));
+		sq = _mm_add_ps(sq, _mm_movehl_ps(sq, sq));
+		sq = _mm_add_ss(sq, _mm_shuffle_ps(sq, sq, 1));
+		*pMin = _mm_cvtss_f32(mn);
+		*pMax = _mm_cvtss_f32(mx);
+		*pSumSq = _mm_cvtss_f32(sq);
+	}
+	dsp_reduce_tail(x, i, num, pMin, pMax, pSumSq);
+}
+
+#if (USEDOUBLES == 1)
+DSP_TARGET_SSE2 static void dsp_dot_lanes_sse2(double *acc, const double *x, const double *y, uint32_t rows, uint32_t xs, uint32_t ys, uint32_t lanes) {
+	uint32_t k = 0, r;
+	for( ; k+4<=lanes; k+=4 ) {
+		__m128d a0 = _mm_loadu_pd(acc + k), a1 = _mm_loadu_pd(acc + k + 2);
+		for( r=0; r<rows; r++ ) {
+			const double *px = x + (size_t)r * xs + k, *py = y + (size_t)r * ys + k;
+			a0 = _mm_add_pd(a0, _mm_mul_pd(_mm_loadu_pd(px), _mm_loadu_pd(py)));
+			a1 = _mm_add_pd(a1, _mm_mul_pd(_mm_loadu_pd(px + 2), _mm_loadu_pd(py + 2)));
+		}
+		_mm_storeu_pd(acc + k, a0);
+		_mm_storeu_pd(acc + k + 2, a1);
+	}
+	dsp_dot_lanes_scalar(acc + k, x + k, y + k, rows, xs, ys, lanes - k);
+}
+#endif
+
+DSP_TARGET_SSE2 static uint32_t dsp_unpack_sse2(const uint8_t *pBuf, uint16_t bit_per_sample, float *pOut, uint32_t num) {
+	uint32_t i = 0;
+	if( bit_per_sample == 16 ) {
+		__m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+		for( ; i+8<=num; i+=8 ) {
+			__m128i v = _mm_loadu_si128((const __m128i *)(pBuf + (size_t)i * 2));
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+			_mm_storeu_ps(pOut + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+			_mm_storeu_ps(pOut + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+		}
+	}
+	return i;
+}
+
+/**
+ * @brief
+ * float_to_pcm() rounding of 2 samples, v * fullScale rounded half away from zero and saturated
+ */
+DSP_TARGET_SSE2 static inline __m128i dsp_round2_sse2(const float *p, __m128d fs, __m128d lo, __m128d hi) {
+	__m128d v = _mm_mul_pd(_mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)p))), fs);
+	__m128d half = _mm_or_pd(_mm_and_pd(v, _mm_set1_pd(-0.0)), _mm_set1_pd(0.5));
+	v = _mm_max_pd(_mm_min_pd(_mm_add_pd(v, half), hi), lo);
+	return _mm_cvttpd_epi32(v);
+}
+
+DSP_TARGET_SSE2 static uint32_t dsp_pack_sse2(const float *pIn, uint16_t bit_per_sample, uint8_t *pBuf, uint32_t num) {
+	uint32_t i = 0;
+	if( bit_per_sample == 16 ) {
+		__m128d fs = _mm_set1_pd(32768.0), lo = _mm_set1_pd(-32768.0), hi = _mm_set1_pd(32767.0);
+		for( ; i+8<=num; i+=8 ) {
+			__m128i a = _mm_unpacklo_epi64(dsp_round2_sse2(pIn + i, fs, lo, hi), dsp_round2_sse2(pIn + i + 2, fs, lo, hi));
+			__m128i b = _mm_unpacklo_epi64(dsp_round2_sse2(pIn + i + 4, fs, lo, hi), dsp_round2_sse2(pIn + i + 6, fs, lo, hi));
+			_mm_storeu_si128((__m128i *)(pBuf + (size_t)i * 2), _mm_packs_epi32(a, b));
+		}
+	}
+	return i;
+}
+
+/**
+ * @brief
+ * 4 sint16_t to 2 + 2 double, sign extended
+ */
+DSP_TARGET_SSE2 static inline void dsp_load4_s16_sse2(const sint16_t *p, __m128d *lo, __m128d *hi) {
+	__m128i v = _mm_loadl_epi64((const __m128i *)p);
+	v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+	*lo = _mm_cvtepi32_pd(v);
+	*hi = _mm_cvtepi32_pd(_mm_srli_si128(v, 8));
+}
+
+/**
+ * @brief
+ * 2 + 2 double truncated and packed with saturation to 4 sint16_t, the clamp of the G.711 appendix loops
+ */
+DSP_TARGET_SSE2 static inline void dsp_store4_s16_sse2(sint16_t *p, __m128d lo, __m128d hi) {
+	__m128i v = _mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi));
+	_mm_storel_epi64((__m128i *)p, _mm_packs_epi32(v, v));
+}
+
+#if (USEDOUBLES == 1)
+DSP_TARGET_SSE2 static void dsp_ola_sse2(double *o, const double *l, const double *r, uint32_t num) {
+	uint32_t i = 0;
+	__m128d incr = _mm_set1_pd(1.0 / num), one = _mm_set1_pd(1.0), two = _mm_set1_pd(2.0);
+	__m128d lo = _mm_set1_pd(-32768.0), hi = _mm_set1_pd(32767.0);
+	__m128d idx = _mm_setr_pd(1.0, 2.0);
+	for( ; i+2<=num; i+=2 ) {
+		__m128d w = _mm_mul_pd(idx, incr);
+		__m128d t = _mm_add_pd(_mm_mul_pd(_mm_sub_pd(one, w), _mm_loadu_pd(l + i)), _mm_mul_pd(w, _mm_loadu_pd(r + i)));
+		_mm_storeu_pd(o + i, _mm_min_pd(_mm_max_pd(t, lo), hi));
+		idx = _mm_add_pd(idx, two);
+	}
+	dsp_ola_tail(o, l, r, i, num);
+}
+#endif
+
+DSP_TARGET_SSE2 static void dsp_ola_s16_sse2(sint16_t *o, const sint16_t *l, const sint16_t *r, uint32_t num, double gain) {
+	uint32_t i = 0;
+	__m128d incr = _mm_set1_pd(1.0 / num), one = _mm_set1_pd(1.0), two = _mm_set1_pd(2.0), g = _mm_set1_pd(gain);
+	__m128d idx = _mm_setr_pd(1.0, 2.0);
+	for( ; i+4<=num; i+=4 ) {
+		__m128d l0, l1, r0, r1;
+		__m128d w0 = _mm_mul_pd(idx, incr), w1 = _mm_mul_pd(_mm_add_pd(idx, two), incr);
+		dsp_load4_s16_sse2(l + i, &l0, &l1);
+		dsp_load4_s16_sse2(r + i, &r0, &r1);
+		l0 = _mm_add_pd(_mm_mul_pd(_mm_mul_pd(_mm_sub_pd(one, w0), g), l0), _mm_mul_pd(w0, r0));
+		l1 = _mm_add_pd(_mm_mul_pd(_mm_mul_pd(_mm_sub_pd(one, w1), g), l1), _mm_mul_pd(w1, r1));
+		dsp_store4_s16_sse2(o + i, l0, l1);
+		idx = _mm_add_pd(idx, _mm_add_pd(two, two));
+	}
+	dsp_ola_s16_tail(o, l, r, i, num, gain);
+}
+
+#if (USEDOUBLES == 1)
+DSP_TARGET_SSE2 static void dsp_gain_ramp_sse2(sint16_t *o, const double *f, uint32_t num, double g, double dg, uint32_t i0) {
+	uint32_t i = 0;
+	__m128d vg = _mm_set1_pd(g), vdg = _mm_set1_pd(dg), two = _mm_set1_pd(2.0);
+	__m128d idx = _mm_setr_pd((double)i0, (double)i0 + 1.0);
+	for( ; i+4<=num; i+=4 ) {
+		__m128d x0, x1;
+		__m128d idx1 = _mm_add_pd(idx, two);
+		if( f != NULL ) {
+			x0 = _mm_cvtepi32_pd(_mm_cvttpd_epi32(_mm_loadu_pd(f + i)));
+			x1 = _mm_cvtepi32_pd(_mm_cvttpd_epi32(_mm_loadu_pd(f + i + 2)));
+		} else {
+			dsp_load4_s16_sse2(o + i, &x0, &x1);
+		}
+		x0 = _mm_mul_pd(x0, _mm_sub_pd(vg, _mm_mul_pd(idx, vdg)));
+		x1 = _mm_mul_pd(x1, _mm_sub_pd(vg, _mm_mul_pd(idx1, vdg)));
+		dsp_store4_s16_sse2(o + i, x0, x1);
+		idx = _mm_add_pd(idx1, two);
+	}
+	dsp_gain_ramp_tail(o, f, i, num, g, dg, i0);
+}
+#endif
+
+DSP_TARGET_SSE2 static double dsp_dot_double_sse2(const float *x, const float *y, uint32_t num) {
+	uint32_t i = 0, j;
+	double acc[DSP_DOT_DOUBLE_SUMS];
+	__m128d xy[DSP_DOT_DOUBLE_SUMS / 2];
+	for( j=0; j<DSP_DOT_DOUBLE_SUMS/2; j++ ) {
+		xy[j] = _mm_setzero_pd();
+	}
+	for( ; i+DSP_DOT_DOUBLE_SUMS<=num; i+=DSP_DOT_DOUBLE_SUMS ) {
+		for( j=0; j<DSP_DOT_DOUBLE_SUMS/2; j++ ) {
+			xy[j] = _mm_add_pd(xy[j], _mm_mul_pd(_mm_cvtps_pd(_mm_castpd_ps(_mm_load_sd((const double *)(x + i + 2 * j)))), _mm_cvtps_pd(_mm_castpd_ps(_mm_load_sd((const double *)(y + i + 2 * j))))));
+		}
+	}
+	for( j=0; j<DSP_DOT_DOUBLE_SUMS/2; j++ ) {
+		_mm_storeu_pd(acc + 2 * j, xy[j]);
+	}
+	return dsp_dot_double_tail(x, y, i, num, acc);
+}
+
+DSP_TARGET_SSE2 static void dsp_dot3_double_sse2(const float *x, const float *y, uint32_t num, double *pSums) {
+	uint32_t i = 0, j;
+	double acc[3 * DSP_DOT_DOUBLE_SUMS];
+	__m128d xy[DSP_DOT_DOUBLE_SUMS / 2], xx[DSP_DOT_DOUBLE_SUMS / 2], yy[DSP_DOT_DOUBLE_SUMS / 2];
+	for( j=0; j<DSP_DOT_DOUBLE_SUMS/2; j++ ) {
+		xy[j] = _mm_setzero_pd();
+		xx[j] = _mm_setzero_pd();
+		yy[j] = _mm_setzero_pd();
+	}
+	for( ; i+DSP_DOT_DOUBLE_SUMS<=num; i+=DSP_DOT_DOUBLE_SUMS ) {
+		for( j=0; j<DSP_DOT_DOUBLE_SUMS/2; j++ ) {
+			__m128d vx = _mm_cvtps_pd(_mm_castpd_ps(_mm_load_sd((const double *)(x + i + 2 * j))));
+			__m128d vy = _mm_cvtps_pd(_mm_castpd_ps(_mm_load_sd((const double *)(y + i + 2 * j))));
+			xy[j] = _mm_add_pd(xy[j], _mm_mul_pd(vx, vy));
+			xx[j] = _mm_add_pd(xx[j], _mm_mul_pd(vx, vx));
+			yy[j] = _mm_add_pd(yy[j], _mm_mul_pd(vy, vy));
+		}
+	}
+	for( j=0; j<DSP_DOT_DOUBLE_SUMS/2; j++ ) {
+		_mm_storeu_pd(acc + 2 * j, xy[j]);
+		_mm_storeu_pd(acc + DSP_DOT_DOUBLE_SUMS + 2 * j, xx[j]);
+		_mm_storeu_pd(acc + 2 * DSP_DOT_DOUBLE_SUMS + 2 * j, yy[j]);
+	}
+	dsp_dot3_double_tail(x, y, i, num, acc, pSums);
+}
+
+/*-------------------- AVX2 --------------------*/
+DSP_TARGET_AVX2 static float dsp_dot_avx2(const float *x, const float *y, uint32_t num) {
+	uint32_t i = 0;
+	float acc;
+	__m256 acc0 = _mm256_setzero_ps();
+	__m256 acc1 = _mm256_setzero_ps();
+	for( ; i+16<=num; i+=16 ) {
+		acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+		acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8)));
+	}
+	for( ; i+8<=num; i+=8 ) {
+		acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+	}
+	acc0 = _mm256_add_ps(acc0, acc1);
+	__m128 s = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	acc = _mm_cvtss_f32(s);
+	for( ; i<num; i++ ) {
+		acc += x[i] * y[i];
+	}
+	return acc;
+}
+
+DSP_TARGET_AVX2 static void dsp_axpy_avx2(float *y, float k, const float *x, uint32_t num) {
+	uint32_t i = 0;
+	__m256 vk = _mm256_set1_ps(k);
+	for( ; i+8<=num; i+=8 ) {
+		_mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(vk, _mm256_loadu_ps(x + i))));
+	}
+	for( ; i<num; i++ ) {
+		y[i] += k * x[i];
+	}
+}
+
+DSP_TARGET_AVX2 static void dsp_lattice_avx2(float *f, float *b, float k, uint32_t num) {
+	uint32_t i = 0;
+	__m256 vk = _mm256_set1_ps(k);
+	for( ; i+8<=num; i+=8 ) {
+		__m256 vf = _mm256_loadu_ps(f + i), vb = _mm256_loadu_ps(b + i);
+		_mm256_storeu_ps(f + i, _mm256_add_ps(vf, _mm256_mul_ps(vk, vb)));
+		_mm256_storeu_ps(b + i, _mm256_add_ps(vb, _mm256_mul_ps(vk, vf)));
+	}
+	for( ; i<num; i++ ) {
+		float vf = f[i], vb = b[i];
+		f[i] = vf + k * vb;
+		b[i] = vb + k * vf;
+	}
+}
+
+DSP_TARGET_AVX2 static void dsp_fft_stage_avx2(float *re, float *im, const float *wr, const float *wi, uint32_t h, uint32_t m) {
+	uint32_t b, j;
+	for( b=0; b<m; b+=2*h ) {
+		float *ar = re + b, *ai = im + b, *br = re + b + h, *bi = im + b + h;
+		for( j=0; j+8<=h; j+=8 ) {
+			__m256 vwr = _mm256_loadu_ps(wr + j), vwi = _mm256_loadu_ps(wi + j);
+			__m256 vbr = _mm256_loadu_ps(br + j), vbi = _mm256_loadu_ps(bi + j);
+			__m256 var = _mm256_loadu_ps(ar + j), vai = _mm256_loadu_ps(ai + j);
+			__m256 tr = _mm256_sub_ps(_mm256_mul_ps(vbr, vwr), _mm256_mul_ps(vbi, vwi));
+			__m256 ti = _mm256_add_ps(_mm256_mul_ps(vbr, vwi), _mm256_mul_ps(vbi, vwr));
+			_mm256_storeu_ps(br + j, _mm256_sub_ps(var, tr));
+			_mm256_storeu_ps(bi + j, _mm256_sub_ps(vai, ti));
+			_mm256_storeu_ps(ar + j, _mm256_add_ps(var, tr));
+			_mm256_storeu_ps(ai + j, _mm256_add_ps(vai, ti));
+		}
+		dsp_butterfly_tail(ar, ai, br, bi, wr, wi, j, h);
+	}
+}
+
+DSP_TARGET_AVX2 static void dsp_reduce_avx2(const float *x, uint32_t num, float *pMin, float *pMax, float *pSumSq) {
+	uint32_t i = 0;
+	*pMin = x[0];
+	*pMax = x[0];
+	*pSumSq = 0.0f;
+	if( num >= 8 ) {
+		__m256 mn = _mm256_loadu_ps(x), mx = mn, sq = _mm256_setzero_ps();
+		for( ; i+8<=num; i+=8 ) {
+			__m256 v = _mm256_loadu_ps(x + i);
+			mn = _mm256_min_ps(mn, v);
+			mx = _mm256_max_ps(mx, v);
+			sq = _mm256_add_ps(sq, _mm256_mul_ps(v, v));
+		}
+		__m128 mn4 = _mm_min_ps(_mm256_castps256_ps128(mn), _mm256_extractf128_ps(mn, 1));
+		__m128 mx4 = _mm_max_ps(_mm256_castps256_ps128(mx), _mm256_extractf128_ps(mx, 1));
+		__m128 sq4 = _mm_add_ps(_mm256_castps256_ps128(sq), _mm256_extractf128_ps(sq, 1));
+		mn4 = _mm_min_ps(mn4, _mm_movehl_ps(mn4, mn4));
+		mn4 = _mm_min_ss(mn4, _mm_shuffle_ps(mn4, mn4, 1));
+		mx4 = _mm_max_ps(mx4, _mm_movehl_ps(mx4, mx4));
+		mx4 = _mm_max_ss(mx4, _mm_shuffle_ps(mx4, mx4, 1));
+		sq4 = _mm_add_ps(sq4, _mm_movehl_ps(sq4, sq4));
+		sq4 = _mm_add_ss(sq4, _mm_shuffle_ps(sq4, sq4, 1));
+		*pMin = _mm_cvtss_f32(mn4);
+		*pMax = _mm_cvtss_f32(mx4);
+		*pSumSq = _mm_cvtss_f32(sq4);
+	}
+	dsp_reduce_tail(x, i, num, pMin, pMax, pSumSq);
+}
+
+#if (USEDOUBLES == 1)
+DSP_TARGET_AVX2 static void dsp_dot_lanes_avx2(double *acc, const double *x, const double *y, uint32_t rows, uint32_t xs, uint32_t ys, uint32_t lanes) {
+	uint32_t k = 0, r;
+	for( ; k+8<=lanes; k+=8 ) {
+		__m256d a0 = _mm256_loadu_pd(acc + k), a1 = _mm256_loadu_pd(acc + k + 4);
+		for( r=0; r<rows; r++ ) {
+			const double *px = x + (size_t)r * xs + k, *py = y + (size_t)r * ys + k;
+			a0 = _mm256_add_pd(a0, _mm256_mul_pd(_mm256_loadu_pd(px), _mm256_loadu_pd(py)));
+			a1 = _mm256_add_pd(a1, _mm256_mul_pd(_mm256_loadu_pd(px + 4), _mm256_loadu_pd(py + 4)));
+		}
+		_mm256_storeu_pd(acc + k, a0);
+		_mm256_storeu_pd(acc + k + 4, a1);
+	}
+	dsp_dot_lanes_sse2(acc + k, x + k, y + k, rows, xs, ys, lanes - k);
+}
+#endif
+
+DSP_TARGET_AVX2 static uint32_t dsp_unpack_avx2(const uint8_t *pBuf, uint16_t bit_per_sample, float *pOut, uint32_t num) {
+	uint32_t i = 0;
+	if( bit_per_sample == 8 ) {
+		__m256 scale = _mm256_set1_ps(1.0f / 128.0f);
+		for( ; i+8<=num; i+=8 ) {
+			__m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(pBuf + i)));
+			v = _mm256_sub_epi32(v, _mm256_set1_epi32(128));
+			_mm256_storeu_ps(pOut + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+		}
+	} else if( bit_per_sample == 16 ) {
+		__m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+		for( ; i+8<=num; i+=8 ) {
+			__m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(pBuf + (size_t)i * 2)));
+			_mm256_storeu_ps(pOut + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+		}
+	} else if( bit_per_sample == 24 ) {
+		/* sample k of a lane to the top 3 bytes of dword k, the arithmetic shift sign extends */
+		__m256i shuf = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+										-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+		__m256 scale = _mm256_set1_ps(1.0f / 8388608.0f);
+		/* the second load reads 4 bytes past the 8 samples */
+		for( ; i+10<=num; i+=8 ) {
+			const uint8_t *p = pBuf + (size_t)i * 3;
+			__m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p)), _mm_loadu_si128((const __m128i *)(p + 12)), 1);
+			v = _mm256_srai_epi32(_mm256_shuffle_epi8(v, shuf), 8);
+			_mm256_storeu_ps(pOut + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+		}
+	} else if( bit_per_sample == 32 ) {
+		/* scaled in double like the scalar path, then rounded once to float */
+		__m256d scale = _mm256_set1_pd(1.0 / 2147483648.0);
+		for( ; i+8<=num; i+=8 ) {
+			const __m128i *p = (const __m128i *)(pBuf + (size_t)i * 4);
+			__m128 lo = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_cvtepi32_pd(_mm_loadu_si128(p)), scale));
+			__m128 hi = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_cvtepi32_pd(_mm_loadu_si128(p + 1)), scale));
+			_mm256_storeu_ps(pOut + i, _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1));
+		}
+	}
+	return i;
+}
+
+/**
+ * @brief
+ * float_to_pcm() rounding of 4 samples
+ */
+DSP_TARGET_AVX2 static inline __m128i dsp_round4_avx2(const float *p, __m256d fs, __m256d lo, __m256d hi) {
+	__m256d v = _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(p)), fs);
+	__m256d half = _mm256_or_pd(_mm256_and_pd(v, _mm256_set1_pd(-0.0)), _mm256_set1_pd(0.5));
+	v = _mm256_max_pd(_mm256_min_pd(_mm256_add_pd(v, half), hi), lo);
+	return _mm256_cvttpd_epi32(v);
+}
+
+DSP_TARGET_AVX2 static uint32_t dsp_pack_avx2(const float *pIn, uint16_t bit_per_sample, uint8_t *pBuf, uint32_t num) {
+	uint32_t i = 0;
+	double full = (double)(1u << (bit_per_sample - 1));
+	__m256d fs = _mm256_set1_pd(full), lo = _mm256_set1_pd(-full), hi = _mm256_set1_pd(full - 1);
+	if( bit_per_sample == 8 ) {
+		for( ; i+8<=num; i+=8 ) {
+			__m128i v = _mm_packs_epi32(dsp_round4_avx2(pIn + i, fs, lo, hi), dsp_round4_avx2(pIn + i + 4, fs, lo, hi));
+			v = _mm_add_epi16(v, _mm_set1_epi16(128));
+			_mm_storel_epi64((__m128i *)(pBuf + i), _mm_packus_epi16(v, v));
+		}
+	} else if( bit_per_sample == 16 ) {
+		for( ; i+8<=num; i+=8 ) {
+			__m128i v = _mm_packs_epi32(dsp_round4_avx2(pIn + i, fs, lo, hi), dsp_round4_avx2(pIn + i + 4, fs, lo, hi));
+			_mm_storeu_si128((__m128i *)(pBuf + (size_t)i * 2), v);
+		}
+	} else if( bit_per_sample == 24 ) {
+		/* low 3 bytes of the 4 dwords to 12 bytes, stored as 8 + 4 so nothing past the samples is written */
+		__m128i shuf = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+		for( ; i+4<=num; i+=4 ) {
+			uint8_t *p = pBuf + (size_t)i * 3;
+			__m128i v = _mm_shuffle_epi8(dsp_round4_avx2(pIn + i, fs, lo, hi), shuf);
+			sint32_t last = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+			_mm_storel_epi64((__m128i *)p, v);
+			memcpy(p + 8, &last, 4);
+		}
+	} else if( bit_per_sample == 32 ) {
+		for( ; i+4<=num; i+=4 ) {
+			_mm_storeu_si128((__m128i *)(pBuf + (size_t)i * 4), dsp_round4_avx2(pIn + i, fs, lo, hi));
+		}
+	}
+	return i;
+}
+
+#if (USEDOUBLES == 1)
+DSP_TARGET_AVX2 static void dsp_ola_avx2(double *o, const double *l, const double *r, uint32_t num) {
+	uint32_t i = 0;
+	__m256d incr = _mm256_set1_pd(1.0 / num), one = _mm256_set1_pd(1.0), four = _mm256_set1_pd(4.0);
+	__m256d lo = _mm256_set1_pd(-32768.0), hi = _mm256_set1_pd(32767.0);
+	__m256d idx = _mm256_setr_pd(1.0, 2.0, 3.0, 4.0);
+	for( ; i+4<=num; i+=4 ) {
+		__m256d w = _mm256_mul_pd(idx, incr);
+		__m256d t = _mm256_add_pd(_mm256_mul_pd(_mm256_sub_pd(one, w), _mm256_loadu_pd(l + i)), _mm256_mul_pd(w, _mm256_loadu_pd(r + i)));
+		_mm256_storeu_pd(o + i, _mm256_min_pd(_mm256_max_pd(t, lo), hi));
+		idx = _mm256_add_pd(idx, four);
+	}
+	dsp_ola_tail(o, l, r, i, num);
+}
+#endif
+
+DSP_TARGET_AVX2 static void dsp_ola_s16_avx2(sint16_t *o, const sint16_t *l, const sint16_t *r, uint32_t num, double gain) {
+	uint32_t i = 0;
+	__m256d incr = _mm256_set1_pd(1.0 / num), one = _mm256_set1_pd(1.0), four = _mm256_set1_pd(4.0), g = _mm256_set1_pd(gain);
+	__m256d idx = _mm256_setr_pd(1.0, 2.0, 3.0, 4.0);
+	for( ; i+8<=num; i+=8 ) {
+		__m256i vl = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(l + i)));
+		__m256i vr = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(r + i)));
+		__m256d w0 = _mm256_mul_pd(idx, incr), w1 = _mm256_mul_pd(_mm256_add_pd(idx, four), incr);
+		__m256d t0 = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(_mm256_sub_pd(one, w0), g), _mm256_cvtepi32_pd(_mm256_castsi256_si128(vl))),
+								   _mm256_mul_pd(w0, _mm256_cvtepi32_pd(_mm256_castsi256_si128(vr))));
+		__m256d t1 = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(_mm256_sub_pd(one, w1), g), _mm256_cvtepi32_pd(_mm256_extracti128_si256(vl, 1))),
+								   _mm256_mul_pd(w1, _mm256_cvtepi32_pd(_mm256_extracti128_si256(vr, 1))));
+		_mm_storeu_si128((__m128i *)(o + i), _mm_packs_epi32(_mm256_cvttpd_epi32(t0), _mm256_cvttpd_epi32(t1)));
+		idx = _mm256_add_pd(idx, _mm256_add_pd(four, four));
+	}
+	dsp_ola_s16_tail(o, l, r, i, num, gain);
+}
+
+#if (USEDOUBLES == 1)
+DSP_TARGET_AVX2 static void dsp_gain_ramp_avx2(sint16_t *o, const double *f, uint32_t num, double g, double dg, uint32_t i0) {
+	uint32_t i = 0;
+	__m256d vg = _mm256_set1_pd(g), vdg = _mm256_set1_pd(dg), four = _mm256_set1_pd(4.0);
+	__m256d idx = _mm256_add_pd(_mm256_set1_pd((double)i0), _mm256_setr_pd(0.0, 1.0, 2.0, 3.0));
+	for( ; i+8<=num; i+=8 ) {
+		__m256d x0, x1;
+		__m256d idx1 = _mm256_add_pd(idx, four);
+		if( f != NULL ) {
+			x0 = _mm256_cvtepi32_pd(_mm256_cvttpd_epi32(_mm256_loadu_pd(f + i)));
+			x1 = _mm256_cvtepi32_pd(_mm256_cvttpd_epi32(_mm256_loadu_pd(f + i + 4)));
+		} else {
+			__m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(o + i)));
+			x0 = _mm256_cvtepi32_pd(_mm256_castsi256_si128(v));
+			x1 = _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1));
+		}
+		x0 = _mm256_mul_pd(x0, _mm256_sub_pd(vg, _mm256_mul_pd(idx, vdg)));
+		x1 = _mm256_mul_pd(x1, _mm256_sub_pd(vg, _mm256_mul_pd(idx1, vdg)));
+		_mm_storeu_si128((__m128i *)(o + i), _mm_packs_epi32(_mm256_cvttpd_epi32(x0), _mm256_cvttpd_epi32(x1)));
+		idx = _mm256_add_pd(idx1, four);
+	}
+	dsp_gain_ramp_tail(o, f, i, num, g, dg, i0);
+}
+#endif
+
+DSP_TARGET_AVX2 static double dsp_dot_double_avx2(const float *x, const float *y, uint32_t num) {
+	uint32_t i = 0, j;
+	double acc[DSP_DOT_DOUBLE_SUMS];
+	__m256d xy[DSP_DOT_DOUBLE_SUMS / 4];
+	for( j=0; j<DSP_DOT_DOUBLE_SUMS/4; j++ ) {
+		xy[j] = _mm256_setzero_pd();
+	}
+	for( ; i+DSP_DOT_DOUBLE_SUMS<=num; i+=DSP_DOT_DOUBLE_SUMS ) {
+		for( j=0; j<DSP_DOT_DOUBLE_SUMS/4; j++ ) {
+			xy[j] = _mm256_add_pd(xy[j], _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(x + i + 4 * j)), _mm256_cvtps_pd(_mm_loadu_ps(y + i + 4 * j))));
+		}
+	}
+	for( j=0; j<DSP_DOT_DOUBLE_SUMS/4; j++ ) {
+		_mm256_storeu_pd(acc + 4 * j, xy[j]);
+	}
+	return dsp_dot_double_tail(x, y, i, num, acc);
+}
+
+DSP_TARGET_AVX2 static void dsp_dot3_double_avx2(const float *x, const float *y, uint32_t num, double *pSums) {
+	uint32_t i = 0, j;
+	double acc[3 * DSP_DOT_DOUBLE_SUMS];
+	__m256d xy[DSP_DOT_DOUBLE_SUMS / 4], xx[DSP_DOT_DOUBLE_SUMS / 4], yy[DSP_DOT_DOUBLE_SUMS / 4];
+	for( j=0; j<DSP_DOT_DOUBLE_SUMS/4; j++ ) {
+		xy[j] = _mm256_setzero_pd();
+		xx[j] = _mm256_setzero_pd();
+		yy[j] = _mm256_setzero_pd();
+	}
+	for( ; i+DSP_DOT_DOUBLE_SUMS<=num; i+=DSP_DOT_DOUBLE_SUMS ) {
+		for( j=0; j<DSP_DOT_DOUBLE_SUMS/4; j++ ) {
+			__m256d vx = _mm256_cvtps_pd(_mm_loadu_ps(x + i + 4 * j));
+			__m256d vy = _mm256_cvtps_pd(_mm_loadu_ps(y + i + 4 * j));
+			xy[j] = _mm256_add_pd(xy[j], _mm256_mul_pd(vx, vy));
+			xx[j] = _mm256_add_pd(xx[j], _mm256_mul_pd(vx, vx));
+			yy[j] = _mm256_add_pd(yy[j], _mm256_mul_pd(vy, vy));
+		}
+	}
+	for( j=0; j<DSP_DOT_DOUBLE_SUMS/4; j++ ) {
+		_mm256_storeu_pd(acc + 4 * j, xy[j]);
+		_mm256_storeu_pd(acc + DSP_DOT_DOUBLE_SUMS + 4 * j, xx[j]);
+		_mm256_storeu_pd(acc + 2 * DSP_DOT_DOUBLE_SUMS + 4 * j, yy[j]);
+	}
+	dsp_dot3_double_tail(x, y, i, num, acc, pSums);
+}
+
+/*-------------------- AVX512 --------------------*/
+/* the gcc 12 avx512 headers fill unused operands with _mm512_undefined_ps(), a false uninitialized warning */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+/* horizontal OP of the 16 lanes, halves folded onto each other */
+#define DSP_AVX512_FOLD(NAME, OP) \
+	DSP_TARGET_AVX512 static inline float NAME(__m512 v) { \
+		v = OP(v, _mm512_shuffle_f32x4(v, v, _MM_SHUFFLE(1, 0, 3, 2))); \
+		v = OP(v, _mm512_shuffle_f32x4(v, v, _MM_SHUFFLE(2, 3, 0, 1))); \
+		v = OP(v, _mm512_permute_ps(v, _MM_SHUFFLE(1, 0, 3, 2))); \
+		v = OP(v, _mm512_permute_ps(v, _MM_SHUFFLE(2, 3, 0, 1))); \
+		return _mm_cvtss_f32(_mm512_castps512_ps128(v)); \
+	}
+
+DSP_AVX512_FOLD(dsp_avx512_sum, _mm512_add_ps)
+DSP_AVX512_FOLD(dsp_avx512_min, _mm512_min_ps)
+DSP_AVX512_FOLD(dsp_avx512_max, _mm512_max_ps)
+
+DSP_TARGET_AVX512 static float dsp_dot_avx512(const float *x, const float *y, uint32_t num) {
+	uint32_t i = 0;
+	__m512 acc0 = _mm512_setzero_ps();
+	__m512 acc1 = _mm512_setzero_ps();
+	for( ; i+32<=num; i+=32 ) {
+		acc0 = _mm512_add_ps(acc0, _mm512_mul_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+		acc1 = _mm512_add_ps(acc1, _mm512_mul_ps(_mm512_loadu_ps(x + i + 16), _mm512_loadu_ps(y + i + 16)));
+	}
+	for( ; i+16<=num; i+=16 ) {
+		acc0 = _mm512_add_ps(acc0, _mm512_mul_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+	}
+	if( i < num ) {
+		__mmask16 m = (__mmask16)((1u << (num - i)) - 1);
+		acc1 = _mm512_add_ps(acc1, _mm512_mul_ps(_mm512_maskz_loadu_ps(m, x + i), _mm512_maskz_loadu_ps(m, y + i)));
+	}
+	return dsp_avx512_sum(_mm512_add_ps(acc0, acc1));
+}
+
+DSP_TARGET_AVX512 static void dsp_axpy_avx512(float *y, float k, const float *x, uint32_t num) {
+	uint32_t i = 0;
+	__m512 vk = _mm512_set1_ps(k);
+	for( ; i+16<=num; i+=16 ) {
+		_mm512_storeu_ps(y + i, _mm512_add_ps(_mm512_loadu_ps(y + i), _mm512_mul_ps(vk, _mm512_loadu_ps(x + i))));
+	}
+	if( i < num ) {
+		__mmask16 m = (__mmask16)((1u << (num - i)) - 1);
+		_mm512_mask_storeu_ps(y + i, m, _mm512_add_ps(_mm512_maskz_loadu_ps(m, y + i), _mm512_mul_ps(vk, _mm512_maskz_loadu_ps(m, x + i))));
+	}
+}
+
+DSP_TARGET_AVX512 static void dsp_lattice_avx512(float *f, float *b, float k, uint32_t num) {
+	uint32_t i = 0;
+	__m512 vk = _mm512_set1_ps(k);
+	for( ; i+16<=num; i+=16 ) {
+		__m512 vf = _mm512_loadu_ps(f + i), vb = _mm512_loadu_ps(b + i);
+		_mm512_storeu_ps(f + i, _mm512_add_ps(vf, _mm512_mul_ps(vk, vb)));
+		_mm512_storeu_ps(b + i, _mm512_add_ps(vb, _mm512_mul_ps(vk, vf)));
+	}
+	if( i < num ) {
+		__mmask16 m = (__mmask16)((1u << (num - i)) - 1);
+		__m512 vf = _mm512_maskz_loadu_ps(m, f + i), vb = _mm512_maskz_loadu_ps(m, b + i);
+		_mm512_mask_storeu_ps(f + i, m, _mm512_add_ps(vf, _mm512_mul_ps(vk, vb)));
+		_mm512_mask_storeu_ps(b + i, m, _mm512_add_ps(vb, _mm512_mul_ps(vk, vf)));
+	}
+}
+
+DSP_TARGET_AVX512 static void dsp_fft_stage_avx512(float *re, float *im, const float *wr, const float *wi, uint32_t h, uint32_t m) {
+	uint32_t b, j;
+	if( h < 16 ) {
+		dsp_fft_stage_avx2(re, im, wr, wi, h, m);
+		return;
+	}
+	for( b=0; b<m; b+=2*h ) {
+		float *ar = re + b, *ai = im + b, *br = re + b + h, *bi = im + b + h;
+		/* h is a power of two, no tail */
+		for( j=0; j<h; j+=16 ) {
+			__m512 vwr = _mm512_loadu_ps(wr + j), vwi = _mm512_loadu_ps(wi + j);
+			__m512 vbr = _mm512_loadu_ps(br + j), vbi = _mm512_loadu_ps(bi + j);
+			__m512 var = _mm512_loadu_ps(ar + j), vai = _mm512_loadu_ps(ai + j);
+			__m512 tr = _mm512_sub_ps(_mm512_mul_ps(vbr, vwr), _mm512_mul_ps(vbi, vwi));
+			__m512 ti = _mm512_add_ps(_mm512_mul_ps(vbr, vwi), _mm512_mul_ps(vbi, vwr));
+			_mm512_storeu_ps(br + j, _mm512_sub_ps(var, tr));
+			_mm512_storeu_ps(bi + j, _mm512_sub_ps(vai, ti));
+			_mm512_storeu_ps(ar + j, _mm512_add_ps(var, tr));
+			_mm512_storeu_ps(ai + j, _mm512_add_ps(vai, ti));
+		}
+	}
+}
+
+DSP_TARGET_AVX512 static void dsp_reduce_avx512(const float *x, uint32_t num, float *pMin, float *pMax, float *pSumSq) {
+	uint32_t i = 0;
+	if( num < 16 ) {
+		dsp_reduce_avx2(x, num, pMin, pMax, pSumSq);
+		return;
+	}
+	__m512 mn = _mm512_loadu_ps(x), mx = mn, sq = _mm512_setzero_ps();
+	for( ; i+16<=num; i+=16 ) {
+		__m512 v = _mm512_loadu_ps(x + i);
+		mn = _mm512_min_ps(mn, v);
+		mx = _mm512_max_ps(mx, v);
+		sq = _mm512_add_ps(sq, _mm512_mul_ps(v, v));
+	}
+	if( i < num ) {
+		/* the masked out lanes repeat x[0], neutral for min / max, zero for the sum */
+		__mmask16 m = (__mmask16)((1u << (num - i)) - 1);
+		__m512 v = _mm512_mask_loadu_ps(_mm512_set1_ps(x[0]), m, x + i);
+		mn = _mm512_min_ps(mn, v);
+		mx = _mm512_max_ps(mx, v);
+		sq = _mm512_mask_add_ps(sq, m, sq, _mm512_mul_ps(v, v));
+	}
+	*pMin = dsp_avx512_min(mn);
+	*pMax = dsp_avx512_max(mx);
+	*pSumSq = dsp_avx512_sum(sq);
+}
+
+#if (USEDOUBLES == 1)
+DSP_TARGET_AVX512 static void dsp_dot_lanes_avx512(double *acc, const double *x, const double *y, uint32_t rows, uint32_t xs, uint32_t ys, uint32_t lanes) {
+	uint32_t k = 0, r;
+	for( ; k+16<=lanes; k+=16 ) {
+		__m512d a0 = _mm512_loadu_pd(acc + k), a1 = _mm512_loadu_pd(acc + k + 8);
+		for( r=0; r<rows; r++ ) {
+			const double *px = x + (size_t)r * xs + k, *py = y + (size_t)r * ys + k;
+			a0 = _mm512_add_pd(a0, _mm512_mul_pd(_mm512_loadu_pd(px), _mm512_loadu_pd(py)));
+			a1 = _mm512_add_pd(a1, _mm512_mul_pd(_mm512_loadu_pd(px + 8), _mm512_loadu_pd(py + 8)));
+		}
+		_mm512_storeu_pd(acc + k, a0);
+		_mm512_storeu_pd(acc + k + 8, a1);
+	}
+	if( k < lanes ) {
+		__mmask8 m = (lanes - k >= 8) ? (__mmask8)0xff : (__mmask8)((1u << (lanes - k)) - 1);
+		__m512d a0 = _mm512_maskz_loadu_pd(m, acc + k);
+		for( r=0; r<rows; r++ ) {
+			a0 = _mm512_add_pd(a0, _mm512_mul_pd(_mm512_maskz_loadu_pd(m, x + (size_t)r * xs + k), _mm512_maskz_loadu_pd(m, y + (size_t)r * ys + k)));
+		}
+		_mm512_mask_storeu_pd(acc + k, m, a0);
+		k += (lanes - k >= 8) ? 8 : lanes - k;
+	}
+	dsp_dot_lanes_scalar(acc + k, x + k, y + k, rows, xs, ys, lanes - k);
+}
+#endif
+
+DSP_TARGET_AVX512 static double dsp_dot_double_avx512(const float *x, const float *y, uint32_t num) {
+	uint32_t i = 0, j;
+	double acc[DSP_DOT_DOUBLE_SUMS];
+	__m512d xy[DSP_DOT_DOUBLE_SUMS / 8];
+	for( j=0; j<DSP_DOT_DOUBLE_SUMS/8; j++ ) {
+		xy[j] = _mm512_setzero_pd();
+	}
+	for( ; i+DSP_DOT_DOUBLE_SUMS<=num; i+=DSP_DOT_DOUBLE_SUMS ) {
+		for( j=0; j<DSP_DOT_DOUBLE_SUMS/8; j++ ) {
+			xy[j] = _mm512_add_pd(xy[j], _mm512_mul_pd(_mm512_cvtps_pd(_mm256_loadu_ps(x + i + 8 * j)), _mm512_cvtps_pd(_mm256_loadu_ps(y + i + 8 * j))));
+		}
+	}
+	for( j=0; j<DSP_DOT_DOUBLE_SUMS/8; j++ ) {
+		_mm512_storeu_pd(acc + 8 * j, xy[j]);
+	}
+	return dsp_dot_double_tail(x, y, i, num, acc);
+}
+
+DSP_TARGET_AVX512 static void dsp_dot3_double_avx512(const float *x, const float *y, uint32_t num, double *pSums) {
+	uint32_t i = 0, j;
+	double acc[3 * DSP_DOT_DOUBLE_SUMS];
+	__m512d xy[DSP_DOT_DOUBLE_SUMS / 8], xx[DSP_DOT_DOUBLE_SUMS / 8], yy[DSP_DOT_DOUBLE_SUMS / 8];
+	for( j=0; j<DSP_DOT_DOUBLE_SUMS/8; j++ ) {
+		xy[j] = _mm512_setzero_pd();
+		xx[j] = _mm512_setzero_pd();
+		yy[j] = _mm512_setzero_pd();
+	}
+	for( ; i+DSP_DOT_DOUBLE_SUMS<=num; i+=DSP_DOT_DOUBLE_SUMS ) {
+		for( j=0; j<DSP_DOT_DOUBLE_SUMS/8; j++ ) {
+			__m512d vx = _mm512_cvtps_pd(_mm256_loadu_ps(x + i + 8 * j));
+			__m512d vy = _mm512_cvtps_pd(_mm256_loadu_ps(y + i + 8 * j));
+			xy[j] = _mm512_add_pd(xy[j], _mm512_mul_pd(vx, vy));
+			xx[j] = _mm512_add_pd(xx[j], _mm512_mul_pd(vx, vx));
+			yy[j] = _mm512_add_pd(yy[j], _mm512_mul_pd(vy, vy));
+		}
+	}
+	for( j=0; j<DSP_DOT_DOUBLE_SUMS/8; j++ ) {
+		_mm512_storeu_pd(acc + 8 * j, xy[j]);
+		_mm512_storeu_pd(acc + DSP_DOT_DOUBLE_SUMS + 8 * j, xx[j]);
+		_mm512_storeu_pd(acc + 2 * DSP_DOT_DOUBLE_SUMS + 8 * j, yy[j]);
+	}
+	dsp_dot3_double_tail(x, y, i, num, acc, pSums);
+}
+
+#pragma GCC diagnostic pop
+#endif
+
+/*-------------------- DISPATCH TABLE --------------------*/
+/* IO / PLC : suffix of the pack / unpack and of the LowcFE synthesis kernels, the avx512 row keeps the avx2 ones */
+#if (USEDOUBLES == 1)
+#define DSP_KERNEL_ROW(ISA, SUFFIX, IO, PLC) \
+	{ ISA, SIMDISA_SCALAR, 0, dsp_dot_##SUFFIX, dsp_axpy_##SUFFIX, dsp_lattice_##SUFFIX, dsp_fft_stage_##SUFFIX, dsp_reduce_##SUFFIX, \
+	  dsp_unpack_##IO, dsp_pack_##IO, dsp_dot_lanes_##SUFFIX, dsp_ola_##PLC, dsp_ola_s16_##PLC, dsp_gain_ramp_##PLC, dsp_dot_double_##SUFFIX, dsp_dot3_double_##SUFFIX }
+#else
+/* Float is float, the double vectors of the Float kernels are not built */
+#define DSP_KERNEL_ROW(ISA, SUFFIX, IO, PLC) \
+	{ ISA, SIMDISA_SCALAR, 0, dsp_dot_##SUFFIX, dsp_axpy_##SUFFIX, dsp_lattice_##SUFFIX, dsp_fft_stage_##SUFFIX, dsp_reduce_##SUFFIX, \
+	  dsp_unpack_##IO, dsp_pack_##IO, dsp_dot_lanes_scalar, dsp_ola_scalar, dsp_ola_s16_##PLC, dsp_gain_ramp_scalar, dsp_dot_double_##SUFFIX, dsp_dot3_double_##SUFFIX }
+#endif
+
+static const dsp_kernel_c dsp_kernel_table[SIMDISA_MAX] = {
+	/* SIMDISA_AUTO, resolved before the lookup */
+	DSP_KERNEL_ROW(SIMDISA_SCALAR, scalar, scalar, scalar),
+	DSP_KERNEL_ROW(SIMDISA_SCALAR, scalar, scalar, scalar),
+#if (DSP_X86 == 1)
+	DSP_KERNEL_ROW(SIMDISA_SSE2, sse2, sse2, sse2),
+	DSP_KERNEL_ROW(SIMDISA_AVX2, avx2, avx2, avx2),
+	DSP_KERNEL_ROW(SIMDISA_AVX512, avx512, avx2, avx2),
+#endif
+};
+
+/*-------------------- GLOBAL PARAMETER --------------------*/
+dsp_kernel_c gDspKernel = DSP_KERNEL_ROW(SIMDISA_SCALAR, scalar, scalar, scalar);
+
+/*-------------------- FUNCTIONS --------------------*/
+uint8_t dsp_cpu_isa(void) {
+#if (DSP_X86 == 1)
+	__builtin_cpu_init();
+	if( __builtin_cpu_supports("avx512f") ) {
+		return SIMDISA_AVX512;
+	}
+	if( __builtin_cpu_supports("avx2") ) {
+		return SIMDISA_AVX2;
+	}
+	if( __builtin_cpu_supports("sse2") ) {
+		return SIMDISA_SSE2;
+	}
+#endif
+	return SIMDISA_SCALAR;
+}
+
+/**
+ * @brief
+ * bind the kernels once, before any dsp module runs
+ * @param force : SIMDISA_AUTO for the best of the cpu, others force that instruction set
+ */
+void dsp_kernel_init(uint8_t force) {
+	uint8_t cpu = dsp_cpu_isa();
+	uint8_t isa = cpu;
+
+	if( force != SIMDISA_AUTO && force < SIMDISA_MAX ) {
+		if( force > cpu ) {
+			printf("simd : %s is not supported by the cpu, %s is used\n", simdisa_name[force], simdisa_name[cpu]);
+		}
+		isa = (force < cpu) ? force : cpu;
+	}
+	gDspKernel = dsp_kernel_table[isa];
+	gDspKernel.isa_cpu = cpu;
+	gDspKernel.forced = (isa != cpu) ? 1 : 0;
+}
@@ -0,0 +1,62 @@
+#ifndef _H_DSP_KERNEL_
+#define _H_DSP_KERNEL_
+
+#include "arch.h"
+#include "config.h"
+
+// float kernels shared by the dsp modules (and the Float kernels of LowcFE), one implementation per
+// instruction set in the same binary, dsp_kernel_init() binds the best one the cpu runs (or the forced one) once
+// at startup
+
+/*-------------------- CONFIGURATION --------------------*/
+#define DSP_DOT_DOUBLE_SUMS (16) /* partial sums of dot_double / dot3_double, sample i goes to sum i % 16 */
+#if (SIMD_EN == 1) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DSP_X86 (1)
+#define DSP_TARGET_SSE2 __attribute__((target("sse2")))
+#define DSP_TARGET_AVX2 __attribute__((target("avx2")))
+/* avx512f brings fma, no contraction so the element wise kernels stay bit exact with the other sets */
+#define DSP_TARGET_AVX512 __attribute__((target("avx512f"), optimize("fp-contract=off")))
+#else
+#define DSP_X86 (0)
+#endif
+
+typedef float (*dsp_dot_f)(const float *x, const float *y, uint32_t num);
+typedef void (*dsp_axpy_f)(float *y, float k, const float *x, uint32_t num);
+typedef void (*dsp_lattice_f)(float *f, float *b, float k, uint32_t num);
+typedef void (*dsp_fft_stage_f)(float *re, float *im, const float *wr, const float *wi, uint32_t h, uint32_t m);
+typedef void (*dsp_reduce_f)(const float *x, uint32_t num, float *pMin, float *pMax, float *pSumSq);
+typedef uint32_t (*dsp_unpack_f)(const uint8_t *pBuf, uint16_t bit_per_sample, float *pOut, uint32_t num);
+typedef uint32_t (*dsp_pack_f)(const float *pIn, uint16_t bit_per_sample, uint8_t *pBuf, uint32_t num);
+typedef void (*dsp_dot_lanes_f)(Float *acc, const Float *x, const Float *y, uint32_t rows, uint32_t xs, uint32_t ys, uint32_t lanes);
+typedef void (*dsp_ola_f)(Float *o, const Float *l, const Float *r, uint32_t num);
+typedef void (*dsp_ola_s16_f)(sint16_t *o, const sint16_t *l, const sint16_t *r, uint32_t num, double gain);
+typedef void (*dsp_gain_ramp_f)(sint16_t *o, const Float *f, uint32_t num, double g, double dg, uint32_t i0);
+typedef double (*dsp_dot_double_f)(const float *x, const float *y, uint32_t num);
+typedef void (*dsp_dot3_double_f)(const float *x, const float *y, uint32_t num, double *pSums);
+
+typedef struct _dsp_kernel_c {
+	uint8_t isa;				/* SIMDISA_xxx of the bound kernels */
+	uint8_t isa_cpu;			/* best SIMDISA_xxx of the cpu */
+	uint8_t forced;				/* isa is below the cpu because of the override */
+	dsp_dot_f dot;				/* sum x[i] * y[i] */
+	dsp_axpy_f axpy;			/* y[i] += k * x[i] */
+	dsp_lattice_f lattice;		/* f[i], b[i] = f[i] + k * b[i], b[i] + k * f[i] */
+	dsp_fft_stage_f fft_stage;	/* radix-2 stage of span h over m complex points, split re / im */
+	dsp_reduce_f reduce;		/* min, max and sum of squares, num > 0 */
+	dsp_unpack_f unpack;		/* packed pcm to float, returns the samples done, the caller finishes the rest */
+	dsp_pack_f pack;			/* float to packed pcm, same rounding as float_to_pcm(), returns the samples done */
+	dsp_dot_lanes_f dot_lanes;	/* acc[k] += sum x[r * xs + k] * y[r * ys + k], each lane summed in row order */
+	dsp_ola_f ola;				/* o[i] = (1 - w) * l[i] + w * r[i] clamped to 16 bit, w = (i + 1) / num */
+	dsp_ola_s16_f ola_s16;		/* o[i] = (1 - w) * gain * l[i] + w * r[i] truncated and saturated, o may be r */
+	dsp_gain_ramp_f gain_ramp;	/* o[i] = x[i] * (g - (i0 + i) * dg) truncated, x : f[i] truncated, or o[i] when f is NULL */
+	dsp_dot_double_f dot_double;	/* sum x[i] * y[i] in double, the same summation order in every set */
+	dsp_dot3_double_f dot3_double;	/* pSums[0..2] = dot_double of x y, x x and y y in one pass */
+} dsp_kernel_c;
+
+extern dsp_kernel_c gDspKernel; /* scalar kernels until dsp_kernel_init() */
+
+/*-------------------- FUNCTIONS --------------------*/
+uint8_t dsp_cpu_isa(void);
+void dsp_kernel_init(uint8_t force);
+
+#endif
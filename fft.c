@@ -0,0 +1,207 @@
+/**
+ * @file fft.c
+ * @author weiyuan.hsu
+ * @brief
+ * implement of the real fft
+ *
+ * fft_get: ................ Return the plan of size n (power of two), bit reverse table and twiddles are
+ * 							 built once and cached, like the resampler filter banks.
+ *
+ * fft_forward: ............ n real samples are packed as n/2 complex samples (even + i odd), transformed
+ * 							 by an iterative radix-2 fft on split re / im arrays and split back into the
+ * 							 n/2+1 bins of the real spectrum. The split layout lets a butterfly stage run
+ * 							 16 (AVX512), 8 (AVX2) or 4 (SSE2) butterflies per instruction, see gDspKernel.
+ *
+ * fft_inverse: ............ Reverse of fft_forward, scaled so fft_inverse(fft_forward(x)) = x.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "arch.h"
+#include "config.h"
+#include "fft.h"
+#include "dspKernel.h"
+
+/*-------------------- GLOBAL PARAMETER --------------------*/
+static fft_c fft_cache[FFT_CACHE_NUM];
+static uint32_t fft_cache_next = 0;
+
+/*-------------------- INTERNAL FUNCTIONS --------------------*/
+static void fft_free(fft_c *fft) {
+	free(fft->bitrev);
+	free(fft->tw_re);
+	free(fft->tw_im);
+	free(fft->post_re);
+	free(fft->post_im);
+	memset(fft, 0x0, sizeof(fft_c));
+}
+
+static sint32_t fft_plan(fft_c *fft, uint32_t n) {
+	uint32_t i, h, bits = 0;
+
+	fft->n = n;
+	fft->half = n / 2;
+	while( (1u << bits) < fft->half ) {
+		bits++;
+	}
+	fft->bitrev = (uint32_t *)malloc(sizeof(uint32_t) * fft->half);
+	fft->tw_re = (float *)malloc(sizeof(float) * fft->half);
+	fft->tw_im = (float *)malloc(sizeof(float) * fft->half);
+	fft->post_re = (float *)malloc(sizeof(float) * fft->half);
+	fft->post_im = (float *)malloc(sizeof(float) * fft->half);
+	if( fft->bitrev == NULL || fft->tw_re == NULL || fft->tw_im == NULL || fft->post_re == NULL || fft->post_im == NULL ) {
+		printf("Allocation memory error");
+		fft_free(fft);
+		return -1;
+	}
+
+	for( i=0; i<fft->half; i++ ) {
+		uint32_t r = 0, b;
+		for( b=0; b<bits; b++ ) {
+			r |= ((i >> b) & 1) << (bits - 1 - b);
+		}
+		fft->bitrev[i] = r;
+		fft->post_re[i] = (float)cos(2.0 * M_PI * i / n);
+		fft->post_im[i] = (float)-sin(2.0 * M_PI * i / n);
+	}
+	/* stage of span h combines two ffts of h points, twiddle j is exp(-pi i j / h) */
+	for( h=1; h<fft->half; h<<=1 ) {
+		for( i=0; i<h; i++ ) {
+			fft->tw_re[h - 1 + i] = (float)cos(M_PI * i / h);
+			fft->tw_im[h - 1 + i] = (float)-sin(M_PI * i / h);
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ * in place forward complex fft of fft->half points
+ */
+static void fft_complex(fft_c *fft, float *re, float *im) {
+	uint32_t m = fft->half;
+	uint32_t i, h;
+
+	for( i=0; i<m; i++ ) {
+		uint32_t r = fft->bitrev[i];
+		if( r > i ) {
+			float t = re[i]; re[i] = re[r]; re[r] = t;
+			t = im[i]; im[i] = im[r]; im[r] = t;
+		}
+	}
+
+	for( h=1; h<m; h<<=1 ) {
+		gDspKernel.fft_stage(re, im, fft->tw_re + h - 1, fft->tw_im + h - 1, h, m);
+	}
+}
+
+/*-------------------- FUNCTIONS --------------------*/
+/**
+ * @brief
+ * plan of a real fft of n points
+ * @return fft_c* : NULL if n is not a power of two in [FFT_SIZE_MIN, FFT_SIZE_MAX]
+ */
+fft_c *fft_get(uint32_t n) {
+	uint32_t i;
+	fft_c *fft;
+	if( n < FFT_SIZE_MIN || n > FFT_SIZE_MAX || (n & (n - 1)) != 0 ) {
+		return NULL;
+	}
+	for( i=0; i<FFT_CACHE_NUM; i++ ) {
+		if( fft_cache[i].n == n ) {
+			return &fft_cache[i];
+		}
+	}
+	fft = &fft_cache[fft_cache_next];
+	fft_cache_next = (fft_cache_next + 1) % FFT_CACHE_NUM;
+	fft_free(fft);
+	if( fft_plan(fft, n) != 0 ) {
+		return NULL;
+	}
+	return fft;
+}
+
+void fft_release_all(void) {
+	uint32_t i;
+	for( i=0; i<FFT_CACHE_NUM; i++ ) {
+		fft_free(&fft_cache[i]);
+	}
+}
+
+/**
+ * @brief
+ * spectrum of n real samples
+ * @param re, im : n/2+1 bins, also used as work area
+ */
+void fft_forward(fft_c *fft, const float *in, float *re, float *im) {
+	uint32_t m = fft->half;
+	uint32_t i, k;
+	float z0r, z0i;
+
+	for( i=0; i<m; i++ ) {
+		re[i] = in[2*i];
+		im[i] = in[2*i+1];
+	}
+	fft_complex(fft, re, im);
+
+	/* X[k] = E[k] + W^k O[k], E / O are the spectra of the even / odd samples */
+	z0r = re[0];
+	z0i = im[0];
+	re[0] = z0r + z0i;
+	im[0] = 0.0f;
+	re[m] = z0r - z0i;
+	im[m] = 0.0f;
+	for( k=1; k<=m/2; k++ ) {
+		float zkr = re[k], zki = im[k], zmr = re[m-k], zmi = im[m-k];
+		float er = 0.5f * (zkr + zmr), ei = 0.5f * (zki - zmi);
+		float or_ = 0.5f * (zki + zmi), oi = -0.5f * (zkr - zmr);
+		float tr = fft->post_re[k] * or_ - fft->post_im[k] * oi;
+		float ti = fft->post_re[k] * oi + fft->post_im[k] * or_;
+		re[m-k] = er - tr;
+		im[m-k] = ti - ei;
+		re[k] = er + tr;
+		im[k] = ei + ti;
+	}
+}
+
+/**
+ * @brief
+ * n real samples of a spectrum
+ * @param re, im : n/2+1 bins, destroyed
+ */
+void fft_inverse(fft_c *fft, float *re, float *im, float *out) {
+	uint32_t m = fft->half;
+	uint32_t i, k;
+	float scale = 1.0f / m;
+	float x0 = re[0], xm = re[m];
+
+	/* back to the packed spectrum Z[k] = E[k] + i O[k] */
+	re[0] = 0.5f * (x0 + xm);
+	im[0] = 0.5f * (x0 - xm);
+	for( k=1; k<=m/2; k++ ) {
+		float xkr = re[k], xki = im[k], xmr = re[m-k], xmi = im[m-k];
+		float er = 0.5f * (xkr + xmr), ei = 0.5f * (xki - xmi);
+		float dr = 0.5f * (xkr - xmr), di = 0.5f * (xki + xmi);
+		float or_ = dr * fft->post_re[k] + di * fft->post_im[k];
+		float oi = di * fft->post_re[k] - dr * fft->post_im[k];
+		re[m-k] = er + oi;
+		im[m-k] = or_ - ei;
+		re[k] = er - oi;
+		im[k] = ei + or_;
+	}
+
+	/* inverse complex fft as conj(fft(conj(Z))) */
+	for( i=0; i<m; i++ ) {
+		im[i] = -im[i];
+	}
+	fft_complex(fft, re, im);
+	for( i=0; i<m; i++ ) {
+		out[2*i] = re[i] * scale;
+		out[2*i+1] = -im[i] * scale;
+	}
+}
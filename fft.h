@@ -0,0 +1,27 @@
+#ifndef _H_FFT_
+#define _H_FFT_
+
+#include "arch.h"
+
+// real fft of power of two size, split complex spectrum (re[], im[]) of n/2+1 bins
+
+/*-------------------- CONFIGURATION --------------------*/
+#define FFT_SIZE_MIN (8)
+#define FFT_SIZE_MAX (1 << 16)
+#define FFT_CACHE_NUM (8) /* sizes kept by fft_get() */
+
+typedef struct _fft_c {
+	uint32_t n;					/* real size */
+	uint32_t half;				/* complex fft size, n/2 */
+	uint32_t *bitrev;			/* half entries */
+	float *tw_re, *tw_im;		/* stage twiddles, stage of span h at [h-1, 2h-1) */
+	float *post_re, *post_im;	/* exp(-2 pi i k / n), k < half, split of the real spectrum */
+} fft_c;
+
+/*-------------------- FUNCTIONS --------------------*/
+fft_c *fft_get(uint32_t n);
+void fft_release_all(void);
+void fft_forward(fft_c *fft, const float *in, float *re, float *im);
+void fft_inverse(fft_c *fft, float *re, float *im, float *out);
+
+#endif
@@ -0,0 +1,453 @@
+/**
+ * @file g711Codec.c
+ * @author weiyuan.hsu
+ * @brief
+ * implement of ITU-T G.711 A-law / u-law codec
+ *
+ * g711codec_init: ......... Build the encode/decode lookup tables from the reference functions and bind
+ * 							 the vector kernels of the instruction set of gDspKernel.
+ *
+ * g711_linear2xxx: ........ Single sample reference encoder (segment search).
+ * g711_xxx2linear: ........ Single sample reference decoder.
+ *
+ * g711_xxx_encode: ........ Bulk encoder. SSE2 / AVX2 path computes the segment with compares and the
+ * 							 mantissa with a per lane multiply, the scalar path uses the table.
+ * g711_xxx_decode: ........ Bulk decoder. AVX2 path gathers from the table, the scalar path looks
+ * 							 up the table one code at a time.
+ *
+ * g711codec_transcode: .... Encode and decode a 16 bit buffer in place, used to put the codec
+ * 							 quantization into the data lost simulation.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+// external reference : https://github.com/openitu/STL (g711.c)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arch.h"
+#include "config.h"
+#include "wave.h"
+#include "wave_type.h"
+#include "utility.h"
+#include "g711Codec.h"
+#include "bufferPool.h"
+#include "asyncIo.h"
+#include "dspKernel.h"
+
+#if (DSP_X86 == 1)
+#include <immintrin.h>
+#endif
+
+/*-------------------- CONFIGURATION --------------------*/
+#define SIGN_BIT (0x80)		/* sign bit for a A-law / u-law byte */
+#define QUANT_MASK (0x0f)	/* quantization field mask */
+#define SEG_SHIFT (4)		/* left shift for segment number */
+#define SEG_MASK (0x70)		/* segment field mask */
+#define ULAW_BIAS (0x84)	/* bias for linear code */
+#define ULAW_CLIP (8159)	/* 14 bit magnitude limit */
+
+#define ALAW_ENC_TABLE_SIZE (1 << 13)	/* A-law only looks at the top 13 bits */
+#define ULAW_ENC_TABLE_SIZE (1 << 14)	/* u-law only looks at the top 14 bits */
+#define TRANSCODE_BLOCK (1024)
+
+/*-------------------- GLOBAL PARAMETER --------------------*/
+static const sint16_t seg_aend[8] = {0x1F, 0x3F, 0x7F, 0xFF, 0x1FF, 0x3FF, 0x7FF, 0xFFF};
+static const sint16_t seg_uend[8] = {0x3F, 0x7F, 0xFF, 0x1FF, 0x3FF, 0x7FF, 0xFFF, 0x1FFF};
+
+static uint8_t alaw_enc_table[ALAW_ENC_TABLE_SIZE];
+static uint8_t ulaw_enc_table[ULAW_ENC_TABLE_SIZE];
+static sint32_t alaw_dec_table[256];	/* 32 bit entries for gather */
+static sint32_t ulaw_dec_table[256];
+static bool g711codec_ready = 0;
+
+static uint32_t (*g711_alaw_encode_vec)(sint16_t *in, uint8_t *out, uint32_t num);
+static uint32_t (*g711_ulaw_encode_vec)(sint16_t *in, uint8_t *out, uint32_t num);
+static uint32_t (*g711_decode_vec)(uint8_t *in, sint16_t *out, uint32_t num, const sint32_t *table);
+
+/*-------------------- INTERNAL FUNCTIONS --------------------*/
+static sint32_t g711_search(sint32_t val, const sint16_t *table, sint32_t size) {
+	sint32_t i;
+	for (i = 0; i < size; i++) {
+		if (val <= table[i]) {
+			return i;
+		}
+	}
+	return size;
+}
+
+#if (DSP_X86 == 1)
+/**
+ * @brief
+ * segment = number of segment end points below the magnitude,
+ * mantissa = magnitude >> shift, where the shift is done by an unsigned
+ * multiply high with 0x8000 halved once per segment above first_halve
+ */
+DSP_TARGET_SSE2 static inline __m128i g711_sse2_compand(__m128i mag, const sint16_t *seg_end, sint32_t first_halve) {
+	__m128i seg = _mm_setzero_si128();
+	__m128i mult = _mm_set1_epi16((short)0x8000);
+	sint32_t k;
+	for (k = 0; k < 8; k++) {
+		__m128i gt = _mm_cmpgt_epi16(mag, _mm_set1_epi16(seg_end[k]));
+		seg = _mm_sub_epi16(seg, gt);
+		if (k >= first_halve) {
+			mult = _mm_or_si128(_mm_and_si128(gt, _mm_srli_epi16(mult, 1)), _mm_andnot_si128(gt, mult));
+		}
+	}
+	__m128i mant = _mm_and_si128(_mm_mulhi_epu16(mag, mult), _mm_set1_epi16(QUANT_MASK));
+	return _mm_or_si128(_mm_slli_epi16(seg, SEG_SHIFT), mant);
+}
+
+DSP_TARGET_SSE2 static inline __m128i g711_sse2_alaw8(__m128i x) {
+	__m128i v = _mm_srai_epi16(x, 3);
+	__m128i sign = _mm_srai_epi16(v, 15);
+	__m128i mag = _mm_xor_si128(v, sign);	/* -v-1 for negative value */
+	__m128i mask = _mm_xor_si128(_mm_set1_epi16(0xD5), _mm_and_si128(sign, _mm_set1_epi16(0x80)));
+	return _mm_xor_si128(g711_sse2_compand(mag, seg_aend, 1), mask);
+}
+
+DSP_TARGET_SSE2 static inline __m128i g711_sse2_ulaw8(__m128i x) {
+	__m128i v = _mm_srai_epi16(x, 2);
+	__m128i sign = _mm_srai_epi16(v, 15);
+	__m128i mag = _mm_sub_epi16(_mm_xor_si128(v, sign), sign);
+	__m128i mask = _mm_xor_si128(_mm_set1_epi16(0xFF), _mm_and_si128(sign, _mm_set1_epi16(0x80)));
+	mag = _mm_min_epi16(mag, _mm_set1_epi16(ULAW_CLIP));
+	mag = _mm_add_epi16(mag, _mm_set1_epi16(ULAW_BIAS >> 2));
+	mag = _mm_min_epi16(mag, _mm_set1_epi16(0x1FFF));	/* segment 8 saturates to 0x7F as well */
+	return _mm_xor_si128(g711_sse2_compand(mag, seg_uend, 0), mask);
+}
+
+DSP_TARGET_SSE2 static uint32_t g711_sse2_alaw_encode(sint16_t *in, uint8_t *out, uint32_t num) {
+	uint32_t i = 0;
+	for( ; i+16<=num; i+=16 ) {
+		__m128i a = g711_sse2_alaw8(_mm_loadu_si128((__m128i *)&in[i]));
+		__m128i b = g711_sse2_alaw8(_mm_loadu_si128((__m128i *)&in[i+8]));
+		_mm_storeu_si128((__m128i *)&out[i], _mm_packus_epi16(a, b));
+	}
+	return i;
+}
+
+DSP_TARGET_SSE2 static uint32_t g711_sse2_ulaw_encode(sint16_t *in, uint8_t *out, uint32_t num) {
+	uint32_t i = 0;
+	for( ; i+16<=num; i+=16 ) {
+		__m128i a = g711_sse2_ulaw8(_mm_loadu_si128((__m128i *)&in[i]));
+		__m128i b = g711_sse2_ulaw8(_mm_loadu_si128((__m128i *)&in[i+8]));
+		_mm_storeu_si128((__m128i *)&out[i], _mm_packus_epi16(a, b));
+	}
+	return i;
+}
+
+/**
+ * @brief
+ * same compand on 16 lanes
+ */
+DSP_TARGET_AVX2 static inline __m256i g711_avx2_compand(__m256i mag, const sint16_t *seg_end, sint32_t first_halve) {
+	__m256i seg = _mm256_setzero_si256();
+	__m256i mult = _mm256_set1_epi16((short)0x8000);
+	sint32_t k;
+	for (k = 0; k < 8; k++) {
+		__m256i gt = _mm256_cmpgt_epi16(mag, _mm256_set1_epi16(seg_end[k]));
+		seg = _mm256_sub_epi16(seg, gt);
+		if (k >= first_halve) {
+			mult = _mm256_blendv_epi8(mult, _mm256_srli_epi16(mult, 1), gt);
+		}
+	}
+	__m256i mant = _mm256_and_si256(_mm256_mulhi_epu16(mag, mult), _mm256_set1_epi16(QUANT_MASK));
+	return _mm256_or_si256(_mm256_slli_epi16(seg, SEG_SHIFT), mant);
+}
+
+DSP_TARGET_AVX2 static inline __m256i g711_avx2_alaw16(__m256i x) {
+	__m256i v = _mm256_srai_epi16(x, 3);
+	__m256i sign = _mm256_srai_epi16(v, 15);
+	__m256i mag = _mm256_xor_si256(v, sign);
+	__m256i mask = _mm256_xor_si256(_mm256_set1_epi16(0xD5), _mm256_and_si256(sign, _mm256_set1_epi16(0x80)));
+	return _mm256_xor_si256(g711_avx2_compand(mag, seg_aend, 1), mask);
+}
+
+DSP_TARGET_AVX2 static inline __m256i g711_avx2_ulaw16(__m256i x) {
+	__m256i v = _mm256_srai_epi16(x, 2);
+	__m256i sign = _mm256_srai_epi16(v, 15);
+	__m256i mag = _mm256_sub_epi16(_mm256_xor_si256(v, sign), sign);
+	__m256i mask = _mm256_xor_si256(_mm256_set1_epi16(0xFF), _mm256_and_si256(sign, _mm256_set1_epi16(0x80)));
+	mag = _mm256_min_epi16(mag, _mm256_set1_epi16(ULAW_CLIP));
+	mag = _mm256_add_epi16(mag, _mm256_set1_epi16(ULAW_BIAS >> 2));
+	mag = _mm256_min_epi16(mag, _mm256_set1_epi16(0x1FFF));
+	return _mm256_xor_si256(g711_avx2_compand(mag, seg_uend, 0), mask);
+}
+
+DSP_TARGET_AVX2 static uint32_t g711_avx2_alaw_encode(sint16_t *in, uint8_t *out, uint32_t num) {
+	uint32_t i = 0;
+	for( ; i+32<=num; i+=32 ) {
+		__m256i a = g711_avx2_alaw16(_mm256_loadu_si256((__m256i *)&in[i]));
+		__m256i b = g711_avx2_alaw16(_mm256_loadu_si256((__m256i *)&in[i+16]));
+		/* packus works per 128 bit lane, the permute puts the 4 quarters back in order */
+		_mm256_storeu_si256((__m256i *)&out[i], _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8));
+	}
+	return i + g711_sse2_alaw_encode(in + i, out + i, num - i);
+}
+
+DSP_TARGET_AVX2 static uint32_t g711_avx2_ulaw_encode(sint16_t *in, uint8_t *out, uint32_t num) {
+	uint32_t i = 0;
+	for( ; i+32<=num; i+=32 ) {
+		__m256i a = g711_avx2_ulaw16(_mm256_loadu_si256((__m256i *)&in[i]));
+		__m256i b = g711_avx2_ulaw16(_mm256_loadu_si256((__m256i *)&in[i+16]));
+		_mm256_storeu_si256((__m256i *)&out[i], _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8));
+	}
+	return i + g711_sse2_ulaw_encode(in + i, out + i, num - i);
+}
+
+DSP_TARGET_AVX2 static uint32_t g711_avx2_decode(uint8_t *in, sint16_t *out, uint32_t num, const sint32_t *table) {
+	uint32_t i = 0;
+	for( ; i+16<=num; i+=16 ) {
+		__m256i lo = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i *)&in[i]));
+		__m256i hi = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i *)&in[i+8]));
+		lo = _mm256_i32gather_epi32((const int *)table, lo, 4);
+		hi = _mm256_i32gather_epi32((const int *)table, hi, 4);
+		__m256i res = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+		_mm256_storeu_si256((__m256i *)&out[i], res);
+	}
+	return i;
+}
+#endif
+
+static uint32_t g711_scalar_encode(sint16_t *in, uint8_t *out, uint32_t num) {
+	return 0;
+}
+
+static uint32_t g711_scalar_decode(uint8_t *in, sint16_t *out, uint32_t num, const sint32_t *table) {
+	return 0;
+}
+
+/**
+ * @brief
+ * vector kernels of the instruction set bound in gDspKernel, they return the samples done
+ */
+static void g711codec_bind(uint8_t isa) {
+	g711_alaw_encode_vec = g711_scalar_encode;
+	g711_ulaw_encode_vec = g711_scalar_encode;
+	g711_decode_vec = g711_scalar_decode;
+#if (DSP_X86 == 1)
+	if( isa >= SIMDISA_AVX2 ) {
+		g711_alaw_encode_vec = g711_avx2_alaw_encode;
+		g711_ulaw_encode_vec = g711_avx2_ulaw_encode;
+		g711_decode_vec = g711_avx2_decode;
+	} else if( isa >= SIMDISA_SSE2 ) {
+		g711_alaw_encode_vec = g711_sse2_alaw_encode;
+		g711_ulaw_encode_vec = g711_sse2_ulaw_encode;
+	}
+#endif
+}
+
+/*-------------------- FUNCTIONS --------------------*/
+uint8_t g711_linear2alaw(sint16_t pcm) {
+	sint32_t mask, seg;
+	sint32_t pcm_val = pcm >> 3;
+	uint8_t aval;
+	if (pcm_val >= 0) {
+		mask = 0xD5;
+	} else {
+		mask = 0x55;
+		pcm_val = -pcm_val - 1;
+	}
+	seg = g711_search(pcm_val, seg_aend, 8);
+	if (seg >= 8) {
+		return (uint8_t)(0x7F ^ mask);
+	}
+	aval = (uint8_t)(seg << SEG_SHIFT);
+	if (seg < 2) {
+		aval |= (pcm_val >> 1) & QUANT_MASK;
+	} else {
+		aval |= (pcm_val >> seg) & QUANT_MASK;
+	}
+	return (uint8_t)(aval ^ mask);
+}
+
+sint16_t g711_alaw2linear(uint8_t code) {
+	sint32_t t, seg;
+	code ^= 0x55;
+	t = (code & QUANT_MASK) << 4;
+	seg = (code & SEG_MASK) >> SEG_SHIFT;
+	switch (seg) {
+		case 0:
+			t += 8;
+			break;
+		case 1:
+			t += 0x108;
+			break;
+		default:
+			t += 0x108;
+			t <<= seg - 1;
+	}
+	return (sint16_t)((code & SIGN_BIT) ? t : -t);
+}
+
+uint8_t g711_linear2ulaw(sint16_t pcm) {
+	sint32_t mask, seg;
+	sint32_t pcm_val = pcm >> 2;
+	if (pcm_val < 0) {
+		pcm_val = -pcm_val;
+		mask = 0x7F;
+	} else {
+		mask = 0xFF;
+	}
+	if (pcm_val > ULAW_CLIP) {
+		pcm_val = ULAW_CLIP;
+	}
+	pcm_val += (ULAW_BIAS >> 2);
+	seg = g711_search(pcm_val, seg_uend, 8);
+	if (seg >= 8) {
+		return (uint8_t)(0x7F ^ mask);
+	}
+	return (uint8_t)(((seg << SEG_SHIFT) | ((pcm_val >> (seg + 1)) & QUANT_MASK)) ^ mask);
+}
+
+sint16_t g711_ulaw2linear(uint8_t code) {
+	sint32_t t;
+	code = ~code;
+	t = ((code & QUANT_MASK) << 3) + ULAW_BIAS;
+	t <<= (code & SEG_MASK) >> SEG_SHIFT;
+	return (sint16_t)((code & SIGN_BIT) ? (ULAW_BIAS - t) : (t - ULAW_BIAS));
+}
+
+void g711codec_init(void) {
+	sint32_t i;
+	g711codec_bind(gDspKernel.isa);
+	if( g711codec_ready ) {
+		return;
+	}
+	for( i=0; i<ALAW_ENC_TABLE_SIZE; i++ ) {
+		alaw_enc_table[i] = g711_linear2alaw((sint16_t)((i < ALAW_ENC_TABLE_SIZE/2 ? i : i - ALAW_ENC_TABLE_SIZE) * 8));
+	}
+	for( i=0; i<ULAW_ENC_TABLE_SIZE; i++ ) {
+		ulaw_enc_table[i] = g711_linear2ulaw((sint16_t)((i < ULAW_ENC_TABLE_SIZE/2 ? i : i - ULAW_ENC_TABLE_SIZE) * 4));
+	}
+	for( i=0; i<256; i++ ) {
+		alaw_dec_table[i] = g711_alaw2linear((uint8_t)i);
+		ulaw_dec_table[i] = g711_ulaw2linear((uint8_t)i);
+	}
+	g711codec_ready = 1;
+}
+
+void g711_alaw_encode(sint16_t *in, uint8_t *out, uint32_t num) {
+	uint32_t i = g711_alaw_encode_vec(in, out, num);
+	for( ; i<num; i++ ) {
+		out[i] = alaw_enc_table[((uint16_t)in[i]) >> 3];
+	}
+}
+
+void g711_ulaw_encode(sint16_t *in, uint8_t *out, uint32_t num) {
+	uint32_t i = g711_ulaw_encode_vec(in, out, num);
+	for( ; i<num; i++ ) {
+		out[i] = ulaw_enc_table[((uint16_t)in[i]) >> 2];
+	}
+}
+
+void g711_alaw_decode(uint8_t *in, sint16_t *out, uint32_t num) {
+	uint32_t i = g711_decode_vec(in, out, num, alaw_dec_table);
+	for( ; i<num; i++ ) {
+		out[i] = (sint16_t)alaw_dec_table[in[i]];
+	}
+}
+
+void g711_ulaw_decode(uint8_t *in, sint16_t *out, uint32_t num) {
+	uint32_t i = g711_decode_vec(in, out, num, ulaw_dec_table);
+	for( ; i<num; i++ ) {
+		out[i] = (sint16_t)ulaw_dec_table[in[i]];
+	}
+}
+
+void g711codec_encode(uint8_t law, sint16_t *in, uint8_t *out, uint32_t num) {
+	if( law == G711LAW_ALAW ) {
+		g711_alaw_encode(in, out, num);
+	} else if( law == G711LAW_MULAW ) {
+		g711_ulaw_encode(in, out, num);
+	}
+}
+
+void g711codec_decode(uint8_t law, uint8_t *in, sint16_t *out, uint32_t num) {
+	if( law == G711LAW_ALAW ) {
+		g711_alaw_decode(in, out, num);
+	} else if( law == G711LAW_MULAW ) {
+		g711_ulaw_decode(in, out, num);
+	}
+}
+
+/**
+ * @brief
+ * encode and decode the buffer in place block by block,
+ * the output carries the same quantization noise as a real G.711 link
+ */
+void g711codec_transcode(uint8_t law, sint16_t *buf, uint32_t num) {
+	uint8_t code[TRANSCODE_BLOCK];
+	uint32_t i, cnt;
+	for( i=0; i<num; i+=cnt ) {
+		cnt = (num - i > TRANSCODE_BLOCK) ? TRANSCODE_BLOCK : num - i;
+		g711codec_encode(law, &buf[i], code, cnt);
+		g711codec_decode(law, code, &buf[i], cnt);
+	}
+}
+
+/**
+ * @brief
+ * encode a mono 16 bit buffer and write it as a G.711 wav file
+ * (18 bytes fmt chunk + fact chunk, as required for non-pcm format)
+ * @return int : 0 success, -1 fail
+ */
+int g711codec_write_wav(char *name, uint8_t law, uint32_t sample_rate, sint16_t *pcm, uint32_t num) {
+	riff_chunk riff_law = { {'R','I','F','F'}, 0, {'W','A','V','E'}};
+	fmt_chunk_header fmt_law_header = { {'f','m','t',' '}, 18 };
+	fmt_chunk_body fmt_law_body;
+	data_chunk fact_law_header = { {'f','a','c','t'}, 4 };
+	data_chunk data_law_header = { {'d','a','t','a'}, num };
+	uint8_t pad = 0;
+	uint8_t *code = NULL;
+	FILE *fp_law = NULL;
+	int ret = -1;
+
+	memset(&fmt_law_body, 0x0, sizeof(fmt_law_body));
+	fmt_law_body.format_tag = (law == G711LAW_ALAW) ? WAVE_FORMAT_ALAW : WAVE_FORMAT_MULAW;
+	fmt_law_body.channels = 1;
+	fmt_law_body.sample_rate = sample_rate;
+	fmt_law_body.byte_per_sec = sample_rate;
+	fmt_law_body.block_align = 1;
+	fmt_law_body.bit_per_sample = 8;
+	riff_law.size = 4 + (8 + fmt_law_header.size) + (8 + fact_law_header.size) + (8 + num + (num & 1));
+
+	code = (uint8_t *)bufpool_alloc(&gBufPool, num);
+	if( code == NULL ) {
+		printf("Allocation memory error");
+		goto EXIT;
+	}
+	g711codec_encode(law, pcm, code, num);
+
+	if( (fp_law = aio_fopen_write(name)) == NULL ) {
+		printf("Can't open the G.711 WAV file for write.\n");
+		goto EXIT;
+	}
+	if( fwrite(&riff_law, 1, sizeof(riff_law), fp_law) != sizeof(riff_law) ||
+		fwrite(&fmt_law_header, 1, sizeof(fmt_law_header), fp_law) != sizeof(fmt_law_header) ||
+		fwrite(&fmt_law_body, 1, fmt_law_header.size, fp_law) != fmt_law_header.size ||
+		fwrite(&fact_law_header, 1, sizeof(fact_law_header), fp_law) != sizeof(fact_law_header) ||
+		fwrite(&num, 1, sizeof(num), fp_law) != sizeof(num) ||
+		fwrite(&data_law_header, 1, sizeof(data_law_header), fp_law) != sizeof(data_law_header) ||
+		fwrite(code, 1, num, fp_law) != num ) {
+		printf("Can't write G.711 WAV file.\n");
+		goto EXIT;
+	}
+	if( (num & 1) && fwrite(&pad, 1, 1, fp_law) != 1 ) {
+		printf("Can't write G.711 WAV file pad byte.\n");
+		goto EXIT;
+	}
+	printf("Done. G.711 WAV file writing in %s .\n", name);
+	ret = 0;
+
+EXIT:
+	if( code != NULL ) {
+		bufpool_free(&gBufPool, code);
+	}
+	if( fp_law != NULL ) {
+		aio_fclose_write(fp_law);
+	}
+	return ret;
+}
@@ -0,0 +1,29 @@
+#ifndef _H_G711CODEC_
+#define _H_G711CODEC_
+
+#include "arch.h"
+
+// ITU-T G.711 A-law / u-law codec, 8 bit code <-> 16 bit linear pcm
+
+/*-------------------- FUNCTIONS --------------------*/
+void g711codec_init(void); /* build the lookup tables, must be called after dsp_kernel_init() and before any bulk function */
+
+/* single sample reference implementation */
+uint8_t g711_linear2alaw(sint16_t pcm);
+sint16_t g711_alaw2linear(uint8_t code);
+uint8_t g711_linear2ulaw(sint16_t pcm);
+sint16_t g711_ulaw2linear(uint8_t code);
+
+/* bulk processing */
+void g711_alaw_encode(sint16_t *in, uint8_t *out, uint32_t num);
+void g711_alaw_decode(uint8_t *in, sint16_t *out, uint32_t num);
+void g711_ulaw_encode(sint16_t *in, uint8_t *out, uint32_t num);
+void g711_ulaw_decode(uint8_t *in, sint16_t *out, uint32_t num);
+void g711codec_encode(uint8_t law, sint16_t *in, uint8_t *out, uint32_t num);
+void g711codec_decode(uint8_t law, uint8_t *in, sint16_t *out, uint32_t num);
+void g711codec_transcode(uint8_t law, sint16_t *buf, uint32_t num);
+
+/* file */
+int g711codec_write_wav(char *name, uint8_t law, uint32_t sample_rate, sint16_t *pcm, uint32_t num);
+
+#endif
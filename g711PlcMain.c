@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include "arch.h"
 #include "config.h"
 #include "utility.h"
@@ -9,46 +10,260 @@
 #include "param.h"
 #include "g711PlcMain.h"
 #include "LowcFE.h"
+#include "resampler.h"
+#include "bufferPool.h"
+#include "lostGap.h"
+#include "jitterBuffer.h"
+#include "vad.h"
 
 // reference:
 // https://www.voiptroubleshooter.com/open_speech/chinese.html (open speech repository)
 // http://www.voiceover-samples.com/languages/chinese-voiceover/ (voice over samples)
 
+/*-------------------- CONFIGURATION --------------------*/
+#define G711_SAMPLE_RATE (8000)
+#define G711_SEG_THREAD_MAX (16)
+#define G711_SEG_WARMUP_FRAMES ((HISTORYLEN + FRAMESZ - 1) / FRAMESZ + 1) /* the history, and the frame an end of erasure OLA changed before it */
+
 /*-------------------- GLOBAL PARAMETER --------------------*/
 LowcFE_c lc;
 sint16_t *pPlc16bBuf;
 sint16_t *pPlc16bOutput;
 bool *pPlcLostRec;
+bool *pPlcSilentRec; // erased frames in silence, filled with comfort noise in pPlc16bBuf and not concealed
 uint32_t g711_frame_num;
 
+// segments of g711PlcSegment(), frames [first, end) of the channel, LowcFE warmed up over the frames before first
+typedef struct _g711_segment_c {
+	LowcFE_c lc;
+	uint32_t first;
+	uint32_t end;
+	pthread_t thread;
+	bool started;
+} g711_segment_c;
+g711_segment_c g711_segment[G711_SEG_THREAD_MAX];
+
+// narrow band bridge, for content which is not 8k 16bit
+bool g711_nb_bridge;
+sint16_t *pPlcNbBuf; // channel resampled to 8k 16bit
+uint32_t g711_sample_num; // 16bit samples the PLC runs over
+
 /*-------------------- INTERNAL FUNCTIONS --------------------*/
+/**
+ * @brief 
+ * resample the single channel to 8k 16bit, the frame lost and the PLC run on this copy
+ */
+static void g711NbBridgeIn(void) {
+
+	uint32_t wb_num = single_channel_size / (fmt_single_body.bit_per_sample/8);
+	resampler_c *rs = resampler_get(fmt_single_body.sample_rate, G711_SAMPLE_RATE);
+	float *pWb = (float *)bufpool_alloc(&gBufPool, wb_num * sizeof(float));
+	float *pNb = NULL;
+
+	g711_sample_num = 0;
+	if( rs == NULL || pWb == NULL ) {
+		bufpool_free(&gBufPool, pWb);
+		return;
+	}
+	g711_sample_num = resampler_out_len(rs, wb_num);
+	pNb = (float *)bufpool_alloc(&gBufPool, g711_sample_num * sizeof(float));
+	pPlcNbBuf = (sint16_t *)bufpool_alloc(&gBufPool, g711_sample_num * sizeof(sint16_t));
+	if( pNb == NULL || pPlcNbBuf == NULL ) {
+		g711_sample_num = 0;
+	} else {
+		pcm_to_float(single_channel_dump, fmt_single_body.bit_per_sample, fmt_single_body.bit_per_sample/8, pWb, wb_num);
+		resampler_process(rs, pWb, wb_num, pNb, g711_sample_num);
+		float_to_pcm(pNb, 16, sizeof(sint16_t), (uint8_t *)pPlcNbBuf, g711_sample_num);
+	}
+	bufpool_free(&gBufPool, pWb);
+	bufpool_free(&gBufPool, pNb);
+}
+
+/**
+ * @brief 
+ * resample the concealed 8k signal back and replace the lost frames (and the following
+ * frame, which holds the end of erasure OLA) in the original channel, good frames keep
+ * their full band
+ */
+static void g711NbBridgeOut(void) {
+
+	uint32_t f, sta, end;
+	uint32_t sample_bytes = fmt_single_body.bit_per_sample/8;
+	uint32_t wb_num = single_channel_size / sample_bytes;
+	resampler_c *rs = resampler_get(G711_SAMPLE_RATE, fmt_single_body.sample_rate);
+	float *pNb = (float *)bufpool_alloc(&gBufPool, g711_sample_num * sizeof(float));
+	float *pWb = (float *)bufpool_alloc(&gBufPool, wb_num * sizeof(float));
+
+	if( rs != NULL && pNb != NULL && pWb != NULL ) {
+		pcm_to_float((uint8_t *)pPlc16bOutput, 16, sizeof(sint16_t), pNb, g711_sample_num);
+		resampler_process(rs, pNb, g711_sample_num, pWb, wb_num);
+		for( f=0; f<g711_frame_num; f++ ) {
+			if( pPlcLostRec[f] == 0 ) {
+				continue;
+			}
+			sta = (uint32_t)((uint64_t)f * FRAMESZ * fmt_single_body.sample_rate / G711_SAMPLE_RATE);
+			end = (uint32_t)((uint64_t)(f + 2) * FRAMESZ * fmt_single_body.sample_rate / G711_SAMPLE_RATE);
+			end = (end > wb_num) ? wb_num : end;
+			if( sta < end ) {
+				float_to_pcm(&pWb[sta], fmt_single_body.bit_per_sample, sample_bytes, single_channel_dump + sta*sample_bytes, end - sta);
+			}
+		}
+	}
+	bufpool_free(&gBufPool, pNb);
+	bufpool_free(&gBufPool, pWb);
+}
+
+/**
+ * @brief
+ * bridge the channel to 8k 16bit when needed and create the lost record of its frames
+ */
+static void g711LostRecInit(void) {
+
+	// release the record of previous channel if it was not concealed
+	if( pPlcLostRec != NULL ) {
+		bufpool_free(&gBufPool, pPlcLostRec);
+		pPlcLostRec = NULL;
+	}
+	if( pPlcNbBuf != NULL ) {
+		bufpool_free(&gBufPool, pPlcNbBuf);
+		pPlcNbBuf = NULL;
+	}
+
+	// LowcFE only works at 8k 16bit, other content goes through the narrow band bridge
+	g711_nb_bridge = ( fmt_single_body.sample_rate != G711_SAMPLE_RATE ) || ( fmt_single_body.bit_per_sample != 16 );
+	if( g711_nb_bridge ) {
+		g711NbBridgeIn();
+	} else {
+		g711_sample_num = single_channel_size/2;
+	}
+
+	// create lost record
+	g711_frame_num = ( g711_sample_num + FRAMESZ - 1 ) / FRAMESZ;
+	pPlcLostRec = (bool *)bufpool_alloc(&gBufPool, g711_frame_num*sizeof(bool));
+	memset(pPlcLostRec, 0x0, g711_frame_num*sizeof(bool));
+}
+
+/**
+ * @brief
+ * erase frame f, in the 8k buffer and in the channel, the section is recorded in gLostGap
+ */
+static void g711FrameLost(uint32_t f) {
+
+	// set flag as lost frame
+	pPlcLostRec[f] = 1;
+
+	// change data
+	if( g711_nb_bridge ) {
+		uint32_t sample_bytes = fmt_single_body.bit_per_sample/8;
+		uint32_t sta = (uint32_t)((uint64_t)f * FRAMESZ * fmt_single_body.sample_rate / G711_SAMPLE_RATE);
+		uint32_t end = (uint32_t)((uint64_t)(f+1) * FRAMESZ * fmt_single_body.sample_rate / G711_SAMPLE_RATE);
+		memset(pPlcNbBuf+f*FRAMESZ, 0x0, FRAMESZ*2);
+		if( end*sample_bytes > single_channel_size ) {
+			end = single_channel_size / sample_bytes;
+		}
+		if( sta < end ) {
+			memset(single_channel_dump+sta*sample_bytes, (sample_bytes == 1) ? 0x80 : 0x0, (end-sta)*sample_bytes);
+			lostgap_add(&gLostGap, sta, end-sta);
+		}
+	} else {
+		memset(single_channel_dump+f*FRAMESZ*2, 0x0, FRAMESZ*2);
+		lostgap_add(&gLostGap, f*FRAMESZ, FRAMESZ);
+	}
+}
+
 void g711DataLost(void) {
 
-	uint32_t i, j, k;
+	uint32_t i, j;
 	uint32_t initialFrame = 4;  // Manual_lost_start_sample;
 	uint32_t lostFrameNum = 3;  // Manual_lost_sample_ratio;
 	uint32_t lostPeriod   = 20; // Manual_lost_period_ratio;
 
-	// create lost record
-	g711_frame_num = ( single_channel_size/2 + FRAMESZ - 1 ) / FRAMESZ;
-	pPlcLostRec = (bool *)malloc(g711_frame_num*sizeof(bool));
-	memset(pPlcLostRec, 0x0, g711_frame_num*sizeof(bool));
+	g711LostRecInit();
 
 	printf("\t-----[ frame type lost simulation ]-----\n");
 	printf("\tTotla frame num = %d\n", g711_frame_num);
 	printf("\tinitialFrame = %d\n", initialFrame);
 	printf("\tlostFrameNum = %d\n", lostFrameNum);
 	printf("\tlostPeriod = %d\n", lostPeriod);
+	printf("\tnarrow band bridge = %d\n", g711_nb_bridge);
 
-	for( i=initialFrame; i<(g711_frame_num-10); i=i+lostPeriod ) {
+	for( i=initialFrame; i+10<g711_frame_num; i=i+lostPeriod ) {
 		for( j=0; j<lostFrameNum; j++ ) {
+			g711FrameLost(i+j);
+		}
+	}
+}
+
+/**
+ * @brief
+ * the frames are the packets of the jitter trace, a packet which misses its playout time is erased
+ */
+void g711JitterLost(void) {
+
+	uint32_t f;
+	bool *pLate = NULL;
+
+	g711LostRecInit();
+
+	printf("\t-----[ jitter buffer lost simulation ]-----\n");
+	printf("\tTotla frame num = %d\n", g711_frame_num);
+	printf("\ttrace = %s\n", ( gJitterTrace[0] != '\0' ) ? gJitterTrace : "synthetic");
+	printf("\tplayout = %s, %d ms\n", jbtype_name[gJitterPolicy], gJitterDelayMs);
+	printf("\tnarrow band bridge = %d\n", g711_nb_bridge);
+
+	if( jitter_load(&gJitterBuffer, gJitterTrace, gJitterSeed) != 0 ) {
+		return;
+	}
+	pLate = (bool *)bufpool_alloc(&gBufPool, g711_frame_num*sizeof(bool));
+	if( pLate == NULL ) {
+		return;
+	}
+	jitter_playout(&gJitterBuffer, gJitterPolicy, (float)gJitterDelayMs, gJitterAdaptFrames, g711_frame_num, pLate);
+	jitter_report(&gJitterBuffer.channel, "channel", 0);
 
-			// set flag as lost frame
-			pPlcLostRec[i+j] = 1;
+	// the last frame is not concealed by g711PlcProc(), it is played as it is
+	for( f=0; f+1<g711_frame_num; f++ ) {
+		if( pLate[f] ) {
+			g711FrameLost(f);
+		}
+	}
+	bufpool_free(&gBufPool, pLate);
+}
+
+/**
+ * @brief
+ * the runs of erased frames whose context is silent take comfort noise in pPlc16bBuf and are played as
+ * good frames, LowcFE skips the pitch search and synthesis of the whole run. The noise of a frame only
+ * depends on its index, the segments of g711PlcSegment() replay the same frames
+ */
+static void g711PlcSilence(void) {
 
-			// change data
-			memset(single_channel_dump+(i+j)*FRAMESZ*2, 0x0, FRAMESZ*2);
+	uint32_t f, run, frames = g711_frame_num - 1;
+	float noise[FRAMESZ];
+	float level;
 
+	lostgap_reset(&gVad.frames, g711_sample_num);
+	for( f=0; f<g711_frame_num; f++ ) {
+		if( pPlcLostRec[f] != 0 ) {
+			lostgap_add(&gVad.frames, f*FRAMESZ, FRAMESZ);
+		}
+	}
+	if( vad_label(&gVad, (uint8_t *)pPlc16bBuf, 16, G711_SAMPLE_RATE, gVadThresholdDb, &gVad.frames) != 0 ) {
+		return;
+	}
+	for( f=0; f<frames; f=run ) {
+		bool silent;
+		for( run=f; run<frames && pPlcLostRec[run] != 0; run++ );
+		if( run == f ) {
+			run++;
+			continue;
+		}
+		silent = vad_silent(&gVad, f*FRAMESZ, (run-f)*FRAMESZ, &level);
+		vad_count(&gVad, (run-f)*FRAMESZ, silent);
+		for( uint32_t n=f; n<run && silent; n++ ) {
+			pPlcSilentRec[n] = 1;
+			vad_noise(noise, FRAMESZ, level, n);
+			float_to_pcm(noise, 16, sizeof(sint16_t), (uint8_t *)&pPlc16bBuf[n*FRAMESZ], FRAMESZ);
 		}
 	}
 }
@@ -58,73 +273,175 @@ void g711PlcInit(void) {
 	uint32_t i = 0;
 
 	// convert byte data to 16bit signed data buffer
-	pPlc16bBuf = (sint16_t *)malloc(single_channel_size);
-	memcpy(pPlc16bBuf, single_channel_dump, single_channel_size);
+	pPlc16bBuf = (sint16_t *)bufpool_alloc(&gBufPool, g711_sample_num*sizeof(sint16_t));
+	if( g711_nb_bridge ) {
+		memcpy(pPlc16bBuf, pPlcNbBuf, g711_sample_num*sizeof(sint16_t));
+	} else {
+		memcpy(pPlc16bBuf, single_channel_dump, g711_sample_num*sizeof(sint16_t));
+	}
 
 	// prepare for output buffer
-	pPlc16bOutput = (sint16_t *)malloc(single_channel_size);
-	memset(pPlc16bOutput, 0xff, single_channel_size);
+	pPlc16bOutput = (sint16_t *)bufpool_alloc(&gBufPool, g711_sample_num*sizeof(sint16_t));
+	memset(pPlc16bOutput, 0xff, g711_sample_num*sizeof(sint16_t));
+
+	pPlcSilentRec = (bool *)bufpool_calloc(&gBufPool, g711_frame_num*sizeof(bool));
+	if( gVadEnable != 0 && pPlcSilentRec != NULL ) {
+		g711PlcSilence();
+	}
 }
 
 void g711PlcExit(void) {
 
-	memcpy(single_channel_dump, pPlc16bOutput, single_channel_size);
+	if( g711_nb_bridge ) {
+		g711NbBridgeOut();
+	} else {
+		memcpy(single_channel_dump, pPlc16bOutput, single_channel_size);
+	}
 
+	if( pPlcNbBuf != NULL ) {
+		bufpool_free(&gBufPool, pPlcNbBuf);
+		pPlcNbBuf = NULL;
+	}
 	if( pPlc16bBuf != NULL ) {
-		free(pPlc16bBuf);
+		bufpool_free(&gBufPool, pPlc16bBuf);
 		pPlc16bBuf = NULL;
 	}
 	if( pPlcLostRec != NULL ) {
-		free(pPlcLostRec);
+		bufpool_free(&gBufPool, pPlcLostRec);
 		pPlcLostRec = NULL;
 	}
+	if( pPlcSilentRec != NULL ) {
+		bufpool_free(&gBufPool, pPlcSilentRec);
+		pPlcSilentRec = NULL;
+	}
 	if( pPlc16bOutput != NULL ) {
-		free(pPlc16bOutput);
+		bufpool_free(&gBufPool, pPlc16bOutput);
 		pPlc16bOutput = NULL;
 	}
 }
 
-void g711PlcProc(void) {
+/**
+ * @brief
+ * conceal frame n in place and copy it out, the output drops the POVERLAPMAX samples of delay
+ * of the concealment so the output file is time-aligned with the input file
+ */
+static void g711PlcFrame(LowcFE_c *pLc, uint32_t n, bool output) {
 
-	sint32_t i;
-	sint32_t nframes; // processed frame count
-	sint32_t nerased; // erased frame count
 	sint16_t in[FRAMESZ]; // i/o buffer
 
-	g711plc_construct(&lc);
-	nframes = 0;
-	nerased = 0;
-	for( nframes=0; nframes<g711_frame_num-1; nframes++ ) {
+	memcpy(in, &pPlc16bBuf[n*FRAMESZ], FRAMESZ*sizeof(sint16_t));
 
-		// 
-		memcpy(in, &pPlc16bBuf[nframes*FRAMESZ], FRAMESZ*sizeof(sint16_t));
+	if( pPlcLostRec[n] != 0 && (pPlcSilentRec == NULL || pPlcSilentRec[n] == 0) ) {
+		g711plc_dofe(pLc, in);
+	} else {
+		g711plc_addtohistory(pLc, in);
+	}
 
-		if( pPlcLostRec[nframes] != 0 ) {
-			nerased++;
-			g711plc_dofe(&lc, in);
-		} else {
-			g711plc_addtohistory (&lc, in);
+	if( !output ) {
+		return;
+	}
+	if( n == 0 ) {
+		memcpy(pPlc16bOutput, &in[POVERLAPMAX], (FRAMESZ-POVERLAPMAX)*sizeof(sint16_t));
+	} else {
+		memcpy(&pPlc16bOutput[n*FRAMESZ-POVERLAPMAX], in, FRAMESZ*sizeof(sint16_t));
+	}
+}
+
+static void *g711PlcSegmentRun(void *arg) {
+
+	g711_segment_c *seg = (g711_segment_c *)arg;
+	uint32_t warm = ( seg->first > G711_SEG_WARMUP_FRAMES ) ? seg->first - G711_SEG_WARMUP_FRAMES : 0;
+
+	g711plc_construct(&seg->lc);
+	for( uint32_t n=warm; n<seg->first; n++ ) {
+		g711PlcFrame(&seg->lc, n, false);
+	}
+	for( uint32_t n=seg->first; n<seg->end; n++ ) {
+		g711PlcFrame(&seg->lc, n, true);
+	}
+	return NULL;
+}
+
+/**
+ * @brief
+ * the frames of the channel cut into segments concealed on their own threads. The state of LowcFE after
+ * G711_SEG_WARMUP_FRAMES good frames is their history only, so a segment which starts after that many good
+ * frames replays them from a cleared LowcFE_c and continues exactly as the serial run. The nominal boundary
+ * moves forward to the first such frame, a boundary which finds none within its segment stays where it is
+ * and the erasures in its warm-up are concealed from a shorter history. The segments write disjoint frames
+ * of the output, the stitch is the output buffer itself
+ */
+static void g711PlcSegment(uint32_t frames, uint32_t segs) {
+
+	uint32_t s, inexact = 0;
+
+	for( s=0; s<segs; s++ ) {
+		uint32_t b = (uint32_t)((uint64_t)frames * s / segs);
+		uint32_t next = (uint32_t)((uint64_t)frames * (s + 1) / segs);
+		uint32_t good = 0, n;
+
+		// good frames before the nominal boundary, then the first boundary after enough of them
+		for( n=(b > G711_SEG_WARMUP_FRAMES) ? b - G711_SEG_WARMUP_FRAMES : 0; n<b; n++ ) {
+			good = ( pPlcLostRec[n] != 0 ) ? 0 : good + 1;
+		}
+		for( n=b; s>0 && n<next && good<G711_SEG_WARMUP_FRAMES; n++ ) {
+			good = ( pPlcLostRec[n] != 0 ) ? 0 : good + 1;
+		}
+		if( s > 0 && good >= G711_SEG_WARMUP_FRAMES ) {
+			b = n;
+		} else if( s > 0 ) {
+			inexact++;
 		}
+		g711_segment[s].first = b;
+		g711_segment[s].started = false;
+		if( s > 0 ) {
+			g711_segment[s-1].end = b;
+		}
+	}
+	g711_segment[segs-1].end = frames;
+
+	printf("	plc segments = %d, inexact boundaries = %d\n", segs, inexact);
 
-		/* 
-		The concealment algorithm delays the signal by
-		POVERLAPMAX samples. Remove the delay so the output
-		file is time-aligned with the input file.
-		*/
-		if( nframes == 0 ) {
-			memcpy(pPlc16bOutput+nframes, &in[POVERLAPMAX], (FRAMESZ-POVERLAPMAX)*sizeof(sint16_t));
+	for( s=1; s<segs; s++ ) {
+		if( pthread_create(&g711_segment[s].thread, NULL, g711PlcSegmentRun, &g711_segment[s]) == 0 ) {
+			g711_segment[s].started = true;
+		}
+	}
+	g711PlcSegmentRun(&g711_segment[0]);
+	for( s=1; s<segs; s++ ) {
+		if( g711_segment[s].started ) {
+			pthread_join(g711_segment[s].thread, NULL);
 		} else {
-			memcpy(&pPlc16bOutput[nframes*FRAMESZ-POVERLAPMAX], in, FRAMESZ*sizeof(sint16_t));
+			g711PlcSegmentRun(&g711_segment[s]);
 		}
 	}
+}
+
+void g711PlcProc(void) {
+
+	// the last frame is not concealed, it is played as it is
+	uint32_t frames = g711_frame_num - 1;
+	uint32_t segs = ( gPlcSegmentThreads < G711_SEG_THREAD_MAX ) ? gPlcSegmentThreads : G711_SEG_THREAD_MAX;
+
+	if( gPlcSegmentMinFrames > 0 && segs > frames / gPlcSegmentMinFrames ) {
+		segs = frames / gPlcSegmentMinFrames;
+	}
+	if( segs > 1 ) {
+		g711PlcSegment(frames, segs);
+		return;
+	}
 
+	g711plc_construct(&lc);
+	for( uint32_t n=0; n<frames; n++ ) {
+		g711PlcFrame(&lc, n, true);
+	}
 }
 
 /*-------------------- FUNCTIONS --------------------*/
 void g711PlcMain(void) {
 
-	if( fmt_single_body.bit_per_sample != 16 ) {
-		printf("not suppport bit/sample != 16\n");
+	if( pPlcLostRec == NULL || g711_frame_num < 2 ) {
+		printf("no frame lost record, g711 plc needs LOSTTYPE_CONTINUOUS_FRAME or LOSTTYPE_JITTER_FRAME\n");
 		return;
 	}
 
@@ -2,6 +2,7 @@
 #define _H_G711PLCMAIN_
 
 void g711DataLost(void);
+void g711JitterLost(void);
 void g711PlcMain(void);
 
 #endif
@@ -0,0 +1,253 @@
+/**
+ * @file interpConceal.c
+ * @author weiyuan.hsu
+ * @brief
+ * implement of the cubic and band limited interpolation concealment
+ *
+ * interp_kernel_get: ...... Return the weight table of a gap shape (length, neighbours before / after).
+ * 							 Every gap sample is a fixed linear combination of the neighbours, so the
+ * 							 weights only depend on the shape and are designed once and cached, like the
+ * 							 resampler filter banks. A lost model repeats the same shape all over the
+ * 							 file, so a channel designs one or two tables.
+ * 							 CUBIC : catmull-rom hermite segment between x[s-1] and x[s+len], tangents
+ * 							 from x[s-2] and x[s+len+1].
+ * 							 SINC : band limited minimum error interpolator, the neighbour correlation
+ * 							 is a gaussian windowed sinc of INTERP_SINC_BAND, solved by cholesky in
+ * 							 double for all gap samples. The weights are constrained to reproduce a
+ * 							 constant and a ramp, so the sinc model only refines the straight line
+ * 							 and does not pull low frequency content towards zero.
+ *
+ * interp_conceal: ......... Only the neighbours of a gap are decoded, to a small contiguous array, and the
+ * 							 gap is the sum of the table rows scaled by the neighbours, each row a SIMD
+ * 							 axpy over the whole gap, no gather. Only received samples are neighbours,
+ * 							 they stop at the previous and the next gap.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "arch.h"
+#include "config.h"
+#include "utility.h"
+#include "lostGap.h"
+#include "interpConceal.h"
+#include "bufferPool.h"
+#include "dspKernel.h"
+
+/*-------------------- GLOBAL PARAMETER --------------------*/
+static interp_kernel_c interp_cache[INTERP_CACHE_NUM];
+static uint32_t interp_cache_next = 0;
+
+/*-------------------- INTERNAL FUNCTIONS --------------------*/
+static void interp_cubic_design(interp_kernel_c *kn) {
+	uint32_t len = kn->len, nl = kn->nl, j;
+	double d = (double)(len + 1);
+	double c = d / (d + 1.0);	/* tangent over d samples, neighbours one sample further out */
+
+	for( j=0; j<len; j++ ) {
+		double u = (double)(j + 1) / d;
+		double h00 = 2*u*u*u - 3*u*u + 1, h10 = u*u*u - 2*u*u + u;
+		double h01 = -2*u*u*u + 3*u*u, h11 = u*u*u - u*u;
+		double w0 = -h10 * c, w1 = h00 - h11 * c, w2 = h01 + h10 * c, w3 = h11 * c;
+
+		/* a missing outer neighbour repeats the inner one */
+		if( nl < 2 ) {
+			w1 += w0;
+		} else {
+			kn->w[(nl - 2) * len + j] = (float)w0;
+		}
+		kn->w[(nl - 1) * len + j] = (float)w1;
+		kn->w[nl * len + j] = (float)w2;
+		if( kn->nr < 2 ) {
+			kn->w[nl * len + j] += (float)w3;
+		} else {
+			kn->w[(nl + 1) * len + j] = (float)w3;
+		}
+	}
+}
+
+static double interp_sinc_corr(double tau, double sigma) {
+	double x = M_PI * INTERP_SINC_BAND * tau;
+	double s = (fabs(x) < 1e-12) ? 1.0 : sin(x) / x;
+	return s * exp(-0.5 * (tau / sigma) * (tau / sigma));
+}
+
+static void interp_chol_solve(const double *chol, uint32_t k, double *v) {
+	uint32_t a, c;
+	for( a=0; a<k; a++ ) {
+		for( c=0; c<a; c++ ) {
+			v[a] -= chol[a * k + c] * v[c];
+		}
+		v[a] /= chol[a * k + a];
+	}
+	for( a=k; a-->0; ) {
+		for( c=a+1; c<k; c++ ) {
+			v[a] -= chol[c * k + a] * v[c];
+		}
+		v[a] /= chol[a * k + a];
+	}
+}
+
+static sint32_t interp_sinc_design(interp_kernel_c *kn) {
+	uint32_t len = kn->len, nl = kn->nl, k = kn->nl + kn->nr;
+	uint32_t a, b, c, j;
+	double sigma = INTERP_SINC_WINDOW * (double)(k + len);
+	double *pos, *chol, *rhs, *one, *ramp;
+	double g00 = 0.0, g01 = 0.0, g11 = 0.0, det;
+
+	pos = (double *)calloc(k * 4 + k * k, sizeof(double));
+	if( pos == NULL ) {
+		printf("Allocation memory error");
+		return -1;
+	}
+	rhs = pos + k;
+	one = rhs + k;
+	ramp = one + k;
+	chol = ramp + k;
+
+	/* neighbour positions from the gap start */
+	for( a=0; a<k; a++ ) {
+		pos[a] = (a < nl) ? -(double)(nl - a) : (double)(len + a - nl);
+	}
+	for( a=0; a<k; a++ ) {
+		for( b=0; b<=a; b++ ) {
+			double v = interp_sinc_corr(pos[a] - pos[b], sigma) + ((a == b) ? INTERP_SINC_LOAD : 0.0);
+			for( c=0; c<b; c++ ) {
+				v -= chol[a * k + c] * chol[b * k + c];
+			}
+			chol[a * k + b] = (a == b) ? sqrt(v) : v / chol[b * k + b];
+		}
+	}
+
+	/* the weights reproduce a constant and a ramp exactly (universal kriging) */
+	for( a=0; a<k; a++ ) {
+		one[a] = 1.0;
+		ramp[a] = pos[a];
+	}
+	interp_chol_solve(chol, k, one);
+	interp_chol_solve(chol, k, ramp);
+	for( a=0; a<k; a++ ) {
+		g00 += one[a];
+		g01 += ramp[a];
+		g11 += pos[a] * ramp[a];
+	}
+	det = g00 * g11 - g01 * g01;
+
+	for( j=0; j<len; j++ ) {
+		double e0 = -1.0, e1 = -(double)j, m0, m1;
+		for( a=0; a<k; a++ ) {
+			rhs[a] = interp_sinc_corr((double)j - pos[a], sigma);
+		}
+		interp_chol_solve(chol, k, rhs);
+		for( a=0; a<k; a++ ) {
+			e0 += rhs[a];
+			e1 += pos[a] * rhs[a];
+		}
+		if( k >= 2 && fabs(det) > 1e-12 ) {
+			m0 = (g11 * e0 - g01 * e1) / det;
+			m1 = (g00 * e1 - g01 * e0) / det;
+		} else {
+			m0 = e0 / g00;
+			m1 = 0.0;
+		}
+		for( a=0; a<k; a++ ) {
+			kn->w[a * len + j] = (float)(rhs[a] - m0 * one[a] - m1 * ramp[a]);
+		}
+	}
+	free(pos);
+	return 0;
+}
+
+/*-------------------- FUNCTIONS --------------------*/
+interp_kernel_c *interp_kernel_get(uint8_t type, uint32_t len, uint32_t nl, uint32_t nr) {
+	uint32_t i;
+	interp_kernel_c *kn;
+	if( len == 0 || nl == 0 || nr == 0 || (type != COMPTYPE_CUBIC && type != COMPTYPE_SINC) ) {
+		return NULL;
+	}
+	for( i=0; i<INTERP_CACHE_NUM; i++ ) {
+		kn = &interp_cache[i];
+		if( kn->w != NULL && kn->type == type && kn->len == len && kn->nl == nl && kn->nr == nr ) {
+			return kn;
+		}
+	}
+	kn = &interp_cache[interp_cache_next];
+	interp_cache_next = (interp_cache_next + 1) % INTERP_CACHE_NUM;
+	free(kn->w);
+	kn->type = type;
+	kn->len = len;
+	kn->nl = nl;
+	kn->nr = nr;
+	kn->w = (float *)calloc((size_t)(nl + nr) * len, sizeof(float));
+	if( kn->w == NULL ) {
+		printf("Allocation memory error");
+		return NULL;
+	}
+	if( type == COMPTYPE_CUBIC ) {
+		interp_cubic_design(kn);
+	} else if( interp_sinc_design(kn) != 0 ) {
+		free(kn->w);
+		kn->w = NULL;
+		return NULL;
+	}
+	return kn;
+}
+
+void interp_release_all(void) {
+	uint32_t i;
+	for( i=0; i<INTERP_CACHE_NUM; i++ ) {
+		free(interp_cache[i].w);
+		interp_cache[i].w = NULL;
+	}
+}
+
+/**
+ * @brief
+ * conceal every gap of the list in a single channel pcm buffer
+ */
+void interp_conceal(uint8_t type, uint8_t *pBuf, uint16_t bit_per_sample, lost_gap_list_c *list) {
+	uint32_t sample_bytes = bit_per_sample / 8;
+	uint32_t num = list->samples;
+	uint32_t taps = (type == COMPTYPE_CUBIC) ? 2 : INTERP_SINC_TAPS;
+	float ctx[2 * INTERP_SINC_TAPS];
+	uint32_t g, k, gap_max = 1;
+	float *y;
+
+	if( list->num == 0 ) {
+		return;
+	}
+	for( g=0; g<list->num; g++ ) {
+		gap_max = (list->gap[g].len > gap_max) ? list->gap[g].len : gap_max;
+	}
+	y = (float *)bufpool_alloc(&gBufPool, sizeof(float) * gap_max);
+	if( y == NULL ) {
+		printf("Allocation memory error");
+		return;
+	}
+
+	for( g=0; g<list->num; g++ ) {
+		uint32_t s = list->gap[g].start, len = list->gap[g].len, e = s + len;
+		uint32_t prev = (g > 0) ? list->gap[g-1].start + list->gap[g-1].len : 0;
+		uint32_t next = (g + 1 < list->num) ? list->gap[g+1].start : num;
+		uint32_t nl = (s - prev < taps) ? s - prev : taps;
+		uint32_t nr = (next - e < taps) ? next - e : taps;
+		interp_kernel_c *kn = interp_kernel_get(type, len, nl, nr);
+
+		/* a gap at the channel edge stays muted */
+		memset(y, 0x0, sizeof(float) * len);
+		if( kn != NULL ) {
+			pcm_to_float(pBuf + (size_t)(s - nl) * sample_bytes, bit_per_sample, sample_bytes, ctx, nl);
+			pcm_to_float(pBuf + (size_t)e * sample_bytes, bit_per_sample, sample_bytes, ctx + nl, nr);
+			for( k=0; k<nl+nr; k++ ) {
+				gDspKernel.axpy(y, ctx[k], kn->w + (size_t)k * len, len);
+			}
+		}
+		float_to_pcm(y, bit_per_sample, sample_bytes, pBuf + (size_t)s * sample_bytes, len);
+	}
+
+	bufpool_free(&gBufPool, y);
+}
@@ -0,0 +1,28 @@
+#ifndef _H_INTERPCONCEAL_
+#define _H_INTERPCONCEAL_
+
+#include "arch.h"
+#include "lostGap.h"
+
+// cubic (catmull-rom) and band limited (windowed sinc) interpolation of the lost gaps
+
+/*-------------------- CONFIGURATION --------------------*/
+#define INTERP_SINC_TAPS (4) /* known neighbours on each side of a gap */
+#define INTERP_SINC_BAND (0.9) /* pass band as a fraction of nyquist */
+#define INTERP_SINC_WINDOW (4.0) /* gaussian window sigma, in units of neighbours + gap */
+#define INTERP_SINC_LOAD (1e-2) /* diagonal loading of the neighbour correlation */
+#define INTERP_CACHE_NUM (8) /* kernel tables kept for reuse across gaps */
+
+typedef struct _interp_kernel_c {
+	uint8_t type;			/* COMPTYPE_CUBIC, COMPTYPE_SINC */
+	uint32_t len;			/* gap length */
+	uint32_t nl, nr;		/* known neighbours before / after the gap */
+	float *w;				/* [nl+nr][len], row k weights neighbour k over the gap */
+} interp_kernel_c;
+
+/*-------------------- FUNCTIONS --------------------*/
+interp_kernel_c *interp_kernel_get(uint8_t type, uint32_t len, uint32_t nl, uint32_t nr); /* cached table, NULL if not supported */
+void interp_release_all(void);
+void interp_conceal(uint8_t type, uint8_t *pBuf, uint16_t bit_per_sample, lost_gap_list_c *list);
+
+#endif
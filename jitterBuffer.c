@@ -0,0 +1,220 @@
+/**
+ * @file jitterBuffer.c
+ * @author weiyuan.hsu
+ * @brief
+ * implement of the jitter buffer simulation of LOSTTYPE_JITTER_FRAME
+ *
+ * jitter_load: ............ Read the arrival trace into the network delay of each 10 ms packet, packet f is
+ * 							 the one sent JB_FRAME_MS * f after the first line, a packet missing in the trace
+ * 							 is lost. Without a trace file a synthetic trace is generated from the seed. The
+ * 							 trace is kept for the next channels and files.
+ *
+ * jitter_playout: ......... Mark the frames whose packet misses its playout time. JBTYPE_FIXED plays every
+ * 							 packet delay_ms after it was sent. JBTYPE_ADAPTIVE starts at delay_ms and every
+ * 							 adapt_frames frames (a talkspurt of the receiver) moves the delay to d + 4 v,
+ * 							 d / v are exponential averages of the packet delay and of its deviation from d
+ * 							 (plain means over the first packets, until 1 / n falls below 1 - JB_ADAPT_ALPHA).
+ * 							 The same pass counts the erased frames of every fixed delay of the table.
+ *
+ * jitter_report: .......... Concealment rate and mouth to ear latency of the policy in use, and the table of
+ * 							 the fixed delays, the trade-off to tune the playout delay against.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "arch.h"
+#include "config.h"
+#include "utility.h"
+#include "LowcFE.h"
+#include "jitterBuffer.h"
+
+/*-------------------- CONFIGURATION --------------------*/
+#define JB_PLC_DELAY_MS (POVERLAPMAX * 1000.0f / 8000.0f)
+#define JB_LINE_MAX (256)
+
+/*-------------------- GLOBAL PARAMETER --------------------*/
+jitter_buffer_c gJitterBuffer;
+
+/*-------------------- INTERNAL FUNCTIONS --------------------*/
+static float jitter_uniform(uint32_t *state) {
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return (float)(x >> 8) / (float)(1 << 24);
+}
+
+static int jitter_synth(jitter_buffer_c *jb, uint32_t seed) {
+	uint32_t state = (seed ^ 0x5bd1e995) * 2654435761u; // a small seed would start the xorshift on tiny numbers
+	float spike = 0.0f;
+
+	state = ( state != 0 ) ? state : 1;
+
+	jb->delay_ms = (float *)malloc(JB_SYNTH_PACKETS * sizeof(float));
+	if( jb->delay_ms == NULL ) {
+		return -1;
+	}
+	jb->packets = JB_SYNTH_PACKETS;
+	for( uint32_t p=0; p<jb->packets; p++ ) {
+		if( jitter_uniform(&state) < JB_SYNTH_SPIKE_RATE ) {
+			spike = JB_SYNTH_SPIKE_MS;
+		}
+		jb->delay_ms[p] = JB_SYNTH_BASE_MS - JB_SYNTH_JITTER_MS * logf(1.0f - jitter_uniform(&state)) + spike;
+		spike = ( spike > JB_FRAME_MS ) ? spike - JB_FRAME_MS : 0.0f;
+		if( jitter_uniform(&state) < JB_SYNTH_LOSS_RATE ) {
+			jb->delay_ms[p] = -1.0f;
+		}
+	}
+	return 0;
+}
+
+static int jitter_read_trace(jitter_buffer_c *jb, const char *trace) {
+	FILE *fp = fopen(trace, "r");
+	char line[JB_LINE_MAX];
+	double send, arrival, send0 = 0.0;
+	uint32_t cap = 0, lines = 0;
+	int ret = -1;
+
+	if( fp == NULL ) {
+		printf("Can't open the jitter trace %s. Exit.\n", trace);
+		return -1;
+	}
+	while( fgets(line, sizeof(line), fp) != NULL ) {
+		sint64_t p;
+		if( line[0] == '#' || sscanf(line, "%lf %lf", &send, &arrival) != 2 ) {
+			continue;
+		}
+		if( lines++ == 0 ) {
+			send0 = send;
+		}
+		p = llround((send - send0) / JB_FRAME_MS);
+		if( p < 0 || p >= (1 << 28) ) {
+			printf("jitter trace %s : packet sent at %.1f ms is out of order. Exit.\n", trace, send);
+			goto EXIT;
+		}
+		if( (uint32_t)p >= cap ) {
+			uint32_t grow = ( cap == 0 ) ? 4096 : cap;
+			float *pNew;
+			while( cap + grow <= (uint32_t)p ) {
+				grow *= 2;
+			}
+			if( (pNew = (float *)realloc(jb->delay_ms, (cap + grow) * sizeof(float))) == NULL ) {
+				goto EXIT;
+			}
+			jb->delay_ms = pNew;
+			for( uint32_t i=cap; i<cap+grow; i++ ) {
+				jb->delay_ms[i] = -1.0f; // not in the trace, lost
+			}
+			cap += grow;
+		}
+		jb->delay_ms[p] = ( arrival < 0.0 ) ? -1.0f : (float)(arrival - send);
+		if( (uint32_t)p >= jb->packets ) {
+			jb->packets = (uint32_t)p + 1;
+		}
+	}
+	if( jb->packets == 0 ) {
+		printf("jitter trace %s has no packet. Exit.\n", trace);
+		goto EXIT;
+	}
+	ret = 0;
+
+EXIT:
+	fclose(fp);
+	return ret;
+}
+
+static void jitter_accumulate(jitter_stats_c *dst, const jitter_stats_c *src) {
+	dst->frames += src->frames;
+	dst->late += src->late;
+	dst->lost += src->lost;
+	dst->delay_sum_ms += src->delay_sum_ms;
+	dst->delay_max_ms = ( src->delay_max_ms > dst->delay_max_ms ) ? src->delay_max_ms : dst->delay_max_ms;
+	for( uint32_t c=0; c<JB_CURVE_NUM; c++ ) {
+		dst->curve_erased[c] += src->curve_erased[c];
+	}
+}
+
+/*-------------------- FUNCTIONS --------------------*/
+int jitter_load(jitter_buffer_c *jb, const char *trace, uint32_t seed) {
+	if( jb->delay_ms != NULL && strcmp(jb->trace, trace) == 0 && jb->seed == seed ) {
+		return 0;
+	}
+	free(jb->delay_ms);
+	jb->delay_ms = NULL;
+	jb->packets = 0;
+	snprintf(jb->trace, sizeof(jb->trace), "%s", trace);
+	jb->seed = seed;
+
+	if( (( trace[0] == '\0' ) ? jitter_synth(jb, seed) : jitter_read_trace(jb, trace)) != 0 ) {
+		free(jb->delay_ms);
+		jb->delay_ms = NULL;
+		jb->packets = 0;
+		return -1;
+	}
+	return 0;
+}
+
+void jitter_playout(jitter_buffer_c *jb, uint8_t policy, float delay_ms, uint32_t adapt_frames, uint32_t frames, bool *pErased) {
+	jitter_stats_c *st = &jb->channel;
+	double d = -1.0, v = 0.0;
+	uint32_t arrived = 0;
+	float playout = delay_ms;
+
+	memset(st, 0x0, sizeof(jitter_stats_c));
+	if( jb->packets == 0 ) {
+		return;
+	}
+	for( uint32_t f=0; f<frames; f++ ) {
+		float n = jb->delay_ms[f % jb->packets];
+
+		// a new talkspurt plays with the delay estimated so far
+		if( policy == JBTYPE_ADAPTIVE && adapt_frames != 0 && f % adapt_frames == 0 && d >= 0.0 ) {
+			playout = (float)(d + JB_ADAPT_VAR_GAIN * v);
+		}
+
+		pErased[f] = ( n < 0.0f || n > playout );
+		st->lost += ( n < 0.0f ) ? 1 : 0;
+		st->late += ( n >= 0.0f && n > playout ) ? 1 : 0;
+		st->delay_sum_ms += playout;
+		st->delay_max_ms = ( playout > st->delay_max_ms ) ? playout : st->delay_max_ms;
+		for( uint32_t c=0; c<JB_CURVE_NUM; c++ ) {
+			st->curve_erased[c] += ( n < 0.0f || n > (float)((c + 1) * JB_CURVE_STEP_MS) ) ? 1 : 0;
+		}
+
+		// delay estimate, from the packets which arrived. A plain mean until the average spans enough packets,
+		// the first packets would weigh for seconds otherwise
+		if( n >= 0.0f ) {
+			double a = 1.0 - 1.0 / ++arrived;
+			a = ( a < JB_ADAPT_ALPHA ) ? a : JB_ADAPT_ALPHA;
+			d = ( d < 0.0 ) ? n : a * d + (1.0 - a) * n;
+			v = a * v + (1.0 - a) * fabs(d - n);
+		}
+	}
+	st->frames = frames;
+	jitter_accumulate(&jb->total, st);
+}
+
+void jitter_report(const jitter_stats_c *stats, const char *title, bool curve) {
+	if( stats->frames == 0 ) {
+		return;
+	}
+	printf("jitter buffer %s : %llu frames, %llu late, %llu lost, concealed %.2f %%, playout delay mean %.1f ms, max %.1f ms, mouth to ear %.1f ms\n",
+		title, (unsigned long long)stats->frames, (unsigned long long)stats->late, (unsigned long long)stats->lost,
+		100.0 * (stats->late + stats->lost) / stats->frames, stats->delay_sum_ms / stats->frames, stats->delay_max_ms,
+		stats->delay_sum_ms / stats->frames + JB_FRAME_MS + JB_PLC_DELAY_MS);
+	for( uint32_t c=0; c<JB_CURVE_NUM && curve; c++ ) {
+		printf("\tfixed %3u ms : mouth to ear %6.1f ms, concealed %6.2f %%\n", (c + 1) * JB_CURVE_STEP_MS,
+			(c + 1) * JB_CURVE_STEP_MS + JB_FRAME_MS + JB_PLC_DELAY_MS, 100.0 * stats->curve_erased[c] / stats->frames);
+	}
+}
+
+void jitter_release(jitter_buffer_c *jb) {
+	free(jb->delay_ms);
+	memset(jb, 0x0, sizeof(jitter_buffer_c));
+}
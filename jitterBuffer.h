@@ -0,0 +1,58 @@
+#ifndef _H_JITTERBUFFER_
+#define _H_JITTERBUFFER_
+
+#include "arch.h"
+
+// jitter buffer of LOSTTYPE_JITTER_FRAME, frame f of the channel is the packet f of an arrival trace, it is
+// erased when it arrives after its playout time (or never arrives) and g711plc_dofe conceals it.
+//
+// trace file, one packet per line, '#' starts a comment
+// <send ms> <arrival ms>		arrival < 0 : the packet is lost
+// the packets are 10 ms frames in send order, the network delay of a packet is arrival - send, so both clocks
+// only need the same rate. A trace shorter than the channel is repeated. Without a trace file a synthetic trace
+// is generated from the seed : base delay + exponential jitter + delay spikes which drain like a queue
+//
+// playout time of packet f : send + delay, the delay is fixed or adapted every adapt_frames frames from the
+// smoothed delay and its variation (d + JB_ADAPT_VAR_GAIN * v, exponential averages of the arrivals).
+// mouth to ear latency of a frame : playout delay + JB_FRAME_MS (packetization) + POVERLAPMAX of the plc
+
+/*-------------------- CONFIGURATION --------------------*/
+#define JB_FRAME_MS (10.0f)
+#define JB_ADAPT_ALPHA (0.998002) /* smoothing of the delay estimate, per packet */
+#define JB_ADAPT_VAR_GAIN (4.0)
+#define JB_CURVE_STEP_MS (10) /* fixed delays of the latency / concealment table */
+#define JB_CURVE_NUM (30)
+#define JB_SYNTH_PACKETS (60000) /* 10 minutes */
+#define JB_SYNTH_BASE_MS (30.0f)
+#define JB_SYNTH_JITTER_MS (8.0f) /* mean of the exponential jitter */
+#define JB_SYNTH_SPIKE_RATE (0.002f) /* spikes per packet */
+#define JB_SYNTH_SPIKE_MS (120.0f) /* delay of the first packet of a spike, the next ones drain JB_FRAME_MS each */
+#define JB_SYNTH_LOSS_RATE (0.005f)
+
+typedef struct _jitter_stats_c {
+	uint64_t frames;
+	uint64_t late;				/* arrived after the playout time */
+	uint64_t lost;				/* never arrived */
+	double delay_sum_ms;		/* playout delay of every frame */
+	float delay_max_ms;
+	uint64_t curve_erased[JB_CURVE_NUM];	/* erased frames with the fixed delay (c + 1) * JB_CURVE_STEP_MS */
+} jitter_stats_c;
+
+typedef struct _jitter_buffer_c {
+	float *delay_ms;			/* network delay of each packet of the trace, < 0 : lost */
+	uint32_t packets;
+	char trace[128];			/* "" : synthetic */
+	uint32_t seed;
+	jitter_stats_c channel;		/* last channel */
+	jitter_stats_c total;		/* every channel of the run */
+} jitter_buffer_c;
+
+extern jitter_buffer_c gJitterBuffer;
+
+/*-------------------- FUNCTIONS --------------------*/
+int jitter_load(jitter_buffer_c *jb, const char *trace, uint32_t seed); /* 0 success, -1 fail, kept while the trace and seed do not change */
+void jitter_playout(jitter_buffer_c *jb, uint8_t policy, float delay_ms, uint32_t adapt_frames, uint32_t frames, bool *pErased);
+void jitter_report(const jitter_stats_c *stats, const char *title, bool curve); /* curve : with the table of the fixed delays */
+void jitter_release(jitter_buffer_c *jb);
+
+#endif
@@ -0,0 +1,955 @@
+/**
+ * @file kernelCheck.c
+ * @author weiyuan.hsu
+ * @brief
+ * implement of the differential kernel check
+ *
+ * kcheck_run: ............. Every dsp kernel and the G.711 codec run once bound to SIMDISA_SCALAR (the
+ * 							 reference) and once per instruction set the cpu has, on the same generated
+ * 							 signals and on lengths which end in every vector tail. The specialized split /
+ * 							 merge / interpolation kernels run next to a per sample reference written from
+ * 							 the format rules, the multi stream g711plc_batch_frame next to one LowcFE_c per
+ * 							 stream. Then the pipeline check runs on the generated signals.
+ *
+ * kcheck_channel: ......... The data lost and the compensation of main.cpp (Model_DataLost / Model_
+ * 							 Compensation, so the g711plc_*, interpolation and concealment code as shipped)
+ * 							 on one channel, once per instruction set, every case compared sample by sample
+ * 							 with the scalar run. RUNMODE_KERNEL_CHECK calls it on every corpus channel.
+ *
+ * tolerance: .............. A kernel is bit exact unless it is listed with a tolerance, the element wise
+ * 							 kernels, the codec and every integer path are. A reassociated float sum (dot,
+ * 							 sum of squares) may differ by 2 * n * eps of the sum of |terms|, the bound of
+ * 							 two summation orders, so its scale is n * sum |terms|. The pipeline tolerance
+ * 							 is a fraction of the full scale of the output samples, per compensation, only
+ * 							 the cases which go through a reassociated sum have one. The LowcFE synthesis
+ * 							 kernels are also compared with the G.711 appendix loops they replace, which
+ * 							 accumulate their ramps, within one 16 bit step.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "arch.h"
+#include "config.h"
+#include "utility.h"
+#include "param.h"
+#include "main.h"
+#include "bufferPool.h"
+#include "lostGap.h"
+#include "dspKernel.h"
+#include "g711Codec.h"
+#include "procKernel.h"
+#include "LowcFE.h"
+#include "kernelCheck.h"
+
+/*-------------------- GLOBAL PARAMETER --------------------*/
+kcheck_c gKernelCheck;
+
+enum {
+	KCHECK_SIG_TONES = 0,
+	KCHECK_SIG_NOISE,
+	KCHECK_SIG_IMPULSE,
+	KCHECK_SIG_SILENCE,
+	KCHECK_SIG_CLIP,
+	KCHECK_SIG_MAX,
+};
+
+static const char kcheck_signal_name[KCHECK_SIG_MAX][16] = {
+	"tones",
+	"noise",
+	"impulse",
+	"silence",
+	"clip",
+};
+
+/* vector lengths of the dsp kernel check, every tail of 4 / 8 / 16 lanes and some long runs */
+static const uint32_t kcheck_len[] = { 1, 3, 4, 7, 8, 9, 15, 16, 17, 31, 33, 63, 64, 65, 255, 1023, 4099 };
+#define KCHECK_LEN_NUM (sizeof(kcheck_len) / sizeof(kcheck_len[0]))
+#define KCHECK_LEN_MAX (4099)
+#define KCHECK_FFT_SIZE (256)
+#define KCHECK_LANES_MAX (65) /* dot_lanes, up to the lengths of kcheck_len */
+#define KCHECK_LANES_ROWS (40)
+
+/* formats of the generated pipeline signals */
+static const struct {
+	uint32_t rate;
+	uint16_t bits;
+} kcheck_format[] = {
+	{ 8000, 16 },
+	{ 44100, 8 },
+	{ 48000, 16 },
+	{ 96000, 24 },
+	{ 48000, 32 },
+};
+#define KCHECK_FORMAT_NUM (sizeof(kcheck_format) / sizeof(kcheck_format[0]))
+
+/* lost / compensation cases of the pipeline check, tolerance in full scale of the output samples */
+static const struct {
+	uint8_t lost;
+	uint8_t comp;
+	double tol;
+	uint8_t bound;				/* 1: the output stays within the peak of the input, checked on the scalar run */
+} kcheck_case[] = {
+	{ LOSTTYPE_INTERLEAVE, COMPTYPE_INNER_INTERPLOATION, 0.0, 0 },
+	{ LOSTTYPE_CONTINUOUS, COMPTYPE_INNER_INTERPLOATION, 0.0, 0 },
+	{ LOSTTYPE_CONTINUOUS_FRAME, COMPTYPE_G711_VOIP, 1e-4, 0 },	/* 8k bridge, a resampled sample may round to the next 16 bit step */
+	{ LOSTTYPE_CONTINUOUS, COMPTYPE_SPECTRAL, 0.0, 0 },
+	{ LOSTTYPE_CONTINUOUS, COMPTYPE_AR_BURG, 0.0, 1 },			/* the fit sums in dot_double, the same on every set */
+	{ LOSTTYPE_INTERLEAVE, COMPTYPE_AR_BURG, 0.0, 1 },			/* dense one sample gaps, a diverging recursion clips */
+	{ LOSTTYPE_CONTINUOUS, COMPTYPE_CUBIC, 0.0, 0 },
+	{ LOSTTYPE_CONTINUOUS, COMPTYPE_SINC, 0.0, 0 },
+	{ LOSTTYPE_CONTINUOUS, COMPTYPE_WSOLA, 0.0, 0 },
+};
+#define KCHECK_CASE_NUM (sizeof(kcheck_case) / sizeof(kcheck_case[0]))
+
+/*-------------------- INTERNAL FUNCTIONS --------------------*/
+static uint32_t kcheck_seed;
+
+static float kcheck_rand(void) {
+	kcheck_seed = kcheck_seed * 1664525u + 1013904223u;
+	return (float)((sint32_t)kcheck_seed >> 8) * (1.0f / 8388608.0f);
+}
+
+/**
+ * @brief
+ * deterministic test signal in [-1, 1), the clip signal overshoots full scale for the saturation paths
+ */
+static void kcheck_signal(uint8_t type, float *pOut, uint32_t num, uint32_t sample_rate) {
+	uint32_t i;
+	kcheck_seed = 0x5eed0000u + type;
+	for( i=0; i<num; i++ ) {
+		double t = (double)i / sample_rate;
+		switch( type ) {
+		case KCHECK_SIG_TONES:
+			pOut[i] = (float)(0.4 * sin(2 * M_PI * 220.0 * t) + 0.25 * sin(2 * M_PI * 1330.0 * t) + 0.1 * sin(2 * M_PI * 3150.0 * t));
+			break;
+		case KCHECK_SIG_NOISE:
+			pOut[i] = kcheck_rand();
+			break;
+		case KCHECK_SIG_IMPULSE:
+			pOut[i] = (i % 97 == 0) ? 0.9f : 0.0f;
+			break;
+		case KCHECK_SIG_CLIP:
+			pOut[i] = ((i / 20) & 1) ? -1.25f : 1.25f;
+			break;
+		default:
+			pOut[i] = 0.0f;
+			break;
+		}
+	}
+}
+
+static double kcheck_load(const uint8_t *p, uint32_t bytes) {
+	if( bytes == 1 ) {
+		return p[0];
+	} else if( bytes == 2 ) {
+		return (sint16_t)(p[0] | (p[1] << 8));
+	} else if( bytes == 3 ) {
+		return b24_signed_to_b32_signed((uint8_t *)p);
+	}
+	return (sint32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+static void kcheck_load_all(const uint8_t *pBuf, uint32_t bytes, double *pOut, uint32_t num) {
+	uint32_t i;
+	for( i=0; i<num; i++ ) {
+		pOut[i] = kcheck_load(pBuf + (size_t)i * bytes, bytes);
+	}
+}
+
+/**
+ * @brief
+ * bind every runtime dispatched kernel to one instruction set
+ */
+static void kcheck_bind(uint8_t isa) {
+	dsp_kernel_init(isa);
+	g711codec_init();
+}
+
+static kcheck_result_c *kcheck_new(kcheck_c *kc) {
+	if( kc->num == kc->cap ) {
+		uint32_t cap = (kc->cap == 0) ? 256 : kc->cap * 2;
+		kcheck_result_c *result = (kcheck_result_c *)realloc(kc->result, sizeof(kcheck_result_c) * cap);
+		if( result == NULL ) {
+			printf("Allocation memory error");
+			return NULL;
+		}
+		kc->result = result;
+		kc->cap = cap;
+	}
+	memset(&kc->result[kc->num], 0x0, sizeof(kcheck_result_c));
+	return &kc->result[kc->num++];
+}
+
+/**
+ * @brief
+ * compare the variant with the reference value by value
+ * @param scale : NULL or 0 : the value must be bit exact, others : |got - ref| <= tol * scale
+ */
+static void kcheck_compare(kcheck_c *kc, const char *kernel, const char *variant, const char *signal, const double *ref, const double *got, const double *scale, uint32_t num, double tol) {
+	kcheck_result_c *r = kcheck_new(kc);
+	double sum = 0.0;
+	uint32_t i;
+
+	if( r == NULL ) {
+		kc->fail_cnt++;
+		return;
+	}
+	snprintf(r->kernel, sizeof(r->kernel), "%s", kernel);
+	snprintf(r->variant, sizeof(r->variant), "%s", variant);
+	snprintf(r->signal, sizeof(r->signal), "%s", signal);
+	r->num = num;
+	r->first = -1;
+	r->tol = tol;
+	r->pass = 1;
+	for( i=0; i<num; i++ ) {
+		double err = fabs(got[i] - ref[i]);
+		if( memcmp(&ref[i], &got[i], sizeof(double)) == 0 ) {
+			continue;
+		}
+		if( r->first < 0 ) {
+			r->first = (sint32_t)i;
+			r->ref = ref[i];
+			r->got = got[i];
+		}
+		r->diff_cnt++;
+		if( scale == NULL || scale[i] == 0.0 || !(err <= tol * scale[i]) ) {
+			r->pass = 0;
+		}
+		if( !(err <= r->max_err) ) {
+			r->max_err = err;
+		}
+		sum += err * err;
+	}
+	r->rms_err = (num > 0) ? sqrt(sum / num) : 0.0;
+	if( r->pass == 0 ) {
+		kc->fail_cnt++;
+	} else if( r->diff_cnt == 0 ) {
+		kc->exact_cnt++;
+	}
+}
+
+/*-------------------- DSP KERNELS --------------------*/
+typedef struct _kcheck_input_c {
+	const float *x;				/* KCHECK_LEN_MAX samples of the signal */
+	const float *y;				/* KCHECK_LEN_MAX samples of a second signal */
+	double *out;				/* values of the run */
+	double *scale;				/* tolerance scale of each value, see kcheck_compare() */
+	float *work;				/* 2 * KCHECK_LEN_MAX */
+} kcheck_input_c;
+
+typedef uint32_t (*kcheck_kernel_f)(kcheck_input_c *in);
+
+static uint32_t kcheck_dot(kcheck_input_c *in) {
+	uint32_t l, i;
+	for( l=0; l<KCHECK_LEN_NUM; l++ ) {
+		double sum = 0.0;
+		for( i=0; i<kcheck_len[l]; i++ ) {
+			sum += fabs((double)in->x[i] * in->y[i]);
+		}
+		in->out[l] = gDspKernel.dot(in->x, in->y, kcheck_len[l]);
+		in->scale[l] = kcheck_len[l] * sum;
+	}
+	return KCHECK_LEN_NUM;
+}
+
+static uint32_t kcheck_dot_double(kcheck_input_c *in) {
+	uint32_t l;
+	for( l=0; l<KCHECK_LEN_NUM; l++ ) {
+		in->out[l] = gDspKernel.dot_double(in->x, in->y, kcheck_len[l]);
+		in->scale[l] = 0.0;
+	}
+	return KCHECK_LEN_NUM;
+}
+
+static uint32_t kcheck_dot3_double(kcheck_input_c *in) {
+	uint32_t l, n = 0;
+	for( l=0; l<KCHECK_LEN_NUM; l++ ) {
+		gDspKernel.dot3_double(in->x, in->y, kcheck_len[l], &in->out[n]);
+		in->scale[n++] = 0.0;
+		in->scale[n++] = 0.0;
+		in->scale[n++] = 0.0;
+	}
+	return n;
+}
+
+static uint32_t kcheck_axpy(kcheck_input_c *in) {
+	uint32_t l, i, n = 0;
+	for( l=0; l<KCHECK_LEN_NUM; l++ ) {
+		memcpy(in->work, in->y, sizeof(float) * kcheck_len[l]);
+		gDspKernel.axpy(in->work, 0.7071f, in->x, kcheck_len[l]);
+		for( i=0; i<kcheck_len[l]; i++ ) {
+			in->scale[n] = 0.0;
+			in->out[n++] = in->work[i];
+		}
+	}
+	return n;
+}
+
+static uint32_t kcheck_lattice(kcheck_input_c *in) {
+	uint32_t l, i, n = 0;
+	float *f = in->work, *b = in->work + KCHECK_LEN_MAX;
+	for( l=0; l<KCHECK_LEN_NUM; l++ ) {
+		memcpy(f, in->x, sizeof(float) * kcheck_len[l]);
+		memcpy(b, in->y, sizeof(float) * kcheck_len[l]);
+		gDspKernel.lattice(f, b, -0.43f, kcheck_len[l]);
+		for( i=0; i<kcheck_len[l]; i++ ) {
+			in->scale[n] = 0.0;
+			in->out[n++] = f[i];
+			in->scale[n] = 0.0;
+			in->out[n++] = b[i];
+		}
+	}
+	return n;
+}
+
+static uint32_t kcheck_fft_stage(kcheck_input_c *in) {
+	float wr[KCHECK_FFT_SIZE / 2], wi[KCHECK_FFT_SIZE / 2];
+	float *re = in->work, *im = in->work + KCHECK_LEN_MAX;
+	uint32_t h, i, n = 0;
+	for( h=1; h<KCHECK_FFT_SIZE; h<<=1 ) {
+		for( i=0; i<h; i++ ) {
+			wr[i] = (float)cos(-M_PI * i / h);
+			wi[i] = (float)sin(-M_PI * i / h);
+		}
+		memcpy(re, in->x, sizeof(float) * KCHECK_FFT_SIZE);
+		memcpy(im, in->y, sizeof(float) * KCHECK_FFT_SIZE);
+		gDspKernel.fft_stage(re, im, wr, wi, h, KCHECK_FFT_SIZE);
+		for( i=0; i<KCHECK_FFT_SIZE; i++ ) {
+			in->scale[n] = 0.0;
+			in->out[n++] = re[i];
+			in->scale[n] = 0.0;
+			in->out[n++] = im[i];
+		}
+	}
+	return n;
+}
+
+static uint32_t kcheck_reduce(kcheck_input_c *in) {
+	uint32_t l, i, n = 0;
+	for( l=0; l<KCHECK_LEN_NUM; l++ ) {
+		float vmin, vmax, sumsq;
+		double sum = 0.0;
+		for( i=0; i<kcheck_len[l]; i++ ) {
+			sum += (double)in->x[i] * in->x[i];
+		}
+		gDspKernel.reduce(in->x, kcheck_len[l], &vmin, &vmax, &sumsq);
+		in->scale[n] = 0.0;
+		in->out[n++] = vmin;
+		in->scale[n] = 0.0;
+		in->out[n++] = vmax;
+		in->scale[n] = kcheck_len[l] * sum;
+		in->out[n++] = sumsq;
+	}
+	return n;
+}
+
+/**
+ * @brief
+ * pcm_to_float() / float_to_pcm() of every sample size, the vector part and the scalar tail together
+ */
+static uint32_t kcheck_unpack(kcheck_input_c *in) {
+	uint8_t *pcm = (uint8_t *)in->work;
+	float *f = in->work + KCHECK_LEN_MAX;
+	uint32_t bytes, i, n = 0;
+	for( bytes=1; bytes<=4; bytes++ ) {
+		for( i=0; i<KCHECK_LEN_MAX*bytes; i++ ) {
+			pcm[i] = (uint8_t)(kcheck_rand() * 128.0f);
+		}
+		pcm_to_float(pcm, bytes * 8, bytes, f, KCHECK_LEN_MAX);
+		for( i=0; i<KCHECK_LEN_MAX; i++ ) {
+			in->scale[n] = 0.0;
+			in->out[n++] = f[i];
+		}
+	}
+	return n;
+}
+
+static uint32_t kcheck_pack(kcheck_input_c *in) {
+	uint8_t *pcm = (uint8_t *)in->work;
+	uint32_t bytes, i, n = 0;
+	for( bytes=1; bytes<=4; bytes++ ) {
+		float_to_pcm((float *)in->x, bytes * 8, bytes, pcm, KCHECK_LEN_MAX);
+		for( i=0; i<KCHECK_LEN_MAX; i++ ) {
+			in->scale[n] = 0.0;
+			in->out[n++] = kcheck_load(pcm + (size_t)i * bytes, bytes);
+		}
+	}
+	return n;
+}
+
+/**
+ * @brief
+ * bulk encode of every 16 bit value and decode of every code against the single sample functions,
+ * the reference run (scalar) is the lookup table path, so both are compared with the definition
+ */
+static uint32_t kcheck_g711(kcheck_input_c *in) {
+	sint16_t *pcm = (sint16_t *)in->work;
+	uint8_t *code = (uint8_t *)(in->work + KCHECK_LEN_MAX);
+	uint32_t law, i, n = 0;
+	for( law=G711LAW_ALAW; law<G711LAW_MAX; law++ ) {
+		for( i=0; i<65536; i+=KCHECK_LEN_MAX ) {
+			uint32_t num = (65536 - i < KCHECK_LEN_MAX) ? 65536 - i : KCHECK_LEN_MAX, j;
+			for( j=0; j<num; j++ ) {
+				pcm[j] = (sint16_t)(i + j);
+			}
+			g711codec_encode((uint8_t)law, pcm, code, num);
+			for( j=0; j<num; j++ ) {
+				uint8_t def = (law == G711LAW_ALAW) ? g711_linear2alaw(pcm[j]) : g711_linear2ulaw(pcm[j]);
+				in->scale[n] = 0.0;
+				in->out[n++] = (double)code[j] - def;
+			}
+		}
+		for( i=0; i<256; i++ ) {
+			code[i] = (uint8_t)i;
+		}
+		g711codec_decode((uint8_t)law, code, pcm, 256);
+		for( i=0; i<256; i++ ) {
+			sint16_t def = (law == G711LAW_ALAW) ? g711_alaw2linear((uint8_t)i) : g711_ulaw2linear((uint8_t)i);
+			in->scale[n] = 0.0;
+			in->out[n++] = (double)pcm[i] - def;
+		}
+	}
+	return n;
+}
+
+/**
+ * @brief
+ * lane k of every row, lane counts which end in every vector tail, the accumulators start from the signal
+ */
+static uint32_t kcheck_dot_lanes(kcheck_input_c *in) {
+	static Float x[KCHECK_LANES_ROWS * (KCHECK_LANES_MAX + 3)], y[KCHECK_LANES_ROWS * (KCHECK_LANES_MAX + 3)];
+	Float acc[KCHECK_LANES_MAX];
+	uint32_t l, i, n = 0;
+	for( l=0; l<KCHECK_LEN_NUM && kcheck_len[l]<=KCHECK_LANES_MAX; l++ ) {
+		uint32_t lanes = kcheck_len[l], stride = lanes + 3;
+		for( i=0; i<KCHECK_LANES_ROWS*stride; i++ ) {
+			x[i] = in->x[i] * 32768.0;
+			y[i] = in->y[i] * 32768.0;
+		}
+		for( i=0; i<lanes; i++ ) {
+			acc[i] = in->y[KCHECK_LEN_MAX - 1 - i];
+		}
+		gDspKernel.dot_lanes(acc, x, y, KCHECK_LANES_ROWS, stride, stride, lanes);
+		for( i=0; i<lanes; i++ ) {
+			in->scale[n] = 0.0;
+			in->out[n++] = acc[i];
+		}
+	}
+	return n;
+}
+
+/**
+ * @brief
+ * LowcFE synthesis kernels, the 16 bit scaled signals (the clip signal saturates) over every length, with the
+ * gain of a decaying erasure, the pitch buffer conversion of the OLA output and the in place forms of
+ * g711plc_overlapadds / g711plc_scalespeech
+ */
+static uint32_t kcheck_plc(kcheck_input_c *in) {
+	static Float l[KCHECK_LEN_MAX], r[KCHECK_LEN_MAX], o[KCHECK_LEN_MAX];
+	static sint16_t ls[KCHECK_LEN_MAX], rs[KCHECK_LEN_MAX], os[KCHECK_LEN_MAX];
+	uint32_t len, i, n = 0;
+	for( i=0; i<KCHECK_LEN_MAX; i++ ) {
+		l[i] = (Float)(in->x[i] * 32768.0);
+		r[i] = (Float)(in->y[i] * 32768.0 * 1.5);
+		ls[i] = (sint16_t)((l[i] > 32767.0) ? 32767.0 : (l[i] < -32768.0) ? -32768.0 : l[i]);
+		rs[i] = (sint16_t)((r[i] > 32767.0) ? 32767.0 : (r[i] < -32768.0) ? -32768.0 : r[i]);
+	}
+	for( len=0; len<KCHECK_LEN_NUM; len++ ) {
+		uint32_t num = kcheck_len[len];
+		gDspKernel.ola(o, l, r, num);
+		for( i=0; i<num; i++ ) {
+			in->out[n++] = o[i];
+		}
+		gDspKernel.ola_s16(os, ls, rs, num, 0.6);
+		for( i=0; i<num; i++ ) {
+			in->out[n++] = os[i];
+		}
+		memcpy(os, rs, sizeof(sint16_t) * num);
+		gDspKernel.ola_s16(os, ls, os, num, 1.0);
+		for( i=0; i<num; i++ ) {
+			in->out[n++] = os[i];
+		}
+		gDspKernel.gain_ramp(os, o, num, 1.0, 0.8 / num, 3);
+		for( i=0; i<num; i++ ) {
+			in->out[n++] = os[i];
+		}
+		memcpy(os, rs, sizeof(sint16_t) * num);
+		gDspKernel.gain_ramp(os, NULL, num, 0.8, 0.6 / num, 0);
+		for( i=0; i<num; i++ ) {
+			in->out[n++] = os[i];
+		}
+	}
+	for( i=0; i<n; i++ ) {
+		in->scale[i] = 0.0;
+	}
+	return n;
+}
+
+/**
+ * @brief
+ * definition of kcheck_plc, the G.711 appendix loops which accumulate the OLA weights and the gain sample by
+ * sample, the tolerance scale is one 16 bit step
+ */
+static uint32_t kcheck_plc_def(kcheck_input_c *in) {
+	static Float l[KCHECK_LEN_MAX], r[KCHECK_LEN_MAX], o[KCHECK_LEN_MAX];
+	static sint16_t ls[KCHECK_LEN_MAX], rs[KCHECK_LEN_MAX];
+	uint32_t len, i, n = 0;
+	for( i=0; i<KCHECK_LEN_MAX; i++ ) {
+		l[i] = (Float)(in->x[i] * 32768.0);
+		r[i] = (Float)(in->y[i] * 32768.0 * 1.5);
+		ls[i] = (sint16_t)((l[i] > 32767.0) ? 32767.0 : (l[i] < -32768.0) ? -32768.0 : l[i]);
+		rs[i] = (sint16_t)((r[i] > 32767.0) ? 32767.0 : (r[i] < -32768.0) ? -32768.0 : r[i]);
+	}
+	for( len=0; len<KCHECK_LEN_NUM; len++ ) {
+		uint32_t num = kcheck_len[len], pass;
+		double incr = 1.0 / num, lw, rw, t, g;
+		for( pass=0; pass<3; pass++ ) {
+			double gain = (pass == 1) ? 0.6 : 1.0;
+			lw = (1.0 - incr) * gain;
+			rw = incr;
+			for( i=0; i<num; i++ ) {
+				t = (pass == 0) ? lw * l[i] + rw * r[i] : lw * ls[i] + rw * rs[i];
+				t = (t > 32767.0) ? 32767.0 : (t < -32768.0) ? -32768.0 : t;
+				o[i] = (pass == 0) ? (Float)t : o[i];
+				in->out[n++] = (pass == 0) ? (double)o[i] : (sint16_t)t;
+				lw -= incr * gain;
+				rw += incr;
+			}
+		}
+		g = 1.0 - 3 * (0.8 / num);
+		for( i=0; i<num; i++ ) {
+			in->out[n++] = (sint16_t)((sint16_t)o[i] * g);
+			g -= 0.8 / num;
+		}
+		g = 0.8;
+		for( i=0; i<num; i++ ) {
+			in->out[n++] = (sint16_t)(rs[i] * g);
+			g -= 0.6 / num;
+		}
+	}
+	for( i=0; i<n; i++ ) {
+		in->scale[i] = 1.0;
+	}
+	return n;
+}
+
+static const struct {
+	char name[16];
+	kcheck_kernel_f run;
+	double tol;
+	uint8_t per_signal;			/* 0 : the input does not come from the signal, run once */
+	kcheck_kernel_f def;		/* NULL, or the definition the scalar run is compared with, within def_tol */
+	double def_tol;
+} kcheck_kernel[] = {
+	{ "dot",		kcheck_dot,			2.0 * FLT_EPSILON,	1, NULL, 0.0 },	/* reassociated sum */
+	{ "axpy",		kcheck_axpy,		0.0,				1, NULL, 0.0 },
+	{ "lattice",	kcheck_lattice,		0.0,				1, NULL, 0.0 },
+	{ "fft_stage",	kcheck_fft_stage,	0.0,				1, NULL, 0.0 },
+	{ "reduce",		kcheck_reduce,		2.0 * FLT_EPSILON,	1, NULL, 0.0 },	/* min / max exact, reassociated sum of squares */
+	{ "unpack",		kcheck_unpack,		0.0,				0, NULL, 0.0 },	/* random bytes */
+	{ "pack",		kcheck_pack,		0.0,				1, NULL, 0.0 },
+	{ "g711codec",	kcheck_g711,		0.0,				0, NULL, 0.0 },	/* every value, difference to the definition */
+	{ "dot_lanes",	kcheck_dot_lanes,	0.0,				1, NULL, 0.0 },	/* each lane in row order */
+	{ "plc_synth",	kcheck_plc,			0.0,				1, kcheck_plc_def, 1.0 },	/* ramps from the index, one step from the accumulated ramps */
+	{ "dot_double",	kcheck_dot_double,	0.0,				1, NULL, 0.0 },	/* exact products, the same partial sums */
+	{ "dot3_double",	kcheck_dot3_double,	0.0,			1, NULL, 0.0 },
+};
+#define KCHECK_KERNEL_NUM (sizeof(kcheck_kernel) / sizeof(kcheck_kernel[0]))
+#define KCHECK_VALUE_MAX (2 * (65536 + 256)) /* values of the largest run, the codec */
+
+static int kcheck_dsp(kcheck_c *kc, uint8_t isa_max) {
+	float *x = (float *)bufpool_alloc(&gBufPool, sizeof(float) * KCHECK_LEN_MAX * 4);
+	double *ref = (double *)bufpool_alloc(&gBufPool, sizeof(double) * KCHECK_VALUE_MAX * 3);
+	kcheck_input_c in;
+	uint8_t s, isa;
+	uint32_t k, num;
+
+	if( x == NULL || ref == NULL ) {
+		printf("Allocation memory error");
+		bufpool_free(&gBufPool, x);
+		bufpool_free(&gBufPool, ref);
+		return -1;
+	}
+	in.x = x;
+	in.y = x + KCHECK_LEN_MAX;
+	in.work = x + 2 * KCHECK_LEN_MAX;
+	in.scale = ref + KCHECK_VALUE_MAX;
+
+	for( s=0; s<KCHECK_SIG_MAX; s++ ) {
+		kcheck_signal(s, x, KCHECK_LEN_MAX, 48000);
+		kcheck_signal(KCHECK_SIG_NOISE, x + KCHECK_LEN_MAX, KCHECK_LEN_MAX, 48000);
+		for( k=0; k<KCHECK_KERNEL_NUM; k++ ) {
+			const char *signal = (kcheck_kernel[k].per_signal != 0) ? kcheck_signal_name[s] : "every value";
+			if( kcheck_kernel[k].per_signal == 0 && s != 0 ) {
+				continue;
+			}
+			// reference, each run draws the same random input
+			kcheck_bind(SIMDISA_SCALAR);
+			kcheck_seed = 0x1234u;
+			in.out = ref;
+			num = kcheck_kernel[k].run(&in);
+			in.out = ref + 2 * KCHECK_VALUE_MAX;
+			if( kcheck_kernel[k].run == kcheck_g711 ) {
+				// the reference of the codec is its definition, the table path is checked too
+				memset(in.out, 0x0, sizeof(double) * num);
+				kcheck_compare(kc, kcheck_kernel[k].name, simdisa_name[SIMDISA_SCALAR], signal, in.out, ref, NULL, num, 0.0);
+			}
+			if( kcheck_kernel[k].def != NULL ) {
+				kcheck_seed = 0x1234u;
+				kcheck_kernel[k].def(&in);
+				kcheck_compare(kc, kcheck_kernel[k].name, simdisa_name[SIMDISA_SCALAR], signal, in.out, ref, in.scale, num, kcheck_kernel[k].def_tol);
+			}
+			for( isa=SIMDISA_SSE2; isa<=isa_max; isa++ ) {
+				kcheck_bind(isa);
+				kcheck_seed = 0x1234u;
+				kcheck_kernel[k].run(&in);
+				kcheck_compare(kc, kcheck_kernel[k].name, simdisa_name[isa], signal, ref, in.out, in.scale, num, kcheck_kernel[k].tol);
+			}
+		}
+	}
+
+	bufpool_free(&gBufPool, x);
+	bufpool_free(&gBufPool, ref);
+	return 0;
+}
+
+/*-------------------- PROCESSING KERNELS --------------------*/
+/**
+ * @brief
+ * gProcKernel split / merge / inner interpolation of every sample size against a per sample reference
+ */
+static int kcheck_proc(kcheck_c *kc) {
+	const uint32_t frames = 4099, channels = 6;
+	uint8_t *in = (uint8_t *)bufpool_alloc(&gBufPool, (size_t)frames * channels * 4);
+	uint8_t *out = (uint8_t *)bufpool_alloc(&gBufPool, (size_t)frames * channels * 4);
+	uint8_t *chn = (uint8_t *)bufpool_alloc(&gBufPool, (size_t)frames * 4);
+	double *ref = (double *)bufpool_alloc(&gBufPool, sizeof(double) * frames * channels * 2);
+	double *got = ref + (size_t)frames * channels;
+	lost_gap_list_c list = { NULL, 0, 0, 0 };
+	proc_plan_c plan;
+	uint32_t bytes, ch, i, b, g;
+	char signal[32];
+
+	if( in == NULL || out == NULL || chn == NULL || ref == NULL ) {
+		printf("Allocation memory error");
+		bufpool_free(&gBufPool, in);
+		bufpool_free(&gBufPool, out);
+		bufpool_free(&gBufPool, chn);
+		bufpool_free(&gBufPool, ref);
+		return -1;
+	}
+	kcheck_seed = 0x600du;
+	for( i=0; i<frames*channels*4; i++ ) {
+		in[i] = (uint8_t)(kcheck_rand() * 128.0f);
+	}
+
+	for( bytes=1; bytes<=4; bytes++ ) {
+		uint32_t stride = bytes * channels;
+		if( proc_kernel_select(bytes * 8, LOSTTYPE_CONTINUOUS, COMPTYPE_INNER_INTERPLOATION, 0) != 0 ) {
+			continue;
+		}
+		snprintf(signal, sizeof(signal), "noise %u bit %u ch", bytes * 8, channels);
+
+		// split of every channel, then merge back to an interleaved buffer
+		for( ch=0; ch<channels; ch++ ) {
+			gProcKernel.split(in + ch * bytes, stride, chn, frames);
+			for( i=0; i<frames; i++ ) {
+				ref[ch * frames + i] = kcheck_load(in + (size_t)i * stride + ch * bytes, bytes);
+			}
+			kcheck_load_all(chn, bytes, got + ch * frames, frames);
+			gProcKernel.merge(chn, out + ch * bytes, stride, frames);
+		}
+		kcheck_compare(kc, "split", "TEMPLATE", signal, ref, got, NULL, frames * channels, 0.0);
+		kcheck_load_all(in, bytes, ref, frames * channels);
+		kcheck_load_all(out, bytes, got, frames * channels);
+		kcheck_compare(kc, "merge", "TEMPLATE", signal, ref, got, NULL, frames * channels, 0.0);
+
+		// inner interpolation of the recorded gaps, integer arithmetic as the definition
+		memset(&plan, 0x0, sizeof(plan));
+		plan.bit_per_sample = bytes * 8;
+		plan.sample_rate = 48000;
+		plan.samples = frames;
+		plan.initial = 15;
+		plan.period = 97;
+		plan.lost = 1 + 12 * bytes;
+		plan.random_max = 1;
+		gProcKernel.split(in, stride, chn, frames);
+		lostgap_reset(&list, frames);
+		gProcKernel.lost(chn, &plan, &list);
+		kcheck_load_all(chn, bytes, ref, frames);
+		for( g=0; g<list.num; g++ ) {
+			uint32_t s = list.gap[g].start, len = list.gap[g].len;
+			if( s == 0 || s + len >= frames ) {
+				continue;
+			}
+			for( b=0; b<len; b++ ) {
+				sint64_t v = ((sint64_t)ref[s + len] * (b + 1) + (sint64_t)ref[s - 1] * (len - b)) / (sint64_t)(len + 1);
+				ref[s + b] = kcheck_load((const uint8_t *)&v, bytes); /* wrapped to the sample as stored */
+			}
+		}
+		gProcKernel.comp(chn, &plan, &list);
+		kcheck_load_all(chn, bytes, got, frames);
+		kcheck_compare(kc, "inner interpolation", "TEMPLATE", signal, ref, got, NULL, frames, 0.0);
+	}
+
+	lostgap_release(&list);
+	bufpool_free(&gBufPool, in);
+	bufpool_free(&gBufPool, out);
+	bufpool_free(&gBufPool, chn);
+	bufpool_free(&gBufPool, ref);
+	return 0;
+}
+
+/**
+ * @brief
+ * g711plc_batch_frame of many streams against one LowcFE_c per stream, every stream its own signal and
+ * loss pattern so the onset, extension, decay, silence and end of erasure paths meet in one frame
+ */
+static int kcheck_plc_batch(kcheck_c *kc) {
+	const uint32_t streams = 37, frames = 200, num = streams * frames * FRAMESZ;
+	float *x = (float *)bufpool_alloc(&gBufPool, sizeof(float) * (frames + streams) * FRAMESZ);
+	sint16_t *pcm = (sint16_t *)bufpool_alloc(&gBufPool, sizeof(sint16_t) * (size_t)num);
+	sint16_t *soa = NULL;
+	uint8_t *erased = (uint8_t *)bufpool_alloc(&gBufPool, (size_t)streams * frames);
+	double *ref = (double *)bufpool_alloc(&gBufPool, sizeof(double) * num * 2);
+	double *got = ref + num;
+	LowcFE_c *lc = (LowcFE_c *)bufpool_alloc(&gBufPool, sizeof(LowcFE_c));
+	LowcFE_batch_c batch;
+	uint32_t j, f, i;
+	char signal[64];
+	int ret = -1;
+
+	memset(&batch, 0x0, sizeof(batch));
+	if( x == NULL || pcm == NULL || erased == NULL || ref == NULL || lc == NULL || g711plc_batch_construct(&batch, streams) != 0 ) {
+		printf("Allocation memory error");
+		goto EXIT;
+	}
+	soa = (sint16_t *)bufpool_alloc(&gBufPool, sizeof(sint16_t) * FRAMESZ * batch.lanes);
+	if( soa == NULL ) {
+		printf("Allocation memory error");
+		goto EXIT;
+	}
+
+	// stream j : signal j % KCHECK_SIG_MAX from offset j frames, bursts of 1 to 9 frames
+	for( j=0; j<streams; j++ ) {
+		kcheck_signal(j % KCHECK_SIG_MAX, x, (frames + streams) * FRAMESZ, 8000);
+		for( i=0; i<frames*FRAMESZ; i++ ) {
+			float v = x[j * FRAMESZ + i] * 32767.0f;
+			pcm[(size_t)j * frames * FRAMESZ + i] = (sint16_t)((v > 32767.0f) ? 32767.0f : ((v < -32768.0f) ? -32768.0f : v));
+		}
+		kcheck_seed = 0xe5a5e000u + j;
+		for( f=0; f<frames; f++ ) {
+			erased[j * frames + f] = ((f + j) % (10 + j % 13) < 1 + j % 9) || (kcheck_rand() > 0.9f);
+		}
+	}
+
+	for( j=0; j<streams; j++ ) {
+		g711plc_construct(lc);
+		for( f=0; f<frames; f++ ) {
+			sint16_t frame[FRAMESZ];
+			memcpy(frame, &pcm[((size_t)j * frames + f) * FRAMESZ], sizeof(frame));
+			if( erased[j * frames + f] ) {
+				g711plc_dofe(lc, frame);
+			} else {
+				g711plc_addtohistory(lc, frame);
+			}
+			for( i=0; i<FRAMESZ; i++ ) {
+				ref[((size_t)j * frames + f) * FRAMESZ + i] = frame[i];
+			}
+		}
+	}
+
+	for( f=0; f<frames; f++ ) {
+		uint8_t flag[64];
+		for( j=0; j<streams; j++ ) {
+			for( i=0; i<FRAMESZ; i++ ) {
+				soa[i * batch.lanes + j] = pcm[((size_t)j * frames + f) * FRAMESZ + i];
+			}
+			flag[j] = erased[j * frames + f];
+		}
+		g711plc_batch_frame(&batch, soa, flag);
+		for( j=0; j<streams; j++ ) {
+			for( i=0; i<FRAMESZ; i++ ) {
+				got[((size_t)j * frames + f) * FRAMESZ + i] = soa[i * batch.lanes + j];
+			}
+		}
+	}
+
+	snprintf(signal, sizeof(signal), "%u streams, %llu erased, %llu onsets", streams, (unsigned long long)batch.erased, (unsigned long long)batch.onsets);
+	kcheck_compare(kc, "g711plc batch", "SOA", signal, ref, got, NULL, num, 0.0);
+	ret = 0;
+
+EXIT:
+	g711plc_batch_release(&batch);
+	bufpool_free(&gBufPool, x);
+	bufpool_free(&gBufPool, pcm);
+	bufpool_free(&gBufPool, soa);
+	bufpool_free(&gBufPool, erased);
+	bufpool_free(&gBufPool, ref);
+	bufpool_free(&gBufPool, lc);
+	return ret;
+}
+
+/**
+ * @brief
+ * the output ref of the pipeline must stay within the peak magnitude of its input pBuf, got is the work buffer
+ */
+static void kcheck_bound(kcheck_c *kc, const char *kernel, const char *signal, const uint8_t *pBuf, uint32_t bytes, const double *ref, double *got, uint32_t num) {
+	double mid = (bytes == 1) ? 128.0 : 0.0, peak = 0.0;	/* 8 bit is unsigned */
+	uint32_t i;
+	kcheck_load_all(pBuf, bytes, got, num);
+	for( i=0; i<num; i++ ) {
+		peak = (fabs(got[i] - mid) > peak) ? fabs(got[i] - mid) : peak;
+	}
+	for( i=0; i<num; i++ ) {
+		got[i] = (ref[i] - mid > peak) ? mid + peak : ((ref[i] - mid < -peak) ? mid - peak : ref[i]);
+	}
+	kcheck_compare(kc, kernel, "input peak", signal, got, ref, NULL, num, 0.0);
+}
+
+/*-------------------- FUNCTIONS --------------------*/
+int kcheck_channel(kcheck_c *kc, const char *signal, const uint8_t *pBuf, uint16_t bit_per_sample, uint32_t sample_rate, uint32_t samples) {
+	uint32_t bytes = bit_per_sample / 8, size = samples * bytes, c;
+	uint8_t isa_restore = gDspKernel.forced ? gDspKernel.isa : (uint8_t)SIMDISA_AUTO;
+	uint8_t isa_max = gDspKernel.isa_cpu, isa;
+	uint8_t *work = (uint8_t *)bufpool_alloc(&gBufPool, size);
+	double *ref = (double *)bufpool_alloc(&gBufPool, sizeof(double) * samples * 3);
+	double *got = ref + samples, *scale = ref + 2 * (size_t)samples;
+	char kernel[sizeof(kc->result[0].kernel)];
+	int ret = -1;
+
+	// state of the flow, the pipeline runs on the globals of main.cpp
+	fmt_chunk_body save_body = fmt_single_body;
+	uint8_t *save_dump = single_channel_dump, *save_lost_dump = lost_channel_dump;
+	uint32_t save_size = single_channel_size;
+	uint8_t save_lost = lostMethod, save_comp = compMethod, save_law = g711CodecLaw, save_random = lostRandomOffsetEnable;
+	uint16_t save_sample = Manual_lost_sample_ratio, save_period = Manual_lost_period_ratio, save_start = Manual_lost_start_sample;
+
+	if( work == NULL || ref == NULL ) {
+		printf("Allocation memory error");
+		goto EXIT;
+	}
+
+	memset(&fmt_single_body, 0x0, sizeof(fmt_chunk_body));
+	fmt_single_body.format_tag = WAVE_FORMAT_PCM;
+	fmt_single_body.channels = 1;
+	fmt_single_body.sample_rate = sample_rate;
+	fmt_single_body.bit_per_sample = bit_per_sample;
+	fmt_single_body.block_align = bytes;
+	fmt_single_body.byte_per_sec = sample_rate * bytes;
+	single_channel_size = size;
+	single_channel_dump = work;
+	lost_channel_dump = NULL;
+	g711CodecLaw = G711LAW_NONE;
+	lostRandomOffsetEnable = 0;
+	Manual_lost_sample_ratio = 4; // short gaps, the default ratios lose more than a period
+	Manual_lost_period_ratio = 32;
+	Manual_lost_start_sample = 15;
+
+	for( c=0; c<samples; c++ ) {
+		scale[c] = (double)(1u << (bit_per_sample - 1));
+	}
+
+	for( c=0; c<KCHECK_CASE_NUM; c++ ) {
+		lostMethod = kcheck_case[c].lost;
+		compMethod = kcheck_case[c].comp;
+		snprintf(kernel, sizeof(kernel), "%s/%s", losttype_name[lostMethod], comptype_name[compMethod]);
+		for( isa=SIMDISA_SCALAR; isa<=isa_max; isa++ ) {
+			kcheck_bind(isa);
+			if( proc_kernel_select(bit_per_sample, lostMethod, compMethod, 0) != 0 ) {
+				break;
+			}
+			memcpy(work, pBuf, size);
+			Model_DataLost();
+			Model_Compensation();
+			kcheck_load_all(work, bytes, (isa == SIMDISA_SCALAR) ? ref : got, samples);
+			if( isa == SIMDISA_SCALAR && kcheck_case[c].bound != 0 ) {
+				kcheck_bound(kc, kernel, signal, pBuf, bytes, ref, got, samples);
+			}
+			if( isa != SIMDISA_SCALAR ) {
+				kcheck_compare(kc, kernel, simdisa_name[isa], signal, ref, got, (kcheck_case[c].tol != 0.0) ? scale : NULL, samples, kcheck_case[c].tol);
+			}
+		}
+	}
+	ret = 0;
+
+EXIT:
+	kcheck_bind(isa_restore);
+	fmt_single_body = save_body;
+	single_channel_dump = save_dump;
+	lost_channel_dump = save_lost_dump;
+	single_channel_size = save_size;
+	lostMethod = save_lost;
+	compMethod = save_comp;
+	g711CodecLaw = save_law;
+	lostRandomOffsetEnable = save_random;
+	Manual_lost_sample_ratio = save_sample;
+	Manual_lost_period_ratio = save_period;
+	Manual_lost_start_sample = save_start;
+	bufpool_free(&gBufPool, work);
+	bufpool_free(&gBufPool, ref);
+	return ret;
+}
+
+void kcheck_run(kcheck_c *kc) {
+	uint8_t isa_restore = gDspKernel.forced ? gDspKernel.isa : (uint8_t)SIMDISA_AUTO;
+	uint8_t isa_max = gDspKernel.isa_cpu;
+	uint32_t f, num;
+	uint8_t s;
+	char signal[64];
+
+	if( isa_max <= SIMDISA_SCALAR ) {
+		printf("kernel check : no optimized instruction set on this cpu, only the specialized kernels are compared\n");
+	}
+	kcheck_dsp(kc, isa_max);
+	kcheck_bind(isa_restore);
+	kcheck_proc(kc);
+	kcheck_plc_batch(kc);
+
+	for( f=0; f<KCHECK_FORMAT_NUM; f++ ) {
+		uint32_t bytes = kcheck_format[f].bits / 8;
+		float *x;
+		uint8_t *pcm;
+		num = kcheck_format[f].rate / 1000 * KCHECK_SIGNAL_MS;
+		x = (float *)bufpool_alloc(&gBufPool, sizeof(float) * num);
+		pcm = (uint8_t *)bufpool_alloc(&gBufPool, (size_t)num * bytes);
+		if( x == NULL || pcm == NULL ) {
+			printf("Allocation memory error");
+			bufpool_free(&gBufPool, x);
+			bufpool_free(&gBufPool, pcm);
+			continue;
+		}
+		for( s=0; s<KCHECK_SIG_MAX; s++ ) {
+			kcheck_signal(s, x, num, kcheck_format[f].rate);
+			float_to_pcm(x, kcheck_format[f].bits, bytes, pcm, num);
+			snprintf(signal, sizeof(signal), "%s %u Hz %u bit", kcheck_signal_name[s], kcheck_format[f].rate, kcheck_format[f].bits);
+			kcheck_channel(kc, signal, pcm, kcheck_format[f].bits, kcheck_format[f].rate, num);
+		}
+		bufpool_free(&gBufPool, x);
+		bufpool_free(&gBufPool, pcm);
+	}
+}
+
+void kcheck_report(kcheck_c *kc) {
+	uint32_t i;
+	for( i=0; i<kc->num; i++ ) {
+		kcheck_result_c *r = &kc->result[i];
+		if( r->diff_cnt == 0 ) {
+			continue;
+		}
+		printf("%s %-24s %-8s %-28s : %u / %u differ, first [%d] ref %.9g got %.9g, max err %.3g, rms err %.3g, tol %.3g\n",
+			(r->pass != 0) ? "  ok" : "FAIL", r->kernel, r->variant, r->signal, r->diff_cnt, r->num, r->first, r->ref, r->got, r->max_err, r->rms_err, r->tol);
+	}
+	printf("kernel check : %u compared, %u bit exact, %u within tolerance, %u failed\n", kc->num, kc->exact_cnt, kc->num - kc->exact_cnt - kc->fail_cnt, kc->fail_cnt);
+}
+
+void kcheck_release(kcheck_c *kc) {
+	free(kc->result);
+	memset(kc, 0x0, sizeof(kcheck_c));
+}
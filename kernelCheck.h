@@ -0,0 +1,44 @@
+#ifndef _H_KERNELCHECK_
+#define _H_KERNELCHECK_
+
+#include "arch.h"
+
+// differential check of the optimized kernels against the scalar reference, every variant runs next to the
+// reference on the same input (generated signals and corpus channels), the outputs are compared bit for bit
+// or within the tolerance of the kernel, see RUNMODE_KERNEL_CHECK
+
+/*-------------------- CONFIGURATION --------------------*/
+#define KCHECK_SIGNAL_MS (250) /* length of the generated signals of the pipeline check */
+
+typedef struct _kcheck_result_c {
+	char kernel[40];			/* kernel, or lost / compensation case of the pipeline */
+	char variant[16];			/* instruction set or specialization compared with the reference */
+	char signal[64];			/* generated signal or corpus channel */
+	uint32_t num;				/* values compared */
+	uint32_t diff_cnt;			/* values not bit exact */
+	sint32_t first;				/* first value not bit exact, -1 : none */
+	double ref;					/* reference and variant value at first */
+	double got;
+	double max_err;				/* max |got - ref| */
+	double rms_err;
+	double tol;					/* allowed |got - ref| per unit of scale, 0 : bit exact */
+	uint8_t pass;
+} kcheck_result_c;
+
+typedef struct _kcheck_c {
+	kcheck_result_c *result;
+	uint32_t num;
+	uint32_t cap;
+	uint32_t fail_cnt;
+	uint32_t exact_cnt;			/* results without any differing value */
+} kcheck_c;
+
+extern kcheck_c gKernelCheck; /* results of the run, see main() */
+
+/*-------------------- FUNCTIONS --------------------*/
+void kcheck_run(kcheck_c *kc); /* dsp, codec and processing kernels, then the pipeline on the generated signals */
+int kcheck_channel(kcheck_c *kc, const char *signal, const uint8_t *pBuf, uint16_t bit_per_sample, uint32_t sample_rate, uint32_t samples); /* pipeline on one channel, 0 success, -1 fail */
+void kcheck_report(kcheck_c *kc); /* differing results and the summary */
+void kcheck_release(kcheck_c *kc);
+
+#endif
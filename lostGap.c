@@ -0,0 +1,84 @@
+/**
+ * @file lostGap.c
+ * @author weiyuan.hsu
+ * @brief
+ * implement of the lost gap list
+ *
+ * lostgap_add: ............ The data lost models add their sections in increasing order, a section which
+ * 							 touches or overlaps the last one is merged into it. The list keeps its
+ * 							 memory between channels, so a batch grows it only a few times.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arch.h"
+#include "config.h"
+#include "lostGap.h"
+
+/*-------------------- GLOBAL PARAMETER --------------------*/
+lost_gap_list_c gLostGap;
+
+/*-------------------- FUNCTIONS --------------------*/
+void lostgap_reset(lost_gap_list_c *list, uint32_t samples) {
+	list->num = 0;
+	list->samples = samples;
+}
+
+void lostgap_add(lost_gap_list_c *list, uint32_t start, uint32_t len) {
+	lost_gap_c *last;
+	uint32_t end;
+
+	if( start >= list->samples || len == 0 ) {
+		return;
+	}
+	end = (len > list->samples - start) ? list->samples : start + len;
+
+	last = (list->num > 0) ? &list->gap[list->num - 1] : NULL;
+	if( last != NULL && start <= last->start + last->len ) {
+		if( end > last->start + last->len ) {
+			last->len = end - last->start;
+		}
+		return;
+	}
+
+	if( list->num == list->cap ) {
+		uint32_t cap = (list->cap == 0) ? 256 : list->cap * 2;
+		lost_gap_c *gap = (lost_gap_c *)realloc(list->gap, sizeof(lost_gap_c) * cap);
+		if( gap == NULL ) {
+			printf("Allocation memory error");
+			return;
+		}
+		list->gap = gap;
+		list->cap = cap;
+	}
+	list->gap[list->num].start = start;
+	list->gap[list->num].len = end - start;
+	list->num++;
+}
+
+void lostgap_copy(lost_gap_list_c *dst, const lost_gap_list_c *src) {
+	if( dst->cap < src->num ) {
+		lost_gap_c *gap = (lost_gap_c *)realloc(dst->gap, sizeof(lost_gap_c) * src->num);
+		if( gap == NULL ) {
+			printf("Allocation memory error");
+			dst->num = 0;
+			return;
+		}
+		dst->gap = gap;
+		dst->cap = src->num;
+	}
+	if( src->num > 0 ) {
+		memcpy(dst->gap, src->gap, sizeof(lost_gap_c) * src->num);
+	}
+	dst->num = src->num;
+	dst->samples = src->samples;
+}
+
+void lostgap_release(lost_gap_list_c *list) {
+	free(list->gap);
+	memset(list, 0x0, sizeof(lost_gap_list_c));
+}
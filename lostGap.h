@@ -0,0 +1,30 @@
+#ifndef _H_LOSTGAP_
+#define _H_LOSTGAP_
+
+#include "arch.h"
+
+// list of the lost sections of the channel in process, filled by the data lost models
+// and used by the compensators which need to know where the gaps are
+
+/*-------------------- CONFIGURATION --------------------*/
+typedef struct _lost_gap_c {
+	uint32_t start;				/* unit : sample */
+	uint32_t len;				/* unit : sample */
+} lost_gap_c;
+
+typedef struct _lost_gap_list_c {
+	lost_gap_c *gap;			/* sorted by start, not overlapping */
+	uint32_t num;
+	uint32_t cap;
+	uint32_t samples;			/* channel length, gaps are clipped to it */
+} lost_gap_list_c;
+
+extern lost_gap_list_c gLostGap; /* gaps of the channel in process, see Model_DataLostAndCompensation() */
+
+/*-------------------- FUNCTIONS --------------------*/
+void lostgap_reset(lost_gap_list_c *list, uint32_t samples);
+void lostgap_add(lost_gap_list_c *list, uint32_t start, uint32_t len);
+void lostgap_copy(lost_gap_list_c *dst, const lost_gap_list_c *src); /* dst keeps its memory when it is large enough */
+void lostgap_release(lost_gap_list_c *list);
+
+#endif
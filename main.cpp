@@ -2,12 +2,34 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
 #include "arch.h"
 #include "utility.h"
 #include "wave.h"
 #include "wave_type.h"
 #include "param.h"
 #include "g711PlcMain.h"
+#include "g711Codec.h"
+#include "resampler.h"
+#include "channelMixer.h"
+#include "bufferPool.h"
+#include "main.h"
+#include "asyncIo.h"
+#include "peakIndex.h"
+#include "npyExport.h"
+#include "lostGap.h"
+#include "interpConceal.h"
+#include "procKernel.h"
+#include "fft.h"
+#include "dspKernel.h"
+#include "planarCache.h"
+#include "stageMemo.h"
+#include "kernelCheck.h"
+#include "plcServer.h"
+#include "pipeline.h"
+#include "jitterBuffer.h"
+#include "catalog.h"
+#include "vad.h"
 
 // reference
 // https://codereview.stackexchange.com/questions/222026/parse-a-wav-file-and-export-pcm-data
@@ -16,12 +38,12 @@
 // -------------------------------------------------- functions --------------------------------------------------
 /**
  * @brief
- * simulate the data lost and compensation process
+ * lost plan of the channel in process
  * 192K, lost 8 samples
  * 96K,  lost 4 samples
  * 48K,  lost 2 samples
  */
-void Model_DataLostAndCompensation(void) {
+static void Model_LostPlan(proc_plan_c *plan) {
 
 	/*
 	Note.
@@ -29,28 +51,21 @@ void Model_DataLostAndCompensation(void) {
 	BitPerSample : > 8 bits, signed value
 
 	CONTINUOUS TYPE
-	| buffer in bytes units
-	|                           |<----- lostPts ----->|                                |<----- lostPts ----->|                                |<----- lostPts ----->|                                  ...
-	|<----- initial phase ----->|<-------------------- lostPeriod -------------------->|<-------------------- lostPeriod -------------------->|<-------------------- lostPeriod -------------------->| ...
+	| buffer in sample units
+	|                           |<---- plan.lost ---->|                                |<---- plan.lost ---->|                                |<---- plan.lost ---->|                                  ...
+	|<----- initial phase ----->|<------------------- plan.period -------------------->|<------------------- plan.period -------------------->|<------------------- plan.period -------------------->| ...
 
 	INTERLEAVE TYPE
-	| buffer in bytes units
+	| buffer in sample units
 	|                           |<-- interleave lost section             -->|          |<-- interleave lost section             -->|          |<-- interleave lost section             -->|
 	|                           |<- xxxx ->|          |<- xxxx ->|          |          |<- xxxx ->|          |<- xxxx ->|          |          |<- xxxx ->|          |<- xxxx ->|          |            ...
-	|<----- initial phase ----->|<-------------------- lostPeriod -------------------->|<-------------------- lostPeriod -------------------->|<-------------------- lostPeriod -------------------->| ...
+	|<----- initial phase ----->|<------------------- plan.period -------------------->|<------------------- plan.period -------------------->|<------------------- plan.period -------------------->| ...
 	*/
 
-	uint32_t initialPhase = 0; // unit : sec
-	uint32_t lostPeriod = fmt_single_body.sample_rate * fmt_single_body.bit_per_sample / 8; // unit : 1sec as bytes
-
+	uint32_t sample_bytes = fmt_single_body.bit_per_sample / 8;
 	uint32_t lostSample = 0; // unit : sample
 	uint32_t lostILSample = 0; // unit : sample
 
-	uint32_t lostPts = 0; // unit : bytes
-	uint32_t lostILPts = 0; // unit: bytes
-
-	uint32_t randomOffset = 0;
-
 	// basic lost parameter
 	if( fmt_single_body.sample_rate <= 48000 ) {
 		lostSample = 2;
@@ -63,273 +78,752 @@ void Model_DataLostAndCompensation(void) {
 		lostILSample = 1;
 	}
 
-	// manual tuning
-	lostSample = lostSample * Manual_lost_sample_ratio;
-	initialPhase = ( fmt_single_body.bit_per_sample / 8 ) * Manual_lost_start_sample;
-	lostPeriod = lostPeriod / Manual_lost_period_ratio;
+	// manual tuning, every position is in samples so a section never splits a sample
+	plan->bit_per_sample = fmt_single_body.bit_per_sample;
+	plan->sample_rate = fmt_single_body.sample_rate;
+	plan->samples = single_channel_size / sample_bytes;
+	plan->initial = Manual_lost_start_sample;
+	plan->period = fmt_single_body.sample_rate / Manual_lost_period_ratio; // 1 sec / ratio
+	plan->lost = lostSample * Manual_lost_sample_ratio;
+	plan->interleave = lostILSample;
+	plan->random_max = ( randomOffsetMax > 0 ) ? randomOffsetMax : 1;
+}
 
-	// necessary parameter
-	lostPts = lostSample * fmt_single_body.bit_per_sample / 8;
-	lostILPts = lostILSample * fmt_single_body.bit_per_sample / 8;
+/**
+ * @brief
+ * key of the data lost stage, chained to the key of its input, see stageMemo.h
+ */
+uint64_t Model_LostKey(uint64_t parent) {
+	uint64_t key = parent;
+	key = stage_key(key, &lostMethod, sizeof(lostMethod));
+	key = stage_key(key, &lostRandomOffsetEnable, sizeof(lostRandomOffsetEnable));
+	key = stage_key(key, &randomOffsetMax, sizeof(randomOffsetMax));
+	key = stage_key(key, &Manual_lost_sample_ratio, sizeof(Manual_lost_sample_ratio));
+	key = stage_key(key, &Manual_lost_period_ratio, sizeof(Manual_lost_period_ratio));
+	key = stage_key(key, &Manual_lost_start_sample, sizeof(Manual_lost_start_sample));
+	key = stage_key(key, &g711CodecLaw, sizeof(g711CodecLaw));
+	if( lostMethod == LOSTTYPE_JITTER_FRAME ) {
+		key = stage_key(key, gJitterTrace, strlen(gJitterTrace));
+		key = stage_key(key, &gJitterSeed, sizeof(gJitterSeed));
+		key = stage_key(key, &gJitterPolicy, sizeof(gJitterPolicy));
+		key = stage_key(key, &gJitterDelayMs, sizeof(gJitterDelayMs));
+		key = stage_key(key, &gJitterAdaptFrames, sizeof(gJitterAdaptFrames));
+	}
+	return key;
+}
+
+/**
+ * @brief
+ * simulate the data lost on single_channel_dump, the sections are recorded in gLostGap
+ */
+void Model_DataLost(void) {
+
+	uint32_t sample_bytes = fmt_single_body.bit_per_sample / 8;
+	proc_plan_c plan;
+
+	Model_LostPlan(&plan);
 
 	// print information
 	printf("-----[ data lost simulation ]-----\n");
-	printf("initial phase : %d bytes = %d samples\n", initialPhase, (initialPhase*8)/fmt_single_body.bit_per_sample);
+	printf("initial phase : %d samples\n", plan.initial);
 	printf("single_channel_size : %d bytes\n", single_channel_size);
-	printf("lost period : %d bytes\n", lostPeriod);
-	printf("lost sample : %d samples\n", lostSample);
-	printf("interleave sample : %d samples\n", lostILSample);
-	printf("lost bytes : %d bytes\n", lostPts);
-	printf("interleave bytes : %d bytes\n", lostILPts);
+	printf("lost period : %d samples\n", plan.period);
+	printf("lost sample : %d samples\n", plan.lost);
+	printf("interleave sample : %d samples\n", plan.interleave);
 	printf("lost type : %s\n", losttype_name[lostMethod]);
 	printf("random offset enable : %d\n", lostRandomOffsetEnable);
-	printf("compensation type : %s\n", comptype_name[compMethod]);
+	printf("g711 codec : %s\n", g711law_name[g711CodecLaw]);
+
+	lostgap_reset(&gLostGap, plan.samples);
+	if( gProcKernel.lost == NULL || plan.period == 0 ) {
+		printf("data lost model not supported for this format\n");
+		return;
+	}
 
 	if( lostRandomOffsetEnable != 0 ) {
 		srand(time(NULL));
 	}
 
-	// data lost
-	if( lostMethod == LOSTTYPE_CONTINUOUS ) {
-		for( uint32_t i=initialPhase; i<single_channel_size; i=i+lostPeriod ) {
-			if( lostRandomOffsetEnable != 0 ) {
-				randomOffset = rand() % (randomOffsetMax*(fmt_single_body.bit_per_sample/8));
-			} else {
-				randomOffset = 0;
-			}
-			memset(single_channel_dump+i+randomOffset, 0x0, lostPts);
-		}
-	} else if( lostMethod == LOSTTYPE_INTERLEAVE ) {
-		for( uint32_t i=initialPhase; i<single_channel_size; i=i+lostPeriod ) {
-			uint32_t currentIdx = 0;
-			for(uint32_t ProcTimes=0; ProcTimes*lostILSample<lostSample; ProcTimes++) {
-				currentIdx = i + ProcTimes*(lostILSample*2)*(fmt_single_body.bit_per_sample/8);
-				memset(single_channel_dump+currentIdx, 0x0, lostILSample*(fmt_single_body.bit_per_sample/8));
-			}
+	// g711 codec : encode -> data lost -> decode, the quantization is applied before the lost
+	if( g711CodecLaw != G711LAW_NONE ) {
+		if( fmt_single_body.bit_per_sample == 16 ) {
+			g711codec_transcode(g711CodecLaw, (sint16_t *)single_channel_dump, single_channel_size/2);
+		} else {
+			printf("g711 codec not suppport bit/sample != 16\n");
 		}
-	} else if( lostMethod == LOSTTYPE_CONTINUOUS_FRAME ) {
-		g711DataLost();
+	}
+
+	// data lost, the lost sections are recorded for the compensators
+	gProcKernel.lost(single_channel_dump, &plan, &gLostGap);
+	peak_index_add(&gPeakIndex, PEAK_SIGNAL_LOST, single_channel_dump, sample_bytes);
+	npy_export_add(&gNpyExport, PEAK_SIGNAL_LOST, single_channel_dump, sample_bytes);
+	if( lost_channel_dump != NULL ) {
+		memcpy(lost_channel_dump, single_channel_dump, single_channel_size);
+	}
+}
+
+/**
+ * @brief
+ * conceal the sections of gLostGap in single_channel_dump with gProcKernel.comp
+ */
+void Model_Compensation(void) {
+
+	proc_plan_c plan;
+
+	Model_LostPlan(&plan);
+	printf("compensation type : %s\n", comptype_name[compMethod]);
+
+	if( gProcKernel.lost == NULL || plan.period == 0 ) {
+		return;
+	}
+
+	// gaps in silence are filled with comfort noise instead of concealed, COMPTYPE_G711_VOIP decides per erased frame
+	memset(&gVad.channel, 0x0, sizeof(vad_stats_c));
+	if( gVadEnable != 0 && gProcKernel.comp != NULL && compMethod != COMPTYPE_G711_VOIP ) {
+		vad_skip_gaps(&gVad, single_channel_dump, plan.bit_per_sample, plan.sample_rate, gVadThresholdDb, &gLostGap);
 	}
 
 	// compensation
-	if( lostMethod != LOSTTYPE_NONE ) {
-		if( compMethod == COMPTYPE_INNER_INTERPLOATION ) {
-			if( lostMethod == LOSTTYPE_CONTINUOUS ) {
-				for( uint32_t i=initialPhase; i<single_channel_size; i=i+lostPeriod ) {
-					if( i > 0 ) {
-						// find the interpolation endpoints
-						sint32_t startPts = 0, endPts = 0;
-						if( fmt_single_body.bit_per_sample == 8 ) {
-							startPts = single_channel_dump[i-(fmt_single_body.bit_per_sample/8)];
-							endPts = single_channel_dump[i+lostPts];
-						} else if( fmt_single_body.bit_per_sample == 16 ) {
-							sint16_t b16_val = 0;
-							b16_val = *((sint16_t*)(&single_channel_dump[i-(fmt_single_body.bit_per_sample/8)]));
-							startPts = b16_val;
-							b16_val = *((sint16_t*)(&single_channel_dump[i+lostPts]));
-							endPts = b16_val;
-						} else if( fmt_single_body.bit_per_sample == 24 ) {
-							startPts = b24_signed_to_b32_signed(&single_channel_dump[i-(fmt_single_body.bit_per_sample/8)]);
-							endPts = b24_signed_to_b32_signed(&single_channel_dump[i+lostPts]);
-						} else if( fmt_single_body.bit_per_sample == 32 ) {
-							startPts = *((sint32_t*)(&single_channel_dump[i-(fmt_single_body.bit_per_sample/8)]));
-							endPts = *((sint32_t*)(&single_channel_dump[i+lostPts]));
-						}
-						// printf("startPts = %d, endPts = %d\n", startPts, endPts);
-
-						// inner interpolation
-						sint32_t intp_value = 0;
-						for( uint32_t j=0; j<lostSample; j++ ) {
-							sint32_t a = endPts*(j+1);
-							sint32_t b = startPts*(lostSample-j);
-							sint32_t c = a + b;
-							sint32_t intp_value = c/(sint32_t)(lostSample+1);
-							// printf("[%2d] intp_value = %d\n", j, intp_value);
-							if( fmt_single_body.bit_per_sample == 8 ) {
-								single_channel_dump[i+j*1+0] = ((intp_value & 0x000000ff) >>  0);
-							} else if( fmt_single_body.bit_per_sample == 16 ) {
-								single_channel_dump[i+j*2+0] = ((intp_value & 0x000000ff) >>  0);
-								single_channel_dump[i+j*2+1] = ((intp_value & 0x0000ff00) >>  8);
-							} else if( fmt_single_body.bit_per_sample == 24 ) {
-								single_channel_dump[i+j*3+0] = ((intp_value & 0x000000ff) >>  0);
-								single_channel_dump[i+j*3+1] = ((intp_value & 0x0000ff00) >>  8);
-								single_channel_dump[i+j*3+2] = ((intp_value & 0x00ff0000) >> 16);
-							} else if( fmt_single_body.bit_per_sample == 24 ) {
-								single_channel_dump[i+j*4+0] = ((intp_value & 0x000000ff) >>  0);
-								single_channel_dump[i+j*4+1] = ((intp_value & 0x0000ff00) >>  8);
-								single_channel_dump[i+j*4+2] = ((intp_value & 0x00ff0000) >> 16);
-								single_channel_dump[i+j*4+2] = ((intp_value & 0xff000000) >> 24);
-							}
-						}
-					}
-				}
-			} else if( lostMethod == LOSTTYPE_INTERLEAVE ) {
-				for( uint32_t i=initialPhase; i<single_channel_size; i=i+lostPeriod ) {
-					uint32_t currentIdx = 0;
-					for(uint32_t ProcTimes=0; ProcTimes*lostILSample<lostSample; ProcTimes++) {
-
-						currentIdx = i + ProcTimes*(lostILSample*2)*(fmt_single_body.bit_per_sample/8);
-
-						// find the interpolation endpoints
-						sint32_t startPts = 0, endPts = 0;
-						if( fmt_single_body.bit_per_sample == 8 ) {
-							startPts = single_channel_dump[currentIdx-(fmt_single_body.bit_per_sample/8)];
-							endPts = single_channel_dump[currentIdx+lostILPts];
-						} else if( fmt_single_body.bit_per_sample == 16 ) {
-							sint16_t b16_val = 0;
-							b16_val = *((sint16_t*)(&single_channel_dump[currentIdx-(fmt_single_body.bit_per_sample/8)]));
-							startPts = b16_val;
-							b16_val = *((sint16_t*)(&single_channel_dump[currentIdx+lostILPts]));
-							endPts = b16_val;
-						} else if( fmt_single_body.bit_per_sample == 24 ) {
-							startPts = b24_signed_to_b32_signed(&single_channel_dump[currentIdx-(fmt_single_body.bit_per_sample/8)]);
-							endPts = b24_signed_to_b32_signed(&single_channel_dump[currentIdx+lostILPts]);
-						} else if( fmt_single_body.bit_per_sample == 32 ) {
-							startPts = *((sint32_t*)(&single_channel_dump[currentIdx-(fmt_single_body.bit_per_sample/8)]));
-							endPts = *((sint32_t*)(&single_channel_dump[currentIdx+lostILPts]));
-						}
-						// printf("startPts = %d, endPts = %d\n", startPts, endPts);
-
-						// inner interpolation
-						sint32_t intp_value = 0;
-						for( uint32_t j=0; j<lostILSample; j++ ) {
-							sint32_t a = endPts*(j+1);
-							sint32_t b = startPts*(lostILSample-j);
-							sint32_t c = a + b;
-							sint32_t intp_value = c/(sint32_t)(lostILSample+1);
-							// printf("[%2d] intp_value = %d\n", j, intp_value);
-							if( fmt_single_body.bit_per_sample == 8 ) {
-								single_channel_dump[currentIdx+j*1+0] = ((intp_value & 0x000000ff) >>  0);
-							} else if( fmt_single_body.bit_per_sample == 16 ) {
-								single_channel_dump[currentIdx+j*2+0] = ((intp_value & 0x000000ff) >>  0);
-								single_channel_dump[currentIdx+j*2+1] = ((intp_value & 0x0000ff00) >>  8);
-							} else if( fmt_single_body.bit_per_sample == 24 ) {
-								single_channel_dump[currentIdx+j*3+0] = ((intp_value & 0x000000ff) >>  0);
-								single_channel_dump[currentIdx+j*3+1] = ((intp_value & 0x0000ff00) >>  8);
-								single_channel_dump[currentIdx+j*3+2] = ((intp_value & 0x00ff0000) >> 16);
-							} else if( fmt_single_body.bit_per_sample == 24 ) {
-								single_channel_dump[currentIdx+j*4+0] = ((intp_value & 0x000000ff) >>  0);
-								single_channel_dump[currentIdx+j*4+1] = ((intp_value & 0x0000ff00) >>  8);
-								single_channel_dump[currentIdx+j*4+2] = ((intp_value & 0x00ff0000) >> 16);
-								single_channel_dump[currentIdx+j*4+2] = ((intp_value & 0xff000000) >> 24);
-							}
-						}
-
-					}
-				}
-			}
-		} else if( compMethod == COMPTYPE_G711_VOIP ) {
-			g711PlcMain();
-		}
+	if( gProcKernel.comp != NULL ) {
+		gProcKernel.comp(single_channel_dump, &plan, &gLostGap);
 	}
+	vad_report(&gVad.channel, "channel");
+	peak_index_add(&gPeakIndex, PEAK_SIGNAL_CONCEALED, single_channel_dump, fmt_single_body.bit_per_sample/8);
+	npy_export_add(&gNpyExport, PEAK_SIGNAL_CONCEALED, single_channel_dump, fmt_single_body.bit_per_sample/8);
 
 }
 
-int single_file_processing(void) {
+/**
+ * @brief
+ * simulate the data lost and compensation process
+ */
+void Model_DataLostAndCompensation(void) {
+	Model_DataLost();
+	Model_Compensation();
+}
+
+/**
+ * @brief
+ * read a wav file into raw_dump and the riff / fmt / data headers,
+ * G.711 data is decoded to 16 bit pcm so the callers only handle pcm
+ * @param stream : 1, pcm data is left in fp for the read stage of the pipeline, raw_dump is only allocated
+ * @return int : 0 success, -1 fail
+ */
+static int wav_read(char *name, uint8_t stream) {
+	int ret = -1;
 
 	// ----------------------------------------------------------------------------------------------------
-	// open file
-	sprintf(filename, "input/%s/%s.wav", InputFileFolder[gFileSelection], InputFileName[gFileSelection]);
-	if ((fp = fopen(filename, "rb"))==NULL) {
+	// open file, unless wav_read_cached() left it open
+	if (fp == NULL && (fp = aio_fopen_read(name))==NULL) {
 		printf("Can't open the file. Exit.\n");
 		goto EXIT;
 	}
-	printf("processing %s\n", filename);
+	printf("processing %s\n", name);
 
 	// ----------------------------------------------------------------------------------------------------
-	// Reading RIFF section
-	if (fread(&riff, sizeof(uint8_t), sizeof(riff), fp) != sizeof(riff))  {
-		printf("Can't read RIFF chunk or EOF is met. Exit.\n");
+	// Reading RIFF, fmt and the headers up to the data chunk
+	if( wav_read_header(fp, &riff, &fmt_header, &fmt_body, &data_header, 1) != 0 ) {
 		goto EXIT;
-	} else {
-		if (strncmp("RIFF", riff.id, sizeof(riff.id)) != 0) {
-			Arr2String(gDebugString, riff.id, sizeof(riff.id));
-			printf("File format is %s, not RIFF. Exit.\n", gDebugString);
+	}
+	message_show_body(fmt_header, fmt_body);
+	printf("data size = %d\n", data_header.size);
+	if( fmt_body.channels == 0 || fmt_body.block_align == 0 ) {
+		printf("%d channels, block align %d. Exit.\n", fmt_body.channels, fmt_body.block_align);
+		goto EXIT;
+	}
+
+	// ----------------------------------------------------------------------------------------------------
+	// Reading PCM raw data and save to file
+	raw_dump = (uint8_t*)bufpool_alloc(&gBufPool, data_header.size);
+	if (raw_dump == NULL) {
+		printf("Allocation memory error");
+		goto EXIT;
+	}
+
+	if( (fmt_body.format_tag == WAVE_FORMAT_PCM) || (fmt_body.format_tag == WAVE_FORMAT_EXTENSIBLE && (*(uint16_t *)fmt_body.sub_format) == WAVE_FORMAT_PCM ) ) {
+		block_numbers = data_header.size / fmt_body.block_align;
+		printf("Start to get pcm data with %d blocks\n", block_numbers);
+		if( stream != 0 ) {
+			return 0;
+		}
+		if ( fread(raw_dump, fmt_body.block_align, block_numbers, fp) != block_numbers ) {
+			printf("Readin PCM data error.\n");
 			goto EXIT;
 		}
-		if (strncmp("WAVE", riff.type, sizeof(riff.type)) != 0) {
-			Arr2String(gDebugString, riff.type, sizeof(riff.type));
-			printf("File format is %s, not WAVE. Exit.\n", gDebugString);
+	} else if( (fmt_body.format_tag == WAVE_FORMAT_ALAW) || (fmt_body.format_tag == WAVE_FORMAT_MULAW) ) {
+		// decode G.711 data to 16 bit pcm, the following flow only handles pcm
+		uint8_t law = (fmt_body.format_tag == WAVE_FORMAT_ALAW) ? G711LAW_ALAW : G711LAW_MULAW;
+		uint8_t *law_dump = raw_dump;
+		block_numbers = data_header.size / fmt_body.block_align;
+		printf("Start to get %s data with %d blocks\n", g711law_name[law], block_numbers);
+		if ( fread(law_dump, fmt_body.block_align, block_numbers, fp) != block_numbers ) {
+			printf("Readin G.711 data error.\n");
 			goto EXIT;
 		}
-	};
-
-	// ----------------------------------------------------------------------------------------------------
-	// Reading fmt.id and fmt.size
-	if (fread(&fmt_header, sizeof(uint8_t), 8, fp) != 8) {
-		printf("Can't read fmt chunk or EOF is met. Exit.\n");
-		goto EXIT;
-	} else {
-		if (strncmp("fmt ", fmt_header.id, sizeof(fmt_header.id)) != 0) {
-			printf("File have no fmt chunk. Exit.\n");
+		raw_dump = (uint8_t*)bufpool_alloc(&gBufPool, block_numbers * fmt_body.block_align * 2);
+		if (raw_dump == NULL) {
+			bufpool_free(&gBufPool, law_dump);
+			printf("Allocation memory error");
 			goto EXIT;
 		}
-	}
-	printf("fmt size: %d\n", fmt_header.size);
+		g711codec_decode(law, law_dump, (sint16_t *)raw_dump, block_numbers * fmt_body.block_align);
+		bufpool_free(&gBufPool, law_dump);
 
-	// ----------------------------------------------------------------------------------------------------
-	// Reading fmt Sample Format Info
-	memset(&fmt_body, 0x0, sizeof(fmt_body));
-	if (fread(&fmt_body, sizeof(uint8_t), fmt_header.size, fp) != fmt_header.size) {
-		printf("Can't read Sample Format Info in fmt chunk or EOF is met. Exit.\n");
+		fmt_header.size = 16;
+		fmt_body.format_tag = WAVE_FORMAT_PCM;
+		fmt_body.bit_per_sample = 16;
+		fmt_body.block_align = fmt_body.channels * 2;
+		fmt_body.byte_per_sec = fmt_body.sample_rate * fmt_body.block_align;
+		data_header.size = block_numbers * fmt_body.block_align;
+		riff.size = BASIC_HEADER_SIZE + fmt_header.size + data_header.size;
+		message_show_body(fmt_header, fmt_body);
+	} else {
+		printf("format tag is not PCM. Exit.\n");
 		goto EXIT;
 	}
+	ret = 0;
+
+EXIT:
+	if( ret != 0 && raw_dump != NULL ) {
+		bufpool_free(&gBufPool, raw_dump);
+		raw_dump = NULL;
+	}
+	if( fp != NULL ) {
+		aio_fclose_read(fp);
+		fp = NULL;
+	}
+	return ret;
+}
 
+int wav_read_file(char *name) {
+	return wav_read(name, 0);
+}
+
+/**
+ * @brief
+ * hash the input file and map its planar channels when the cache has them, the headers come from the
+ * entry and raw_dump is only allocated for the merge. On a miss fp is left open at the start of the file
+ * for wav_read_file()
+ * @return int : 1 hit, 0 miss, -1 fail
+ */
+int wav_read_cached(char *name, uint64_t *pHash) {
+	if ((fp = aio_fopen_read(name))==NULL) {
+		printf("Can't open the file. Exit.\n");
+		return -1;
+	}
+	*pHash = pcache_hash(fp);
+
+	// the raw / original dumps need the input data, not the planar channels
+	if( gFlow_dump_raw_pcm != 0 || gFlow_dump_original_wav != 0 || pcache_open(&gPlanarCache, *pHash, gResampleTargetRate) != 0 ) {
+		return 0;
+	}
+	aio_fclose_read(fp);
+	fp = NULL;
+	printf("processing %s from %s\n", name, gPlanarCache.path);
+
+	memcpy(&riff, &gPlanarCache.head.riff, sizeof(riff_chunk));
+	memcpy(&fmt_header, &gPlanarCache.head.fmt_header, sizeof(fmt_chunk_header));
+	memcpy(&fmt_body, &gPlanarCache.head.fmt_body, sizeof(fmt_chunk_body));
+	memcpy(&data_header, &gPlanarCache.head.data_header, sizeof(data_chunk));
+	block_numbers = gPlanarCache.head.block_numbers;
 	message_show_body(fmt_header, fmt_body);
 
-	// Reading data/some chunk
-	if (fread(&data_header, sizeof(uint8_t), 8, fp)!=8) {
-		printf("Error of reading data chunk. Exit.\n");
-		goto EXIT;
-	} else {
-		while( strncmp("data", data_header.id, sizeof(data_header.id)) != 0 ) {
-			if( fseek(fp, data_header.size, SEEK_CUR) != 0 ) {
-				printf("Error of finding data chunk. Exit.\n");
-				goto EXIT;
+	raw_dump = (uint8_t*)bufpool_alloc(&gBufPool, data_header.size);
+	if (raw_dump == NULL) {
+		printf("Allocation memory error");
+		pcache_close(&gPlanarCache);
+		return -1;
+	}
+	return 1;
+}
+
+/**
+ * @brief
+ * name of channel ch in the output files, a file without (or with a too short) speaker mask takes the default
+ * layout of its channel count like the mixer, a channel beyond the mask is named by its index
+ */
+static const char *output_channel_name(uint8_t ch) {
+	static char name[16];
+	uint32_t mask = fmt_body.channel_mask;
+	uint8_t idx;
+	if( get_speaker_mask_num(mask) < fmt_body.channels ) {
+		mask = mixer_default_mask(fmt_body.channels);
+	}
+	idx = get_speaker_mask_idx(mask, ch);
+	if( idx < SPEAKER_NUM_MAX ) {
+		return channel_name[idx];
+	}
+	sprintf(name, "CH%d", ch);
+	return name;
+}
+
+/**
+ * @brief
+ * write the outputs of the concealed channel ch, tag follows the channel name (compensation of a sweep)
+ * @param pPcm : concealed channel, single_channel_size bytes
+ * @param pPeak : pyramid of the channel, nothing is written when it is empty
+ * @param pNpy : planar array of the channel, nothing is written when it is empty
+ * @return int : 0 success, -1 fail, the files left open are closed by single_file_processing()
+ */
+static int write_channel_outputs(uint8_t ch, const char *tag, uint8_t *pPcm, peak_index_c *pPeak, npy_export_c *pNpy) {
+
+	// write peak index sidecar
+	if( pPeak->total != 0 ) {
+		sprintf(filename, "output/MY_%s_%s%s_peak.bin", InputFileName[gFileSelection], output_channel_name(ch), tag);
+		peak_index_write(pPeak, filename);
+	}
+
+	// write golden / lost / concealed array
+	if( pNpy->image != NULL ) {
+		sprintf(filename, "output/MY_%s_%s%s.npy", InputFileName[gFileSelection], output_channel_name(ch), tag);
+		if( npy_export_write(pNpy, filename) != 0 ) {
+			return -1;
+		}
+	}
+
+	// write pcm data
+	if( (gFlow_dump_single_channel_pcm == 1 && ch == 0) || ( gFlow_dump_single_channel_pcm == 2 ) ) {
+		sprintf(filename, "output/MY_%s_%s%s_pcm.raw", InputFileName[gFileSelection], output_channel_name(ch), tag);
+		if( (fp_pcm_data = aio_fopen_write(filename)) == NULL ) {
+			printf("Can't open the single channel raw PCM file for write. Exit.\n");
+			return -1;
+		}
+		if( fwrite(pPcm, 1, single_channel_size, fp_pcm_data) != single_channel_size ) {
+			printf("Can't write single channel raw PCM file. Exit.\n");
+			return -1;
+		}
+		printf("Done. PCM data writing in %s .\n", filename);
+		if( fp_pcm_data != NULL ) {
+			aio_fclose_write(fp_pcm_data);
+			fp_pcm_data = NULL;
+		}
+	}
+
+	// write wav data
+	if( (gFlow_dump_single_channel == 1 && ch == 0) || ( gFlow_dump_single_channel == 2 ) ) {
+
+		sprintf(filename, "output/MY_%s_%s%s.wav", InputFileName[gFileSelection], output_channel_name(ch), tag);
+		if( (fp_single_output = aio_fopen_write(filename)) == NULL ) {
+			printf("Can't open the new WAV file for write. Exit.\n");
+		} else {
+			if( fwrite(&riff_single, 1, sizeof(riff_single), fp_single_output) != sizeof(riff_single) ) {
+				printf("Can't write WAV file riff header. Exit.\n");
+				return -1;
+			}
+			if( fwrite(&fmt_single_header, 1, sizeof(fmt_single_header), fp_single_output) != sizeof(fmt_single_header) ) {
+				printf("Can't write WAV file chunk header. Exit.\n");
+				return -1;
+			}
+			if( fwrite(&fmt_single_body, 1, fmt_single_header.size, fp_single_output) != fmt_single_header.size ) {
+				printf("Can't write WAV file chunk body. Exit.\n");
+				return -1;
+			}
+			if( fwrite(&data_single_header, 1, sizeof(data_single_header), fp_single_output) != sizeof(data_single_header) ) {
+				printf("Can't write WAV file data chunk. Exit.\n");
+				return -1;
+			}
+			if( fwrite(pPcm, 1, single_channel_size, fp_single_output) != single_channel_size ) {
+				printf("Can't write WAV file pcm data. Exit.\n");
+				return -1;
+			}
+			printf("Done. WAV file writing in %s .\n", filename);
+			if( fp_single_output != NULL ) {
+				aio_fclose_write(fp_single_output);
+				fp_single_output = NULL;
 			}
-			fread(&data_header, sizeof(uint8_t), 8, fp);
 		}
 	}
-	printf("data size = %d\n", data_header.size);
+
+	// write G.711 wav data
+	if( (gFlow_dump_single_channel_g711 == 1 && ch == 0) || ( gFlow_dump_single_channel_g711 == 2 ) ) {
+		if( g711CodecLaw != G711LAW_NONE && fmt_single_body.bit_per_sample == 16 ) {
+			sprintf(filename, "output/MY_%s_%s%s_%s.wav", InputFileName[gFileSelection], output_channel_name(ch), tag, g711law_name[g711CodecLaw]);
+			if( g711codec_write_wav(filename, g711CodecLaw, fmt_single_body.sample_rate, (sint16_t *)pPcm, single_channel_size/2) != 0 ) {
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief
+ * write the outputs of the processed interleaved data pPcm, tag follows the file name
+ * @return int : 0 success, -1 fail, the files left open are closed by single_file_processing()
+ */
+static int write_file_outputs(uint8_t *pPcm, const char *tag) {
 
 	// ----------------------------------------------------------------------------------------------------
-	// Reading PCM raw data and save to file
-	raw_dump = (uint8_t*)malloc(data_header.size);
-	if (raw_dump == NULL) {
+	// Mix the processed channels to another speaker layout
+	if( gFlow_dump_downmix != MIXTYPE_NONE ) {
+		mixer_c mixer;
+		fmt_chunk_body fmt_mix_body;
+		uint32_t mix_size = 0;
+		uint8_t *mix_dump = NULL;
+
+		if( gFlow_dump_downmix == MIXTYPE_REMAP ) {
+			mixer_build_remap(&mixer, fmt_body.channel_mask, fmt_body.channels, gMixRemapSpeaker, gMixRemapChannels);
+		} else {
+			mixer_build(&mixer, fmt_body.channel_mask, fmt_body.channels, gFlow_dump_downmix);
+		}
+		mix_size = block_numbers * mixer.out_channels * (fmt_body.bit_per_sample/8);
+		mix_dump = (uint8_t*)bufpool_alloc(&gBufPool, mix_size);
+		if( mix_dump == NULL || mixer.out_channels == 0 ) {
+			printf("Can't mix to %s. Exit.\n", mixtype_name[gFlow_dump_downmix]);
+			bufpool_free(&gBufPool, mix_dump);
+			return -1;
+		}
+		mixer_process(&mixer, pPcm, fmt_body.bit_per_sample, block_numbers, mix_dump);
+
+		memcpy(&fmt_mix_body, &fmt_body, sizeof(fmt_chunk_body));
+		fmt_mix_body.channels = mixer.out_channels;
+		fmt_mix_body.block_align = mixer.out_channels * (fmt_body.bit_per_sample/8);
+		fmt_mix_body.byte_per_sec = fmt_mix_body.sample_rate * fmt_mix_body.block_align;
+		fmt_mix_body.channel_mask = mixer.out_mask;
+		sprintf(filename, "output/MY_%s%s_mix_%s.wav", InputFileName[gFileSelection], tag, mixtype_name[gFlow_dump_downmix]);
+		if( wav_write_pcm(filename, &fmt_mix_body, fmt_header.size, mix_dump, mix_size) != 0 ) {
+			bufpool_free(&gBufPool, mix_dump);
+			return -1;
+		}
+		bufpool_free(&gBufPool, mix_dump);
+	}
+
+	// ----------------------------------------------------------------------------------------------------
+	// Package wave file with processed data
+	if( gFlow_dump_modified != 0 ) {
+		sprintf(filename, "output/MY_%s%s_modified.wav", InputFileName[gFileSelection], tag);
+		if( (fp_output = aio_fopen_write(filename)) == NULL ) {
+			printf("Can't open the new WAV file for write. Exit.\n");
+			return -1;
+		} else {
+			// write original information
+			if( fwrite(&riff, 1, sizeof(riff), fp_output) != sizeof(riff) ) {
+				printf("Can't write WAV file riff header. Exit.\n");
+				return -1;
+			}
+			if( fwrite(&fmt_header, 1, sizeof(fmt_header), fp_output) != sizeof(fmt_header) ) {
+				printf("Can't write WAV file chunk header. Exit.\n");
+				return -1;
+			}
+			if( fwrite(&fmt_body, 1, fmt_header.size, fp_output) != fmt_header.size ) {
+				printf("Can't write WAV file chunk body. Exit.\n");
+				return -1;
+			}
+			if( fwrite(&data_header, 1, sizeof(data_header), fp_output) != sizeof(data_header) ) {
+				printf("Can't write WAV file data chunk. Exit.\n");
+				return -1;
+			}
+			if( fwrite(pPcm, fmt_body.block_align, block_numbers, fp_output) != block_numbers ) {
+				printf("Can't write WAV file pcm data. Exit.\n");
+				return -1;
+			}
+			printf("Done. WAV file writing in %s .\n", filename);
+			aio_fclose_write(fp_output);
+			fp_output = NULL;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief
+ * data lost and compensation k of the sweep on single_channel_dump, the data lost is taken from the stage memo
+ * when lost_key was seen before
+ * @param tag : suffix of the outputs, the compensation name in a sweep
+ */
+static void conceal_channel(uint8_t k, uint64_t lost_key, char *tag) {
+	if( gCompSweepNum != 0 ) {
+		compMethod = gCompSweep[k];
+		sprintf(tag, "_%s", comptype_name[compMethod]);
+		proc_kernel_select(fmt_body.bit_per_sample, lostMethod, compMethod, lostRandomOffsetEnable);
+	}
+	if( stage_lookup(&gStageMemo, STAGE_LOST, lost_key) != 0 ) {
+		memcpy(single_channel_dump, stage_channel(&gStageMemo, STAGE_LOST, 0), single_channel_size);
+		stage_load_gap(&gStageMemo, 0, &gLostGap);
+		peak_index_add(&gPeakIndex, PEAK_SIGNAL_LOST, single_channel_dump, fmt_single_body.bit_per_sample/8);
+		npy_export_add(&gNpyExport, PEAK_SIGNAL_LOST, single_channel_dump, fmt_single_body.bit_per_sample/8);
+	} else {
+		Model_DataLost();
+		if( lost_key != 0 && stage_reserve(&gStageMemo, STAGE_LOST, 1, single_channel_size) == 0 ) {
+			memcpy(stage_channel(&gStageMemo, STAGE_LOST, 0), single_channel_dump, single_channel_size);
+			stage_save_gap(&gStageMemo, 0, &gLostGap);
+			stage_commit(&gStageMemo, STAGE_LOST, lost_key);
+		}
+	}
+	Model_Compensation();
+}
+
+/*-------------------- PIPELINE --------------------*/
+// the process stage is the calling thread, it owns the globals of the data lost / compensation models
+// (single_channel_dump, gLostGap, gPeakIndex, gStageMemo). The read and split stages work on blocks of
+// gPipelineBlockFrames frames, the compensators need the whole channel, so the process and write stages
+// work on channels, a channel is concealed while the writer stores the one before.
+typedef struct _pipe_channel_c {
+	uint8_t ch;
+	uint8_t k;					/* compensation of the sweep */
+	uint8_t *pcm;				/* channel in process, the planar channel itself or buf */
+	uint8_t *buf;				/* copy of the planar channel for a sweep, single_channel_size bytes */
+	peak_index_c peak;			/* pyramid of the channel, moved out of gPeakIndex */
+	npy_export_c npy;			/* array of the channel, moved out of gNpyExport */
+	char tag[40];
+} pipe_channel_c;
+
+typedef struct _pipe_file_c {
+	pipe_queue_c read_q;		/* read -> split : first frame of a block in raw_dump, NULL ends the file */
+	pipe_queue_c split_q;		/* split -> process : planar channels, in channel order */
+	pipe_queue_c write_q;		/* process -> write : pipe_channel_c, NULL ends the file */
+	pipe_queue_c free_q;		/* write -> process : pipe_channel_c written */
+	pipe_stage_c stage[PIPE_STAGE_MAX];
+	pipe_channel_c batch[PIPE_QUEUE_SIZE];
+	uint8_t *plane;				/* planar channels of the split stage, channel ch at ch * single_channel_size */
+	uint8_t **sweep_dump;
+	uint32_t frames;
+	proc_split_f split;			/* gProcKernel is selected again by a sweep on the process stage */
+	proc_merge_f merge;
+	uint8_t read_fail;
+	uint8_t write_fail;
+} pipe_file_c;
+
+static pipe_file_c pipe_file;
+
+static void *pipe_read_stage(void *arg) {
+	pipe_file_c *pf = (pipe_file_c *)arg;
+	pipe_stage_c *st = &pf->stage[PIPE_STAGE_READ];
+
+	pipe_stage_begin(st);
+	for( uint32_t first=0; first<pf->frames; first+=gPipelineBlockFrames ) {
+		uint32_t frames = ( pf->frames - first < gPipelineBlockFrames ) ? pf->frames - first : gPipelineBlockFrames;
+		uint8_t *pBlock = raw_dump + first * sample_size_per_group;
+		if( fp != NULL && fread(pBlock, sample_size_per_group, frames, fp) != frames ) {
+			pf->read_fail = 1;
+			break;
+		}
+		pipe_push(&pf->read_q, pBlock, st);
+	}
+	pipe_push(&pf->read_q, NULL, st);
+	pipe_stage_end(st);
+	return NULL;
+}
+
+static void *pipe_split_stage(void *arg) {
+	pipe_file_c *pf = (pipe_file_c *)arg;
+	pipe_stage_c *st = &pf->stage[PIPE_STAGE_SPLIT];
+	uint32_t sample_bytes = fmt_body.bit_per_sample / 8;
+	uint8_t *pBlock;
+
+	pipe_stage_begin(st);
+	while( (pBlock = (uint8_t *)pipe_pop(&pf->read_q, st)) != NULL ) {
+		uint32_t first = (pBlock - raw_dump) / sample_size_per_group;
+		uint32_t frames = ( pf->frames - first < gPipelineBlockFrames ) ? pf->frames - first : gPipelineBlockFrames;
+		for( uint8_t ch=0; ch<fmt_body.channels; ch++ ) {
+			pf->split(pBlock + ch*sample_bytes, sample_size_per_group, pf->plane + ch*single_channel_size + first*sample_bytes, frames);
+		}
+	}
+	// every channel is complete with the last block
+	for( uint8_t ch=0; ch<fmt_body.channels; ch++ ) {
+		pipe_push(&pf->split_q, pf->plane + ch*single_channel_size, st);
+	}
+	pipe_stage_end(st);
+	return NULL;
+}
+
+static void *pipe_write_stage(void *arg) {
+	pipe_file_c *pf = (pipe_file_c *)arg;
+	pipe_stage_c *st = &pf->stage[PIPE_STAGE_WRITE];
+	uint32_t sample_bytes = fmt_body.bit_per_sample / 8;
+	pipe_channel_c *batch;
+
+	pipe_stage_begin(st);
+	while( (batch = (pipe_channel_c *)pipe_pop(&pf->write_q, st)) != NULL ) {
+		if( pf->write_fail == 0 && write_channel_outputs(batch->ch, batch->tag, batch->pcm, &batch->peak, &batch->npy) != 0 ) {
+			pf->write_fail = 1;
+		}
+		pf->merge(batch->pcm, pf->sweep_dump[batch->k] + batch->ch*sample_bytes, sample_size_per_group, pf->frames);
+		peak_index_release(&batch->peak);
+		npy_export_release(&batch->npy);
+		pipe_push(&pf->free_q, batch, st);
+	}
+	pipe_stage_end(st);
+	return NULL;
+}
+
+/**
+ * @brief
+ * the channel loop of single_file_processing() on the stage threads, the pcm data is read by the read stage
+ * when fp is still open (wav_read() with stream), a cache hit maps the planar channels and has no read / split
+ * @return int : 0 success, -1 fail
+ */
+static int pipelined_channel_processing(int cache_hit, uint64_t split_key, uint8_t sweep_num, uint8_t **sweep_dump) {
+	pipe_file_c *pf = &pipe_file;
+	pipe_stage_c *st = &pf->stage[PIPE_STAGE_PROCESS];
+	uint8_t depth = ( gPipelineDepth == 0 ) ? 1 : ( gPipelineDepth < PIPE_QUEUE_SIZE ) ? gPipelineDepth : PIPE_QUEUE_SIZE;
+	pthread_t read_thread, split_thread, write_thread;
+	uint64_t t0 = pipe_time_ns();
+	uint64_t lost_key = 0;
+	int ret = -1;
+
+	memset(pf, 0x0, sizeof(pipe_file_c));
+	pipe_queue_init(&pf->read_q);
+	pipe_queue_init(&pf->split_q);
+	pipe_queue_init(&pf->write_q);
+	pipe_queue_init(&pf->free_q);
+	pf->sweep_dump = sweep_dump;
+	pf->frames = data_header.size / sample_size_per_group;
+	pf->split = gProcKernel.split;
+	pf->merge = gProcKernel.merge;
+	if( gPipelineBlockFrames == 0 ) {
+		gPipelineBlockFrames = 65536;
+	}
+
+	// batches, the writer gives them back to the process stage. Without a sweep the planar channel is concealed
+	// in place, a sweep conceals a copy for each compensation
+	for( uint8_t b=0; b<depth; b++ ) {
+		if( sweep_num > 1 && (pf->batch[b].buf = (uint8_t*)bufpool_alloc(&gBufPool, single_channel_size)) == NULL ) {
+			printf("Allocation memory error");
+			goto EXIT;
+		}
+		pipe_push(&pf->free_q, &pf->batch[b], &pf->stage[PIPE_STAGE_WRITE]);
+	}
+	if( cache_hit == 0 && (pf->plane = (uint8_t*)bufpool_alloc(&gBufPool, (size_t)single_channel_size * fmt_body.channels)) == NULL ) {
 		printf("Allocation memory error");
 		goto EXIT;
 	}
 
-	if( (fmt_body.format_tag == WAVE_FORMAT_PCM) || (fmt_body.format_tag == WAVE_FORMAT_EXTENSIBLE && (*(uint16_t *)fmt_body.sub_format) == WAVE_FORMAT_PCM ) ) {
-		block_numbers = data_header.size / fmt_body.block_align;
-		printf("Start to get pcm data with %d blocks\n", block_numbers);
-		if ( fread(raw_dump, fmt_body.block_align, block_numbers, fp) != block_numbers ) {
-			printf("Readin PCM data error.\n");
+	// stage threads, the read stage runs on this thread when it can not be started
+	if( pthread_create(&write_thread, NULL, pipe_write_stage, pf) != 0 ) {
+		printf("Can't start the pipeline. Exit.\n");
+		goto EXIT;
+	}
+	if( cache_hit == 0 ) {
+		if( pthread_create(&split_thread, NULL, pipe_split_stage, pf) != 0 ) {
+			printf("Can't start the pipeline. Exit.\n");
+			pipe_push(&pf->write_q, NULL, st);
+			pthread_join(write_thread, NULL);
 			goto EXIT;
-		} else {
-			if( gFlow_dump_raw_pcm != 0 ) {
-				sprintf(filename, "output/%s_pcm.raw", InputFileName[gFileSelection]);
-				if( (fp_pcm_data = fopen(filename, "wb")) == NULL ) {
-					printf("Can't open the raw PCM file for write. Exit.\n");
-					goto EXIT;
+		}
+		if( pthread_create(&read_thread, NULL, pipe_read_stage, pf) != 0 ) {
+			pipe_read_stage(pf);
+			read_thread = pthread_self();
+		}
+	}
+
+	pipe_stage_begin(st);
+	for( uint8_t ch=0; ch<fmt_body.channels; ch++ ) {
+		uint8_t *plane = ( cache_hit != 0 ) ? pcache_channel(&gPlanarCache, ch) : (uint8_t *)pipe_pop(&pf->split_q, st);
+		if( pf->read_fail != 0 ) {
+			continue; // the split stage still hands over every channel
+		}
+		if( cache_hit == 0 ) {
+			pcache_store_channel(&gPlanarCache, plane);
+		}
+
+		// data lost stage key of this file and channel, only a sweep reuses it
+		lost_key = ( sweep_num > 1 ) ? Model_LostKey(stage_key(split_key, &ch, sizeof(ch))) : 0;
+
+		for( uint8_t k=0; k<sweep_num; k++ ) {
+			pipe_channel_c *batch = (pipe_channel_c *)pipe_pop(&pf->free_q, st);
+			batch->ch = ch;
+			batch->k = k;
+			batch->tag[0] = '\0';
+			if( sweep_num > 1 ) {
+				memcpy(batch->buf, plane, single_channel_size);
+			}
+			batch->pcm = ( sweep_num > 1 ) ? batch->buf : plane;
+			single_channel_dump = batch->pcm;
+
+			// golden pyramid and array, taken before the data lost
+			if( (gFlow_dump_peak_index == 1 && ch == 0) || ( gFlow_dump_peak_index == 2 ) ) {
+				if( peak_index_init(&gPeakIndex, fmt_single_body.sample_rate, fmt_single_body.bit_per_sample, single_channel_size/(fmt_single_body.bit_per_sample/8)) == 0 ) {
+					peak_index_add(&gPeakIndex, PEAK_SIGNAL_GOLDEN, single_channel_dump, fmt_single_body.bit_per_sample/8);
 				}
-				if( fwrite(raw_dump, fmt_body.block_align, block_numbers, fp_pcm_data) != block_numbers ) {
-					printf("Can't write PCM file. Exit.\n");
-					goto EXIT;
+			}
+			if( (gFlow_dump_npy == 1 && ch == 0) || ( gFlow_dump_npy == 2 ) ) {
+				if( npy_export_init(&gNpyExport, gNpyType, fmt_single_body.bit_per_sample, single_channel_size/(fmt_single_body.bit_per_sample/8)) == 0 ) {
+					npy_export_add(&gNpyExport, PEAK_SIGNAL_GOLDEN, single_channel_dump, fmt_single_body.bit_per_sample/8);
 				}
-				printf("Done. PCM data writing in %s .\n", filename);
 			}
+			conceal_channel(k, lost_key, batch->tag);
+			memcpy(&batch->peak, &gPeakIndex, sizeof(peak_index_c));
+			memset(&gPeakIndex, 0x0, sizeof(peak_index_c));
+			memcpy(&batch->npy, &gNpyExport, sizeof(npy_export_c));
+			memset(&gNpyExport, 0x0, sizeof(npy_export_c));
+			pipe_push(&pf->write_q, batch, st);
 		}
-	} else {
-		printf("format tag is not PCM. Exit.\n");
+	}
+	pipe_push(&pf->write_q, NULL, st);
+	pipe_stage_end(st);
+
+	pthread_join(write_thread, NULL);
+	if( cache_hit == 0 ) {
+		pthread_join(split_thread, NULL);
+		if( !pthread_equal(read_thread, pthread_self()) ) {
+			pthread_join(read_thread, NULL);
+		}
+	}
+	single_channel_dump = NULL;
+	pipe_report(pf->stage, pipe_time_ns() - t0);
+
+	if( pf->read_fail != 0 ) {
+		printf("Readin PCM data error.\n");
 		goto EXIT;
 	}
+	if( pf->write_fail != 0 ) {
+		goto EXIT;
+	}
+	ret = 0;
+
+EXIT:
+	for( uint8_t b=0; b<depth; b++ ) {
+		bufpool_free(&gBufPool, pf->batch[b].buf);
+	}
+	bufpool_free(&gBufPool, pf->plane);
+	return ret;
+}
+
+int single_file_processing(void) {
+	int cache_hit = 0;
+	uint64_t cache_hash = 0;
+	uint8_t sweep_num = ( gCompSweepNum == 0 ) ? 1 : ( gCompSweepNum < COMPTYPE_MAX ) ? gCompSweepNum : (uint8_t)COMPTYPE_MAX;
+	uint8_t *sweep_dump[COMPTYPE_MAX] = { NULL };
+	uint8_t comp_param = compMethod;
+	char sweep_tag[40] = "";
+	uint64_t split_key = 0, lost_key = 0;
+	uint8_t pipelined = ( gPipelineEnable != 0 && gRunMode == RUNMODE_PROCESS ) ? 1 : 0;
+
+	// ----------------------------------------------------------------------------------------------------
+	// read file, an input seen before is mapped from the planar cache
+	sprintf(filename, "input/%s/%s.wav", InputFileFolder[gFileSelection], InputFileName[gFileSelection]);
+	if( gPlanarCacheEnable != 0 && (cache_hit = wav_read_cached(filename, &cache_hash)) < 0 ) {
+		goto EXIT;
+	}
+	if( cache_hit == 0 && wav_read(filename, pipelined != 0 && gResampleTargetRate == 0 && gFlow_dump_raw_pcm == 0 && gFlow_dump_original_wav == 0) != 0 ) {
+		goto EXIT;
+	}
+
+	// ----------------------------------------------------------------------------------------------------
+	// save pcm data to file
+	if( gFlow_dump_raw_pcm != 0 ) {
+		sprintf(filename, "output/%s_pcm.raw", InputFileName[gFileSelection]);
+		if( (fp_pcm_data = aio_fopen_write(filename)) == NULL ) {
+			printf("Can't open the raw PCM file for write. Exit.\n");
+			goto EXIT;
+		}
+		if( fwrite(raw_dump, fmt_body.block_align, block_numbers, fp_pcm_data) != block_numbers ) {
+			printf("Can't write PCM file. Exit.\n");
+			goto EXIT;
+		}
+		printf("Done. PCM data writing in %s .\n", filename);
+		aio_fclose_write(fp_pcm_data);
+		fp_pcm_data = NULL;
+	}
 
 	// ----------------------------------------------------------------------------------------------------
 	// Package wave file
 	if( gFlow_dump_original_wav != 0 ) {
 		sprintf(filename, "output/MY_%s_restored.wav", InputFileName[gFileSelection]);
-		if( (fp_output = fopen(filename, "wb")) == NULL ) {
+		if( (fp_output = aio_fopen_write(filename)) == NULL ) {
 			printf("Can't open the new WAV file for write. Exit.\n");
 			goto EXIT;
 		} else {
@@ -355,6 +849,37 @@ int single_file_processing(void) {
 				goto EXIT;
 			}
 			printf("Done. WAV file writing in %s .\n", filename);
+			aio_fclose_write(fp_output);
+			fp_output = NULL;
+		}
+	}
+
+	// ----------------------------------------------------------------------------------------------------
+	// normalize sample rate of the batch
+	if( gResampleTargetRate != 0 && gResampleTargetRate != fmt_body.sample_rate ) {
+		uint32_t out_frames = 0;
+		uint8_t *resampled_dump = resampler_convert_interleaved(raw_dump, fmt_body.channels, fmt_body.bit_per_sample, fmt_body.sample_rate, block_numbers, gResampleTargetRate, &out_frames);
+		if( resampled_dump == NULL ) {
+			printf("Can't resample %d to %d. Exit.\n", fmt_body.sample_rate, gResampleTargetRate);
+			goto EXIT;
+		}
+		bufpool_free(&gBufPool, raw_dump);
+		raw_dump = resampled_dump;
+		block_numbers = out_frames;
+		fmt_body.sample_rate = gResampleTargetRate;
+		fmt_body.byte_per_sec = fmt_body.sample_rate * fmt_body.block_align;
+		data_header.size = block_numbers * fmt_body.block_align;
+		riff.size = BASIC_HEADER_SIZE + fmt_header.size + data_header.size;
+		printf("Resample to %d, %d blocks\n", fmt_body.sample_rate, block_numbers);
+	}
+
+	// ----------------------------------------------------------------------------------------------------
+	// processed data of each compensation of the sweep, the first one is merged back to raw_dump
+	sweep_dump[0] = raw_dump;
+	for( uint8_t k=1; k<sweep_num; k++ ) {
+		if( (sweep_dump[k] = (uint8_t*)bufpool_alloc(&gBufPool, data_header.size)) == NULL ) {
+			printf("Allocation memory error");
+			goto EXIT;
 		}
 	}
 
@@ -389,150 +914,199 @@ int single_file_processing(void) {
 		// show signle file information
 		message_show_body(fmt_single_header, fmt_single_body);
 
-		single_channel_dump = (uint8_t*)malloc(single_channel_size);
-		uint32_t singla_channel_dump_idx = 0;
-		for( uint8_t ch=0; ch<fmt_body.channels; ch++ ) {
+		// kernels of this file, the channel loop below does not branch on the format any more
+		if( proc_kernel_select(fmt_body.bit_per_sample, lostMethod, compMethod, lostRandomOffsetEnable) != 0 ) {
+			goto EXIT;
+		}
 
-			// separate single channel data
-			singla_channel_dump_idx = 0;
-			for( uint32_t idx=0; idx<data_header.size; idx=idx+sample_size_per_group ) {
-				for( uint32_t sample_idx=0; sample_idx<(fmt_body.bit_per_sample/8); sample_idx++ ) {
-					single_channel_dump[singla_channel_dump_idx++] = raw_dump[idx + ch*(fmt_body.bit_per_sample/8) + sample_idx];
-				}
+		// split stage key, the content hash when the planar cache computed it
+		split_key = ( cache_hash != 0 ) ? cache_hash : stage_key(0, InputFileName[gFileSelection], strlen(InputFileName[gFileSelection]));
+
+		// a miss stores the channels of the split pass for the next run
+		if( cache_hit == 0 ) {
+			if( pipelined == 0 ) {
+				single_channel_dump = (uint8_t*)bufpool_alloc(&gBufPool, single_channel_size);
+			}
+			if( gPlanarCacheEnable != 0 ) {
+				pcache_store_begin(&gPlanarCache, cache_hash, gResampleTargetRate, &riff, &fmt_header, &fmt_body, &data_header, block_numbers, single_channel_size);
 			}
+		}
+		if( pipelined != 0 && pipelined_channel_processing(cache_hit, split_key, sweep_num, sweep_dump) != 0 ) {
+			goto EXIT;
+		}
+		for( uint8_t ch=0; ch<fmt_body.channels && pipelined == 0; ch++ ) {
 
-			// simulation data lost
-			Model_DataLostAndCompensation();
+			// separate single channel data, or process the mapped channel in place
+			if( cache_hit != 0 ) {
+				single_channel_dump = pcache_channel(&gPlanarCache, ch);
+			} else {
+				gProcKernel.split(raw_dump + ch*(fmt_body.bit_per_sample/8), sample_size_per_group, single_channel_dump, data_header.size / sample_size_per_group);
+				pcache_store_channel(&gPlanarCache, single_channel_dump);
+			}
 
-			// write pcm data
-			if( (gFlow_dump_single_channel_pcm == 1 && ch == 0) || ( gFlow_dump_single_channel_pcm == 2 ) ) {
-				sprintf(filename, "output/MY_%s_%s_pcm.raw", InputFileName[gFileSelection], channel_name[get_speaker_mask_idx(fmt_body.channel_mask, ch)]);
-				if( (fp_pcm_data = fopen(filename, "wb")) == NULL ) {
-					printf("Can't open the single channel raw PCM file for write. Exit.\n");
-					goto EXIT;
-				}
-				if( fwrite(single_channel_dump, 1, single_channel_size, fp_pcm_data) != single_channel_size ) {
-					printf("Can't write single channel raw PCM file. Exit.\n");
-					goto EXIT;
-				}
-				printf("Done. PCM data writing in %s .\n", filename);
-				if( fp_pcm_data != NULL ) {
-					fclose(fp_pcm_data);
-					fp_pcm_data = NULL;
-				}
+			// the channel is an input of the differential kernel check, it is not processed further
+			if( gRunMode == RUNMODE_KERNEL_CHECK ) {
+				char check_name[sizeof(gKernelCheck.result[0].signal)];
+				snprintf(check_name, sizeof(check_name), "%s %s", InputFileName[gFileSelection], output_channel_name(ch));
+				kcheck_channel(&gKernelCheck, check_name, single_channel_dump, fmt_single_body.bit_per_sample, fmt_single_body.sample_rate, single_channel_size/(fmt_single_body.bit_per_sample/8));
+				continue;
 			}
 
-			// write wav data
-			if( (gFlow_dump_single_channel == 1 && ch == 0) || ( gFlow_dump_single_channel == 2 ) ) {
-
-				sprintf(filename, "output/MY_%s_%s.wav", InputFileName[gFileSelection], channel_name[get_speaker_mask_idx(fmt_body.channel_mask, ch)]);
-				if( (fp_single_output = fopen(filename, "wb")) == NULL ) {
-					printf("Can't open the new WAV file for write. Exit.\n");
-				} else {
-					if( fwrite(&riff_single, 1, sizeof(riff_single), fp_single_output) != sizeof(riff_single) ) {
-						printf("Can't write WAV file riff header. Exit.\n");
-						goto EXIT;
-					}
-					if( fwrite(&fmt_single_header, 1, sizeof(fmt_single_header), fp_single_output) != sizeof(fmt_single_header) ) {
-						printf("Can't write WAV file chunk header. Exit.\n");
-						goto EXIT;
-					}
-					if( fwrite(&fmt_single_body, 1, fmt_single_header.size, fp_single_output) != fmt_single_header.size ) {
-						printf("Can't write WAV file chunk body. Exit.\n");
-						goto EXIT;
-					}
-					if( fwrite(&data_single_header, 1, sizeof(data_single_header), fp_single_output) != sizeof(data_single_header) ) {
-						printf("Can't write WAV file data chunk. Exit.\n");
-						goto EXIT;
-					}
-					if( fwrite(single_channel_dump, 1, single_channel_size, fp_single_output) != single_channel_size ) {
-						printf("Can't write WAV file pcm data. Exit.\n");
-						goto EXIT;
-					}
-					printf("Done. WAV file writing in %s .\n", filename);
-					if( fp_single_output != NULL ) {
-						fclose(fp_single_output);
-						fp_single_output = NULL;
-					}
+			// golden pyramid and array, taken before the data lost
+			if( (gFlow_dump_peak_index == 1 && ch == 0) || ( gFlow_dump_peak_index == 2 ) ) {
+				if( peak_index_init(&gPeakIndex, fmt_single_body.sample_rate, fmt_single_body.bit_per_sample, single_channel_size/(fmt_single_body.bit_per_sample/8)) == 0 ) {
+					peak_index_add(&gPeakIndex, PEAK_SIGNAL_GOLDEN, single_channel_dump, fmt_single_body.bit_per_sample/8);
+				}
+			}
+			if( (gFlow_dump_npy == 1 && ch == 0) || ( gFlow_dump_npy == 2 ) ) {
+				if( npy_export_init(&gNpyExport, gNpyType, fmt_single_body.bit_per_sample, single_channel_size/(fmt_single_body.bit_per_sample/8)) == 0 ) {
+					npy_export_add(&gNpyExport, PEAK_SIGNAL_GOLDEN, single_channel_dump, fmt_single_body.bit_per_sample/8);
 				}
 			}
 
-			// put data back
-			singla_channel_dump_idx = 0;
-			for( uint32_t idx=0; idx<data_header.size; idx=idx+sample_size_per_group ) {
-				for( uint32_t sample_idx=0; sample_idx<(fmt_body.bit_per_sample/8); sample_idx++ ) {
-					raw_dump[idx + ch*(fmt_body.bit_per_sample/8) + sample_idx] = single_channel_dump[singla_channel_dump_idx++];
+			// data lost stage key of this file and channel, only a sweep reuses it
+			lost_key = ( sweep_num > 1 ) ? Model_LostKey(stage_key(split_key, &ch, sizeof(ch))) : 0;
+
+			// conceal the lost channel with each compensation of the sweep, the data lost runs once
+			for( uint8_t k=0; k<sweep_num; k++ ) {
+				conceal_channel(k, lost_key, sweep_tag);
+				if( write_channel_outputs(ch, sweep_tag, single_channel_dump, &gPeakIndex, &gNpyExport) != 0 ) {
+					goto EXIT;
 				}
+
+				// put data back
+				gProcKernel.merge(single_channel_dump, sweep_dump[k] + ch*(fmt_body.bit_per_sample/8), sample_size_per_group, data_header.size / sample_size_per_group);
 			}
+			peak_index_release(&gPeakIndex);
+			npy_export_release(&gNpyExport);
 
 		}
+		pcache_store_end(&gPlanarCache);
 
 	}
 
 	// ----------------------------------------------------------------------------------------------------
-	// Package wave file with processed data
-	if( gFlow_dump_modified != 0 ) {
-		sprintf(filename, "output/MY_%s_modified.wav", InputFileName[gFileSelection]);
-		if( (fp_output = fopen(filename, "wb")) == NULL ) {
-			printf("Can't open the new WAV file for write. Exit.\n");
+	// outputs of the processed data, one set per compensation of the sweep
+	if( gRunMode == RUNMODE_KERNEL_CHECK ) {
+		goto EXIT;
+	}
+	for( uint8_t k=0; k<sweep_num && sweep_dump[k] != NULL; k++ ) {
+		if( gCompSweepNum != 0 ) {
+			sprintf(sweep_tag, "_%s", comptype_name[gCompSweep[k]]);
+		}
+		if( write_file_outputs(sweep_dump[k], sweep_tag) != 0 ) {
 			goto EXIT;
-		} else {
-			// write original information
-			if( fwrite(&riff, 1, sizeof(riff), fp_output) != sizeof(riff) ) {
-				printf("Can't write WAV file riff header. Exit.\n");
-				goto EXIT;
-			}
-			if( fwrite(&fmt_header, 1, sizeof(fmt_header), fp_output) != sizeof(fmt_header) ) {
-				printf("Can't write WAV file chunk header. Exit.\n");
-				goto EXIT;
-			}
-			if( fwrite(&fmt_body, 1, fmt_header.size, fp_output) != fmt_header.size ) {
-				printf("Can't write WAV file chunk body. Exit.\n");
-				goto EXIT;
-			}
-			if( fwrite(&data_header, 1, sizeof(data_header), fp_output) != sizeof(data_header) ) {
-				printf("Can't write WAV file data chunk. Exit.\n");
-				goto EXIT;
-			}
-			if( fwrite(raw_dump, fmt_body.block_align, block_numbers, fp_output) != block_numbers ) {
-				printf("Can't write WAV file pcm data. Exit.\n");
-				goto EXIT;
-			}
-			printf("Done. WAV file writing in %s .\n", filename);
 		}
 	}
 
 EXIT:
+	peak_index_release(&gPeakIndex);
+	npy_export_release(&gNpyExport);
+	compMethod = comp_param;
+	for( uint8_t k=1; k<sweep_num; k++ ) {
+		bufpool_free(&gBufPool, sweep_dump[k]);
+	}
 	if( raw_dump != NULL ) {
-		free(raw_dump);
+		bufpool_free(&gBufPool, raw_dump);
 		raw_dump=NULL;
 	}
+	if( gPlanarCache.map != NULL ) {
+		single_channel_dump = NULL; // mapped, not from the pool
+	}
+	pcache_close(&gPlanarCache);
 	if( single_channel_dump != NULL ) {
-		free(single_channel_dump);
+		bufpool_free(&gBufPool, single_channel_dump);
 		single_channel_dump=NULL;
 	}
 	if( fp_pcm_data != NULL ) {
-		fclose(fp_pcm_data);
+		aio_fclose_write(fp_pcm_data);
 		fp_pcm_data = NULL;
 	}
 	if( fp_single_output != NULL ) {
-		fclose(fp_single_output);
+		aio_fclose_write(fp_single_output);
 		fp_single_output = NULL;
 	}
 	if( fp_output != NULL ) {
-		fclose(fp_output);
+		aio_fclose_write(fp_output);
 		fp_output = NULL;
 	}
 	if( fp != NULL ) {
-		fclose(fp);
+		aio_fclose_read(fp);
 		fp = NULL;
 	}
 
 	return 0;
 }
 
+/**
+ * @brief
+ * queue the read of the input file idx, so it is loaded while the current file is processed
+ */
+void prefetch_input_file(uint8_t idx) {
+	char name[sizeof(filename)];
+	if( idx < process_file_start || idx > process_file_end ) {
+		return;
+	}
+	sprintf(name, "input/%s/%s.wav", InputFileFolder[idx], InputFileName[idx]);
+	aio_prefetch(name);
+}
+
+#ifndef WFP_PYTHON_MODULE
 int main(void) {
-	for(gFileSelection=process_file_start; gFileSelection<=process_file_end; gFileSelection++) {
-		single_file_processing();
+	int ret;
+	uint8_t server_fail = 0;
+	uint8_t catalog_fail = 0;
+	dsp_kernel_init(gSimdIsaForce);
+	g711codec_init();
+	bufpool_init(&gBufPool);
+	aio_init((gAsyncIoEnable != 0) ? gAsyncIoThreads : 0);
+	pcache_init(&gPlanarCache, gPlanarCacheFolder);
+	printf("-----[ run report ]-----\n");
+	printf("file i/o : %s\n", aio_backend_name());
+	printf("simd : %s%s (cpu %s)\n", simdisa_name[gDspKernel.isa], gDspKernel.forced ? " forced" : "", simdisa_name[gDspKernel.isa_cpu]);
+	printf("run mode : %s\n", runmode_name[gRunMode]);
+	if( gRunMode == RUNMODE_KERNEL_CHECK ) {
+		kcheck_run(&gKernelCheck);
+	}
+	if( gRunMode == RUNMODE_SERVER ) {
+		server_fail = ( plcsrv_run(gServerSocket, gServerWorkers, gServerPinCpu, gServerIdleUs) != 0 ) ? 1 : 0;
+	} else if( gRunMode == RUNMODE_CATALOG ) {
+		catalog_fail = ( catalog_run(gCatalogRoot, gCatalogThreads, gCatalogFile, gCatalogJson) != 0 ) ? 1 : 0;
+	} else {
+		prefetch_input_file(process_file_start);
+		for(gFileSelection=process_file_start; gFileSelection<=process_file_end; gFileSelection++) {
+			prefetch_input_file(gFileSelection + 1);
+			single_file_processing();
+		}
+	}
+	if( aio_drain() != 0 ) {
+		printf("Some output files were not written.\n");
 	}
-}
\ No newline at end of file
+	aio_exit();
+	if( gPlanarCacheEnable != 0 ) {
+		printf("planar cache : %u hit, %u stored\n", gPlanarCache.hit_cnt, gPlanarCache.store_cnt);
+	}
+	jitter_report(&gJitterBuffer.total, "total", 1);
+	vad_report(&gVad.total, "total");
+	for( uint8_t s=0; s<STAGE_MAX; s++ ) {
+		if( gStageMemo.result[s].reuse_cnt != 0 ) {
+			printf("stage %s : %u run, %u reused\n", stage_name[s], gStageMemo.result[s].run_cnt, gStageMemo.result[s].reuse_cnt);
+		}
+	}
+	resampler_release_all();
+	jitter_release(&gJitterBuffer);
+	vad_release(&gVad);
+	fft_release_all();
+	interp_release_all();
+	lostgap_release(&gLostGap);
+	stage_release(&gStageMemo);
+	if( gRunMode == RUNMODE_KERNEL_CHECK ) {
+		kcheck_report(&gKernelCheck);
+	}
+	bufpool_show_stats(&gBufPool);
+	bufpool_destroy(&gBufPool);
+	ret = ( gKernelCheck.fail_cnt != 0 || server_fail != 0 || catalog_fail != 0 ) ? 1 : 0;
+	kcheck_release(&gKernelCheck);
+	return ret;
+}
+#endif
@@ -0,0 +1,15 @@
+#ifndef _MAIN_H_
+#define _MAIN_H_
+
+#include "arch.h"
+
+// processing flow of main.cpp, shared with the python module (built with WFP_PYTHON_MODULE, no main())
+
+int wav_read_file(char *name);
+uint64_t Model_LostKey(uint64_t parent);
+void Model_DataLost(void);
+void Model_Compensation(void);
+void Model_DataLostAndCompensation(void);
+int single_file_processing(void);
+
+#endif
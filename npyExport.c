@@ -0,0 +1,143 @@
+/**
+ * @file npyExport.c
+ * @author weiyuan.hsu
+ * @brief
+ * implement of the planar numpy export of the golden, lost and concealed signals
+ *
+ * npy_export_init: ........ Size the file image of a channel, the npy header padded with spaces to NPY_ALIGN
+ * 							 bytes and three rows of samples, the rows of signals never added stay zero.
+ *
+ * npy_export_add: ......... Convert one signal into its row. float32 goes through pcm_to_float(), straight into
+ * 							 the image (the gDspKernel.unpack path for a planar channel), int32 shifts the
+ * 							 samples to the top of the word. The source may be interleaved (stride).
+ *
+ * npy_export_write: ....... One write of the image, through the write behind of asyncIo when it is enabled.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arch.h"
+#include "config.h"
+#include "utility.h"
+#include "peakIndex.h"
+#include "npyExport.h"
+#include "bufferPool.h"
+#include "asyncIo.h"
+
+/*-------------------- CONFIGURATION --------------------*/
+#define NPY_MAGIC_LEN (10) /* "\x93NUMPY", version 1.0, uint16_t length of the dictionary */
+
+/*-------------------- GLOBAL PARAMETER --------------------*/
+npy_export_c gNpyExport;
+
+/*-------------------- INTERNAL FUNCTIONS --------------------*/
+static void npy_to_int32(uint8_t *pBuf, uint16_t bit_per_sample, uint32_t stride, sint32_t *pOut, uint32_t num) {
+	uint32_t i;
+	for( i=0; i<num; i++, pBuf+=stride ) {
+		if( bit_per_sample == 8 ) {
+			pOut[i] = (sint32_t)((uint32_t)((sint32_t)pBuf[0] - 128) << 24);
+		} else if( bit_per_sample == 16 ) {
+			pOut[i] = (sint32_t)((uint32_t)(*(sint16_t *)pBuf) << 16);
+		} else if( bit_per_sample == 24 ) {
+			pOut[i] = (sint32_t)((uint32_t)b24_signed_to_b32_signed(pBuf) << 8);
+		} else {
+			pOut[i] = *(sint32_t *)pBuf;
+		}
+	}
+}
+
+/*-------------------- FUNCTIONS --------------------*/
+/**
+ * @brief
+ * take the file image of a channel from gBufPool and write its header
+ * @return sint32_t : 0 success, -1 fail
+ */
+sint32_t npy_export_init(npy_export_c *np, uint8_t dtype, uint16_t bit_per_sample, uint32_t samples) {
+	char dict[NPY_ALIGN * 2];
+	size_t size;
+	uint32_t len;
+
+	memset(np, 0x0, sizeof(npy_export_c));
+	if( samples == 0 || dtype >= NPYTYPE_MAX ) {
+		return -1;
+	}
+	np->dtype = dtype;
+	np->bit_per_sample = bit_per_sample;
+	np->samples = samples;
+
+	/* the dictionary ends with '\n', padded so the data starts at a multiple of NPY_ALIGN */
+	len = (uint32_t)snprintf(dict, sizeof(dict), "{'descr': '%s', 'fortran_order': False, 'shape': (%d, %u), }",
+		( dtype == NPYTYPE_FLOAT32 ) ? "<f4" : "<i4", PEAK_SIGNAL_MAX, samples);
+	np->header = (NPY_MAGIC_LEN + len + 1 + NPY_ALIGN - 1) / NPY_ALIGN * NPY_ALIGN;
+
+	size = np->header + (size_t)PEAK_SIGNAL_MAX * samples * 4;
+	np->image = (uint8_t *)bufpool_calloc(&gBufPool, size);
+	if( np->image == NULL ) {
+		printf("Allocation memory error");
+		memset(np, 0x0, sizeof(npy_export_c));
+		return -1;
+	}
+	memcpy(np->image, "\x93NUMPY\x01\x00", 8);
+	np->image[8] = (uint8_t)((np->header - NPY_MAGIC_LEN) & 0xff);
+	np->image[9] = (uint8_t)((np->header - NPY_MAGIC_LEN) >> 8);
+	memcpy(np->image + NPY_MAGIC_LEN, dict, len);
+	memset(np->image + NPY_MAGIC_LEN + len, ' ', np->header - NPY_MAGIC_LEN - len - 1);
+	np->image[np->header - 1] = '\n';
+	return 0;
+}
+
+/**
+ * @brief
+ * convert one signal into its row
+ * @param pBuf : first sample of the channel
+ * @param stride : bytes between two samples, block_align when pBuf is interleaved
+ */
+void npy_export_add(npy_export_c *np, uint8_t signal, uint8_t *pBuf, uint32_t stride) {
+	uint8_t *pRow;
+
+	if( np->image == NULL || signal >= PEAK_SIGNAL_MAX ) {
+		return;
+	}
+	pRow = np->image + np->header + (size_t)signal * np->samples * 4;
+	if( np->dtype == NPYTYPE_FLOAT32 ) {
+		pcm_to_float(pBuf, np->bit_per_sample, stride, (float *)pRow, np->samples);
+	} else {
+		npy_to_int32(pBuf, np->bit_per_sample, stride, (sint32_t *)pRow, np->samples);
+	}
+}
+
+/**
+ * @brief
+ * write the image of the channel
+ * @return sint32_t : 0 success, -1 fail
+ */
+sint32_t npy_export_write(npy_export_c *np, char *name) {
+	size_t size = np->header + (size_t)PEAK_SIGNAL_MAX * np->samples * 4;
+	FILE *fp_npy = NULL;
+	sint32_t ret = 0;
+
+	if( np->image == NULL ) {
+		return -1;
+	}
+	if( (fp_npy = aio_fopen_write(name)) == NULL ) {
+		printf("Can't open the npy file for write.\n");
+		return -1;
+	}
+	if( fwrite(np->image, 1, size, fp_npy) != size ) {
+		printf("Can't write npy file.\n");
+		ret = -1;
+	} else {
+		printf("Done. npy writing in %s .\n", name);
+	}
+	aio_fclose_write(fp_npy);
+	return ret;
+}
+
+void npy_export_release(npy_export_c *np) {
+	bufpool_free(&gBufPool, np->image);
+	memset(np, 0x0, sizeof(npy_export_c));
+}
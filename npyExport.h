@@ -0,0 +1,33 @@
+#ifndef _H_NPYEXPORT_
+#define _H_NPYEXPORT_
+
+#include "arch.h"
+
+// golden, lost and concealed signals of a channel as one numpy array of shape (3, samples) in C order, the row of
+// a signal is its PEAK_SIGNAL_* index, so np.load(name, mmap_mode='r')[1] maps the lost signal without a copy.
+// NPYTYPE_FLOAT32 : pcm_to_float() scale, full scale is 1.0 for every bit depth
+// NPYTYPE_INT32 : the samples left justified to 32 bits (8 bit is centered first), exact for every bit depth
+// the header is padded to NPY_ALIGN bytes (npy format 1.0), the data starts aligned in the mapped file and a plain
+// reader can skip header bytes and read raw little endian samples. Row k starts k * samples * 4 bytes later, it
+// is only aligned when samples is a multiple of NPY_ALIGN / 4
+
+/*-------------------- CONFIGURATION --------------------*/
+#define NPY_ALIGN (64)
+
+typedef struct _npy_export_c {
+	uint8_t dtype;				/* NPYTYPE_FLOAT32, NPYTYPE_INT32 */
+	uint16_t bit_per_sample;	/* of the channel */
+	uint32_t samples;
+	uint32_t header;			/* bytes before the data, a multiple of NPY_ALIGN */
+	uint8_t *image;				/* whole file, header and the rows */
+} npy_export_c;
+
+extern npy_export_c gNpyExport; /* array of the channel in process, see single_file_processing() */
+
+/*-------------------- FUNCTIONS --------------------*/
+sint32_t npy_export_init(npy_export_c *np, uint8_t dtype, uint16_t bit_per_sample, uint32_t samples); /* 0 success, -1 fail */
+void npy_export_add(npy_export_c *np, uint8_t signal, uint8_t *pBuf, uint32_t stride); /* signal : PEAK_SIGNAL_*, stride : bytes between two samples */
+sint32_t npy_export_write(npy_export_c *np, char *name); /* 0 success, -1 fail */
+void npy_export_release(npy_export_c *np);
+
+#endif
@@ -9,6 +9,9 @@
 #include "config.h"
 
 // -------------------------------------------------- global parameter --------------------------------------------------
+// run mode
+uint8_t gRunMode = RUNMODE_PROCESS; // RUNMODE_PROCESS: data lost / compensation of the input files, RUNMODE_KERNEL_CHECK: compare the optimized kernels with the scalar reference on generated signals and the input channels, nothing is written, RUNMODE_SERVER: conceal the frames of other processes, see plcServer.h, until SIGINT / SIGTERM, RUNMODE_CATALOG: header only index of the wav files under gCatalogRoot, see catalog.h
+
 // flow control
 uint8_t gFlow_dump_original_wav = 0; // re-package the output the original data, should be the same as original wav file
 uint8_t gFlow_dump_modified = 1; // generate the wav file with processed pcm data
@@ -16,6 +19,10 @@ uint8_t gFlow_dump_raw_pcm = 0; // dump the processed pcm data
 uint8_t gFlow_dump_single_channel_header = 0; // 0: standard header, 1: extened header
 uint8_t gFlow_dump_single_channel = 1; // 0: disable , 1: dump first channel, 2: dump all channels
 uint8_t gFlow_dump_single_channel_pcm = 0; // 0: disable , 1: dump first channel, 2: dump all channels
+uint8_t gFlow_dump_single_channel_g711 = 0; // 0: disable , 1: dump first channel, 2: dump all channels, encoded with g711CodecLaw
+uint8_t gFlow_dump_peak_index = 0; // 0: disable , 1: first channel, 2: all channels, golden / lost / concealed min-max-rms pyramid sidecar for the plot scripts
+uint8_t gFlow_dump_npy = 0; // 0: disable , 1: first channel, 2: all channels, golden / lost / concealed planar .npy of gNpyType, see npyExport.h
+uint8_t gNpyType = NPYTYPE_FLOAT32; // NPYTYPE_FLOAT32: full scale 1.0, NPYTYPE_INT32: samples left justified to 32 bits
 
 // file
 char gDebugString[256];
@@ -39,17 +46,70 @@ data_chunk data_single_header = { {'d','a','t','a'} };
 
 uint8_t *raw_dump;
 uint8_t *single_channel_dump;
+uint8_t *lost_channel_dump = NULL; // when set, the channel is copied here between the data lost and the compensation
 uint32_t single_channel_size;
 uint32_t sample_size_per_group;
 
 // data lost and compensation
 uint8_t lostRandomOffsetEnable = 0; // 0:disable, 1:enable
 uint32_t randomOffsetMax = 200; // unit : samples
-uint8_t lostMethod = LOSTTYPE_INTERLEAVE; // LOSTTYPE_NONE, LOSTTYPE_CONTINUOUS, LOSTTYPE_INTERLEAVE
+uint8_t lostMethod = LOSTTYPE_INTERLEAVE; // LOSTTYPE_NONE, LOSTTYPE_CONTINUOUS, LOSTTYPE_INTERLEAVE, LOSTTYPE_CONTINUOUS_FRAME, LOSTTYPE_JITTER_FRAME
 uint16_t Manual_lost_sample_ratio = 256;
 uint16_t Manual_lost_period_ratio = 32;
 uint16_t Manual_lost_start_sample = 15;
-uint8_t compMethod = COMPTYPE_NONE; // COMPTYPE_NONE, COMPTYPE_INNER_INTERPLOATION
+uint8_t compMethod = COMPTYPE_NONE; // COMPTYPE_NONE, COMPTYPE_INNER_INTERPLOATION, COMPTYPE_G711_VOIP, COMPTYPE_SPECTRAL, COMPTYPE_AR_BURG, COMPTYPE_CUBIC, COMPTYPE_SINC, COMPTYPE_WSOLA
+uint8_t g711CodecLaw = G711LAW_NONE; // G711LAW_NONE, G711LAW_ALAW, G711LAW_MULAW : pass single channel through the codec before data lost (16 bit only)
+uint8_t gCompSweepNum = 0; // 0: compMethod only, N: conceal each data lost pass with the first N of gCompSweep, outputs are suffixed with the compensation name
+uint8_t gCompSweep[COMPTYPE_MAX] = { COMPTYPE_INNER_INTERPLOATION, COMPTYPE_SPECTRAL, COMPTYPE_AR_BURG, COMPTYPE_CUBIC, COMPTYPE_SINC }; // each type at most once, COMPTYPE_G711_VOIP needs LOSTTYPE_CONTINUOUS_FRAME or LOSTTYPE_JITTER_FRAME
+
+// jitter buffer, LOSTTYPE_JITTER_FRAME
+char gJitterTrace[128] = ""; // packet arrival trace, lines of "<send ms> <arrival ms>" (arrival < 0 : lost), "": synthetic trace of gJitterSeed, see jitterBuffer.h
+uint32_t gJitterSeed = 1; // seed of the synthetic trace
+uint8_t gJitterPolicy = JBTYPE_ADAPTIVE; // JBTYPE_FIXED: play every packet gJitterDelayMs after it was sent, JBTYPE_ADAPTIVE: start at gJitterDelayMs and follow the delay of the trace
+uint32_t gJitterDelayMs = 60; // playout delay, unit : ms
+uint32_t gJitterAdaptFrames = 100; // frames between two playout delay changes of JBTYPE_ADAPTIVE
+
+// sample rate
+uint32_t gResampleTargetRate = 0; // 0: disable, others: resample every input file to this rate before channel separation
+
+// channel mixing
+uint8_t gFlow_dump_downmix = MIXTYPE_NONE; // MIXTYPE_NONE, MIXTYPE_STEREO, MIXTYPE_MONO, MIXTYPE_REMAP : mix the processed channels in the same pass
+uint8_t gMixRemapChannels = 2; // output channels of MIXTYPE_REMAP
+uint8_t gMixRemapSpeaker[SPEAKER_NUM_MAX] = { SPEAKER_FRONT_RIGHT, SPEAKER_FRONT_LEFT }; // input speaker of each output channel for MIXTYPE_REMAP
+
+// file i/o
+uint8_t gAsyncIoEnable = 0; // 0: blocking stdio, 1: read the next input file ahead and write outputs behind on I/O threads
+uint8_t gAsyncIoThreads = 2; // number of I/O threads when gAsyncIoEnable, up to AIO_THREAD_MAX
+uint8_t gPlanarCacheEnable = 0; // 0: disable, 1: map the decoded planar channels of an input seen before from gPlanarCacheFolder, keyed by the file content (not used with gFlow_dump_raw_pcm / gFlow_dump_original_wav)
+char gPlanarCacheFolder[64] = "cache"; // entries are <content hash>_<gResampleTargetRate>.planar
+
+// dsp kernels
+uint8_t gSimdIsaForce = SIMDISA_AUTO; // SIMDISA_AUTO: best of the cpu, SIMDISA_SCALAR, SIMDISA_SSE2, SIMDISA_AVX2, SIMDISA_AVX512: force (lowered to the cpu)
+
+// plc server
+char gServerSocket[108] = "/tmp/wavparser_plc.sock"; // unix socket of RUNMODE_SERVER
+uint8_t gServerWorkers = 2; // worker threads, up to PLCSRV_WORKER_MAX, session s is served by worker s % gServerWorkers
+uint8_t gServerPinCpu = 1; // 0: scheduled by the os, 1: pin worker i to cpu i
+uint32_t gServerIdleUs = 50; // sleep of a worker without frames to conceal, the latency of the first frame after a pause
+
+// pipeline
+uint8_t gPipelineEnable = 0; // 0: read, split, data lost / compensation and write of a file in sequence, 1: each phase on its own thread, see pipeline.h (RUNMODE_PROCESS only)
+uint32_t gPipelineBlockFrames = 65536; // frames of a read / split batch
+uint8_t gPipelineDepth = 2; // concealed channels in flight to the writer, up to PIPE_QUEUE_SIZE
+
+// g711 plc
+uint8_t gPlcSegmentThreads = 1; // 1: conceal a channel in one pass, N: cut it into up to N segments concealed on their own threads, up to G711_SEG_THREAD_MAX
+uint32_t gPlcSegmentMinFrames = 3000; // shortest segment, unit : 10 ms frames, shorter channels use fewer segments
+
+// catalog, RUNMODE_CATALOG
+char gCatalogRoot[128] = "input"; // directory tree of the wav files
+uint8_t gCatalogThreads = 4; // header reader threads, up to CATALOG_THREAD_MAX
+char gCatalogFile[128] = "output/catalog"; // index, <name>.bin and <name>.json
+uint8_t gCatalogJson = 1; // 0: binary index only, 1: also the JSON index
+
+// activity detection
+uint8_t gVadEnable = 0; // 0: conceal every gap, 1: fill the gaps whose context is silent with comfort noise instead of concealing them, see vad.h
+sint32_t gVadThresholdDb = -50; // level of silence, unit : dB of full scale
 
 // other information
 uint32_t block_numbers = 0;
@@ -5,6 +5,9 @@
 #include "wave.h"
 #include "wave_type.h"
 
+// run mode
+extern uint8_t gRunMode;
+
 // flow control
 extern uint8_t gFlow_dump_original_wav;
 extern uint8_t gFlow_dump_modified;
@@ -12,6 +15,10 @@ extern uint8_t gFlow_dump_raw_pcm;
 extern uint8_t gFlow_dump_single_channel_header;
 extern uint8_t gFlow_dump_single_channel;
 extern uint8_t gFlow_dump_single_channel_pcm;
+extern uint8_t gFlow_dump_single_channel_g711;
+extern uint8_t gFlow_dump_peak_index;
+extern uint8_t gFlow_dump_npy;
+extern uint8_t gNpyType;
 
 // file
 extern char gDebugString[256];
@@ -35,6 +42,7 @@ extern data_chunk data_single_header;
 
 extern uint8_t *raw_dump;
 extern uint8_t *single_channel_dump;
+extern uint8_t *lost_channel_dump;
 extern uint32_t single_channel_size;
 extern uint32_t sample_size_per_group;
 
@@ -46,6 +54,58 @@ extern uint16_t Manual_lost_sample_ratio;
 extern uint16_t Manual_lost_period_ratio;
 extern uint16_t Manual_lost_start_sample;
 extern uint8_t compMethod;
+extern uint8_t g711CodecLaw;
+extern uint8_t gCompSweepNum;
+extern uint8_t gCompSweep[];
+
+// jitter buffer
+extern char gJitterTrace[128];
+extern uint32_t gJitterSeed;
+extern uint8_t gJitterPolicy;
+extern uint32_t gJitterDelayMs;
+extern uint32_t gJitterAdaptFrames;
+
+// sample rate
+extern uint32_t gResampleTargetRate;
+
+// channel mixing
+extern uint8_t gFlow_dump_downmix;
+extern uint8_t gMixRemapChannels;
+extern uint8_t gMixRemapSpeaker[SPEAKER_NUM_MAX];
+
+// file i/o
+extern uint8_t gAsyncIoEnable;
+extern uint8_t gAsyncIoThreads;
+extern uint8_t gPlanarCacheEnable;
+extern char gPlanarCacheFolder[64];
+
+// dsp kernels
+extern uint8_t gSimdIsaForce;
+
+// plc server
+extern char gServerSocket[108];
+extern uint8_t gServerWorkers;
+extern uint8_t gServerPinCpu;
+extern uint32_t gServerIdleUs;
+
+// pipeline
+extern uint8_t gPipelineEnable;
+extern uint32_t gPipelineBlockFrames;
+extern uint8_t gPipelineDepth;
+
+// g711 plc
+extern uint8_t gPlcSegmentThreads;
+extern uint32_t gPlcSegmentMinFrames;
+
+// catalog
+extern char gCatalogRoot[128];
+extern uint8_t gCatalogThreads;
+extern char gCatalogFile[128];
+extern uint8_t gCatalogJson;
+
+// activity detection
+extern uint8_t gVadEnable;
+extern sint32_t gVadThresholdDb;
 
 // other information
 extern uint32_t block_numbers;
@@ -0,0 +1,213 @@
+/**
+ * @file peakIndex.c
+ * @author weiyuan.hsu
+ * @brief
+ * implement of the min / max / rms pyramid sidecar
+ *
+ * peak_index_init: ........ Size the pyramid of a channel, level 0 has one entry per PEAK_BASE_BLOCK samples
+ * 							 and every next level is PEAK_RATIO times coarser, down to a single entry.
+ *
+ * peak_index_add: ......... One pass over the samples of a signal. A block is converted to float in a small
+ * 							 scratch and reduced to min / max / sum of squares with AVX2/SSE2 while it is
+ * 							 still in L1, the source may be interleaved (stride), so the golden signal is
+ * 							 taken straight from the wav data. The upper levels are reduced from level 0,
+ * 							 rms is merged as mean square so it is exact at every level.
+ *
+ * peak_index_write: ....... Write golden, lost and concealed pyramids into one sidecar, a plot at any zoom
+ * 							 picks the level with about one entry per pixel and reads only that slice.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "arch.h"
+#include "config.h"
+#include "utility.h"
+#include "peakIndex.h"
+#include "bufferPool.h"
+#include "asyncIo.h"
+#include "dspKernel.h"
+
+/*-------------------- GLOBAL PARAMETER --------------------*/
+peak_index_c gPeakIndex;
+
+char peak_signal_name[PEAK_SIGNAL_MAX][32] = {
+	"GOLDEN",
+	"LOST",
+	"CONCEALED",
+};
+
+/*-------------------- INTERNAL FUNCTIONS --------------------*/
+static inline sint16_t peak_quantize(float v) {
+	float q = v * 32767.0f;
+	q = (q >= 0.0f) ? q + 0.5f : q - 0.5f;
+	if( q > 32767.0f ) {
+		return 32767;
+	} else if( q < -32768.0f ) {
+		return -32768;
+	}
+	return (sint16_t)q;
+}
+
+static void peak_store_level(peak_entry_c *pOut, float *work, uint32_t count) {
+	uint32_t i;
+	for( i=0; i<count; i++ ) {
+		pOut[i].min = peak_quantize(work[3*i+0]);
+		pOut[i].max = peak_quantize(work[3*i+1]);
+		pOut[i].rms = peak_quantize(sqrtf(work[3*i+2]));
+	}
+}
+
+/*-------------------- FUNCTIONS --------------------*/
+/**
+ * @brief
+ * size the pyramid for a channel of samples and take the buffers from gBufPool
+ * @return sint32_t : 0 success, -1 fail
+ */
+sint32_t peak_index_init(peak_index_c *pk, uint32_t sample_rate, uint16_t bit_per_sample, uint32_t samples) {
+	uint32_t count;
+	uint8_t s;
+	bool fail;
+
+	memset(pk, 0x0, sizeof(peak_index_c));
+	if( samples == 0 ) {
+		return -1;
+	}
+	pk->sample_rate = sample_rate;
+	pk->bit_per_sample = bit_per_sample;
+	pk->samples = samples;
+
+	count = (samples + PEAK_BASE_BLOCK - 1) / PEAK_BASE_BLOCK;
+	while( pk->levels < PEAK_LEVEL_MAX ) {
+		pk->count[pk->levels++] = count;
+		pk->total += count;
+		if( count == 1 ) {
+			break;
+		}
+		count = (count + PEAK_RATIO - 1) / PEAK_RATIO;
+	}
+
+	pk->work = (float *)bufpool_alloc(&gBufPool, sizeof(float) * 3 * pk->count[0]);
+	fail = (pk->work == NULL);
+	for( s=0; s<PEAK_SIGNAL_MAX; s++ ) {
+		pk->entry[s] = (peak_entry_c *)bufpool_calloc(&gBufPool, sizeof(peak_entry_c) * pk->total);
+		fail = fail || (pk->entry[s] == NULL);
+	}
+	if( fail ) {
+		printf("Allocation memory error");
+		peak_index_release(pk);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ * build every level of one signal
+ * @param pBuf : first sample of the channel
+ * @param stride : bytes between two samples, block_align when pBuf is interleaved
+ */
+void peak_index_add(peak_index_c *pk, uint8_t signal, uint8_t *pBuf, uint32_t stride) {
+	float block[PEAK_BASE_BLOCK];
+	peak_entry_c *pOut;
+	uint64_t span;
+	uint32_t i, l, n;
+
+	if( pk->total == 0 || signal >= PEAK_SIGNAL_MAX ) {
+		return;
+	}
+
+	/* level 0, one pass over the samples */
+	for( i=0; i<pk->count[0]; i++ ) {
+		uint32_t sta = i * PEAK_BASE_BLOCK;
+		n = (pk->samples - sta > PEAK_BASE_BLOCK) ? PEAK_BASE_BLOCK : pk->samples - sta;
+		pcm_to_float(pBuf + (size_t)sta * stride, pk->bit_per_sample, stride, block, n);
+		gDspKernel.reduce(block, n, &pk->work[3*i+0], &pk->work[3*i+1], &pk->work[3*i+2]);
+		pk->work[3*i+2] /= n;
+	}
+	pOut = pk->entry[signal];
+	peak_store_level(pOut, pk->work, pk->count[0]);
+
+	/* upper levels, reduced in place from the level below */
+	span = PEAK_BASE_BLOCK;
+	for( l=1; l<pk->levels; l++ ) {
+		uint32_t below = pk->count[l-1];
+		pOut += below;
+		for( i=0; i<pk->count[l]; i++ ) {
+			uint32_t j, sta = i * PEAK_RATIO;
+			uint32_t end = (sta + PEAK_RATIO > below) ? below : sta + PEAK_RATIO;
+			float vmin = pk->work[3*sta+0], vmax = pk->work[3*sta+1];
+			double ms = 0.0, weight = 0.0;
+			for( j=sta; j<end; j++ ) {
+				/* the last entry of a level covers less samples */
+				uint64_t left = pk->samples - (uint64_t)j * span;
+				double w = (double)((left > span) ? span : left);
+				vmin = (pk->work[3*j+0] < vmin) ? pk->work[3*j+0] : vmin;
+				vmax = (pk->work[3*j+1] > vmax) ? pk->work[3*j+1] : vmax;
+				ms += pk->work[3*j+2] * w;
+				weight += w;
+			}
+			pk->work[3*i+0] = vmin;
+			pk->work[3*i+1] = vmax;
+			pk->work[3*i+2] = (float)(ms / weight);
+		}
+		peak_store_level(pOut, pk->work, pk->count[l]);
+		span *= PEAK_RATIO;
+	}
+}
+
+/**
+ * @brief
+ * write the sidecar of the three signals, a signal never added is all zero
+ * @return sint32_t : 0 success, -1 fail
+ */
+sint32_t peak_index_write(peak_index_c *pk, char *name) {
+	peak_file_header header = { {'P','E','A','K'}, PEAK_VERSION, PEAK_SIGNAL_MAX };
+	FILE *fp_peak = NULL;
+	sint32_t ret = 0;
+	uint8_t s;
+
+	if( pk->total == 0 ) {
+		return -1;
+	}
+	header.sample_rate = pk->sample_rate;
+	header.samples = pk->samples;
+	header.bit_per_sample = pk->bit_per_sample;
+	header.levels = pk->levels;
+	header.base_block = PEAK_BASE_BLOCK;
+	header.ratio = PEAK_RATIO;
+
+	if( (fp_peak = aio_fopen_write(name)) == NULL ) {
+		printf("Can't open the peak index file for write.\n");
+		return -1;
+	}
+	if( fwrite(&header, 1, sizeof(header), fp_peak) != sizeof(header) ||
+		fwrite(pk->count, sizeof(uint32_t), pk->levels, fp_peak) != pk->levels ) {
+		ret = -1;
+	}
+	for( s=0; s<PEAK_SIGNAL_MAX && ret == 0; s++ ) {
+		if( fwrite(pk->entry[s], sizeof(peak_entry_c), pk->total, fp_peak) != pk->total ) {
+			ret = -1;
+		}
+	}
+	if( ret != 0 ) {
+		printf("Can't write peak index file.\n");
+	} else {
+		printf("Done. Peak index writing in %s .\n", name);
+	}
+	aio_fclose_write(fp_peak);
+	return ret;
+}
+
+void peak_index_release(peak_index_c *pk) {
+	uint8_t s;
+	bufpool_free(&gBufPool, pk->work);
+	for( s=0; s<PEAK_SIGNAL_MAX; s++ ) {
+		bufpool_free(&gBufPool, pk->entry[s]);
+	}
+	memset(pk, 0x0, sizeof(peak_index_c));
+}
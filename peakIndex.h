@@ -0,0 +1,63 @@
+#ifndef _H_PEAKINDEX_
+#define _H_PEAKINDEX_
+
+#include "arch.h"
+
+// multi-resolution min / max / rms pyramid of a channel, written as a sidecar file for the plot scripts
+//
+// sidecar layout (little endian)
+// | peak_file_header | uint32_t count[levels] | signal 0 : level 0 .. level n | signal 1 : ... | signal 2 : ... |
+// each level is count[l] entries of peak_entry_c, entry i of level l covers samples [i, i+1) * base_block * ratio^l
+
+/*-------------------- CONFIGURATION --------------------*/
+#define PEAK_BASE_BLOCK (64) /* samples per entry of level 0 */
+#define PEAK_RATIO (4) /* entries of level l merged into one entry of level l+1 */
+#define PEAK_LEVEL_MAX (16)
+#define PEAK_VERSION (1)
+
+enum {
+	PEAK_SIGNAL_GOLDEN = 0,
+	PEAK_SIGNAL_LOST,
+	PEAK_SIGNAL_CONCEALED,
+	PEAK_SIGNAL_MAX,
+};
+
+typedef struct _peak_file_header {
+	char id[4];					/* "PEAK" */
+	uint16_t version;
+	uint16_t signals;
+	uint32_t sample_rate;
+	uint32_t samples;
+	uint16_t bit_per_sample;
+	uint16_t levels;
+	uint32_t base_block;
+	uint32_t ratio;
+} peak_file_header;
+
+typedef struct _peak_entry_c {
+	sint16_t min;				/* full scale is 32767 for every bit depth */
+	sint16_t max;
+	sint16_t rms;
+} peak_entry_c;
+
+typedef struct _peak_index_c {
+	uint32_t sample_rate;
+	uint32_t samples;
+	uint16_t bit_per_sample;
+	uint16_t levels;
+	uint32_t count[PEAK_LEVEL_MAX];
+	uint32_t total;				/* entries of all levels, per signal */
+	peak_entry_c *entry[PEAK_SIGNAL_MAX];
+	float *work;				/* min / max / mean square of the level being reduced */
+} peak_index_c;
+
+extern peak_index_c gPeakIndex; /* pyramid of the channel in process, see single_file_processing() */
+extern char peak_signal_name[PEAK_SIGNAL_MAX][32];
+
+/*-------------------- FUNCTIONS --------------------*/
+sint32_t peak_index_init(peak_index_c *pk, uint32_t sample_rate, uint16_t bit_per_sample, uint32_t samples);
+void peak_index_add(peak_index_c *pk, uint8_t signal, uint8_t *pBuf, uint32_t stride);
+sint32_t peak_index_write(peak_index_c *pk, char *name);
+void peak_index_release(peak_index_c *pk);
+
+#endif
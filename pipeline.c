@@ -0,0 +1,115 @@
+/**
+ * @file pipeline.c
+ * @author weiyuan.hsu
+ * @brief
+ * implement of the stage queues of the pipelined file processing, gPipelineEnable
+ *
+ * pipe_push / pipe_pop: ... Lock-free ring of PIPE_QUEUE_SIZE pointers between two threads. The producer
+ * 							 only writes head and the consumer only writes tail, each on its own cache line,
+ * 							 an item is published by the release store of head and given back by the release
+ * 							 store of tail. A full ring holds the producer, so a slow stage throttles the
+ * 							 stages in front of it instead of growing the memory in flight.
+ *
+ * waiting: ................ A stage polls PIPE_SPIN times (sched_yield) and then sleeps PIPE_IDLE_US between
+ * 							 polls, the time is counted in wait_ns of the stage.
+ *
+ * pipe_report: ............ Busy time of a stage is its run time less its waits, the file takes about the
+ * 							 busy time of the slowest stage when the pipeline is balanced.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include "arch.h"
+#include "config.h"
+#include "pipeline.h"
+
+/*-------------------- GLOBAL PARAMETER --------------------*/
+char pipe_stage_name[PIPE_STAGE_MAX][32] = {
+	"read",
+	"split",
+	"lost / compensation",
+	"write",
+};
+
+/*-------------------- INTERNAL FUNCTIONS --------------------*/
+static void pipe_wait(uint32_t *spin) {
+	if( *spin < PIPE_SPIN ) {
+		(*spin)++;
+		sched_yield();
+	} else {
+		usleep(PIPE_IDLE_US);
+	}
+}
+
+/*-------------------- FUNCTIONS --------------------*/
+uint64_t pipe_time_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void pipe_queue_init(pipe_queue_c *q) {
+	memset(q, 0x0, sizeof(pipe_queue_c));
+}
+
+void pipe_push(pipe_queue_c *q, void *item, pipe_stage_c *stage) {
+	uint32_t head = q->head;
+	uint32_t spin = 0;
+	uint64_t t0 = 0;
+
+	if( head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) >= PIPE_QUEUE_SIZE ) {
+		t0 = pipe_time_ns();
+		stage->stalls++;
+		while( head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) >= PIPE_QUEUE_SIZE ) {
+			pipe_wait(&spin);
+		}
+		stage->wait_ns += pipe_time_ns() - t0;
+	}
+	q->item[head & (PIPE_QUEUE_SIZE - 1)] = item;
+	__atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+	if( item != NULL ) {
+		stage->batches++;
+	}
+}
+
+void *pipe_pop(pipe_queue_c *q, pipe_stage_c *stage) {
+	uint32_t tail = q->tail;
+	uint32_t spin = 0;
+	uint64_t t0 = 0;
+	void *item;
+
+	if( __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) == tail ) {
+		t0 = pipe_time_ns();
+		while( __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) == tail ) {
+			pipe_wait(&spin);
+		}
+		stage->wait_ns += pipe_time_ns() - t0;
+	}
+	item = q->item[tail & (PIPE_QUEUE_SIZE - 1)];
+	__atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+	return item;
+}
+
+void pipe_stage_begin(pipe_stage_c *stage) {
+	memset(stage, 0x0, sizeof(pipe_stage_c));
+	stage->t_start = pipe_time_ns();
+}
+
+void pipe_stage_end(pipe_stage_c *stage) {
+	uint64_t run = pipe_time_ns() - stage->t_start;
+	stage->busy_ns = ( run > stage->wait_ns ) ? run - stage->wait_ns : 0;
+}
+
+void pipe_report(pipe_stage_c *stage, uint64_t wall_ns) {
+	printf("-----[ pipeline ]-----\n");
+	for( uint8_t s=0; s<PIPE_STAGE_MAX; s++ ) {
+		printf("%-20s : busy %8.2f ms, wait %8.2f ms, %u batches, %u stalls\n", pipe_stage_name[s], stage[s].busy_ns / 1e6, stage[s].wait_ns / 1e6, stage[s].batches, stage[s].stalls);
+	}
+	printf("%-20s : %8.2f ms\n", "file", wall_ns / 1e6);
+}
@@ -0,0 +1,52 @@
+#ifndef _H_PIPELINE_
+#define _H_PIPELINE_
+
+#include "arch.h"
+
+// stage threads of single_file_processing() when gPipelineEnable is set, the read, split, lost / compensation
+// and write phases of a file run at the same time and hand their batches forward through single producer /
+// single consumer queues. A full queue holds its producer (back-pressure), a stage only waits on its own queues
+
+/*-------------------- CONFIGURATION --------------------*/
+#define PIPE_QUEUE_SIZE (16) /* batches of a queue, power of 2 */
+#define PIPE_CACHELINE (64)
+#define PIPE_SPIN (256) /* polls (sched_yield) before a waiting stage sleeps */
+#define PIPE_IDLE_US (20)
+
+enum {
+	PIPE_STAGE_READ = 0,
+	PIPE_STAGE_SPLIT,
+	PIPE_STAGE_PROCESS,
+	PIPE_STAGE_WRITE,
+	PIPE_STAGE_MAX,
+};
+
+typedef struct _pipe_queue_c {
+	uint32_t head;				/* next item to push, producer only */
+	uint8_t pad0[PIPE_CACHELINE - 4];
+	uint32_t tail;				/* next item to pop, consumer only */
+	uint8_t pad1[PIPE_CACHELINE - 4];
+	void *item[PIPE_QUEUE_SIZE];
+} pipe_queue_c;
+
+typedef struct _pipe_stage_c {
+	uint64_t t_start;			/* CLOCK_MONOTONIC ns */
+	uint64_t busy_ns;			/* run time less the waits, set by pipe_stage_end() */
+	uint64_t wait_ns;			/* blocked on an empty input or a full output queue */
+	uint32_t batches;			/* items pushed, the end of file marker is not counted */
+	uint32_t stalls;			/* pushes held by a full queue */
+	uint8_t pad[PIPE_CACHELINE - 32];	/* written by the thread of the stage only */
+} pipe_stage_c;
+
+extern char pipe_stage_name[PIPE_STAGE_MAX][32];
+
+/*-------------------- FUNCTIONS --------------------*/
+uint64_t pipe_time_ns(void);
+void pipe_queue_init(pipe_queue_c *q);
+void pipe_push(pipe_queue_c *q, void *item, pipe_stage_c *stage); /* wait while the queue is full */
+void *pipe_pop(pipe_queue_c *q, pipe_stage_c *stage); /* wait while the queue is empty */
+void pipe_stage_begin(pipe_stage_c *stage);
+void pipe_stage_end(pipe_stage_c *stage);
+void pipe_report(pipe_stage_c *stage, uint64_t wall_ns); /* busy / wait time of every stage against the wall time of the file */
+
+#endif
@@ -0,0 +1,262 @@
+/**
+ * @file planarCache.c
+ * @author weiyuan.hsu
+ * @brief
+ * implement of the planar channel cache
+ *
+ * pcache_hash: ............ 64 bit xxHash of the input file, read through the FILE* of the parser so a
+ * 							 prefetched file is hashed from memory. The key is the content, a renamed or
+ * 							 copied file hits, an edited one misses.
+ *
+ * pcache_open: ............ Map the entry <folder>/<hash>_<rate>.planar. An entry of another layout
+ * 							 version, key or size (a cut write) is removed and stored again. The mapping
+ * 							 is private, the lost models and compensators write the mapped channels in
+ * 							 place and only the touched pages are copied, the file is never changed.
+ *
+ * pcache_store_*: ......... On a miss the channels are appended in the split pass of the parser, into a
+ * 							 temporary file renamed on the last channel, so a cut run never leaves an
+ * 							 entry the next run would map.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "arch.h"
+#include "config.h"
+#include "bufferPool.h"
+#include "planarCache.h"
+
+/*-------------------- GLOBAL PARAMETER --------------------*/
+pcache_c gPlanarCache;
+
+static const uint8_t pcache_zero[PCACHE_ALIGN] = { 0 };
+
+/*-------------------- INTERNAL FUNCTIONS --------------------*/
+#define PCACHE_P1 (11400714785092514177ULL)
+#define PCACHE_P2 (14029467366897019727ULL)
+#define PCACHE_P3 (1609587929392839161ULL)
+#define PCACHE_P4 (9650029242287828579ULL)
+#define PCACHE_P5 (2870177450012600261ULL)
+
+static inline uint64_t pcache_rotl(uint64_t x, uint32_t r) {
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t pcache_read64(const uint8_t *p) {
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t pcache_round(uint64_t acc, uint64_t v) {
+	acc += v * PCACHE_P2;
+	acc = pcache_rotl(acc, 31);
+	return acc * PCACHE_P1;
+}
+
+static inline uint64_t pcache_merge(uint64_t h, uint64_t v) {
+	h ^= pcache_round(0, v);
+	return h * PCACHE_P1 + PCACHE_P4;
+}
+
+static size_t pcache_head_size(void) {
+	return (sizeof(pcache_head_c) + PCACHE_ALIGN - 1) / PCACHE_ALIGN * PCACHE_ALIGN;
+}
+
+static void pcache_name(pcache_c *cache, uint64_t hash, uint32_t rate) {
+	snprintf(cache->path, sizeof(cache->path), "%s/%016llx_%u.planar", cache->folder, (unsigned long long)hash, rate);
+	snprintf(cache->path_tmp, sizeof(cache->path_tmp), "%s.tmp", cache->path);
+}
+
+/*-------------------- FUNCTIONS --------------------*/
+void pcache_init(pcache_c *cache, const char *folder) {
+	memset(cache, 0x0, sizeof(pcache_c));
+	snprintf(cache->folder, sizeof(cache->folder), "%s", folder);
+}
+
+uint64_t pcache_hash(FILE *fp) {
+	uint64_t v[4] = { PCACHE_P1 + PCACHE_P2, PCACHE_P2, 0, 0 - PCACHE_P1 };
+	uint64_t total = 0, h;
+	size_t left = 0, got;
+	uint8_t *buf = (uint8_t *)bufpool_alloc(&gBufPool, PCACHE_HASH_CHUNK);
+	const uint8_t *p;
+
+	if( buf == NULL ) {
+		return 0;
+	}
+	rewind(fp);
+	while( (got = fread(buf + left, 1, PCACHE_HASH_CHUNK - left, fp)) > 0 ) {
+		size_t n = left + got, i;
+		total += got;
+		for( i=0; i+32<=n; i+=32 ) {
+			v[0] = pcache_round(v[0], pcache_read64(buf + i));
+			v[1] = pcache_round(v[1], pcache_read64(buf + i + 8));
+			v[2] = pcache_round(v[2], pcache_read64(buf + i + 16));
+			v[3] = pcache_round(v[3], pcache_read64(buf + i + 24));
+		}
+		left = n - i;
+		memmove(buf, buf + i, left);
+	}
+	rewind(fp);
+
+	if( total >= 32 ) {
+		h = pcache_rotl(v[0], 1) + pcache_rotl(v[1], 7) + pcache_rotl(v[2], 12) + pcache_rotl(v[3], 18);
+		h = pcache_merge(h, v[0]);
+		h = pcache_merge(h, v[1]);
+		h = pcache_merge(h, v[2]);
+		h = pcache_merge(h, v[3]);
+	} else {
+		h = PCACHE_P5;
+	}
+	h += total;
+
+	// tail below a stripe
+	p = buf;
+	for( ; left>=8; left-=8, p+=8 ) {
+		h ^= pcache_round(0, pcache_read64(p));
+		h = pcache_rotl(h, 27) * PCACHE_P1 + PCACHE_P4;
+	}
+	if( left >= 4 ) {
+		uint32_t w;
+		memcpy(&w, p, sizeof(w));
+		h ^= (uint64_t)w * PCACHE_P1;
+		h = pcache_rotl(h, 23) * PCACHE_P2 + PCACHE_P3;
+		left -= 4;
+		p += 4;
+	}
+	for( ; left>0; left--, p++ ) {
+		h ^= (uint64_t)(*p) * PCACHE_P5;
+		h = pcache_rotl(h, 11) * PCACHE_P1;
+	}
+	h ^= h >> 33;
+	h *= PCACHE_P2;
+	h ^= h >> 29;
+	h *= PCACHE_P3;
+	h ^= h >> 32;
+
+	bufpool_free(&gBufPool, buf);
+	return h;
+}
+
+int pcache_open(pcache_c *cache, uint64_t hash, uint32_t rate) {
+	struct stat st;
+	pcache_head_c *head;
+	sint32_t fd;
+	void *map;
+
+	pcache_name(cache, hash, rate);
+	if( (fd = open(cache->path, O_RDONLY)) < 0 ) {
+		return -1;
+	}
+	if( fstat(fd, &st) != 0 || (size_t)st.st_size < pcache_head_size() ) {
+		close(fd);
+		return -1;
+	}
+	map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if( map == MAP_FAILED ) {
+		return -1;
+	}
+
+	head = (pcache_head_c *)map;
+	if( strncmp("WFPC", head->magic, sizeof(head->magic)) != 0 || head->version != PCACHE_VERSION
+		|| head->hash != hash || head->rate != rate || head->fmt_body.channels == 0
+		|| (size_t)st.st_size != pcache_head_size() + (size_t)head->channel_stride * head->fmt_body.channels ) {
+		printf("planar cache entry %s is stale, stored again\n", cache->path);
+		munmap(map, (size_t)st.st_size);
+		remove(cache->path);
+		return -1;
+	}
+	memcpy(&cache->head, head, sizeof(pcache_head_c));
+	cache->map = (uint8_t *)map;
+	cache->map_size = (size_t)st.st_size;
+	cache->hit_cnt++;
+	return 0;
+}
+
+uint8_t *pcache_channel(pcache_c *cache, uint16_t ch) {
+	if( cache->map == NULL || ch >= cache->head.fmt_body.channels ) {
+		return NULL;
+	}
+	return cache->map + pcache_head_size() + (size_t)cache->head.channel_stride * ch;
+}
+
+int pcache_store_begin(pcache_c *cache, uint64_t hash, uint32_t rate, riff_chunk *pRiff, fmt_chunk_header *pFmtHeader, fmt_chunk_body *pFmtBody, data_chunk *pDataHeader, uint32_t blocks, uint32_t channel_size) {
+	pcache_head_c *head = &cache->head;
+	size_t pad = pcache_head_size() - sizeof(pcache_head_c);
+
+	mkdir(cache->folder, 0755);
+	pcache_name(cache, hash, rate);
+	if( access(cache->path, F_OK) == 0 ) {
+		return 0; // stored by an earlier run which did not look it up
+	}
+	if( (cache->fp_store = fopen(cache->path_tmp, "wb")) == NULL ) {
+		printf("Can't open the planar cache entry %s for write.\n", cache->path_tmp);
+		return -1;
+	}
+
+	memset(head, 0x0, sizeof(pcache_head_c));
+	memcpy(head->magic, "WFPC", sizeof(head->magic));
+	head->version = PCACHE_VERSION;
+	head->hash = hash;
+	head->rate = rate;
+	head->block_numbers = blocks;
+	head->channel_size = channel_size;
+	head->channel_stride = (channel_size + PCACHE_ALIGN - 1) / PCACHE_ALIGN * PCACHE_ALIGN;
+	memcpy(&head->riff, pRiff, sizeof(riff_chunk));
+	memcpy(&head->fmt_header, pFmtHeader, sizeof(fmt_chunk_header));
+	memcpy(&head->fmt_body, pFmtBody, sizeof(fmt_chunk_body));
+	memcpy(&head->data_header, pDataHeader, sizeof(data_chunk));
+	if( fwrite(head, 1, sizeof(pcache_head_c), cache->fp_store) != sizeof(pcache_head_c)
+		|| fwrite(pcache_zero, 1, pad, cache->fp_store) != pad ) {
+		pcache_close(cache);
+		return -1;
+	}
+	return 0;
+}
+
+void pcache_store_channel(pcache_c *cache, const uint8_t *pBuf) {
+	size_t pad = cache->head.channel_stride - cache->head.channel_size;
+
+	if( cache->fp_store == NULL ) {
+		return;
+	}
+	if( fwrite(pBuf, 1, cache->head.channel_size, cache->fp_store) != cache->head.channel_size
+		|| fwrite(pcache_zero, 1, pad, cache->fp_store) != pad ) {
+		printf("Can't write the planar cache entry %s.\n", cache->path_tmp);
+		pcache_close(cache);
+	}
+}
+
+void pcache_store_end(pcache_c *cache) {
+	if( cache->fp_store == NULL ) {
+		return;
+	}
+	if( fclose(cache->fp_store) != 0 || rename(cache->path_tmp, cache->path) != 0 ) {
+		printf("Can't write the planar cache entry %s.\n", cache->path);
+		remove(cache->path_tmp);
+	} else {
+		cache->store_cnt++;
+	}
+	cache->fp_store = NULL;
+}
+
+void pcache_close(pcache_c *cache) {
+	if( cache->fp_store != NULL ) {
+		fclose(cache->fp_store);
+		remove(cache->path_tmp);
+		cache->fp_store = NULL;
+	}
+	if( cache->map != NULL ) {
+		munmap(cache->map, cache->map_size);
+		cache->map = NULL;
+		cache->map_size = 0;
+	}
+}
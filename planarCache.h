@@ -0,0 +1,56 @@
+#ifndef _H_PLANARCACHE_
+#define _H_PLANARCACHE_
+
+#include <stdio.h>
+#include <stddef.h>
+#include "arch.h"
+#include "wave.h"
+#include "wave_type.h"
+
+// on-disk cache of the decoded planar channels, keyed by the content hash of the input file,
+// a sweep over the same corpus maps the channels of the second run on instead of reading, decoding and splitting
+
+/*-------------------- CONFIGURATION --------------------*/
+#define PCACHE_VERSION (1) /* bump when the entry layout or the decode changes */
+#define PCACHE_ALIGN (64) /* header and channels start on a cache line */
+#define PCACHE_HASH_CHUNK (1 << 20) /* bytes per read while hashing */
+
+typedef struct _pcache_head_c {
+	sint8_t magic[4];			/* "WFPC" */
+	uint32_t version;			/* PCACHE_VERSION */
+	uint64_t hash;				/* content hash of the input file */
+	uint32_t rate;				/* gResampleTargetRate of the entry, 0 : native rate */
+	uint32_t block_numbers;
+	uint32_t channel_size;		/* bytes of a channel */
+	uint32_t channel_stride;	/* bytes between two channels, channel_size aligned to PCACHE_ALIGN */
+	riff_chunk riff;			/* headers of the decoded (and resampled) interleaved data */
+	fmt_chunk_header fmt_header;
+	fmt_chunk_body fmt_body;
+	data_chunk data_header;
+} pcache_head_c;
+
+typedef struct _pcache_c {
+	char folder[64];
+	pcache_head_c head;			/* entry mapped or in write */
+	uint8_t *map;				/* mapped entry, private so the channels are processed in place */
+	size_t map_size;
+	FILE *fp_store;				/* entry in write on a miss */
+	char path[192];
+	char path_tmp[200];
+	uint32_t hit_cnt;
+	uint32_t store_cnt;
+} pcache_c;
+
+extern pcache_c gPlanarCache; /* cache of the batch, see main() */
+
+/*-------------------- FUNCTIONS --------------------*/
+void pcache_init(pcache_c *cache, const char *folder);
+uint64_t pcache_hash(FILE *fp); /* hash of the whole stream, fp is rewound */
+int pcache_open(pcache_c *cache, uint64_t hash, uint32_t rate); /* 0 : hit, the entry is mapped */
+uint8_t *pcache_channel(pcache_c *cache, uint16_t ch);
+int pcache_store_begin(pcache_c *cache, uint64_t hash, uint32_t rate, riff_chunk *pRiff, fmt_chunk_header *pFmtHeader, fmt_chunk_body *pFmtBody, data_chunk *pDataHeader, uint32_t blocks, uint32_t channel_size);
+void pcache_store_channel(pcache_c *cache, const uint8_t *pBuf);
+void pcache_store_end(pcache_c *cache);
+void pcache_close(pcache_c *cache); /* unmap the entry, drop an unfinished store */
+
+#endif
@@ -0,0 +1,543 @@
+/**
+ * @file plcServer.c
+ * @author weiyuan.hsu
+ * @brief
+ * implement of the concealment service, RUNMODE_SERVER
+ *
+ * plcsrv_run: ............. Listen on a unix socket, one connection is one session. PLCSRV_CMD_OPEN makes
+ * 							 a shared memory block (memfd) with the in / out rings, a LowcFE_c for the session
+ * 							 and sends the fd back with SCM_RIGHTS. The main thread only handles the
+ * 							 connections, the frames never go through the socket. The connections are
+ * 							 non blocking, a request arriving in pieces is collected in its session.
+ *
+ * worker: ................. Session s is served by worker s % workers, so a LowcFE_c is only touched by one
+ * 							 thread. A worker polls the in rings of its sessions, runs g711plc_dofe on the
+ * 							 erased frames and g711plc_addtohistory on the others and pushes the result to
+ * 							 the out ring. A full out ring stops the session until the client pops, the
+ * 							 frames stay in the in ring (back-pressure). Workers spin while there is work,
+ * 							 sleep idle_us after PLCSRV_SPIN empty rounds, and can be pinned to a cpu.
+ *
+ * session end: ............ Hang up or PLCSRV_CMD_CLOSE. The worker acknowledges (CLOSING -> DONE) before the
+ * 							 memory is unmapped, the stats of the session are printed (and sent back on
+ * 							 PLCSRV_CMD_CLOSE).
+ *
+ * latency: ................ t_done - t_submit of every frame, both CLOCK_MONOTONIC of the same host, so it is
+ * 							 the time in the ring plus the concealment, mean / max and a log2 histogram.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "arch.h"
+#include "config.h"
+#include "LowcFE.h"
+#include "plcServer.h"
+
+/*-------------------- CONFIGURATION --------------------*/
+#define PLCSRV_SPIN (256) /* empty polls of a worker before it sleeps */
+#define PLCSRV_POLL_MS (50) /* main loop, reap of the closed sessions */
+
+enum {
+	PLCSRV_SESSION_FREE = 0,
+	PLCSRV_SESSION_CONNECTED,	/* connection, no shared memory yet */
+	PLCSRV_SESSION_ACTIVE,		/* served by its worker */
+	PLCSRV_SESSION_CLOSING,		/* asked the worker to drop it */
+	PLCSRV_SESSION_DONE,		/* the worker does not touch it any more */
+};
+
+typedef struct _plcsrv_session_c {
+	uint32_t state;				/* PLCSRV_SESSION_xxx, atomic */
+	int conn;					/* -1 : hung up */
+	uint8_t reply;				/* send the stats on conn when reaped, PLCSRV_CMD_CLOSE */
+	uint32_t req_len;			/* bytes of req received so far */
+	plcsrv_req_c req;			/* request being received, conn is non blocking */
+	plcsrv_shm_c *shm;
+	LowcFE_c lc;
+	plcsrv_stats_c stats;		/* written by the worker only */
+} plcsrv_session_c;
+
+typedef struct _plcsrv_worker_c {
+	pthread_t thread;
+	uint8_t id;
+	uint8_t pin;
+	uint32_t idle_us;
+} plcsrv_worker_c;
+
+/*-------------------- GLOBAL PARAMETER --------------------*/
+static plcsrv_session_c *plcsrv_session = NULL;
+static plcsrv_worker_c plcsrv_worker[PLCSRV_WORKER_MAX];
+static uint8_t plcsrv_worker_num = 0;
+static uint32_t plcsrv_worker_stop = 0;		/* atomic */
+static volatile sig_atomic_t plcsrv_stop = 0;
+
+/*-------------------- INTERNAL FUNCTIONS --------------------*/
+static uint64_t plcsrv_now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void plcsrv_signal(int sig) {
+	plcsrv_stop = 1;
+}
+
+static void plcsrv_account(plcsrv_stats_c *st, uint64_t t_submit, uint64_t t_done) {
+	uint64_t lat, us;
+	uint32_t b = 0;
+	if( t_submit == 0 || t_submit > t_done ) {
+		return;
+	}
+	lat = t_done - t_submit;
+	st->lat_sum_ns += lat;
+	if( lat > st->lat_max_ns ) {
+		st->lat_max_ns = lat;
+	}
+	us = lat / 1000;
+	while( us > 1 && b < PLCSRV_LAT_BUCKETS - 1 ) {
+		us >>= 1;
+		b++;
+	}
+	st->lat_hist[b]++;
+}
+
+/**
+ * @brief
+ * move the frames of the in ring through the PLC to the out ring
+ * @return frames done
+ */
+static uint32_t plcsrv_serve(plcsrv_session_c *sess) {
+	plcsrv_ring_c *in = &sess->shm->in, *out = &sess->shm->out;
+	uint32_t head = __atomic_load_n(&in->head, __ATOMIC_ACQUIRE);
+	uint32_t tail = in->tail;
+	uint32_t ohead = out->head;
+	uint32_t otail = __atomic_load_n(&out->tail, __ATOMIC_ACQUIRE);
+	uint32_t n = 0;
+
+	while( tail != head ) {
+		plcsrv_slot_c *src, *dst;
+		uint64_t t0;
+		if( ohead - otail >= PLCSRV_RING_FRAMES ) {
+			otail = __atomic_load_n(&out->tail, __ATOMIC_ACQUIRE);
+			if( ohead - otail >= PLCSRV_RING_FRAMES ) {
+				sess->stats.stalls++;
+				break;
+			}
+		}
+		src = &in->slot[tail & (PLCSRV_RING_FRAMES - 1)];
+		dst = &out->slot[ohead & (PLCSRV_RING_FRAMES - 1)];
+		dst->seq = src->seq;
+		dst->t_submit = src->t_submit;
+		dst->erased = src->erased;
+		t0 = plcsrv_now_ns();
+		if( src->erased != 0 ) {
+			g711plc_dofe(&sess->lc, dst->pcm);
+			sess->stats.erased++;
+		} else {
+			memcpy(dst->pcm, src->pcm, sizeof(dst->pcm));
+			g711plc_addtohistory(&sess->lc, dst->pcm);
+		}
+		dst->t_done = plcsrv_now_ns();
+		sess->stats.proc_sum_ns += dst->t_done - t0;
+		sess->stats.frames++;
+		plcsrv_account(&sess->stats, dst->t_submit, dst->t_done);
+		tail++;
+		ohead++;
+		n++;
+		__atomic_store_n(&in->tail, tail, __ATOMIC_RELEASE);
+		__atomic_store_n(&out->head, ohead, __ATOMIC_RELEASE);
+	}
+	return n;
+}
+
+static void *plcsrv_worker_main(void *arg) {
+	plcsrv_worker_c *w = (plcsrv_worker_c *)arg;
+	uint32_t idle = 0, s;
+
+	if( w->pin != 0 ) {
+		cpu_set_t set;
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		CPU_ZERO(&set);
+		CPU_SET(w->id % ((cpus > 0) ? cpus : 1), &set);
+		if( pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0 ) {
+			printf("plc server : worker %u can not be pinned\n", w->id);
+		}
+	}
+
+	while( __atomic_load_n(&plcsrv_worker_stop, __ATOMIC_ACQUIRE) == 0 ) {
+		uint32_t done = 0;
+		for( s=w->id; s<PLCSRV_SESSION_MAX; s+=plcsrv_worker_num ) {
+			plcsrv_session_c *sess = &plcsrv_session[s];
+			uint32_t state = __atomic_load_n(&sess->state, __ATOMIC_ACQUIRE);
+			if( state == PLCSRV_SESSION_CLOSING ) {
+				__atomic_store_n(&sess->state, PLCSRV_SESSION_DONE, __ATOMIC_RELEASE);
+			} else if( state == PLCSRV_SESSION_ACTIVE ) {
+				done += plcsrv_serve(sess);
+			}
+		}
+		if( done != 0 ) {
+			idle = 0;
+		} else if( ++idle >= PLCSRV_SPIN ) {
+			usleep(w->idle_us);
+		}
+	}
+	return NULL;
+}
+
+static int plcsrv_send(int conn, plcsrv_rsp_c *rsp, int fd) {
+	struct msghdr msg;
+	struct iovec iov;
+	char ctrl[CMSG_SPACE(sizeof(int))];
+
+	memset(&msg, 0x0, sizeof(msg));
+	iov.iov_base = rsp;
+	iov.iov_len = sizeof(plcsrv_rsp_c);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	if( fd >= 0 ) {
+		struct cmsghdr *cmsg;
+		memset(ctrl, 0x0, sizeof(ctrl));
+		msg.msg_control = ctrl;
+		msg.msg_controllen = sizeof(ctrl);
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	}
+	return (sendmsg(conn, &msg, MSG_NOSIGNAL) == (ssize_t)sizeof(plcsrv_rsp_c)) ? 0 : -1;
+}
+
+static void plcsrv_reply(plcsrv_session_c *sess, uint32_t status) {
+	plcsrv_rsp_c rsp;
+	uint32_t s = (uint32_t)(sess - plcsrv_session);
+	memset(&rsp, 0x0, sizeof(rsp));
+	rsp.magic = PLCSRV_MAGIC;
+	rsp.status = status;
+	rsp.session = s;
+	rsp.worker = s % plcsrv_worker_num;
+	rsp.stats = sess->stats;	/* may be a frame behind the worker */
+	plcsrv_send(sess->conn, &rsp, -1);
+}
+
+static void plcsrv_open(plcsrv_session_c *sess) {
+	plcsrv_rsp_c rsp;
+	uint32_t s = (uint32_t)(sess - plcsrv_session);
+	int fd;
+
+	fd = memfd_create("wavparser_plc", MFD_CLOEXEC);
+	if( fd < 0 || ftruncate(fd, sizeof(plcsrv_shm_c)) != 0 ) {
+		printf("plc server : shared memory of session %u, %s\n", s, strerror(errno));
+		if( fd >= 0 ) {
+			close(fd);
+		}
+		plcsrv_reply(sess, PLCSRV_ERR_MEMORY);
+		return;
+	}
+	sess->shm = (plcsrv_shm_c *)mmap(NULL, sizeof(plcsrv_shm_c), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if( sess->shm == MAP_FAILED ) {
+		printf("plc server : map of session %u, %s\n", s, strerror(errno));
+		sess->shm = NULL;
+		close(fd);
+		plcsrv_reply(sess, PLCSRV_ERR_MEMORY);
+		return;
+	}
+	sess->shm->magic = PLCSRV_MAGIC;
+	sess->shm->version = PLCSRV_VERSION;
+	sess->shm->frames = PLCSRV_RING_FRAMES;
+	sess->shm->framesz = FRAMESZ;
+	g711plc_construct(&sess->lc);
+	memset(&sess->stats, 0x0, sizeof(plcsrv_stats_c));
+
+	memset(&rsp, 0x0, sizeof(rsp));
+	rsp.magic = PLCSRV_MAGIC;
+	rsp.status = PLCSRV_OK;
+	rsp.session = s;
+	rsp.worker = s % plcsrv_worker_num;
+	rsp.shm_size = sizeof(plcsrv_shm_c);
+	if( plcsrv_send(sess->conn, &rsp, fd) != 0 ) {
+		munmap(sess->shm, sizeof(plcsrv_shm_c));
+		sess->shm = NULL;
+	} else {
+		__atomic_store_n(&sess->state, PLCSRV_SESSION_ACTIVE, __ATOMIC_RELEASE);
+	}
+	close(fd);	/* the mappings keep the memory */
+}
+
+/**
+ * @brief
+ * end the session, an active one is released once its worker acknowledged, see plcsrv_reap()
+ */
+static void plcsrv_close(plcsrv_session_c *sess, uint8_t hangup) {
+	if( hangup != 0 && sess->conn >= 0 ) {
+		close(sess->conn);
+		sess->conn = -1;
+	}
+	sess->reply = (hangup == 0) ? 1 : 0;
+	if( sess->state == PLCSRV_SESSION_ACTIVE ) {
+		__atomic_store_n(&sess->state, PLCSRV_SESSION_CLOSING, __ATOMIC_RELEASE);
+	} else if( sess->state == PLCSRV_SESSION_CONNECTED ) {
+		__atomic_store_n(&sess->state, PLCSRV_SESSION_DONE, __ATOMIC_RELEASE);
+	}
+}
+
+static void plcsrv_report(uint32_t s, const plcsrv_stats_c *st) {
+	printf("plc session %u (worker %u) : %llu frames, %llu erased, %llu stalls, latency mean %.1f us, p50 < %.0f us, p99 < %.0f us, max %.1f us, plc %.2f us / frame\n",
+		s, s % plcsrv_worker_num, (unsigned long long)st->frames, (unsigned long long)st->erased, (unsigned long long)st->stalls,
+		(st->frames != 0) ? st->lat_sum_ns / 1000.0 / st->frames : 0.0, plcsrv_latency_quantile(st, 0.5), plcsrv_latency_quantile(st, 0.99),
+		st->lat_max_ns / 1000.0, (st->frames != 0) ? st->proc_sum_ns / 1000.0 / st->frames : 0.0);
+}
+
+static void plcsrv_reap(void) {
+	uint32_t s;
+	for( s=0; s<PLCSRV_SESSION_MAX; s++ ) {
+		plcsrv_session_c *sess = &plcsrv_session[s];
+		if( __atomic_load_n(&sess->state, __ATOMIC_ACQUIRE) != PLCSRV_SESSION_DONE ) {
+			continue;
+		}
+		if( sess->shm != NULL ) {
+			plcsrv_report(s, &sess->stats);
+			munmap(sess->shm, sizeof(plcsrv_shm_c));
+			sess->shm = NULL;
+		}
+		if( sess->conn >= 0 ) {
+			if( sess->reply != 0 ) {
+				plcsrv_reply(sess, PLCSRV_OK);
+			}
+			close(sess->conn);
+			sess->conn = -1;
+		}
+		sess->reply = 0;
+		__atomic_store_n(&sess->state, PLCSRV_SESSION_FREE, __ATOMIC_RELEASE);
+	}
+}
+
+static void plcsrv_accept(int lfd) {
+	static uint32_t next = 0;
+	plcsrv_rsp_c rsp;
+	uint32_t i;
+	int conn = accept4(lfd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+
+	if( conn < 0 ) {
+		return;
+	}
+	// round robin over the slots, so the sessions spread over the workers
+	for( i=0; i<PLCSRV_SESSION_MAX; i++ ) {
+		plcsrv_session_c *sess = &plcsrv_session[(next + i) % PLCSRV_SESSION_MAX];
+		if( sess->state == PLCSRV_SESSION_FREE ) {
+			sess->conn = conn;
+			sess->reply = 0;
+			sess->req_len = 0;
+			sess->state = PLCSRV_SESSION_CONNECTED;
+			next = (next + i + 1) % PLCSRV_SESSION_MAX;
+			return;
+		}
+	}
+	memset(&rsp, 0x0, sizeof(rsp));
+	rsp.magic = PLCSRV_MAGIC;
+	rsp.status = PLCSRV_ERR_FULL;
+	plcsrv_send(conn, &rsp, -1);
+	close(conn);
+}
+
+static void plcsrv_request(plcsrv_session_c *sess) {
+	plcsrv_req_c req;
+	ssize_t len = recv(sess->conn, (uint8_t *)&sess->req + sess->req_len, sizeof(req) - sess->req_len, 0);
+
+	if( len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ) {
+		return;
+	}
+	if( len <= 0 ) {
+		plcsrv_close(sess, 1);
+		return;
+	}
+	// a partial request waits in the session for the rest, the other connections are still served
+	sess->req_len += (uint32_t)len;
+	if( sess->req_len < sizeof(req) ) {
+		return;
+	}
+	req = sess->req;
+	sess->req_len = 0;
+	if( req.magic != PLCSRV_MAGIC || req.version != PLCSRV_VERSION ) {
+		plcsrv_reply(sess, PLCSRV_ERR_PROTOCOL);
+		plcsrv_close(sess, 1);
+		return;
+	}
+	switch( req.cmd ) {
+	case PLCSRV_CMD_OPEN:
+		if( sess->state != PLCSRV_SESSION_CONNECTED ) {
+			plcsrv_reply(sess, PLCSRV_ERR_STATE);
+		} else {
+			plcsrv_open(sess);
+		}
+		break;
+	case PLCSRV_CMD_STATS:
+		plcsrv_reply(sess, (sess->state == PLCSRV_SESSION_ACTIVE) ? PLCSRV_OK : PLCSRV_ERR_STATE);
+		break;
+	case PLCSRV_CMD_CLOSE:
+		plcsrv_close(sess, 0);
+		break;
+	default:
+		plcsrv_reply(sess, PLCSRV_ERR_PROTOCOL);
+		break;
+	}
+}
+
+/*-------------------- FUNCTIONS --------------------*/
+double plcsrv_latency_quantile(const plcsrv_stats_c *stats, double q) {
+	uint64_t total = 0, acc = 0;
+	uint32_t b;
+	for( b=0; b<PLCSRV_LAT_BUCKETS; b++ ) {
+		total += stats->lat_hist[b];
+	}
+	if( total == 0 ) {
+		return 0.0;
+	}
+	for( b=0; b<PLCSRV_LAT_BUCKETS; b++ ) {
+		acc += stats->lat_hist[b];
+		if( acc >= q * total ) {
+			break;
+		}
+	}
+	return (double)(2ull << ((b < PLCSRV_LAT_BUCKETS) ? b : PLCSRV_LAT_BUCKETS - 1));
+}
+
+int plcsrv_run(const char *path, uint8_t workers, uint8_t pin, uint32_t idle_us) {
+	struct sockaddr_un addr;
+	struct sigaction sa;
+	struct pollfd *pfd = NULL;
+	uint32_t *pidx = NULL;
+	uint32_t s, n;
+	uint8_t w;
+	int lfd = -1, ret = -1;
+
+	if( strlen(path) >= sizeof(addr.sun_path) ) {
+		printf("plc server : socket path too long, %s\n", path);
+		return -1;
+	}
+	plcsrv_worker_num = (workers == 0) ? 1 : ((workers > PLCSRV_WORKER_MAX) ? PLCSRV_WORKER_MAX : workers);
+	plcsrv_session = (plcsrv_session_c *)calloc(PLCSRV_SESSION_MAX, sizeof(plcsrv_session_c));
+	pfd = (struct pollfd *)malloc(sizeof(struct pollfd) * (PLCSRV_SESSION_MAX + 1));
+	pidx = (uint32_t *)malloc(sizeof(uint32_t) * (PLCSRV_SESSION_MAX + 1));
+	if( plcsrv_session == NULL || pfd == NULL || pidx == NULL ) {
+		printf("Allocation memory error");
+		goto EXIT;
+	}
+	for( s=0; s<PLCSRV_SESSION_MAX; s++ ) {
+		plcsrv_session[s].conn = -1;
+	}
+
+	lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	memset(&addr, 0x0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	unlink(path);
+	if( lfd < 0 || bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(lfd, 64) != 0 ) {
+		printf("plc server : can not listen on %s, %s\n", path, strerror(errno));
+		goto EXIT;
+	}
+
+	// no SA_RESTART, the signal wakes poll()
+	memset(&sa, 0x0, sizeof(sa));
+	sa.sa_handler = plcsrv_signal;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	plcsrv_stop = 0;
+	plcsrv_worker_stop = 0;
+	for( w=0; w<plcsrv_worker_num; w++ ) {
+		plcsrv_worker[w].id = w;
+		plcsrv_worker[w].pin = pin;
+		plcsrv_worker[w].idle_us = idle_us;
+		if( pthread_create(&plcsrv_worker[w].thread, NULL, plcsrv_worker_main, &plcsrv_worker[w]) != 0 ) {
+			printf("plc server : worker %u, %s\n", w, strerror(errno));
+			plcsrv_worker_num = w;
+			break;
+		}
+	}
+	if( plcsrv_worker_num == 0 ) {
+		goto EXIT;
+	}
+	printf("plc server : %s, %u workers%s, %u sessions, %u frames per ring\n", path, plcsrv_worker_num, (pin != 0) ? " pinned" : "", PLCSRV_SESSION_MAX, PLCSRV_RING_FRAMES);
+
+	while( plcsrv_stop == 0 ) {
+		n = 0;
+		pfd[n].fd = lfd;
+		pfd[n].events = POLLIN;
+		pidx[n++] = PLCSRV_SESSION_MAX;
+		for( s=0; s<PLCSRV_SESSION_MAX; s++ ) {
+			uint32_t state = plcsrv_session[s].state;
+			if( plcsrv_session[s].conn >= 0 && (state == PLCSRV_SESSION_CONNECTED || state == PLCSRV_SESSION_ACTIVE) ) {
+				pfd[n].fd = plcsrv_session[s].conn;
+				pfd[n].events = POLLIN;
+				pidx[n++] = s;
+			}
+		}
+		if( poll(pfd, n, PLCSRV_POLL_MS) > 0 ) {
+			for( s=0; s<n; s++ ) {
+				if( pfd[s].revents == 0 ) {
+					continue;
+				}
+				if( pidx[s] == PLCSRV_SESSION_MAX ) {
+					plcsrv_accept(lfd);
+				} else if( pfd[s].revents & POLLIN ) {
+					plcsrv_request(&plcsrv_session[pidx[s]]);
+				} else {
+					plcsrv_close(&plcsrv_session[pidx[s]], 1);
+				}
+			}
+		}
+		plcsrv_reap();
+	}
+
+	// shutdown, every session is acknowledged by the workers before they stop
+	for( s=0; s<PLCSRV_SESSION_MAX; s++ ) {
+		if( plcsrv_session[s].state != PLCSRV_SESSION_FREE ) {
+			plcsrv_close(&plcsrv_session[s], 1);
+		}
+	}
+	for( n=0; n<1000; n++ ) {
+		for( s=0; s<PLCSRV_SESSION_MAX; s++ ) {
+			if( __atomic_load_n(&plcsrv_session[s].state, __ATOMIC_ACQUIRE) == PLCSRV_SESSION_CLOSING ) {
+				break;
+			}
+		}
+		if( s == PLCSRV_SESSION_MAX ) {
+			break;
+		}
+		usleep(1000);
+	}
+	plcsrv_reap();
+	ret = 0;
+
+EXIT:
+	__atomic_store_n(&plcsrv_worker_stop, 1, __ATOMIC_RELEASE);
+	for( w=0; w<plcsrv_worker_num; w++ ) {
+		pthread_join(plcsrv_worker[w].thread, NULL);
+	}
+	plcsrv_worker_num = 0;
+	if( lfd >= 0 ) {
+		close(lfd);
+		unlink(path);
+	}
+	free(plcsrv_session);
+	plcsrv_session = NULL;
+	free(pfd);
+	free(pidx);
+	return ret;
+}
@@ -0,0 +1,95 @@
+#ifndef _H_PLCSERVER_
+#define _H_PLCSERVER_
+
+#include "arch.h"
+#include "LowcFE.h"
+
+// concealment service for other processes, RUNMODE_SERVER.
+// a client opens a session on the unix socket and gets back (SCM_RIGHTS) the fd of a shared memory block with two
+// single producer / single consumer rings, it pushes 10 ms frames of 8 kHz pcm with an erased flag and pops the
+// concealed frames (delayed by POVERLAPMAX like g711plc_dofe / g711plc_addtohistory). Every session has its own
+// LowcFE_c and is served by one worker of the pool, the connection stays open for the life of the session.
+// the structures below are the protocol, a client only needs this header, the heads and tails are read and
+// written with acquire / release atomics, every field is padded to its own cache line
+
+/*-------------------- CONFIGURATION --------------------*/
+#define PLCSRV_MAGIC (0x57465053) /* "SPFW" */
+#define PLCSRV_VERSION (1)
+#define PLCSRV_RING_FRAMES (64) /* slots of each ring, power of 2 */
+#define PLCSRV_SESSION_MAX (256)
+#define PLCSRV_WORKER_MAX (16)
+#define PLCSRV_CACHELINE (64)
+#define PLCSRV_LAT_BUCKETS (32) /* latency histogram, bucket b : [2^b, 2^(b+1)) us */
+
+enum {
+	PLCSRV_CMD_OPEN = 0,		/* reply with the shared memory fd */
+	PLCSRV_CMD_STATS,			/* reply with the stats of the session */
+	PLCSRV_CMD_CLOSE,			/* end the session, hanging up does the same */
+};
+
+enum {
+	PLCSRV_OK = 0,
+	PLCSRV_ERR_PROTOCOL,
+	PLCSRV_ERR_FULL,			/* PLCSRV_SESSION_MAX sessions open */
+	PLCSRV_ERR_MEMORY,
+	PLCSRV_ERR_STATE,			/* no session open on the connection */
+};
+
+typedef struct _plcsrv_slot_c {
+	uint64_t seq;				/* frame number, set by the client and returned */
+	uint64_t t_submit;			/* CLOCK_MONOTONIC ns, client when pushed */
+	uint64_t t_done;			/* CLOCK_MONOTONIC ns, server when concealed */
+	uint8_t erased;				/* 1 : pcm is not valid, synthesize it */
+	uint8_t reserved[7];
+	sint16_t pcm[FRAMESZ];
+} plcsrv_slot_c;
+
+typedef struct _plcsrv_ring_c {
+	uint32_t head;				/* next slot to write, producer only */
+	uint8_t pad0[PLCSRV_CACHELINE - 4];
+	uint32_t tail;				/* next slot to read, consumer only */
+	uint8_t pad1[PLCSRV_CACHELINE - 4];
+	plcsrv_slot_c slot[PLCSRV_RING_FRAMES];	/* 3 cache lines each */
+} plcsrv_ring_c;
+
+typedef struct _plcsrv_shm_c {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t frames;			/* PLCSRV_RING_FRAMES */
+	uint32_t framesz;			/* FRAMESZ samples per slot */
+	uint8_t pad[PLCSRV_CACHELINE - 16];
+	plcsrv_ring_c in;			/* client -> server */
+	plcsrv_ring_c out;			/* server -> client */
+} plcsrv_shm_c;
+
+typedef struct _plcsrv_req_c {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t cmd;				/* PLCSRV_CMD_xxx */
+	uint32_t reserved;
+} plcsrv_req_c;
+
+typedef struct _plcsrv_stats_c {
+	uint64_t frames;			/* frames concealed or added to the history */
+	uint64_t erased;
+	uint64_t stalls;			/* times the out ring was full, the client is behind */
+	uint64_t lat_sum_ns;		/* t_done - t_submit */
+	uint64_t lat_max_ns;
+	uint64_t proc_sum_ns;		/* time in g711plc_dofe / g711plc_addtohistory */
+	uint32_t lat_hist[PLCSRV_LAT_BUCKETS];
+} plcsrv_stats_c;
+
+typedef struct _plcsrv_rsp_c {
+	uint32_t magic;
+	uint32_t status;			/* PLCSRV_OK, PLCSRV_ERR_xxx */
+	uint32_t session;
+	uint32_t worker;
+	uint64_t shm_size;			/* bytes to map from the fd of PLCSRV_CMD_OPEN */
+	plcsrv_stats_c stats;		/* PLCSRV_CMD_STATS */
+} plcsrv_rsp_c;
+
+/*-------------------- FUNCTIONS --------------------*/
+int plcsrv_run(const char *path, uint8_t workers, uint8_t pin, uint32_t idle_us); /* serve until SIGINT / SIGTERM, 0 success, -1 fail */
+double plcsrv_latency_quantile(const plcsrv_stats_c *stats, double q); /* us, upper edge of the histogram bucket */
+
+#endif
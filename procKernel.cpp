@@ -0,0 +1,199 @@
+/**
+ * @file procKernel.cpp
+ * @author weiyuan.hsu
+ * @brief
+ * implement of the specialized processing kernels
+ *
+ * proc_kernel_select: ..... Pick the kernels of a file from the dispatch tables, indexed by the sample size
+ * 							 and the lost / compensation type. It runs once per file, the per sample loops
+ * 							 below are templates on the sample size, so every load / store is a fixed size
+ * 							 access the compiler unrolls (and vectorizes for the split / merge copies).
+ *
+ * proc_lost_*: ............ Zero the lost sections of a single channel and record them in the gap list.
+ * 							 Sections are clamped to the channel, the last period used to run past it.
+ *
+ * proc_comp_linear: ....... The inner interpolation, from the samples next to each recorded gap. A gap
+ * 							 without a sample on one side is left as lost.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arch.h"
+#include "config.h"
+#include "utility.h"
+#include "lostGap.h"
+#include "procKernel.h"
+#include "g711PlcMain.h"
+#include "spectralConceal.h"
+#include "arConceal.h"
+#include "interpConceal.h"
+#include "wsola.h"
+
+/*-------------------- GLOBAL PARAMETER --------------------*/
+proc_kernel_c gProcKernel;
+
+/*-------------------- INTERNAL FUNCTIONS --------------------*/
+/**
+ * @brief
+ * sample load / store of B bytes, 8 bit is unsigned, others are signed little endian
+ */
+template<uint32_t B> static inline sint32_t proc_load(const uint8_t *p);
+template<> inline sint32_t proc_load<1>(const uint8_t *p) { return p[0]; }
+template<> inline sint32_t proc_load<2>(const uint8_t *p) { return (sint16_t)(p[0] | (p[1] << 8)); }
+template<> inline sint32_t proc_load<3>(const uint8_t *p) { return (sint32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24)) >> 8; }
+template<> inline sint32_t proc_load<4>(const uint8_t *p) { return (sint32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24)); }
+
+template<uint32_t B> static inline void proc_store(uint8_t *p, sint32_t v) {
+	for( uint32_t b=0; b<B; b++ ) {
+		p[b] = (uint8_t)(v >> (8 * b));
+	}
+}
+
+template<uint32_t B> static void proc_split(const uint8_t *pIn, uint32_t stride, uint8_t *pOut, uint32_t frames) {
+	for( uint32_t i=0; i<frames; i++ ) {
+		memcpy(pOut + (size_t)i * B, pIn + (size_t)i * stride, B);
+	}
+}
+
+template<uint32_t B> static void proc_merge(const uint8_t *pIn, uint8_t *pOut, uint32_t stride, uint32_t frames) {
+	for( uint32_t i=0; i<frames; i++ ) {
+		memcpy(pOut + (size_t)i * stride, pIn + (size_t)i * B, B);
+	}
+}
+
+static void proc_lost_none(uint8_t *pBuf, const proc_plan_c *plan, lost_gap_list_c *list) {
+}
+
+template<uint32_t B, bool RANDOM> static void proc_lost_continuous(uint8_t *pBuf, const proc_plan_c *plan, lost_gap_list_c *list) {
+	for( uint32_t i=plan->initial; i<plan->samples; i+=plan->period ) {
+		uint32_t s = i + ( RANDOM ? (uint32_t)rand() % plan->random_max : 0 );
+		uint32_t len;
+		if( s >= plan->samples ) {
+			break;
+		}
+		len = ( plan->lost < plan->samples - s ) ? plan->lost : plan->samples - s;
+		memset(pBuf + (size_t)s * B, 0x0, (size_t)len * B);
+		lostgap_add(list, s, len);
+	}
+}
+
+template<uint32_t B> static void proc_lost_interleave(uint8_t *pBuf, const proc_plan_c *plan, lost_gap_list_c *list) {
+	for( uint32_t i=plan->initial; i<plan->samples; i+=plan->period ) {
+		for( uint32_t t=0; t<plan->lost; t+=plan->interleave ) {
+			uint32_t s = i + t * 2;
+			uint32_t len;
+			if( s >= plan->samples ) {
+				break;
+			}
+			len = ( plan->interleave < plan->samples - s ) ? plan->interleave : plan->samples - s;
+			memset(pBuf + (size_t)s * B, 0x0, (size_t)len * B);
+			lostgap_add(list, s, len);
+		}
+	}
+}
+
+static void proc_lost_frame(uint8_t *pBuf, const proc_plan_c *plan, lost_gap_list_c *list) {
+	g711DataLost();
+}
+
+static void proc_lost_jitter(uint8_t *pBuf, const proc_plan_c *plan, lost_gap_list_c *list) {
+	g711JitterLost();
+}
+
+/**
+ * @brief
+ * T is the type of the interpolation, 32 bit integer for 8 / 16 bit samples. 24 / 32 bit samples
+ * overflow it, they use double : the numerator is an integer below 2^53 and the quotient below 2^31,
+ * so the division truncates to the integer result while the gap is shorter than 2^22 samples.
+ */
+template<uint32_t B, typename T> static void proc_comp_linear(uint8_t *pBuf, const proc_plan_c *plan, lost_gap_list_c *list) {
+	for( uint32_t g=0; g<list->num; g++ ) {
+		uint32_t s = list->gap[g].start, len = list->gap[g].len;
+		if( s == 0 || s + len >= plan->samples ) {
+			continue;
+		}
+		T startPts = (T)proc_load<B>(pBuf + (size_t)(s - 1) * B);
+		T endPts = (T)proc_load<B>(pBuf + (size_t)(s + len) * B);
+		T div = (T)(len + 1);
+		uint8_t *p = pBuf + (size_t)s * B;
+		for( uint32_t j=0; j<len; j++ ) {
+			proc_store<B>(p + (size_t)j * B, (sint32_t)((endPts * (T)(j + 1) + startPts * (T)(len - j)) / div));
+		}
+	}
+}
+
+static void proc_comp_g711(uint8_t *pBuf, const proc_plan_c *plan, lost_gap_list_c *list) {
+	g711PlcMain();
+}
+
+static void proc_comp_spectral(uint8_t *pBuf, const proc_plan_c *plan, lost_gap_list_c *list) {
+	spectral_conceal(pBuf, plan->bit_per_sample, plan->sample_rate, list);
+}
+
+static void proc_comp_ar(uint8_t *pBuf, const proc_plan_c *plan, lost_gap_list_c *list) {
+	ar_conceal(pBuf, plan->bit_per_sample, plan->sample_rate, list);
+}
+
+static void proc_comp_cubic(uint8_t *pBuf, const proc_plan_c *plan, lost_gap_list_c *list) {
+	interp_conceal(COMPTYPE_CUBIC, pBuf, plan->bit_per_sample, list);
+}
+
+static void proc_comp_sinc(uint8_t *pBuf, const proc_plan_c *plan, lost_gap_list_c *list) {
+	interp_conceal(COMPTYPE_SINC, pBuf, plan->bit_per_sample, list);
+}
+
+static void proc_comp_wsola(uint8_t *pBuf, const proc_plan_c *plan, lost_gap_list_c *list) {
+	wsola_conceal(pBuf, plan->bit_per_sample, plan->sample_rate, list);
+}
+
+/*-------------------- DISPATCH TABLE --------------------*/
+#define PROC_BYTES_MAX (4)
+
+static const proc_split_f proc_split_table[PROC_BYTES_MAX] = {
+	proc_split<1>, proc_split<2>, proc_split<3>, proc_split<4>,
+};
+
+static const proc_merge_f proc_merge_table[PROC_BYTES_MAX] = {
+	proc_merge<1>, proc_merge<2>, proc_merge<3>, proc_merge<4>,
+};
+
+/* [sample bytes - 1][lost type][random offset] */
+#define PROC_LOST_ROW(B) \
+	{ \
+		{ proc_lost_none, proc_lost_none }, \
+		{ proc_lost_continuous<B, false>, proc_lost_continuous<B, true> }, \
+		{ proc_lost_interleave<B>, proc_lost_interleave<B> }, \
+		{ proc_lost_frame, proc_lost_frame }, \
+		{ proc_lost_jitter, proc_lost_jitter }, \
+	}
+
+static const proc_lost_f proc_lost_table[PROC_BYTES_MAX][LOSTTYPE_MAX][2] = {
+	PROC_LOST_ROW(1), PROC_LOST_ROW(2), PROC_LOST_ROW(3), PROC_LOST_ROW(4),
+};
+
+/* [sample bytes - 1][compensation type] */
+#define PROC_COMP_ROW(B, T) \
+	{ NULL, proc_comp_linear<B, T>, proc_comp_g711, proc_comp_spectral, proc_comp_ar, proc_comp_cubic, proc_comp_sinc, proc_comp_wsola }
+
+static const proc_comp_f proc_comp_table[PROC_BYTES_MAX][COMPTYPE_MAX] = {
+	PROC_COMP_ROW(1, sint32_t), PROC_COMP_ROW(2, sint32_t), PROC_COMP_ROW(3, double), PROC_COMP_ROW(4, double),
+};
+
+/*-------------------- FUNCTIONS --------------------*/
+int proc_kernel_select(uint16_t bit_per_sample, uint8_t lost, uint8_t comp, uint8_t random) {
+	uint32_t bytes = bit_per_sample / 8;
+	if( bit_per_sample % 8 != 0 || bytes == 0 || bytes > PROC_BYTES_MAX || lost >= LOSTTYPE_MAX || comp >= COMPTYPE_MAX ) {
+		printf("no processing kernel for %d bit/sample, lost %d, compensation %d\n", bit_per_sample, lost, comp);
+		memset(&gProcKernel, 0x0, sizeof(proc_kernel_c));
+		return -1;
+	}
+	gProcKernel.split = proc_split_table[bytes - 1];
+	gProcKernel.merge = proc_merge_table[bytes - 1];
+	gProcKernel.lost = proc_lost_table[bytes - 1][lost][(random != 0) ? 1 : 0];
+	gProcKernel.comp = ( lost == LOSTTYPE_NONE ) ? NULL : proc_comp_table[bytes - 1][comp];
+	return 0;
+}
@@ -0,0 +1,39 @@
+#ifndef _H_PROCKERNEL_
+#define _H_PROCKERNEL_
+
+#include "arch.h"
+#include "lostGap.h"
+
+// per file dispatch of the channel split / merge, data lost and compensation kernels,
+// each kernel is specialized for the sample size, so its inner loop has no format branch
+
+/*-------------------- CONFIGURATION --------------------*/
+typedef struct _proc_plan_c {
+	uint16_t bit_per_sample;
+	uint32_t sample_rate;
+	uint32_t samples;			/* channel length */
+	uint32_t initial;			/* first lost section, unit : sample */
+	uint32_t period;			/* lost period, unit : sample */
+	uint32_t lost;				/* lost samples per period */
+	uint32_t interleave;		/* lost / kept run of the interleave type, unit : sample */
+	uint32_t random_max;		/* random offset range of the continuous type, unit : sample */
+} proc_plan_c;
+
+typedef void (*proc_split_f)(const uint8_t *pIn, uint32_t stride, uint8_t *pOut, uint32_t frames);
+typedef void (*proc_merge_f)(const uint8_t *pIn, uint8_t *pOut, uint32_t stride, uint32_t frames);
+typedef void (*proc_lost_f)(uint8_t *pBuf, const proc_plan_c *plan, lost_gap_list_c *list);
+typedef void (*proc_comp_f)(uint8_t *pBuf, const proc_plan_c *plan, lost_gap_list_c *list);
+
+typedef struct _proc_kernel_c {
+	proc_split_f split;			/* interleaved -> single channel */
+	proc_merge_f merge;			/* single channel -> interleaved */
+	proc_lost_f lost;
+	proc_comp_f comp;			/* NULL : no compensation */
+} proc_kernel_c;
+
+extern proc_kernel_c gProcKernel; /* kernels of the file in process, see proc_kernel_select() */
+
+/*-------------------- FUNCTIONS --------------------*/
+int proc_kernel_select(uint16_t bit_per_sample, uint8_t lost, uint8_t comp, uint8_t random); /* 0 success, -1 format not supported */
+
+#endif
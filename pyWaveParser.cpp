@@ -0,0 +1,562 @@
+/**
+ * @file pyWaveParser.cpp
+ * @author weiyuan.hsu
+ * @brief
+ * python module "wavparser" on top of the wav reader, data lost models and compensators
+ *
+ * wavparser.read: ......... Parse a wav file and return the channels as a planar (channels, frames) buffer.
+ * 							 The object exports the buffer protocol, numpy.asarray() wraps the memory
+ * 							 without a copy. Samples keep their pcm value : uint8 for 8 bit, int16 for
+ * 							 16 bit, int32 for 24 / 32 bit.
+ *
+ * wavparser.simulate: ..... Run a lost / compensation configuration in process and return the golden, lost
+ * 							 and concealed channels, nothing is written to output/. The split, lost and
+ * 							 compensation results are keyed (stageMemo.h), a call which only changes comp
+ * 							 runs the compensation alone, the file is parsed again only when it changed.
+ *
+ * wavparser.stages: ....... Run / reuse counters of those results.
+ *
+ * wavparser.simd: ......... Report or force the instruction set of the dsp kernels.
+ *
+ * wavparser.kernel_check: . Differential check of the optimized kernels against the scalar reference
+ * 							 (kernelCheck.h), the rows give the first differing value and the error stats.
+ *
+ * wavparser.catalog: ...... Load a binary index of RUNMODE_CATALOG (catalog.h), one dict per file, or scan a
+ * 							 directory tree into a new index when a root is given.
+ *
+ * build (from the repository root, python3-dev needed, no numpy needed to build) :
+ *   g++ -O2 -shared -fPIC -DWFP_PYTHON_MODULE $(python3-config --includes) pyWaveParser.cpp main.cpp param.c utility.c \
+ *       LowcFE.c g711PlcMain.c g711Codec.c resampler.c channelMixer.c bufferPool.c asyncIo.c peakIndex.c \
+ *       fft.c lostGap.c spectralConceal.c arConceal.c interpConceal.c procKernel.cpp dspKernel.c planarCache.c stageMemo.c kernelCheck.c plcServer.c pipeline.c jitterBuffer.c wsola.c npyExport.c catalog.c vad.c \
+ *       -o wavparser$(python3-config --extension-suffix) -lpthread
+ *
+ * usage :
+ *   import numpy, wavparser
+ *   ch = wavparser.read("input/sample_wav/96k/beemoved_96k_2ch_16b_short.wav")
+ *   pcm = numpy.asarray(ch)          # shape (2, frames), int16, no copy
+ *   golden, lost, comp = wavparser.simulate(path, lost=wavparser.LOST_INTERLEAVE, comp=wavparser.COMP_INNER_INTERPLOATION)
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifdef WFP_PYTHON_MODULE /* only in the module build, a plain build of the tree skips this file */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "arch.h"
+#include "config.h"
+#include "utility.h"
+#include "wave.h"
+#include "wave_type.h"
+#include "param.h"
+#include "main.h"
+#include "g711Codec.h"
+#include "bufferPool.h"
+#include "procKernel.h"
+#include "dspKernel.h"
+#include "stageMemo.h"
+#include "kernelCheck.h"
+#include "catalog.h"
+
+/*-------------------- CONFIGURATION --------------------*/
+typedef struct _py_channels_c {
+	PyObject_HEAD
+	uint8_t *buf;				/* planar samples, channel after channel */
+	Py_ssize_t shape[2];		/* channels, frames */
+	Py_ssize_t strides[2];
+	Py_ssize_t itemsize;
+	char format[2];
+	uint32_t sample_rate;
+	uint16_t bit_per_sample;
+	uint32_t channel_mask;
+} py_channels_c;
+
+/*-------------------- CHANNELS OBJECT --------------------*/
+static void py_channels_dealloc(py_channels_c *self) {
+	free(self->buf);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static int py_channels_getbuffer(py_channels_c *self, Py_buffer *view, int flags) {
+	view->obj = (PyObject *)self;
+	view->buf = self->buf;
+	view->len = self->shape[0] * self->shape[1] * self->itemsize;
+	view->readonly = 0;
+	view->itemsize = self->itemsize;
+	view->format = ((flags & PyBUF_FORMAT) == PyBUF_FORMAT) ? self->format : NULL;
+	view->ndim = 2;
+	view->shape = ((flags & PyBUF_ND) == PyBUF_ND) ? self->shape : NULL;
+	view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? self->strides : NULL;
+	view->suboffsets = NULL;
+	view->internal = NULL;
+	Py_INCREF(self);
+	return 0;
+}
+
+static PyBufferProcs py_channels_as_buffer = {
+	(getbufferproc)py_channels_getbuffer,
+	NULL,
+};
+
+static PyMemberDef py_channels_members[] = {
+	{ (char *)"sample_rate", T_UINT, offsetof(py_channels_c, sample_rate), READONLY, (char *)"sample rate" },
+	{ (char *)"bit_per_sample", T_USHORT, offsetof(py_channels_c, bit_per_sample), READONLY, (char *)"bit per sample of the source" },
+	{ (char *)"channel_mask", T_UINT, offsetof(py_channels_c, channel_mask), READONLY, (char *)"speaker mask" },
+	{ (char *)"channels", T_PYSSIZET, offsetof(py_channels_c, shape), READONLY, (char *)"channel number" },
+	{ (char *)"frames", T_PYSSIZET, offsetof(py_channels_c, shape) + sizeof(Py_ssize_t), READONLY, (char *)"samples per channel" },
+	{ NULL },
+};
+
+static PyTypeObject py_channels_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"wavparser.Channels",
+};
+
+/**
+ * @brief
+ * copy pBuf into a new planar Channels object
+ * @param channel_step : bytes between the first samples of two channels, sample bytes when interleaved
+ * @param stride : bytes between two samples of a channel, block_align when interleaved
+ */
+static PyObject *py_channels_new(uint8_t *pBuf, uint32_t channel_step, uint32_t stride, uint16_t channels, uint16_t bit_per_sample, uint32_t frames) {
+	py_channels_c *self = PyObject_New(py_channels_c, &py_channels_type);
+	uint32_t sample_bytes = bit_per_sample / 8;
+	uint32_t ch, i;
+
+	if( self == NULL ) {
+		return NULL;
+	}
+	self->itemsize = (sample_bytes == 1) ? 1 : (sample_bytes == 2) ? 2 : 4;
+	self->format[0] = (sample_bytes == 1) ? 'B' : (sample_bytes == 2) ? 'h' : 'i';
+	self->format[1] = '\0';
+	self->shape[0] = channels;
+	self->shape[1] = frames;
+	self->strides[0] = (Py_ssize_t)frames * self->itemsize;
+	self->strides[1] = self->itemsize;
+	self->sample_rate = fmt_body.sample_rate;
+	self->bit_per_sample = bit_per_sample;
+	self->channel_mask = fmt_body.channel_mask;
+	self->buf = (uint8_t *)malloc((size_t)channels * frames * self->itemsize + 1);
+	if( self->buf == NULL ) {
+		Py_DECREF(self);
+		return PyErr_NoMemory();
+	}
+
+	for( ch=0; ch<channels; ch++ ) {
+		uint8_t *pIn = pBuf + (size_t)ch * channel_step;
+		if( sample_bytes == 1 ) {
+			uint8_t *pOut = self->buf + (size_t)ch * frames;
+			for( i=0; i<frames; i++, pIn+=stride ) {
+				pOut[i] = pIn[0];
+			}
+		} else if( sample_bytes == 2 ) {
+			sint16_t *pOut = (sint16_t *)self->buf + (size_t)ch * frames;
+			for( i=0; i<frames; i++, pIn+=stride ) {
+				pOut[i] = *(sint16_t *)pIn;
+			}
+		} else if( sample_bytes == 3 ) {
+			sint32_t *pOut = (sint32_t *)self->buf + (size_t)ch * frames;
+			for( i=0; i<frames; i++, pIn+=stride ) {
+				pOut[i] = b24_signed_to_b32_signed(pIn);
+			}
+		} else {
+			sint32_t *pOut = (sint32_t *)self->buf + (size_t)ch * frames;
+			for( i=0; i<frames; i++, pIn+=stride ) {
+				pOut[i] = *(sint32_t *)pIn;
+			}
+		}
+	}
+	return (PyObject *)self;
+}
+
+/*-------------------- INTERNAL FUNCTIONS --------------------*/
+static void py_release_raw_dump(void) {
+	bufpool_free(&gBufPool, raw_dump);
+	raw_dump = NULL;
+}
+
+static sint32_t py_read(char *path) {
+	if( wav_read_file(path) != 0 ) {
+		PyErr_Format(PyExc_IOError, "can't parse %s as a pcm / G.711 wav file", path);
+		return -1;
+	}
+	if( fmt_body.block_align == 0 || fmt_body.bit_per_sample < 8 || fmt_body.bit_per_sample > 32 || (fmt_body.bit_per_sample % 8) != 0 ) {
+		py_release_raw_dump();
+		PyErr_Format(PyExc_ValueError, "%d bit per sample is not supported", fmt_body.bit_per_sample);
+		return -1;
+	}
+	return 0;
+}
+
+/*-------------------- FUNCTIONS --------------------*/
+static PyObject *py_wavparser_read(PyObject *self, PyObject *args) {
+	char *path = NULL;
+	PyObject *ret;
+
+	if( !PyArg_ParseTuple(args, "s", &path) ) {
+		return NULL;
+	}
+	if( py_read(path) != 0 ) {
+		return NULL;
+	}
+	ret = py_channels_new(raw_dump, fmt_body.bit_per_sample/8, fmt_body.block_align, fmt_body.channels, fmt_body.bit_per_sample, block_numbers);
+	py_release_raw_dump();
+	return ret;
+}
+
+static PyObject *py_wavparser_simulate(PyObject *self, PyObject *args, PyObject *kwargs) {
+	static const char *keywords[] = { "path", "lost", "comp", "law", "sample_ratio", "period_ratio", "start", "random_offset", NULL };
+	char *path = NULL;
+	int lost = lostMethod, comp = compMethod, law = g711CodecLaw;
+	int sample_ratio = Manual_lost_sample_ratio, period_ratio = Manual_lost_period_ratio, start = Manual_lost_start_sample;
+	int random_offset = lostRandomOffsetEnable;
+	uint8_t save_lost = lostMethod, save_comp = compMethod, save_law = g711CodecLaw, save_random = lostRandomOffsetEnable;
+	uint16_t save_sample = Manual_lost_sample_ratio, save_period = Manual_lost_period_ratio, save_start = Manual_lost_start_sample;
+	PyObject *ret = NULL;
+	struct stat st;
+	uint64_t split_key, lost_key, comp_key;
+	bool fused;
+	uint32_t sample_bytes, ch;
+
+	if( !PyArg_ParseTupleAndKeywords(args, kwargs, "s|iiiiiii", (char **)keywords, &path, &lost, &comp, &law, &sample_ratio, &period_ratio, &start, &random_offset) ) {
+		return NULL;
+	}
+	if( lost < 0 || lost >= LOSTTYPE_MAX || comp < 0 || comp >= COMPTYPE_MAX || law < 0 || law >= G711LAW_MAX || sample_ratio <= 0 || period_ratio <= 0 || start < 0 ) {
+		PyErr_SetString(PyExc_ValueError, "invalid lost / compensation configuration");
+		return NULL;
+	}
+	if( stat(path, &st) != 0 ) {
+		PyErr_Format(PyExc_IOError, "can't parse %s as a pcm / G.711 wav file", path);
+		return NULL;
+	}
+
+	// split stage, the decoded planar channels are kept while the file does not change
+	split_key = stage_key(0, path, strlen(path));
+	split_key = stage_key(split_key, &st.st_size, sizeof(st.st_size));
+	split_key = stage_key(split_key, &st.st_mtim, sizeof(st.st_mtim));
+	if( stage_lookup(&gStageMemo, STAGE_SPLIT, split_key) == 0 ) {
+		if( py_read(path) != 0 ) {
+			return NULL;
+		}
+		sample_bytes = fmt_body.bit_per_sample / 8;
+		if( proc_kernel_select(fmt_body.bit_per_sample, LOSTTYPE_NONE, COMPTYPE_NONE, 0) != 0 || stage_reserve(&gStageMemo, STAGE_SPLIT, fmt_body.channels, block_numbers * sample_bytes) != 0 ) {
+			py_release_raw_dump();
+			PyErr_NoMemory();
+			return NULL;
+		}
+		for( ch=0; ch<fmt_body.channels; ch++ ) {
+			gProcKernel.split(raw_dump + ch * sample_bytes, fmt_body.block_align, stage_channel(&gStageMemo, STAGE_SPLIT, ch), block_numbers);
+		}
+		memcpy(&gStageMemo.fmt_body, &fmt_body, sizeof(fmt_chunk_body));
+		gStageMemo.frames = block_numbers;
+		py_release_raw_dump();
+		stage_commit(&gStageMemo, STAGE_SPLIT, split_key);
+	}
+	memcpy(&fmt_body, &gStageMemo.fmt_body, sizeof(fmt_chunk_body));
+	block_numbers = gStageMemo.frames;
+
+	sample_bytes = fmt_body.bit_per_sample / 8;
+	single_channel_size = block_numbers * sample_bytes;
+	memcpy(&fmt_single_body, &fmt_body, sizeof(fmt_chunk_body));
+	fmt_single_body.channels = 1;
+	fmt_single_body.block_align = sample_bytes;
+	fmt_single_body.byte_per_sec = fmt_single_body.sample_rate * sample_bytes;
+
+	single_channel_dump = (uint8_t *)bufpool_alloc(&gBufPool, single_channel_size);
+	if( single_channel_dump == NULL ) {
+		PyErr_NoMemory();
+		goto EXIT;
+	}
+
+	lostMethod = (uint8_t)lost;
+	compMethod = (uint8_t)comp;
+	g711CodecLaw = (uint8_t)law;
+	Manual_lost_sample_ratio = (uint16_t)sample_ratio;
+	Manual_lost_period_ratio = (uint16_t)period_ratio;
+	Manual_lost_start_sample = (uint16_t)start;
+	lostRandomOffsetEnable = (uint8_t)random_offset;
+
+	if( proc_kernel_select(fmt_body.bit_per_sample, lostMethod, compMethod, lostRandomOffsetEnable) != 0 ) {
+		PyErr_SetString(PyExc_ValueError, "bit/sample not supported by the lost / compensation kernels");
+		goto EXIT;
+	}
+
+	// lost stage, reused when only the compensation changes. The G.711 PLC keeps the frame lost
+	// record of the channel in process only, so it runs in the channel pass of the lost
+	lost_key = Model_LostKey(split_key);
+	comp_key = stage_key(lost_key, &compMethod, sizeof(compMethod));
+	fused = ( compMethod == COMPTYPE_G711_VOIP );
+	if( stage_lookup(&gStageMemo, STAGE_LOST, fused ? 0 : lost_key) == 0 ) {
+		if( stage_reserve(&gStageMemo, STAGE_LOST, fmt_body.channels, single_channel_size) != 0 || stage_reserve(&gStageMemo, STAGE_COMP, fmt_body.channels, single_channel_size) != 0 ) {
+			PyErr_NoMemory();
+			goto EXIT;
+		}
+		for( ch=0; ch<fmt_body.channels; ch++ ) {
+			memcpy(single_channel_dump, stage_channel(&gStageMemo, STAGE_SPLIT, ch), single_channel_size);
+			Model_DataLost();
+			memcpy(stage_channel(&gStageMemo, STAGE_LOST, ch), single_channel_dump, single_channel_size);
+			stage_save_gap(&gStageMemo, ch, &gLostGap);
+			if( fused ) {
+				Model_Compensation();
+				memcpy(stage_channel(&gStageMemo, STAGE_COMP, ch), single_channel_dump, single_channel_size);
+			}
+		}
+		// a random offset is drawn again on every call, never reused
+		stage_commit(&gStageMemo, STAGE_LOST, ( lostRandomOffsetEnable != 0 ) ? 0 : lost_key);
+		if( fused ) {
+			stage_commit(&gStageMemo, STAGE_COMP, ( lostRandomOffsetEnable != 0 ) ? 0 : comp_key);
+		}
+	}
+
+	// compensation stage
+	if( !fused && stage_lookup(&gStageMemo, STAGE_COMP, comp_key) == 0 ) {
+		if( stage_reserve(&gStageMemo, STAGE_COMP, fmt_body.channels, single_channel_size) != 0 ) {
+			PyErr_NoMemory();
+			goto EXIT;
+		}
+		for( ch=0; ch<fmt_body.channels; ch++ ) {
+			memcpy(single_channel_dump, stage_channel(&gStageMemo, STAGE_LOST, ch), single_channel_size);
+			stage_load_gap(&gStageMemo, ch, &gLostGap);
+			Model_Compensation();
+			memcpy(stage_channel(&gStageMemo, STAGE_COMP, ch), single_channel_dump, single_channel_size);
+		}
+		stage_commit(&gStageMemo, STAGE_COMP, ( lostRandomOffsetEnable != 0 ) ? 0 : comp_key);
+	}
+
+	{
+		PyObject *pyGolden = py_channels_new(stage_channel(&gStageMemo, STAGE_SPLIT, 0), single_channel_size, sample_bytes, fmt_body.channels, fmt_body.bit_per_sample, block_numbers);
+		PyObject *pyLost = py_channels_new(stage_channel(&gStageMemo, STAGE_LOST, 0), single_channel_size, sample_bytes, fmt_body.channels, fmt_body.bit_per_sample, block_numbers);
+		PyObject *pyComp = py_channels_new(stage_channel(&gStageMemo, STAGE_COMP, 0), single_channel_size, sample_bytes, fmt_body.channels, fmt_body.bit_per_sample, block_numbers);
+		if( pyGolden != NULL && pyLost != NULL && pyComp != NULL ) {
+			ret = PyTuple_Pack(3, pyGolden, pyLost, pyComp);
+		}
+		Py_XDECREF(pyGolden);
+		Py_XDECREF(pyLost);
+		Py_XDECREF(pyComp);
+	}
+
+EXIT:
+	lostMethod = save_lost;
+	compMethod = save_comp;
+	g711CodecLaw = save_law;
+	lostRandomOffsetEnable = save_random;
+	Manual_lost_sample_ratio = save_sample;
+	Manual_lost_period_ratio = save_period;
+	Manual_lost_start_sample = save_start;
+	bufpool_free(&gBufPool, single_channel_dump);
+	single_channel_dump = NULL;
+	return ret;
+}
+
+static PyObject *py_wavparser_stages(PyObject *self, PyObject *args) {
+	PyObject *ret = PyDict_New();
+	uint8_t s;
+
+	for( s=0; s<STAGE_MAX && ret != NULL; s++ ) {
+		PyObject *count = Py_BuildValue("(II)", gStageMemo.result[s].run_cnt, gStageMemo.result[s].reuse_cnt);
+		if( count == NULL || PyDict_SetItemString(ret, stage_name[s], count) != 0 ) {
+			Py_XDECREF(count);
+			Py_DECREF(ret);
+			return NULL;
+		}
+		Py_DECREF(count);
+	}
+	return ret;
+}
+
+static PyObject *py_wavparser_simd(PyObject *self, PyObject *args) {
+	int isa = -1;
+
+	if( !PyArg_ParseTuple(args, "|i", &isa) ) {
+		return NULL;
+	}
+	if( isa >= SIMDISA_MAX ) {
+		PyErr_SetString(PyExc_ValueError, "invalid instruction set");
+		return NULL;
+	}
+	if( isa >= 0 ) {
+		dsp_kernel_init((uint8_t)isa);
+		g711codec_init();
+	}
+	return Py_BuildValue("(ss)", simdisa_name[gDspKernel.isa], simdisa_name[gDspKernel.isa_cpu]);
+}
+
+static PyObject *py_wavparser_kernel_check(PyObject *self, PyObject *args) {
+	PyObject *ret;
+	Py_ssize_t f;
+	uint32_t i;
+	uint16_t ch;
+	char signal[sizeof(gKernelCheck.result[0].signal)];
+
+	kcheck_release(&gKernelCheck);
+	kcheck_run(&gKernelCheck);
+
+	// corpus channels, every argument is a wav file
+	for( f=0; f<PyTuple_Size(args); f++ ) {
+		const char *path = PyUnicode_AsUTF8(PyTuple_GetItem(args, f));
+		const char *base;
+		uint32_t sample_bytes;
+		uint8_t *chn;
+		if( path == NULL || py_read((char *)path) != 0 ) {
+			return NULL;
+		}
+		sample_bytes = fmt_body.bit_per_sample / 8;
+		chn = (uint8_t *)bufpool_alloc(&gBufPool, (size_t)block_numbers * sample_bytes);
+		if( chn == NULL || proc_kernel_select(fmt_body.bit_per_sample, LOSTTYPE_NONE, COMPTYPE_NONE, 0) != 0 ) {
+			bufpool_free(&gBufPool, chn);
+			py_release_raw_dump();
+			PyErr_NoMemory();
+			return NULL;
+		}
+		base = strrchr(path, '/');
+		base = (base != NULL) ? base + 1 : path;
+		for( ch=0; ch<fmt_body.channels; ch++ ) {
+			gProcKernel.split(raw_dump + ch * sample_bytes, fmt_body.block_align, chn, block_numbers);
+			snprintf(signal, sizeof(signal), "%s CH%d", base, ch);
+			kcheck_channel(&gKernelCheck, signal, chn, fmt_body.bit_per_sample, fmt_body.sample_rate, block_numbers);
+		}
+		bufpool_free(&gBufPool, chn);
+		py_release_raw_dump();
+	}
+
+	ret = PyList_New(0);
+	for( i=0; i<gKernelCheck.num && ret != NULL; i++ ) {
+		kcheck_result_c *r = &gKernelCheck.result[i];
+		PyObject *row = Py_BuildValue("{s:s,s:s,s:s,s:I,s:I,s:i,s:d,s:d,s:d,s:d,s:d,s:O}",
+			"kernel", r->kernel, "variant", r->variant, "signal", r->signal, "num", r->num, "differ", r->diff_cnt,
+			"first", r->first, "ref", r->ref, "got", r->got, "max_err", r->max_err, "rms_err", r->rms_err, "tol", r->tol,
+			"pass", (r->pass != 0) ? Py_True : Py_False);
+		if( row == NULL || PyList_Append(ret, row) != 0 ) {
+			Py_XDECREF(row);
+			Py_DECREF(ret);
+			return NULL;
+		}
+		Py_DECREF(row);
+	}
+	return ret;
+}
+
+static PyObject *py_wavparser_catalog(PyObject *self, PyObject *args) {
+	const char *path = NULL, *root = NULL;
+	int threads = 4;
+	catalog_c cat;
+	PyObject *ret;
+	uint32_t i;
+
+	if( !PyArg_ParseTuple(args, "s|zi", &path, &root, &threads) ) {
+		return NULL;
+	}
+	memset(&cat, 0x0, sizeof(catalog_c));
+	if( root != NULL ) {
+		// path is the name of the new index, without extension
+		char bin[1024];
+		if( catalog_scan(&cat, root, (uint8_t)((threads > 0 && threads < CATALOG_THREAD_MAX) ? threads : CATALOG_THREAD_MAX)) != 0 || catalog_write(&cat, path, 0) != 0 ) {
+			catalog_release(&cat);
+			PyErr_Format(PyExc_IOError, "can't write the catalog %s of %s", path, root);
+			return NULL;
+		}
+		snprintf(bin, sizeof(bin), "%s.bin", path);
+		catalog_release(&cat);
+		path = NULL;
+		if( catalog_load(&cat, bin) != 0 ) {
+			PyErr_Format(PyExc_IOError, "can't load the catalog %s", bin);
+			return NULL;
+		}
+	} else if( catalog_load(&cat, path) != 0 ) {
+		PyErr_Format(PyExc_IOError, "can't load the catalog %s", path);
+		return NULL;
+	}
+
+	ret = PyList_New(0);
+	for( i=0; i<cat.head.files && ret != NULL; i++ ) {
+		catalog_entry_c *e = &cat.entry[i];
+		PyObject *row = Py_BuildValue("{s:s,s:I,s:I,s:I,s:I,s:I,s:I,s:I,s:I,s:d,s:K,s:I,s:K,s:L}",
+			"path", cat.pool + e->path, "status", e->status, "format_tag", e->format_tag, "sample_rate", e->sample_rate,
+			"channels", e->channels, "bit_per_sample", e->bit_per_sample, "block_align", e->block_align,
+			"channel_mask", e->channel_mask, "frames", e->frames, "duration", e->duration,
+			"data_offset", (unsigned long long)e->data_offset, "data_size", e->data_size,
+			"file_size", (unsigned long long)e->file_size, "mtime", (long long)e->mtime);
+		if( row == NULL || PyList_Append(ret, row) != 0 ) {
+			Py_XDECREF(row);
+			Py_DECREF(ret);
+			ret = NULL;
+			break;
+		}
+		Py_DECREF(row);
+	}
+	catalog_release(&cat);
+	return ret;
+}
+
+static PyMethodDef py_wavparser_methods[] = {
+	{ "read", (PyCFunction)py_wavparser_read, METH_VARARGS,
+	  "read(path) -> Channels\nparse a wav file, the channels are a planar (channels, frames) buffer" },
+	{ "simulate", (PyCFunction)(void (*)(void))py_wavparser_simulate, METH_VARARGS | METH_KEYWORDS,
+	  "simulate(path, lost, comp, law, sample_ratio, period_ratio, start, random_offset) -> (golden, lost, concealed)\n"
+	  "run the data lost and compensation on every channel, unset arguments keep the values of param.c,\n"
+	  "the split and lost results of the previous call are reused when only the later parameters changed" },
+	{ "stages", (PyCFunction)py_wavparser_stages, METH_NOARGS,
+	  "stages() -> {stage: (run, reused)}\ncounters of the stage results kept by simulate()" },
+	{ "simd", (PyCFunction)py_wavparser_simd, METH_VARARGS,
+	  "simd(isa) -> (bound, cpu)\nrebind the dsp kernels to ISA_xxx (ISA_AUTO for the best of the cpu), no argument only reports" },
+	{ "kernel_check", (PyCFunction)py_wavparser_kernel_check, METH_VARARGS,
+	  "kernel_check(*paths) -> [result]\ncompare every optimized kernel with the scalar reference on the generated signals\n"
+	  "and the channels of the given wav files, one dict per kernel, variant and signal" },
+	{ "catalog", (PyCFunction)py_wavparser_catalog, METH_VARARGS,
+	  "catalog(path, root=None, threads=4) -> [entry]\nload the binary index path of RUNMODE_CATALOG, one dict per file, with root\n"
+	  "scan the tree first and write the index to path.bin" },
+	{ NULL, NULL, 0, NULL },
+};
+
+static struct PyModuleDef py_wavparser_module = {
+	PyModuleDef_HEAD_INIT,
+	"wavparser",
+	"wav reader, data lost models and compensators of WaveFileParser",
+	-1,
+	py_wavparser_methods,
+};
+
+static void py_add_constants(PyObject *module, const char *prefix, char (*names)[32], uint8_t num) {
+	char key[64];
+	uint8_t i;
+	for( i=0; i<num; i++ ) {
+		snprintf(key, sizeof(key), "%s%s", prefix, names[i]);
+		PyModule_AddIntConstant(module, key, i);
+	}
+}
+
+PyMODINIT_FUNC PyInit_wavparser(void) {
+	PyObject *module;
+
+	py_channels_type.tp_basicsize = sizeof(py_channels_c);
+	py_channels_type.tp_dealloc = (destructor)py_channels_dealloc;
+	py_channels_type.tp_flags = Py_TPFLAGS_DEFAULT;
+	py_channels_type.tp_doc = "planar channels, (channels, frames), exported with the buffer protocol";
+	py_channels_type.tp_as_buffer = &py_channels_as_buffer;
+	py_channels_type.tp_members = py_channels_members;
+	if( PyType_Ready(&py_channels_type) < 0 ) {
+		return NULL;
+	}
+
+	module = PyModule_Create(&py_wavparser_module);
+	if( module == NULL ) {
+		return NULL;
+	}
+	Py_INCREF(&py_channels_type);
+	PyModule_AddObject(module, "Channels", (PyObject *)&py_channels_type);
+	py_add_constants(module, "LOST_", losttype_name, LOSTTYPE_MAX);
+	py_add_constants(module, "COMP_", comptype_name, COMPTYPE_MAX);
+	py_add_constants(module, "LAW_", g711law_name, G711LAW_MAX);
+	py_add_constants(module, "ISA_", simdisa_name, SIMDISA_MAX);
+
+	dsp_kernel_init(gSimdIsaForce);
+	g711codec_init();
+	bufpool_init(&gBufPool);
+	return module;
+}
+#endif
@@ -0,0 +1,225 @@
+/**
+ * @file resampler.c
+ * @author weiyuan.hsu
+ * @brief
+ * implement of polyphase sample rate converter
+ *
+ * resampler_get: .......... Return the filter bank for in_rate -> out_rate. The ratio is reduced to
+ * 							 up/down by gcd, a kaiser windowed sinc prototype at up*in_rate is designed
+ * 							 with the cutoff at the lower nyquist and split into up phases. Each phase is
+ * 							 stored reversed and normalized to unity DC gain. Banks are cached, so a batch
+ * 							 of files with the same rate designs the filter once.
+ *
+ * resampler_process: ...... Output sample n sits at input position n*down/up. The phase is the remainder,
+ * 							 the output is the dot product of the phase taps with the input window, done
+ * 							 with AVX2/SSE2 when available.
+ *
+ * resampler_convert_interleaved: Resample every channel of an interleaved pcm buffer.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "arch.h"
+#include "config.h"
+#include "utility.h"
+#include "resampler.h"
+#include "bufferPool.h"
+#include "dspKernel.h"
+
+/*-------------------- GLOBAL PARAMETER --------------------*/
+static resampler_c resampler_cache[RESAMPLER_CACHE_NUM];
+static uint32_t resampler_cache_next = 0;
+
+/*-------------------- INTERNAL FUNCTIONS --------------------*/
+static uint32_t resampler_gcd(uint32_t a, uint32_t b) {
+	while (b) {
+		uint32_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/**
+ * @brief
+ * zero order modified bessel function of the first kind, for the kaiser window
+ */
+static double resampler_bessel_i0(double x) {
+	double sum = 1.0, term = 1.0;
+	sint32_t k;
+	for (k = 1; k < 64; k++) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+		if (term < sum * 1e-12) {
+			break;
+		}
+	}
+	return sum;
+}
+
+static sint32_t resampler_design(resampler_c *rs, uint32_t in_rate, uint32_t out_rate) {
+	uint32_t g = resampler_gcd(in_rate, out_rate);
+	uint32_t p, k, half;
+	double fc, center, i0beta;
+	double *proto;
+
+	rs->in_rate = in_rate;
+	rs->out_rate = out_rate;
+	rs->up = out_rate / g;
+	rs->down = in_rate / g;
+	fc = ((rs->up < rs->down) ? (double)rs->up / rs->down : 1.0) * RESAMPLER_ROLLOFF;
+	rs->taps = 2 * (uint32_t)ceil(RESAMPLER_ZERO_CROSSINGS / fc);
+	rs->taps = (rs->taps + RESAMPLER_TAP_ALIGN - 1) / RESAMPLER_TAP_ALIGN * RESAMPLER_TAP_ALIGN;
+	if( (uint64_t)rs->up * rs->taps > RESAMPLER_BANK_MAX ) {
+		printf("resampler : ratio %d/%d needs a too large filter bank\n", rs->up, rs->down);
+		return -1;
+	}
+
+	half = rs->taps / 2;
+	center = (double)half * rs->up;
+	i0beta = resampler_bessel_i0(RESAMPLER_KAISER_BETA);
+	proto = (double *)malloc(sizeof(double) * rs->up * rs->taps);
+	rs->bank = (float *)malloc(sizeof(float) * rs->up * rs->taps);
+	if( proto == NULL || rs->bank == NULL ) {
+		printf("Allocation memory error");
+		free(proto);
+		free(rs->bank);
+		rs->bank = NULL;
+		return -1;
+	}
+
+	/* prototype low pass at up*in_rate, time in input sample units */
+	for( k=0; k<rs->up*rs->taps; k++ ) {
+		double t = ((double)k - center) / rs->up;
+		double x = fc * t;
+		double sinc = (x == 0.0) ? 1.0 : sin(M_PI * x) / (M_PI * x);
+		double r = ((double)k - center) / center;
+		double win = (r * r >= 1.0) ? 0.0 : resampler_bessel_i0(RESAMPLER_KAISER_BETA * sqrt(1.0 - r * r)) / i0beta;
+		proto[k] = fc * sinc * win;
+	}
+
+	/* split into phases, reversed so the inner loop walks input and taps forward */
+	for( p=0; p<rs->up; p++ ) {
+		double sum = 0.0;
+		for( k=0; k<rs->taps; k++ ) {
+			sum += proto[p + k * rs->up];
+		}
+		for( k=0; k<rs->taps; k++ ) {
+			rs->bank[p * rs->taps + (rs->taps - 1 - k)] = (float)(proto[p + k * rs->up] / sum);
+		}
+	}
+	free(proto);
+	return 0;
+}
+
+/*-------------------- FUNCTIONS --------------------*/
+resampler_c *resampler_get(uint32_t in_rate, uint32_t out_rate) {
+	uint32_t i;
+	resampler_c *rs;
+	if( in_rate == 0 || out_rate == 0 ) {
+		return NULL;
+	}
+	for( i=0; i<RESAMPLER_CACHE_NUM; i++ ) {
+		if( resampler_cache[i].bank != NULL && resampler_cache[i].in_rate == in_rate && resampler_cache[i].out_rate == out_rate ) {
+			return &resampler_cache[i];
+		}
+	}
+	rs = &resampler_cache[resampler_cache_next];
+	resampler_cache_next = (resampler_cache_next + 1) % RESAMPLER_CACHE_NUM;
+	if( rs->bank != NULL ) {
+		free(rs->bank);
+		rs->bank = NULL;
+	}
+	if( resampler_design(rs, in_rate, out_rate) != 0 ) {
+		return NULL;
+	}
+	printf("resampler : %d -> %d, up %d, down %d, taps %d\n", in_rate, out_rate, rs->up, rs->down, rs->taps);
+	return rs;
+}
+
+void resampler_release_all(void) {
+	uint32_t i;
+	for( i=0; i<RESAMPLER_CACHE_NUM; i++ ) {
+		if( resampler_cache[i].bank != NULL ) {
+			free(resampler_cache[i].bank);
+			resampler_cache[i].bank = NULL;
+		}
+	}
+}
+
+uint32_t resampler_out_len(resampler_c *rs, uint32_t in_len) {
+	return (uint32_t)(((uint64_t)in_len * rs->up + rs->down - 1) / rs->down);
+}
+
+/**
+ * @brief
+ * resample a whole buffer, input outside [0, in_len) is taken as zero
+ * @param out_len : output sample number, usually resampler_out_len() or the original
+ *                  length when converting back
+ */
+void resampler_process(resampler_c *rs, float *in, uint32_t in_len, float *out, uint32_t out_len) {
+	uint32_t n, half = rs->taps / 2;
+	uint32_t q = 0, p = 0;
+	uint32_t qstep = rs->down / rs->up, pstep = rs->down % rs->up;
+	uint32_t pad_len = in_len + 2 * rs->taps + qstep + 1;
+	float *pad = (float *)bufpool_calloc(&gBufPool, pad_len * sizeof(float));
+	if( pad == NULL ) {
+		printf("Allocation memory error");
+		return;
+	}
+	memcpy(&pad[rs->taps], in, in_len * sizeof(float));
+
+	/* window of output n starts at input q - half + 1, q = n*down/up */
+	for( n=0; n<out_len; n++ ) {
+		uint32_t start = q + rs->taps - half + 1;
+		out[n] = (start + rs->taps <= pad_len) ? gDspKernel.dot(&pad[start], &rs->bank[p * rs->taps], rs->taps) : 0.0f;
+		q += qstep;
+		p += pstep;
+		if( p >= rs->up ) {
+			p -= rs->up;
+			q++;
+		}
+	}
+	bufpool_free(&gBufPool, pad);
+}
+
+/**
+ * @brief
+ * resample every channel of an interleaved pcm buffer
+ * @return uint8_t* : new interleaved buffer from gBufPool (caller frees), NULL if fail
+ */
+uint8_t *resampler_convert_interleaved(uint8_t *in, uint16_t channels, uint16_t bit_per_sample, uint32_t in_rate, uint32_t in_frames, uint32_t out_rate, uint32_t *out_frames) {
+	resampler_c *rs = resampler_get(in_rate, out_rate);
+	uint32_t sample_bytes = bit_per_sample / 8;
+	uint32_t frame_bytes = sample_bytes * channels;
+	uint8_t *out = NULL;
+	float *fin = NULL, *fout = NULL;
+	uint16_t ch;
+
+	if( rs == NULL ) {
+		return NULL;
+	}
+	*out_frames = resampler_out_len(rs, in_frames);
+	out = (uint8_t *)bufpool_alloc(&gBufPool, (size_t)(*out_frames) * frame_bytes);
+	fin = (float *)bufpool_alloc(&gBufPool, sizeof(float) * in_frames);
+	fout = (float *)bufpool_alloc(&gBufPool, sizeof(float) * (*out_frames));
+	if( out == NULL || fin == NULL || fout == NULL ) {
+		printf("Allocation memory error");
+		bufpool_free(&gBufPool, out);
+		out = NULL;
+	} else {
+		for( ch=0; ch<channels; ch++ ) {
+			pcm_to_float(in + ch * sample_bytes, bit_per_sample, frame_bytes, fin, in_frames);
+			resampler_process(rs, fin, in_frames, fout, *out_frames);
+			float_to_pcm(fout, bit_per_sample, frame_bytes, out + ch * sample_bytes, *out_frames);
+		}
+	}
+	bufpool_free(&gBufPool, fin);
+	bufpool_free(&gBufPool, fout);
+	return out;
+}
@@ -0,0 +1,32 @@
+#ifndef _H_RESAMPLER_
+#define _H_RESAMPLER_
+
+#include "arch.h"
+
+// polyphase sample rate converter for arbitrary rational ratio (out_rate/in_rate = up/down)
+
+/*-------------------- CONFIGURATION --------------------*/
+#define RESAMPLER_ZERO_CROSSINGS (16) /* sinc zero crossings on each side of the center */
+#define RESAMPLER_ROLLOFF (0.94) /* cutoff as a fraction of the lower nyquist */
+#define RESAMPLER_KAISER_BETA (8.0) /* kaiser window shape */
+#define RESAMPLER_TAP_ALIGN (8) /* taps per phase rounded up for the SIMD dot product */
+#define RESAMPLER_BANK_MAX (1 << 22) /* maximum filter bank size in coefficients */
+#define RESAMPLER_CACHE_NUM (8) /* filter banks kept for reuse across files */
+
+typedef struct _resampler_c {
+	uint32_t in_rate;
+	uint32_t out_rate;
+	uint32_t up;			/* L : interpolation factor */
+	uint32_t down;			/* M : decimation factor */
+	uint32_t taps;			/* taps per phase */
+	float *bank;			/* [up][taps] filter bank, taps reversed per phase */
+} resampler_c;
+
+/*-------------------- FUNCTIONS --------------------*/
+resampler_c *resampler_get(uint32_t in_rate, uint32_t out_rate); /* cached filter bank, NULL if ratio not supported */
+void resampler_release_all(void);
+uint32_t resampler_out_len(resampler_c *rs, uint32_t in_len);
+void resampler_process(resampler_c *rs, float *in, uint32_t in_len, float *out, uint32_t out_len);
+uint8_t *resampler_convert_interleaved(uint8_t *in, uint16_t channels, uint16_t bit_per_sample, uint32_t in_rate, uint32_t in_frames, uint32_t out_rate, uint32_t *out_frames);
+
+#endif
@@ -0,0 +1,243 @@
+/**
+ * @file spectralConceal.c
+ * @author weiyuan.hsu
+ * @brief
+ * implement of the stft spectral concealment
+ *
+ * spectral_extrapolate: ... Two hann windowed frames one hop apart end right before the gap. Every bin
+ * 							 keeps the magnitude of the last frame and turns by the phase advance measured
+ * 							 between the two frames, r = B conj(A) / |B conj(A)|, so no trigonometry is
+ * 							 needed per frame. The extrapolated frames are inverse transformed and overlap
+ * 							 added with the synthesis window over the gap, normalized by the window power.
+ *
+ * spectral_conceal: ....... Each gap is extrapolated forward from the samples before it and backward from
+ * 							 the (time reversed) samples after it, the two estimates are cross faded with
+ * 							 a raised cosine so the gap joins the signal at both ends. The frame shrinks
+ * 							 when the clean context around a gap is short, a side without enough context
+ * 							 is skipped, and very short gaps are bridged by a straight line. Only the gap
+ * 							 samples are written back, the rest of the channel stays bit exact.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "arch.h"
+#include "config.h"
+#include "utility.h"
+#include "fft.h"
+#include "lostGap.h"
+#include "spectralConceal.h"
+#include "bufferPool.h"
+
+/*-------------------- CONFIGURATION --------------------*/
+typedef struct _spectral_work_c {
+	float *ctx;					/* reversed context of the backward extrapolation */
+	float *frame;
+	float *win;
+	uint32_t win_n;				/* size of the window in win */
+	float *reA, *imA;			/* older analysis frame, then the hop rotation */
+	float *reB, *imB;			/* newer analysis frame, then the extrapolated spectrum */
+	float *reT, *imT;			/* copy for the inverse transform */
+	float *fwd, *bwd, *norm;	/* gap length */
+} spectral_work_c;
+
+/*-------------------- INTERNAL FUNCTIONS --------------------*/
+/**
+ * @brief
+ * stft frame for the sample rate, halved until frame + hop fits in the clean context
+ * @return uint32_t : 0 if even the smallest frame does not fit
+ */
+static uint32_t spectral_frame_size(uint32_t sample_rate, uint32_t avail) {
+	uint32_t n = SPECTRAL_FRAME_MIN;
+	while( n < SPECTRAL_FRAME_MAX && (uint64_t)n * 48000 < (uint64_t)SPECTRAL_FRAME_REF * sample_rate ) {
+		n <<= 1;
+	}
+	while( n > SPECTRAL_FRAME_MIN && n + n / SPECTRAL_HOP_DIV > avail ) {
+		n >>= 1;
+	}
+	return (n + n / SPECTRAL_HOP_DIV <= avail) ? n : 0;
+}
+
+static void spectral_window(spectral_work_c *w, uint32_t n) {
+	uint32_t i;
+	if( w->win_n == n ) {
+		return;
+	}
+	for( i=0; i<n; i++ ) {
+		w->win[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * i / n));
+	}
+	w->win_n = n;
+}
+
+/**
+ * @brief
+ * extrapolate len samples after ctx
+ * @param ctx : n + n/4 clean samples, the last one is right before the gap
+ */
+static void spectral_extrapolate(spectral_work_c *w, const float *ctx, uint32_t n, uint32_t len, float *out) {
+	fft_c *fft = fft_get(n);
+	uint32_t h = n / SPECTRAL_HOP_DIV, bins = n / 2 + 1;
+	uint32_t i, k, m;
+
+	memset(out, 0x0, sizeof(float) * len);
+	if( fft == NULL ) {
+		return;
+	}
+	spectral_window(w, n);
+
+	for( i=0; i<n; i++ ) {
+		w->frame[i] = ctx[i] * w->win[i];
+	}
+	fft_forward(fft, w->frame, w->reA, w->imA);
+	for( i=0; i<n; i++ ) {
+		w->frame[i] = ctx[h + i] * w->win[i];
+	}
+	fft_forward(fft, w->frame, w->reB, w->imB);
+
+	/* phase advance of one hop as a unit rotation */
+	for( k=0; k<bins; k++ ) {
+		float pr = w->reB[k] * w->reA[k] + w->imB[k] * w->imA[k];
+		float pi = w->imB[k] * w->reA[k] - w->reB[k] * w->imA[k];
+		float mag = sqrtf(pr * pr + pi * pi);
+		w->reA[k] = (mag > 1e-20f) ? pr / mag : 1.0f;
+		w->imA[k] = (mag > 1e-20f) ? pi / mag : 0.0f;
+	}
+
+	memset(w->norm, 0x0, sizeof(float) * len);
+	/* frame m covers [m*h - n, m*h) from the gap start */
+	for( m=1; m*h<len+n; m++ ) {
+		sint32_t off = (sint32_t)(m * h) - (sint32_t)n;
+		uint32_t i0 = (off < 0) ? (uint32_t)(-off) : 0;
+		uint32_t i1 = ((sint64_t)len - off < (sint64_t)n) ? (uint32_t)(len - off) : n;
+
+		for( k=0; k<bins; k++ ) {
+			float yr = w->reB[k] * w->reA[k] - w->imB[k] * w->imA[k];
+			float yi = w->reB[k] * w->imA[k] + w->imB[k] * w->reA[k];
+			w->reB[k] = w->reT[k] = yr;
+			w->imB[k] = w->imT[k] = yi;
+		}
+		fft_inverse(fft, w->reT, w->imT, w->frame);
+		for( i=i0; i<i1; i++ ) {
+			out[off + i] += w->frame[i] * w->win[i];
+			w->norm[off + i] += w->win[i] * w->win[i];
+		}
+	}
+	for( i=0; i<len; i++ ) {
+		out[i] = (w->norm[i] > 1e-6f) ? out[i] / w->norm[i] : 0.0f;
+	}
+}
+
+static void spectral_line(float *x, uint32_t num, uint32_t s, uint32_t len) {
+	uint32_t j;
+	/* a gap at the channel edge stays muted */
+	if( s == 0 || s + len >= num ) {
+		memset(&x[s], 0x0, sizeof(float) * len);
+		return;
+	}
+	for( j=0; j<len; j++ ) {
+		x[s + j] = x[s - 1] + (x[s + len] - x[s - 1]) * (float)(j + 1) / (float)(len + 1);
+	}
+}
+
+static void spectral_work_free(spectral_work_c *w) {
+	bufpool_free(&gBufPool, w->ctx);
+	bufpool_free(&gBufPool, w->frame);
+	bufpool_free(&gBufPool, w->win);
+	bufpool_free(&gBufPool, w->reA);
+	bufpool_free(&gBufPool, w->fwd);
+}
+
+static sint32_t spectral_work_alloc(spectral_work_c *w, uint32_t gap_max) {
+	uint32_t bins = SPECTRAL_FRAME_MAX / 2 + 1;
+	memset(w, 0x0, sizeof(spectral_work_c));
+	w->ctx = (float *)bufpool_alloc(&gBufPool, sizeof(float) * (SPECTRAL_FRAME_MAX + SPECTRAL_FRAME_MAX / SPECTRAL_HOP_DIV));
+	w->frame = (float *)bufpool_alloc(&gBufPool, sizeof(float) * SPECTRAL_FRAME_MAX);
+	w->win = (float *)bufpool_alloc(&gBufPool, sizeof(float) * SPECTRAL_FRAME_MAX);
+	w->reA = (float *)bufpool_alloc(&gBufPool, sizeof(float) * bins * 6);
+	w->fwd = (float *)bufpool_alloc(&gBufPool, sizeof(float) * gap_max * 3);
+	if( w->ctx == NULL || w->frame == NULL || w->win == NULL || w->reA == NULL || w->fwd == NULL ) {
+		spectral_work_free(w);
+		return -1;
+	}
+	w->imA = w->reA + bins;
+	w->reB = w->imA + bins;
+	w->imB = w->reB + bins;
+	w->reT = w->imB + bins;
+	w->imT = w->reT + bins;
+	w->bwd = w->fwd + gap_max;
+	w->norm = w->bwd + gap_max;
+	return 0;
+}
+
+/*-------------------- FUNCTIONS --------------------*/
+/**
+ * @brief
+ * conceal every gap of the list in a single channel pcm buffer
+ */
+void spectral_conceal(uint8_t *pBuf, uint16_t bit_per_sample, uint32_t sample_rate, lost_gap_list_c *list) {
+	uint32_t sample_bytes = bit_per_sample / 8;
+	uint32_t num = list->samples;
+	uint32_t g, t, gap_max = 1;
+	spectral_work_c w;
+	float *x;
+
+	if( list->num == 0 ) {
+		return;
+	}
+	for( g=0; g<list->num; g++ ) {
+		gap_max = (list->gap[g].len > gap_max) ? list->gap[g].len : gap_max;
+	}
+	x = (float *)bufpool_alloc(&gBufPool, sizeof(float) * num);
+	if( x == NULL || spectral_work_alloc(&w, gap_max) != 0 ) {
+		printf("Allocation memory error");
+		bufpool_free(&gBufPool, x);
+		return;
+	}
+	pcm_to_float(pBuf, bit_per_sample, sample_bytes, x, num);
+
+	for( g=0; g<list->num; g++ ) {
+		uint32_t s = list->gap[g].start, len = list->gap[g].len, e = s + len;
+		uint32_t next = (g + 1 < list->num) ? list->gap[g+1].start : num;
+		uint32_t nf = 0, nb = 0;
+
+		if( len >= SPECTRAL_GAP_MIN ) {
+			/* gaps before are concealed already, gaps after are not */
+			nf = spectral_frame_size(sample_rate, s);
+			nb = spectral_frame_size(sample_rate, next - e);
+		}
+		if( nf != 0 ) {
+			spectral_extrapolate(&w, &x[s - nf - nf / SPECTRAL_HOP_DIV], nf, len, w.fwd);
+		}
+		if( nb != 0 ) {
+			uint32_t ctx_len = nb + nb / SPECTRAL_HOP_DIV;
+			for( t=0; t<ctx_len; t++ ) {
+				w.ctx[t] = x[e + ctx_len - 1 - t];
+			}
+			spectral_extrapolate(&w, w.ctx, nb, len, w.bwd);
+		}
+
+		if( nf != 0 && nb != 0 ) {
+			for( t=0; t<len; t++ ) {
+				float c = sinf((float)M_PI * 0.5f * (float)(t + 1) / (float)(len + 1));
+				c *= c;
+				x[s + t] = (1.0f - c) * w.fwd[t] + c * w.bwd[len - 1 - t];
+			}
+		} else if( nf != 0 ) {
+			memcpy(&x[s], w.fwd, sizeof(float) * len);
+		} else if( nb != 0 ) {
+			for( t=0; t<len; t++ ) {
+				x[s + t] = w.bwd[len - 1 - t];
+			}
+		} else {
+			spectral_line(x, num, s, len);
+		}
+		float_to_pcm(&x[s], bit_per_sample, sample_bytes, pBuf + (size_t)s * sample_bytes, len);
+	}
+
+	spectral_work_free(&w);
+	bufpool_free(&gBufPool, x);
+}
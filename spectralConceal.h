@@ -0,0 +1,19 @@
+#ifndef _H_SPECTRALCONCEAL_
+#define _H_SPECTRALCONCEAL_
+
+#include "arch.h"
+#include "lostGap.h"
+
+// stft concealment of the lost gaps, for music at high sample rates
+
+/*-------------------- CONFIGURATION --------------------*/
+#define SPECTRAL_FRAME_REF (1024) /* stft frame at 48k, scaled with the sample rate */
+#define SPECTRAL_FRAME_MIN (256)
+#define SPECTRAL_FRAME_MAX (8192)
+#define SPECTRAL_HOP_DIV (4) /* hop = frame / 4 */
+#define SPECTRAL_GAP_MIN (4) /* shorter gaps are bridged by a straight line */
+
+/*-------------------- FUNCTIONS --------------------*/
+void spectral_conceal(uint8_t *pBuf, uint16_t bit_per_sample, uint32_t sample_rate, lost_gap_list_c *list);
+
+#endif
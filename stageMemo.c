@@ -0,0 +1,130 @@
+/**
+ * @file stageMemo.c
+ * @author weiyuan.hsu
+ * @brief
+ * implement of the keyed stage results
+ *
+ * stage_key: .............. Chain a parameter into the key of the stage input (64 bit FNV-1a, mixed so
+ * 							 chains of small values spread). The split key is the identity of the input,
+ * 							 the lost key adds the lost model and its parameters, the compensation key
+ * 							 adds the compensation type, so changing only compMethod keeps the split and
+ * 							 the lost results.
+ *
+ * stage_lookup: ........... A matching key is a reuse. Otherwise the stage and every later stage drop
+ * 							 their key, the caller recomputes and commits. A stage is only valid after
+ * 							 the commit, a failed pass never leaves a result a later call would reuse.
+ *
+ * stage_reserve: .......... Buffers are kept between calls and only grow, a sweep over one file does
+ * 							 not allocate after the first pass.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arch.h"
+#include "config.h"
+#include "bufferPool.h"
+#include "lostGap.h"
+#include "stageMemo.h"
+
+/*-------------------- GLOBAL PARAMETER --------------------*/
+stage_memo_c gStageMemo;
+
+char stage_name[STAGE_MAX][32] = {
+	"SPLIT",
+	"LOST",
+	"COMP",
+};
+
+/*-------------------- FUNCTIONS --------------------*/
+uint64_t stage_key(uint64_t parent, const void *param, size_t size) {
+	const uint8_t *p = (const uint8_t *)param;
+	uint64_t h = 14695981039346656037ULL ^ parent;
+	size_t i;
+
+	for( i=0; i<size; i++ ) {
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return (h == 0) ? 1 : h;
+}
+
+int stage_lookup(stage_memo_c *memo, uint8_t stage, uint64_t key) {
+	uint8_t s;
+
+	if( key != 0 && memo->result[stage].key == key ) {
+		memo->result[stage].reuse_cnt++;
+		return 1;
+	}
+	for( s=stage; s<STAGE_MAX; s++ ) {
+		memo->result[s].key = 0;
+	}
+	memo->result[stage].run_cnt++;
+	return 0;
+}
+
+int stage_reserve(stage_memo_c *memo, uint8_t stage, uint16_t channels, uint32_t channel_size) {
+	stage_result_c *r = &memo->result[stage];
+	size_t size = (size_t)channels * channel_size;
+
+	if( r->cap < size ) {
+		bufpool_free(&gBufPool, r->buf);
+		r->buf = (uint8_t *)bufpool_alloc(&gBufPool, size);
+		r->cap = (r->buf != NULL) ? size : 0;
+		if( r->buf == NULL ) {
+			printf("Allocation memory error");
+			return -1;
+		}
+	}
+	if( stage == STAGE_LOST && r->gap_num < channels ) {
+		lost_gap_list_c *gap = (lost_gap_list_c *)realloc(r->gap, sizeof(lost_gap_list_c) * channels);
+		if( gap == NULL ) {
+			printf("Allocation memory error");
+			return -1;
+		}
+		memset(gap + r->gap_num, 0x0, sizeof(lost_gap_list_c) * (channels - r->gap_num));
+		r->gap = gap;
+		r->gap_num = channels;
+	}
+	r->channels = channels;
+	r->channel_size = channel_size;
+	return 0;
+}
+
+void stage_commit(stage_memo_c *memo, uint8_t stage, uint64_t key) {
+	memo->result[stage].key = key;
+}
+
+uint8_t *stage_channel(stage_memo_c *memo, uint8_t stage, uint16_t ch) {
+	stage_result_c *r = &memo->result[stage];
+	return r->buf + (size_t)ch * r->channel_size;
+}
+
+void stage_save_gap(stage_memo_c *memo, uint16_t ch, const lost_gap_list_c *list) {
+	lostgap_copy(&memo->result[STAGE_LOST].gap[ch], list);
+}
+
+void stage_load_gap(stage_memo_c *memo, uint16_t ch, lost_gap_list_c *list) {
+	lostgap_copy(list, &memo->result[STAGE_LOST].gap[ch]);
+}
+
+void stage_release(stage_memo_c *memo) {
+	uint8_t s;
+	uint16_t ch;
+
+	for( s=0; s<STAGE_MAX; s++ ) {
+		stage_result_c *r = &memo->result[s];
+		bufpool_free(&gBufPool, r->buf);
+		for( ch=0; ch<r->gap_num; ch++ ) {
+			lostgap_release(&r->gap[ch]);
+		}
+		free(r->gap);
+	}
+	memset(memo, 0x0, sizeof(stage_memo_c));
+}
@@ -0,0 +1,53 @@
+#ifndef _H_STAGEMEMO_
+#define _H_STAGEMEMO_
+
+#include <stddef.h>
+#include "arch.h"
+#include "wave.h"
+#include "wave_type.h"
+#include "lostGap.h"
+
+// keyed results of the processing stages, decode -> split -> lost -> compensate -> metrics -> write
+// the key of a stage chains the key of its input with its own parameters, a stage whose key did not
+// change is reused and a changed key recomputes that stage and everything after it
+
+/*-------------------- CONFIGURATION --------------------*/
+enum {
+	STAGE_SPLIT = 0,			/* decoded planar channels (golden) */
+	STAGE_LOST,					/* channels after the data lost, and their gap lists */
+	STAGE_COMP,					/* concealed channels */
+	STAGE_MAX,
+};
+
+typedef struct _stage_result_c {
+	uint64_t key;				/* key of the held result, 0 : nothing held */
+	uint8_t *buf;				/* planar, channel after channel */
+	size_t cap;
+	uint16_t channels;
+	uint32_t channel_size;		/* bytes of a channel */
+	lost_gap_list_c *gap;		/* STAGE_LOST : gap list of each channel */
+	uint16_t gap_num;
+	uint32_t run_cnt;
+	uint32_t reuse_cnt;
+} stage_result_c;
+
+typedef struct _stage_memo_c {
+	stage_result_c result[STAGE_MAX];
+	fmt_chunk_body fmt_body;	/* format of the STAGE_SPLIT result */
+	uint32_t frames;
+} stage_memo_c;
+
+extern stage_memo_c gStageMemo; /* see single_file_processing() and the python module */
+extern char stage_name[STAGE_MAX][32];
+
+/*-------------------- FUNCTIONS --------------------*/
+uint64_t stage_key(uint64_t parent, const void *param, size_t size); /* never 0 */
+int stage_lookup(stage_memo_c *memo, uint8_t stage, uint64_t key); /* 1 : reuse, 0 : recompute, the stage and the later ones are dropped */
+int stage_reserve(stage_memo_c *memo, uint8_t stage, uint16_t channels, uint32_t channel_size);
+void stage_commit(stage_memo_c *memo, uint8_t stage, uint64_t key); /* key 0 : the result is never reused */
+uint8_t *stage_channel(stage_memo_c *memo, uint8_t stage, uint16_t ch);
+void stage_save_gap(stage_memo_c *memo, uint16_t ch, const lost_gap_list_c *list);
+void stage_load_gap(stage_memo_c *memo, uint16_t ch, lost_gap_list_c *list);
+void stage_release(stage_memo_c *memo);
+
+#endif
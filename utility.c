@@ -4,6 +4,8 @@
 #include "utility.h"
 #include "arch.h"
 #include "config.h"
+#include "asyncIo.h"
+#include "dspKernel.h"
 
 /*-------------------- GLOBAL PARAMETER --------------------*/
 char losttype_name[LOSTTYPE_MAX][32] = {
@@ -11,12 +13,56 @@ char losttype_name[LOSTTYPE_MAX][32] = {
 	"CONTINUOUS",
 	"INTERLEAVE",
 	"CONTINUOUS_FRAME",
+	"JITTER_FRAME",
 };
 
 char comptype_name[COMPTYPE_MAX][32] = {
 	"NONE",
 	"INNER_INTERPLOATION",
 	"G711_VOIP",
+	"SPECTRAL",
+	"AR_BURG",
+	"CUBIC",
+	"SINC",
+	"WSOLA",
+};
+
+char g711law_name[G711LAW_MAX][32] = {
+	"NONE",
+	"ALAW",
+	"MULAW",
+};
+
+char mixtype_name[MIXTYPE_MAX][32] = {
+	"NONE",
+	"STEREO",
+	"MONO",
+	"REMAP",
+};
+
+char simdisa_name[SIMDISA_MAX][32] = {
+	"AUTO",
+	"SCALAR",
+	"SSE2",
+	"AVX2",
+	"AVX512",
+};
+
+char runmode_name[RUNMODE_MAX][32] = {
+	"PROCESS",
+	"KERNEL_CHECK",
+	"SERVER",
+	"CATALOG",
+};
+
+char jbtype_name[JBTYPE_MAX][32] = {
+	"FIXED",
+	"ADAPTIVE",
+};
+
+char npytype_name[NPYTYPE_MAX][32] = {
+	"FLOAT32",
+	"INT32",
 };
 
 uint32_t channel_mask[SPEAKER_NUM_MAX] = {
@@ -92,6 +138,69 @@ sint32_t b24_signed_to_b32_signed(uint8_t *pBuf) {
 	return ret;
 }
 
+/**
+ * @brief 
+ * convert pcm samples to float in [-1, 1)
+ * @param pBuf : pointer to the first sample
+ * @param bit_per_sample : 8 (unsigned), 16, 24, 32 (signed)
+ * @param stride : bytes between two samples, bit_per_sample/8 for a single channel buffer (gDspKernel.unpack)
+ * @param pOut : float output
+ * @param num : sample number
+ */
+void pcm_to_float(uint8_t *pBuf, uint16_t bit_per_sample, uint32_t stride, float *pOut, uint32_t num) {
+	uint32_t i = 0;
+	if( stride == bit_per_sample / 8u ) {
+		i = gDspKernel.unpack(pBuf, bit_per_sample, pOut, num);
+		pBuf += (size_t)i * stride;
+	}
+	for( ; i<num; i++, pBuf+=stride ) {
+		if( bit_per_sample == 8 ) {
+			pOut[i] = ((sint32_t)pBuf[0] - 128) * (1.0f / 128.0f);
+		} else if( bit_per_sample == 16 ) {
+			pOut[i] = (*(sint16_t *)pBuf) * (1.0f / 32768.0f);
+		} else if( bit_per_sample == 24 ) {
+			pOut[i] = b24_signed_to_b32_signed(pBuf) * (1.0f / 8388608.0f);
+		} else {
+			pOut[i] = (float)((*(sint32_t *)pBuf) * (1.0 / 2147483648.0));
+		}
+	}
+}
+
+/**
+ * @brief 
+ * convert float in [-1, 1) back to pcm samples with rounding and saturation,
+ * a single channel buffer goes through gDspKernel.pack
+ */
+void float_to_pcm(float *pIn, uint16_t bit_per_sample, uint32_t stride, uint8_t *pBuf, uint32_t num) {
+	uint32_t i = 0;
+	double fullScale = (double)(1u << (bit_per_sample - 1));
+	if( stride == bit_per_sample / 8u ) {
+		i = gDspKernel.pack(pIn, bit_per_sample, pBuf, num);
+		pBuf += (size_t)i * stride;
+	}
+	for( ; i<num; i++, pBuf+=stride ) {
+		double v = pIn[i] * fullScale;
+		v = (v >= 0) ? v + 0.5 : v - 0.5;
+		if( v > fullScale - 1 ) {
+			v = fullScale - 1;
+		} else if( v < -fullScale ) {
+			v = -fullScale;
+		}
+		sint32_t val = (sint32_t)v;
+		if( bit_per_sample == 8 ) {
+			pBuf[0] = (uint8_t)(val + 128);
+		} else if( bit_per_sample == 16 ) {
+			*(sint16_t *)pBuf = (sint16_t)val;
+		} else if( bit_per_sample == 24 ) {
+			pBuf[0] = ((val & 0x000000ff) >>  0);
+			pBuf[1] = ((val & 0x0000ff00) >>  8);
+			pBuf[2] = ((val & 0x00ff0000) >> 16);
+		} else {
+			*(sint32_t *)pBuf = val;
+		}
+	}
+}
+
 /*-------------------- FUNCTIONS --------------------*/
 /*
 The channels specified in dwChannleMask must be present in the prescribed order (from least significant bit up).
@@ -171,4 +280,119 @@ void message_show_body(fmt_chunk_header fmt_header, fmt_chunk_body fmt_body) {
 		message_format(*(uint16_t *)fmt_body.sub_format);
 	}
 	printf("----------[format body end]----------\n");
-}
\ No newline at end of file
+}
+
+/*-------------------- FILE FUNCTIONS --------------------*/
+/**
+ * @brief 
+ * read the RIFF, fmt and chunk headers of a wav file, the chunks before the data chunk are skipped
+ * @param fp : at the start of the file, left at the first byte of the data chunk
+ * @param verbose : 0, nothing is printed (the catalog threads), 1, the fmt size and the errors are printed
+ * @return int : 0 success, -1 fail
+ */
+int wav_read_header(FILE *fp, riff_chunk *pRiff, fmt_chunk_header *pFmtHeader, fmt_chunk_body *pFmtBody, data_chunk *pDataHeader, uint8_t verbose) {
+	char name[8];
+	uint32_t size;
+
+	// Reading RIFF section
+	if (fread(pRiff, sizeof(uint8_t), sizeof(riff_chunk), fp) != sizeof(riff_chunk))  {
+		if( verbose != 0 ) {
+			printf("Can't read RIFF chunk or EOF is met. Exit.\n");
+		}
+		return -1;
+	}
+	if (strncmp("RIFF", pRiff->id, sizeof(pRiff->id)) != 0) {
+		Arr2String(name, pRiff->id, sizeof(pRiff->id));
+		if( verbose != 0 ) {
+			printf("File format is %s, not RIFF. Exit.\n", name);
+		}
+		return -1;
+	}
+	if (strncmp("WAVE", pRiff->type, sizeof(pRiff->type)) != 0) {
+		Arr2String(name, pRiff->type, sizeof(pRiff->type));
+		if( verbose != 0 ) {
+			printf("File format is %s, not WAVE. Exit.\n", name);
+		}
+		return -1;
+	}
+
+	// Reading fmt.id and fmt.size
+	if (fread(pFmtHeader, sizeof(uint8_t), 8, fp) != 8) {
+		if( verbose != 0 ) {
+			printf("Can't read fmt chunk or EOF is met. Exit.\n");
+		}
+		return -1;
+	}
+	if (strncmp("fmt ", pFmtHeader->id, sizeof(pFmtHeader->id)) != 0) {
+		if( verbose != 0 ) {
+			printf("File have no fmt chunk. Exit.\n");
+		}
+		return -1;
+	}
+	if( verbose != 0 ) {
+		printf("fmt size: %d\n", pFmtHeader->size);
+	}
+
+	// Reading fmt Sample Format Info, a longer fmt chunk than the extensible one is skipped over
+	memset(pFmtBody, 0x0, sizeof(fmt_chunk_body));
+	size = ( pFmtHeader->size < sizeof(fmt_chunk_body) ) ? pFmtHeader->size : sizeof(fmt_chunk_body);
+	if (fread(pFmtBody, sizeof(uint8_t), size, fp) != size || fseek(fp, pFmtHeader->size - size, SEEK_CUR) != 0) {
+		if( verbose != 0 ) {
+			printf("Can't read Sample Format Info in fmt chunk or EOF is met. Exit.\n");
+		}
+		return -1;
+	}
+
+	// Reading data/some chunk, a chunk of odd size is followed by a pad byte
+	if (fread(pDataHeader, sizeof(uint8_t), 8, fp) != 8) {
+		if( verbose != 0 ) {
+			printf("Error of reading data chunk. Exit.\n");
+		}
+		return -1;
+	}
+	while( strncmp("data", pDataHeader->id, sizeof(pDataHeader->id)) != 0 ) {
+		if( fseek(fp, (long)pDataHeader->size + (pDataHeader->size & 1), SEEK_CUR) != 0 || fread(pDataHeader, sizeof(uint8_t), 8, fp) != 8 ) {
+			if( verbose != 0 ) {
+				printf("Error of finding data chunk. Exit.\n");
+			}
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief 
+ * write a pcm wav file
+ * @param name : file name
+ * @param pFmt : format body, only the first fmt_size bytes are written
+ * @param fmt_size : 16 for standard header, 40 for extended header
+ * @param pData : interleaved pcm data
+ * @param size : data size in bytes
+ * @return int : 0 success, -1 fail
+ */
+int wav_write_pcm(char *name, fmt_chunk_body *pFmt, uint32_t fmt_size, uint8_t *pData, uint32_t size) {
+	riff_chunk riff_out = { {'R','I','F','F'}, 0, {'W','A','V','E'}};
+	fmt_chunk_header fmt_out_header = { {'f','m','t',' '}, fmt_size };
+	data_chunk data_out_header = { {'d','a','t','a'}, size };
+	FILE *fp_out = NULL;
+	int ret = -1;
+
+	riff_out.size = BASIC_HEADER_SIZE + fmt_size + size;
+	if( (fp_out = aio_fopen_write(name)) == NULL ) {
+		printf("Can't open the new WAV file for write.\n");
+		return -1;
+	}
+	if( fwrite(&riff_out, 1, sizeof(riff_out), fp_out) != sizeof(riff_out) ||
+		fwrite(&fmt_out_header, 1, sizeof(fmt_out_header), fp_out) != sizeof(fmt_out_header) ||
+		fwrite(pFmt, 1, fmt_size, fp_out) != fmt_size ||
+		fwrite(&data_out_header, 1, sizeof(data_out_header), fp_out) != sizeof(data_out_header) ||
+		fwrite(pData, 1, size, fp_out) != size ) {
+		printf("Can't write WAV file.\n");
+	} else {
+		printf("Done. WAV file writing in %s .\n", name);
+		ret = 0;
+	}
+	aio_fclose_write(fp_out);
+	return ret;
+}
@@ -1,6 +1,7 @@
 #ifndef _UTILITY_H_
 #define _UTILITY_H_
 
+#include <stdio.h>
 #include <string.h>
 #include "arch.h"
 #include "wave.h"
@@ -13,6 +14,7 @@ enum {
 	LOSTTYPE_CONTINUOUS,
 	LOSTTYPE_INTERLEAVE,
 	LOSTTYPE_CONTINUOUS_FRAME,
+	LOSTTYPE_JITTER_FRAME,
 	LOSTTYPE_MAX,
 };
 
@@ -20,18 +22,75 @@ enum {
 	COMPTYPE_NONE = 0,
 	COMPTYPE_INNER_INTERPLOATION,
 	COMPTYPE_G711_VOIP,
+	COMPTYPE_SPECTRAL,
+	COMPTYPE_AR_BURG,
+	COMPTYPE_CUBIC,
+	COMPTYPE_SINC,
+	COMPTYPE_WSOLA,
 	COMPTYPE_MAX,
 };
 
+enum {
+	G711LAW_NONE = 0,
+	G711LAW_ALAW,
+	G711LAW_MULAW,
+	G711LAW_MAX,
+};
+
+enum {
+	MIXTYPE_NONE = 0,
+	MIXTYPE_STEREO,
+	MIXTYPE_MONO,
+	MIXTYPE_REMAP,
+	MIXTYPE_MAX,
+};
+
+enum {
+	SIMDISA_AUTO = 0,
+	SIMDISA_SCALAR,
+	SIMDISA_SSE2,
+	SIMDISA_AVX2,
+	SIMDISA_AVX512,
+	SIMDISA_MAX,
+};
+
+enum {
+	RUNMODE_PROCESS = 0,
+	RUNMODE_KERNEL_CHECK,
+	RUNMODE_SERVER,
+	RUNMODE_CATALOG,
+	RUNMODE_MAX,
+};
+
+enum {
+	JBTYPE_FIXED = 0,
+	JBTYPE_ADAPTIVE,
+	JBTYPE_MAX,
+};
+
+enum {
+	NPYTYPE_FLOAT32 = 0,
+	NPYTYPE_INT32,
+	NPYTYPE_MAX,
+};
+
 /*-------------------- GLOBAL PARAMETER --------------------*/
 extern char comptype_name[COMPTYPE_MAX][32];
 extern char losttype_name[LOSTTYPE_MAX][32];
+extern char g711law_name[G711LAW_MAX][32];
+extern char mixtype_name[MIXTYPE_MAX][32];
+extern char simdisa_name[SIMDISA_MAX][32];
+extern char runmode_name[RUNMODE_MAX][32];
+extern char jbtype_name[JBTYPE_MAX][32];
+extern char npytype_name[NPYTYPE_MAX][32];
 extern char channel_name[SPEAKER_NUM_MAX][32];
 extern uint32_t channel_mask[SPEAKER_NUM_MAX];
 
 /*-------------------- DATA/STRING PROCESSING FUNCTIONS --------------------*/
 void Arr2String(char *Dest, char *Src, uint8_t size );
 sint32_t b24_signed_to_b32_signed(uint8_t *pBuf);
+void pcm_to_float(uint8_t *pBuf, uint16_t bit_per_sample, uint32_t stride, float *pOut, uint32_t num);
+void float_to_pcm(float *pIn, uint16_t bit_per_sample, uint32_t stride, uint8_t *pBuf, uint32_t num);
 
 /*-------------------- FUNCTIONS --------------------*/
 void message_speaker_mask(uint32_t input);
@@ -40,4 +99,8 @@ void message_show_body(fmt_chunk_header fmt_header, fmt_chunk_body fmt_body);
 uint8_t get_speaker_mask_num(uint32_t input);
 uint8_t get_speaker_mask_idx(uint32_t input, uint8_t sequence_number);
 
+/*-------------------- FILE FUNCTIONS --------------------*/
+int wav_read_header(FILE *fp, riff_chunk *pRiff, fmt_chunk_header *pFmtHeader, fmt_chunk_body *pFmtBody, data_chunk *pDataHeader, uint8_t verbose); /* 0 success, fp at the first pcm byte, -1 fail */
+int wav_write_pcm(char *name, fmt_chunk_body *pFmt, uint32_t fmt_size, uint8_t *pData, uint32_t size);
+
 #endif
\ No newline at end of file
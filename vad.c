@@ -0,0 +1,207 @@
+/**
+ * @file vad.c
+ * @author weiyuan.hsu
+ * @brief
+ * implement of the activity detection which skips the concealment of the gaps in silence
+ *
+ * vad_label: .............. One pass over the channel, a block is converted to float (gDspKernel.unpack for
+ * 							 a planar channel) and its runs of received samples, between the gaps of the
+ * 							 list, are reduced to their sum of squares by gDspKernel.reduce while the block
+ * 							 is in L1, the pass of the peak index. The lost samples are never measured.
+ *
+ * vad_silent: ............. Every block of the context with received samples must stay below the threshold,
+ * 							 the level of the comfort noise is the rms of the received samples of the context.
+ *
+ * vad_skip_gaps: .......... The gap list compensators : the gaps in silence are filled with comfort noise and
+ * 							 removed from the list before gProcKernel.comp, the others are concealed as usual.
+ * 							 COMPTYPE_G711_VOIP decides per run of erased frames in g711PlcProc().
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "arch.h"
+#include "config.h"
+#include "utility.h"
+#include "dspKernel.h"
+#include "vad.h"
+
+/*-------------------- GLOBAL PARAMETER --------------------*/
+vad_c gVad;
+
+/*-------------------- INTERNAL FUNCTIONS --------------------*/
+/**
+ * @brief
+ * sum of squares and received samples of the blocks [b0, b1], false when one of them is active
+ */
+static bool vad_side(vad_c *vad, sint64_t b0, sint64_t b1, double *pSumSq, uint64_t *pReceived) {
+	for( sint64_t b=b0; b<=b1; b++ ) {
+		if( vad->received[b] == 0 ) {
+			continue;
+		}
+		if( vad->sumsq[b] > vad->threshold * vad->received[b] ) {
+			return false;
+		}
+		*pSumSq += vad->sumsq[b];
+		*pReceived += vad->received[b];
+	}
+	return true;
+}
+
+/*-------------------- FUNCTIONS --------------------*/
+int vad_label(vad_c *vad, uint8_t *pBuf, uint16_t bit_per_sample, uint32_t sample_rate, sint32_t threshold_db, const lost_gap_list_c *lost) {
+	uint32_t sample_bytes = bit_per_sample / 8;
+	uint32_t samples = lost->samples;
+	uint32_t block = (uint32_t)((uint64_t)sample_rate * VAD_BLOCK_MS / 1000);
+	uint32_t g = 0;
+
+	block = ( block > 0 ) ? block : 1;
+	vad->blocks = (samples + block - 1) / block;
+	vad->samples = samples;
+	vad->threshold = (float)pow(10.0, threshold_db / 10.0);
+	if( block != vad->block ) {
+		float *pNew = (float *)realloc(vad->work, sizeof(float) * block);
+		if( pNew == NULL ) {
+			vad->blocks = 0;
+			return -1;
+		}
+		vad->work = pNew;
+		vad->block = block;
+	}
+	if( vad->blocks > vad->cap ) {
+		float *pSumSq = (float *)realloc(vad->sumsq, sizeof(float) * vad->blocks);
+		uint32_t *pReceived = ( pSumSq != NULL ) ? (uint32_t *)realloc(vad->received, sizeof(uint32_t) * vad->blocks) : NULL;
+		vad->sumsq = ( pSumSq != NULL ) ? pSumSq : vad->sumsq;
+		vad->received = ( pReceived != NULL ) ? pReceived : vad->received;
+		if( pSumSq == NULL || pReceived == NULL ) {
+			vad->blocks = 0;
+			return -1;
+		}
+		vad->cap = vad->blocks;
+	}
+
+	for( uint32_t b=0; b<vad->blocks; b++ ) {
+		uint32_t sta = b * block;
+		uint32_t end = ( samples - sta > block ) ? sta + block : samples;
+		uint32_t i = sta;
+		pcm_to_float(pBuf + (size_t)sta * sample_bytes, bit_per_sample, sample_bytes, vad->work, end - sta);
+		vad->sumsq[b] = 0.0f;
+		vad->received[b] = 0;
+		while( i < end ) {
+			uint32_t run_end = end;
+			float vmin, vmax, sumsq;
+			while( g < lost->num && lost->gap[g].start + lost->gap[g].len <= i ) {
+				g++;
+			}
+			if( g < lost->num && lost->gap[g].start <= i ) {
+				/* in a gap, to its end */
+				i = ( lost->gap[g].start + lost->gap[g].len < end ) ? lost->gap[g].start + lost->gap[g].len : end;
+				continue;
+			}
+			run_end = ( g < lost->num && lost->gap[g].start < end ) ? lost->gap[g].start : end;
+			gDspKernel.reduce(&vad->work[i - sta], run_end - i, &vmin, &vmax, &sumsq);
+			vad->sumsq[b] += sumsq;
+			vad->received[b] += run_end - i;
+			i = run_end;
+		}
+	}
+	return 0;
+}
+
+bool vad_silent(vad_c *vad, uint32_t start, uint32_t len, float *pLevel) {
+	sint64_t ctx = VAD_CONTEXT_MS / VAD_BLOCK_MS;
+	sint64_t b0, b1;
+	double ss_before = 0.0, ss_after = 0.0;
+	uint64_t rec_before = 0, rec_after = 0;
+	bool edge_before, edge_after;
+
+	if( vad->blocks == 0 || len == 0 || start >= vad->samples ) {
+		return false;
+	}
+	b0 = start / vad->block;
+	b1 = ( start + len < vad->samples ) ? (start + len - 1) / vad->block : vad->blocks - 1;
+	edge_before = ( b0 < ctx );
+	edge_after = ( b1 + ctx >= vad->blocks );
+	if( !vad_side(vad, ( edge_before ) ? 0 : b0 - ctx, b0, &ss_before, &rec_before) ||
+		!vad_side(vad, b1, ( edge_after ) ? vad->blocks - 1 : b1 + ctx, &ss_after, &rec_after) ) {
+		return false;
+	}
+	if( (rec_before < vad->block && !edge_before) || (rec_after < vad->block && !edge_after) || rec_before + rec_after < vad->block ) {
+		return false;
+	}
+	*pLevel = (float)sqrt((ss_before + ss_after) / (double)(rec_before + rec_after));
+	return true;
+}
+
+void vad_noise(float *pOut, uint32_t num, float level, uint32_t seed) {
+	uint32_t state = (seed ^ 0x2545f491) * 2654435761u; // neighbouring seeds start far apart
+	float a = level * 1.7320508f / (float)(1u << 23); // uniform in [-a, a) has the rms a / sqrt(3)
+
+	state = ( state != 0 ) ? state : 1;
+	for( uint32_t i=0; i<num; i++ ) {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		pOut[i] = a * (float)((sint32_t)(state >> 8) - (1 << 23));
+	}
+}
+
+int vad_skip_gaps(vad_c *vad, uint8_t *pBuf, uint16_t bit_per_sample, uint32_t sample_rate, sint32_t threshold_db, lost_gap_list_c *list) {
+	uint32_t sample_bytes = bit_per_sample / 8;
+	uint32_t g, kept = 0;
+
+	if( vad_label(vad, pBuf, bit_per_sample, sample_rate, threshold_db, list) != 0 ) {
+		printf("Allocation memory error");
+		return -1;
+	}
+	for( g=0; g<list->num; g++ ) {
+		uint32_t s = list->gap[g].start, len = list->gap[g].len;
+		float level;
+		bool silent = vad_silent(vad, s, len, &level);
+
+		vad_count(vad, len, silent);
+		if( !silent ) {
+			list->gap[kept++] = list->gap[g];
+			continue;
+		}
+		for( uint32_t done=0; done<len; done+=vad->block ) {
+			uint32_t n = ( len - done > vad->block ) ? vad->block : len - done;
+			vad_noise(vad->work, n, level, s + done);
+			float_to_pcm(vad->work, bit_per_sample, sample_bytes, pBuf + (size_t)(s + done) * sample_bytes, n);
+		}
+	}
+	list->num = kept;
+	return 0;
+}
+
+void vad_count(vad_c *vad, uint32_t samples, bool skipped) {
+	vad->channel.gaps++;
+	vad->channel.samples += samples;
+	vad->channel.gaps_skipped += ( skipped ) ? 1 : 0;
+	vad->channel.samples_skipped += ( skipped ) ? samples : 0;
+	vad->total.gaps++;
+	vad->total.samples += samples;
+	vad->total.gaps_skipped += ( skipped ) ? 1 : 0;
+	vad->total.samples_skipped += ( skipped ) ? samples : 0;
+}
+
+void vad_report(const vad_stats_c *stats, const char *title) {
+	if( stats->gaps == 0 ) {
+		return;
+	}
+	printf("vad %s : %llu of %llu gaps in silence, %llu of %llu lost samples filled with comfort noise (%.1f %% of the concealment skipped)\n",
+		title, (unsigned long long)stats->gaps_skipped, (unsigned long long)stats->gaps, (unsigned long long)stats->samples_skipped,
+		(unsigned long long)stats->samples, 100.0 * stats->samples_skipped / stats->samples);
+}
+
+void vad_release(vad_c *vad) {
+	free(vad->sumsq);
+	free(vad->received);
+	free(vad->work);
+	lostgap_release(&vad->frames);
+	memset(vad, 0x0, sizeof(vad_c));
+}
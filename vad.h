@@ -0,0 +1,52 @@
+#ifndef _H_VAD_
+#define _H_VAD_
+
+#include "arch.h"
+#include "lostGap.h"
+
+// activity of a channel from the energy of its received samples, per VAD_BLOCK_MS block. A gap (a run of erased
+// frames for COMPTYPE_G711_VOIP) whose context, the VAD_CONTEXT_MS of received samples on each side, stays below
+// the threshold is not concealed, it is filled with comfort noise at the level of the context.
+//
+// the sum of squares of a block only takes its received samples, whatever the data lost model left in the gaps
+// (0x00 of proc_lost_xxx is full scale for 8 bit pcm), a block is weighed by its received samples and a block with
+// none is no evidence. A side of the gap needs at least a block of received samples, or the channel end, and the
+// gap needs one such side
+
+/*-------------------- CONFIGURATION --------------------*/
+#define VAD_BLOCK_MS (10)
+#define VAD_CONTEXT_MS (40) /* on each side of the gap, the hangover of the activity */
+
+typedef struct _vad_stats_c {
+	uint64_t gaps;
+	uint64_t gaps_skipped;		/* in silence, filled with comfort noise */
+	uint64_t samples;			/* lost samples */
+	uint64_t samples_skipped;
+} vad_stats_c;
+
+typedef struct _vad_c {
+	uint32_t block;				/* samples of a block */
+	uint32_t blocks;
+	uint32_t cap;				/* blocks allocated */
+	uint32_t samples;
+	float threshold;			/* mean square, full scale 1.0 */
+	float *sumsq;				/* [blocks] sum of squares of the block */
+	uint32_t *received;			/* [blocks] samples of the block which are not lost */
+	float *work;				/* [block] float samples of a block */
+	lost_gap_list_c frames;		/* erased frames of COMPTYPE_G711_VOIP as gaps */
+	vad_stats_c channel;		/* channel in process, cleared by Model_Compensation() */
+	vad_stats_c total;			/* every channel of the run */
+} vad_c;
+
+extern vad_c gVad;
+
+/*-------------------- FUNCTIONS --------------------*/
+int vad_label(vad_c *vad, uint8_t *pBuf, uint16_t bit_per_sample, uint32_t sample_rate, sint32_t threshold_db, const lost_gap_list_c *lost); /* the channel is lost->samples long, 0 success, -1 fail */
+bool vad_silent(vad_c *vad, uint32_t start, uint32_t len, float *pLevel); /* pLevel : rms of the context, full scale 1.0 */
+void vad_noise(float *pOut, uint32_t num, float level, uint32_t seed); /* comfort noise of rms level, the same for a seed */
+int vad_skip_gaps(vad_c *vad, uint8_t *pBuf, uint16_t bit_per_sample, uint32_t sample_rate, sint32_t threshold_db, lost_gap_list_c *list); /* label the channel, fill the gaps in silence and take them out of list, 0 success, -1 fail */
+void vad_count(vad_c *vad, uint32_t samples, bool skipped); /* one gap into the stats of the channel and of the run */
+void vad_report(const vad_stats_c *stats, const char *title);
+void vad_release(vad_c *vad);
+
+#endif
@@ -0,0 +1,71 @@
+import numpy
+import struct
+from matplotlib import pyplot
+
+# plot golden / lost / concealed envelopes from the peak index sidecar (gFlow_dump_peak_index)
+# only the level with about one entry per pixel is read, so any zoom of a huge file reads a few KB
+#
+# sidecar layout, see peakIndex.h
+# | header 28 bytes | uint32 count[levels] | signal 0 : level 0 .. level n | signal 1 : ... | signal 2 : ... |
+# entry : int16 min, int16 max, int16 rms, full scale 32767
+
+# some setting
+gPlotStart = 0 # unit : sample
+gPlotEnd = -1 # unit : sample, -1 : end of file
+gPlotWidth = 2000 # entries per plot, about the pixels of the figure
+gDataName = "rimsky_192k_2ch_16b_short_FRONT_LEFT"
+gDataDir = "output"
+
+gSignalName = ['golden', 'lost', 'concealed']
+gSignalColor = ['g', 'k', 'r']
+gEntryType = numpy.dtype([('min', '<i2'), ('max', '<i2'), ('rms', '<i2')])
+
+def loadPeakHeader(fileName) :
+	with open(fileName, 'rb') as f :
+		magic, version, signals, sample_rate, samples, bit_per_sample, levels, base_block, ratio = struct.unpack('<4sHHIIHHII', f.read(28))
+		if magic != b'PEAK' :
+			raise ValueError('{} is not a peak index file'.format(fileName))
+		count = struct.unpack('<{}I'.format(levels), f.read(4 * levels))
+	info = {
+		'signals' : signals, 'sample_rate' : sample_rate, 'samples' : samples, 'bit_per_sample' : bit_per_sample,
+		'levels' : levels, 'base_block' : base_block, 'ratio' : ratio, 'count' : count,
+		'data_offset' : 28 + 4 * levels, 'total' : sum(count),
+	}
+	return info
+
+def loadPeakLevel(fileName, info, signal, start, end, width) :
+	# coarsest level which still has width entries in [start, end)
+	level = 0
+	span = info['base_block']
+	while level + 1 < info['levels'] and (end - start) / (span * info['ratio']) >= width :
+		level += 1
+		span *= info['ratio']
+	first = start // span
+	last = min((end + span - 1) // span, info['count'][level])
+	offset = info['data_offset'] + (signal * info['total'] + sum(info['count'][:level]) + first) * gEntryType.itemsize
+	entry = numpy.fromfile(fileName, dtype=gEntryType, count=last - first, offset=offset)
+	x = (numpy.arange(first, last) * span).clip(max=info['samples'])
+	return x, entry, span
+
+def showPeak(start = gPlotStart, end = gPlotEnd, width = gPlotWidth) :
+	fileName = "{}/MY_{}_peak.bin".format(gDataDir, gDataName)
+	info = loadPeakHeader(fileName)
+	if end < 0 or end > info['samples'] :
+		end = info['samples']
+
+	fig, ax = pyplot.subplots(info['signals'], 1, sharex=True)
+	fig.suptitle('{} envelope'.format(gDataName))
+	fig.set_figwidth(15)
+	fig.set_figheight(9)
+	fig.subplots_adjust(left=0.05, right=0.95)
+
+	for signal in range(info['signals']) :
+		x, entry, span = loadPeakLevel(fileName, info, signal, start, end, width)
+		ax[signal].fill_between(x, entry['min'] / 32767.0, entry['max'] / 32767.0, color=gSignalColor[signal], alpha=0.4, linewidth=0, label='{} min/max'.format(gSignalName[signal]))
+		ax[signal].plot(x, entry['rms'] / 32767.0, gSignalColor[signal], linewidth=0.5, label='{} rms'.format(gSignalName[signal]))
+		ax[signal].set_title('sample from {} to {}, {} samples per entry'.format(start, end, span))
+		ax[signal].legend(loc='upper right')
+	pyplot.show()
+
+if __name__ == "__main__":
+	showPeak(gPlotStart, gPlotEnd, gPlotWidth)
@@ -53,9 +53,9 @@ def loadWav(loadtype=0) :
 	if fileinfo.sampwidth == 2 :
 		ret_numpy_array = numpy.frombuffer(audio, dtype=numpy.int16)
 	elif fileinfo.sampwidth == 3 :
-		ret_numpy_array = numpy.array([], dtype=numpy.int32)
-		for i in range(0, int(gPlotEnd+gPlotPadding*4)*3) : 
-			ret_numpy_array = numpy.append(ret_numpy_array, [unpack_s24bit_new(audio[i*3:i*3+3])])
+		# sign extend the little endian 3 bytes samples in one go, see unpack_s24bit_new
+		b = numpy.frombuffer(audio, dtype=numpy.uint8).reshape(-1, 3).astype(numpy.int32)
+		ret_numpy_array = ((b[:, 0] | (b[:, 1] << 8) | (b[:, 2] << 16)) << 8) >> 8
 	else :
 		ret_numpy_array = numpy.frombuffer(audio, dtype=numpy.int32)
 
@@ -0,0 +1,332 @@
+/**
+ * @file wsola.c
+ * @author weiyuan.hsu
+ * @brief
+ * implement of the WSOLA time scale modification and of COMPTYPE_WSOLA
+ *
+ * wsola_push / wsola_pull: Streaming engine. Every hop of output takes one hann frame of the input, the
+ * 							 nominal position of the frame advances hop * speed, the speed of the pull,
+ * 							 so the playout rate can change from one pull to the next. The frame is moved
+ * 							 within +-tol to where its first half best matches the natural continuation
+ * 							 of the previous frame (its second half in the input), a coarse search on
+ * 							 rate / WSOLA_DEC_RATE decimated samples and a full rate one around the best,
+ * 							 the two steps of g711plc_findpitch. The first frame is taken as is and its
+ * 							 first half is output unwindowed, so an unmodified stretch starts exactly on
+ * 							 the input. The input is kept from the oldest sample a search can still read.
+ *
+ * wsola_scale: ............ One shot stretch of a segment to an exact length, the frames are spread from
+ * 							 the first to the last full frame of the segment.
+ *
+ * wsola_conceal: .......... Each gap is covered by stretching the samples before it (WSOLA_CTX_GAPS gaps,
+ * 							 at least WSOLA_CTX_MIN_MS) over themselves and the gap, as a receiver slowing
+ * 							 its playout down would. Only the gap is written: it is read from the stretch
+ * 							 where the stretch best continues the hop before the gap (the frame search)
+ * 							 and cross faded, over its last hop, to where the stretch best leads into the
+ * 							 samples after it. Unlike LowcFE the stretched signal is real speech and does
+ * 							 not mute on long gaps, the speed only drops as the gap grows. A gap with less
+ * 							 than a frame before it is a line between its edges.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "arch.h"
+#include "config.h"
+#include "utility.h"
+#include "lostGap.h"
+#include "LowcFE.h"
+#include "wsola.h"
+#include "bufferPool.h"
+
+/*-------------------- INTERNAL FUNCTIONS --------------------*/
+/**
+ * @brief
+ * Lag in [0, n] of r where len samples best match l, coarse on every dec-th sample then full rate around the best.
+ */
+static sint32_t wsola_search(const wsola_c *ws, const Float *l, const Float *r, sint32_t n, sint32_t len) {
+	sint32_t clen = len - len % ws->dec;
+	sint32_t best, lo = 0, hi = n;
+
+	if( clen > 0 ) {
+		best = g711plc_xcorr_search(l, r, 0, n, clen, ws->dec, WSOLA_MINPOWER * (clen / ws->dec), true);
+		lo = ( best - (ws->dec - 1) > 0 ) ? best - (ws->dec - 1) : 0;
+		hi = ( best + (ws->dec - 1) < n ) ? best + (ws->dec - 1) : n;
+	}
+	return g711plc_xcorr_search(l, r, lo, hi, len, 1, WSOLA_MINPOWER * len, false);
+}
+
+/**
+ * @brief
+ * Position in y[at - tol, at + tol] whose len samples best match x, the samples are copied to the Float work.
+ */
+static uint32_t wsola_align(const wsola_c *ws, const float *x, const float *y, uint32_t at, sint32_t len, Float *work) {
+	Float *r = work + len;
+	sint32_t i;
+	for( i=0; i<len; i++ ) {
+		work[i] = (Float)x[i];
+	}
+	for( i=0; i<2 * ws->tol + len; i++ ) {
+		r[i] = (Float)y[at - ws->tol + i];
+	}
+	return at - ws->tol + wsola_search(ws, work, r, 2 * ws->tol, len);
+}
+
+/**
+ * @brief
+ * Take the next frame, -1 when the input does not hold it yet.
+ */
+static int wsola_frame(wsola_c *ws, double speed) {
+	sint64_t end = ws->in_base + ws->in_num;
+	sint64_t nom = (sint64_t)floor(ws->pos + 0.5);
+	sint64_t lo = ( ws->first ) ? nom : nom - ws->tol;
+	sint64_t hi = ( ws->first ) ? nom : nom + ws->tol;
+	sint64_t p;
+	const Float *x;
+
+	if( !ws->eos && hi + ws->win > end ) {
+		return -1;
+	}
+	/* at the input end the frames stay on the last full frame and search a pitch cycle back */
+	if( hi > end - ws->win ) {
+		hi = end - ws->win;
+		lo = ( ws->first ) ? hi : ( lo < hi - 2 * ws->tol ) ? lo : hi - 2 * ws->tol;
+	}
+	lo = ( lo > ws->in_base ) ? lo : ws->in_base;
+	if( hi < lo ) {
+		return -1;
+	}
+
+	if( ws->first ) {
+		p = lo;
+		x = ws->in + (p - ws->in_base);
+		for( sint32_t i=0; i<ws->hop; i++ ) {
+			ws->tail[i] = x[i] * ws->window[ws->hop + i];
+		}
+	} else {
+		const Float *l = ws->in + (ws->prev + ws->hop - ws->in_base);
+		const Float *r = ws->in + (lo - ws->in_base);
+		p = lo + wsola_search(ws, l, r, (sint32_t)(hi - lo), ws->hop);
+	}
+
+	x = ws->in + (p - ws->in_base);
+	for( sint32_t i=0; i<ws->hop; i++ ) {
+		ws->ola[i] = (float)(ws->tail[i] + x[i] * ws->window[i]);
+		ws->tail[i] = x[ws->hop + i] * ws->window[ws->hop + i];
+	}
+	ws->ola_pos = 0;
+	ws->moved += ( p != nom ) ? 1 : 0;
+	ws->frames++;
+	ws->prev = p;
+	ws->pos = ( ws->first ) ? (double)p + ws->hop * speed : ws->pos + ws->hop * speed;
+	ws->first = false;
+	return 0;
+}
+
+static void wsola_line(float *x, uint32_t num, uint32_t s, uint32_t len) {
+	uint32_t j;
+	/* a gap at the channel edge stays muted */
+	if( s == 0 || s + len >= num ) {
+		memset(&x[s], 0x0, sizeof(float) * len);
+		return;
+	}
+	for( j=0; j<len; j++ ) {
+		x[s + j] = x[s - 1] + (x[s + len] - x[s - 1]) * (float)(j + 1) / (float)(len + 1);
+	}
+}
+
+/*-------------------- FUNCTIONS --------------------*/
+int wsola_init(wsola_c *ws, uint32_t sample_rate) {
+	memset(ws, 0x0, sizeof(wsola_c));
+	ws->sample_rate = sample_rate;
+	ws->hop = (sint32_t)((uint64_t)sample_rate * WSOLA_WIN_MS / 2000);
+	ws->hop = ( ws->hop > 1 ) ? ws->hop : 1;
+	ws->win = ws->hop * 2;
+	ws->tol = (sint32_t)((uint64_t)sample_rate * WSOLA_TOL_MS / 1000);
+	ws->dec = (sint32_t)(sample_rate / WSOLA_DEC_RATE);
+	ws->dec = ( ws->dec > 1 ) ? ws->dec : 1;
+	ws->dec = ( ws->dec < ws->hop ) ? ws->dec : ws->hop;
+
+	ws->window = (Float *)malloc(sizeof(Float) * ws->win);
+	ws->tail = (Float *)malloc(sizeof(Float) * ws->hop);
+	ws->ola = (float *)malloc(sizeof(float) * ws->hop);
+	if( ws->window == NULL || ws->tail == NULL || ws->ola == NULL ) {
+		wsola_release(ws);
+		return -1;
+	}
+	for( sint32_t i=0; i<ws->win; i++ ) {
+		ws->window[i] = (Float)(0.5 - 0.5 * cos(2.0 * M_PI * i / ws->win));
+	}
+	wsola_reset(ws);
+	return 0;
+}
+
+void wsola_reset(wsola_c *ws) {
+	ws->in_base = 0;
+	ws->in_num = 0;
+	ws->eos = false;
+	ws->first = true;
+	ws->pos = 0.0;
+	ws->prev = 0;
+	ws->ola_pos = ws->hop;
+	ws->frames = 0;
+	ws->moved = 0;
+}
+
+int wsola_push(wsola_c *ws, const float *in, uint32_t num) {
+	/* the next search reads from the last frame or from tol before the nominal position */
+	sint64_t end = ws->in_base + ws->in_num;
+	sint64_t keep = (sint64_t)floor(ws->pos) - ws->tol;
+
+	keep = ( ws->prev < keep ) ? ws->prev : keep;
+	keep = ( ws->first || keep < ws->in_base ) ? ws->in_base : keep;
+	keep = ( keep < end ) ? keep : end;
+
+	if( keep > ws->in_base && (keep - ws->in_base >= ws->in_num / 2 || (sint64_t)ws->in_num + num > ws->in_cap) ) {
+		sint32_t drop = (sint32_t)(keep - ws->in_base);
+		memmove(ws->in, ws->in + drop, sizeof(Float) * (ws->in_num - drop));
+		ws->in_num -= drop;
+		ws->in_base = keep;
+	}
+	if( (sint64_t)ws->in_num + num > ws->in_cap ) {
+		sint64_t cap = ( ws->in_cap > 0 ) ? ws->in_cap : ws->win * 4;
+		Float *pNew;
+		while( cap < (sint64_t)ws->in_num + num ) {
+			cap *= 2;
+		}
+		if( cap > 0x7fffffff || (pNew = (Float *)realloc(ws->in, sizeof(Float) * cap)) == NULL ) {
+			return -1;
+		}
+		ws->in = pNew;
+		ws->in_cap = (sint32_t)cap;
+	}
+	for( uint32_t i=0; i<num; i++ ) {
+		ws->in[ws->in_num + i] = (Float)in[i];
+	}
+	ws->in_num += num;
+	return 0;
+}
+
+void wsola_end(wsola_c *ws) {
+	ws->eos = true;
+}
+
+uint32_t wsola_pull(wsola_c *ws, float *out, uint32_t num, double speed) {
+	uint32_t done = 0;
+
+	while( done < num ) {
+		uint32_t n;
+		if( ws->ola_pos == ws->hop && wsola_frame(ws, speed) != 0 ) {
+			break;
+		}
+		n = (uint32_t)(ws->hop - ws->ola_pos);
+		n = ( n < num - done ) ? n : num - done;
+		memcpy(out + done, ws->ola + ws->ola_pos, sizeof(float) * n);
+		ws->ola_pos += n;
+		done += n;
+	}
+	return done;
+}
+
+int wsola_scale(wsola_c *ws, const float *in, uint32_t in_num, float *out, uint32_t out_num) {
+	uint32_t frames = (out_num + ws->hop - 1) / ws->hop;
+	double speed = 1.0;
+
+	if( in_num < (uint32_t)ws->win ) {
+		return -1;
+	}
+	if( frames > 1 ) {
+		speed = (double)(in_num - ws->win) / ((double)(frames - 1) * ws->hop);
+	}
+	wsola_reset(ws);
+	if( wsola_push(ws, in, in_num) != 0 ) {
+		return -1;
+	}
+	wsola_end(ws);
+	return ( wsola_pull(ws, out, out_num, speed) == out_num ) ? 0 : -1;
+}
+
+void wsola_release(wsola_c *ws) {
+	free(ws->window);
+	free(ws->in);
+	free(ws->tail);
+	free(ws->ola);
+	memset(ws, 0x0, sizeof(wsola_c));
+}
+
+void wsola_conceal(uint8_t *pBuf, uint16_t bit_per_sample, uint32_t sample_rate, lost_gap_list_c *list) {
+	uint32_t sample_bytes = bit_per_sample / 8;
+	uint32_t num = list->samples;
+	uint32_t ctx_min = (uint32_t)((uint64_t)sample_rate * WSOLA_CTX_MIN_MS / 1000);
+	uint32_t g, t, gap_max = 1, ctx_max;
+	wsola_c ws;
+	float *x, *y = NULL;
+	Float *work = NULL;
+
+	if( list->num == 0 ) {
+		return;
+	}
+	memset(&ws, 0x0, sizeof(wsola_c));
+	for( g=0; g<list->num; g++ ) {
+		gap_max = (list->gap[g].len > gap_max) ? list->gap[g].len : gap_max;
+	}
+	ctx_max = ( gap_max * WSOLA_CTX_GAPS > ctx_min ) ? gap_max * WSOLA_CTX_GAPS : ctx_min;
+	x = (float *)bufpool_alloc(&gBufPool, sizeof(float) * num);
+	if( x == NULL || wsola_init(&ws, sample_rate) != 0 ||
+		(y = (float *)bufpool_alloc(&gBufPool, sizeof(float) * ((size_t)ctx_max + gap_max + ws.tol + ws.hop))) == NULL ||
+		(work = (Float *)bufpool_alloc(&gBufPool, sizeof(Float) * (2 * ws.tol + 2 * ws.hop))) == NULL ) {
+		printf("Allocation memory error");
+		bufpool_free(&gBufPool, x);
+		bufpool_free(&gBufPool, y);
+		wsola_release(&ws);
+		return;
+	}
+	pcm_to_float(pBuf, bit_per_sample, sample_bytes, x, num);
+
+	for( g=0; g<list->num; g++ ) {
+		uint32_t s = list->gap[g].start, len = list->gap[g].len, e = s + len;
+		uint32_t next = (g + 1 < list->num) ? list->gap[g+1].start : num;
+		/* gaps before are concealed already, gaps after are not */
+		uint32_t ctx = ( len * WSOLA_CTX_GAPS > ctx_min ) ? len * WSOLA_CTX_GAPS : ctx_min;
+		uint32_t tail = ( next - e < (uint32_t)ws.hop ) ? next - e : (uint32_t)ws.hop;
+		uint32_t ramp = ( len < (uint32_t)ws.hop ) ? len : (uint32_t)ws.hop;
+		uint32_t q, q_e = 0;
+		float miss_s, miss_e = 0.0f;
+
+		/* a short history is stretched as it is, less than a frame is a line */
+		ctx = ( ctx < s ) ? ctx : s;
+		if( ctx < (uint32_t)ws.win || wsola_scale(&ws, &x[s - ctx], ctx, y, ctx + len + ws.tol + ws.hop) != 0 ) {
+			wsola_line(x, num, s, len);
+			float_to_pcm(&x[s], bit_per_sample, sample_bytes, pBuf + (size_t)s * sample_bytes, len);
+			continue;
+		}
+		/* the gap is read from the stretch where it continues the hop before the gap, and cross faded to
+		   where it leads into the samples after the gap, the received samples are not touched */
+		q = wsola_align(&ws, &x[s - ws.hop], y, ctx - ws.hop, ws.hop, work) + ws.hop;
+		miss_s = x[s - 1] - y[q - 1];
+		if( tail > 0 ) {
+			/* too few samples after the gap to align on, the same read is carried on to the next one */
+			q_e = ( tail == (uint32_t)ws.hop ) ? wsola_align(&ws, &x[e], y, ctx + len, ws.hop, work) - len : q;
+			miss_e = x[e] - y[q_e + len];
+		}
+		/* what is left of the miss of the aligned stretch at the edges is ramped out over a hop */
+		for( t=0; t<len; t++ ) {
+			float c = (t < ramp) ? 0.5f + 0.5f * cosf((float)M_PI * (float)t / (float)ramp) : 0.0f;
+			x[s + t] = y[q + t] + miss_s * c;
+			if( tail > 0 && t + ramp >= len ) {
+				float w = 0.5f - 0.5f * cosf((float)M_PI * (float)(t + ramp + 1 - len) / (float)(ramp + 1));
+				c = 0.5f + 0.5f * cosf((float)M_PI * (float)(len - 1 - t) / (float)ramp);
+				x[s + t] = (1.0f - w) * x[s + t] + w * (y[q_e + t] + miss_e * c);
+			}
+		}
+		float_to_pcm(&x[s], bit_per_sample, sample_bytes, pBuf + (size_t)s * sample_bytes, len);
+	}
+
+	bufpool_free(&gBufPool, work);
+	bufpool_free(&gBufPool, y);
+	bufpool_free(&gBufPool, x);
+	wsola_release(&ws);
+}
@@ -0,0 +1,56 @@
+#ifndef _H_WSOLA_
+#define _H_WSOLA_
+
+#include "arch.h"
+#include "lostGap.h"
+
+// WSOLA (waveform similarity overlap-add) time scale modification, any sample rate. Hann frames of WSOLA_WIN_MS
+// are overlap-added every hop (half a frame) of the output, frame k is read near the input position k * hop *
+// speed, moved within +-WSOLA_TOL_MS to the position whose first half best continues the previous frame
+// (g711plc_xcorr_search, the pitch search of LowcFE). speed > 1 compresses (drains a jitter buffer), < 1 expands.
+//
+// streaming : wsola_push() the received samples, wsola_pull() the playout at the speed of the moment. Without
+// enough input a pull returns short, after wsola_end() the input end holds the frames and the last pitch cycles
+// repeat for as long as the output is pulled.
+
+/*-------------------- CONFIGURATION --------------------*/
+#define WSOLA_WIN_MS (20) /* frame, the hop is half of it */
+#define WSOLA_TOL_MS (8) /* search +-, two tolerances span the longest pitch of LowcFE (PITCH_MAX, 15 ms) */
+#define WSOLA_DEC_RATE (4000) /* coarse search on rate / 4000 decimated samples, NDEC at 8k */
+#define WSOLA_MINPOWER ((Float)1e-9) /* per sample power floor of the correlation, CORRMINPOWER of full scale audio */
+#define WSOLA_CTX_GAPS (2) /* concealment : the gap is covered by stretching up to 2 gaps of the samples before it */
+#define WSOLA_CTX_MIN_MS (40) /* and at least 40 ms, a shorter history is stretched as it is, less than a frame is a line */
+
+typedef struct _wsola_c {
+	uint32_t sample_rate;
+	sint32_t win;				/* frame, samples, even */
+	sint32_t hop;				/* win / 2 */
+	sint32_t tol;
+	sint32_t dec;				/* coarse search decimation */
+	Float *window;				/* periodic hann [win], window[i] + window[i + hop] = 1 */
+	Float *in;					/* input from absolute sample in_base */
+	sint64_t in_base;
+	sint32_t in_num;
+	sint32_t in_cap;
+	bool eos;					/* no more input, see wsola_end() */
+	bool first;					/* next frame is the first, taken as is */
+	double pos;					/* nominal input position of the next frame */
+	sint64_t prev;				/* input position of the last frame */
+	Float *tail;				/* [hop] second half of the last frame */
+	float *ola;					/* [hop] finished output of the last frame */
+	sint32_t ola_pos;			/* ola samples pulled */
+	uint64_t frames;
+	uint64_t moved;				/* frames read away from their nominal position */
+} wsola_c;
+
+/*-------------------- FUNCTIONS --------------------*/
+int wsola_init(wsola_c *ws, uint32_t sample_rate); /* 0 success, -1 fail */
+void wsola_reset(wsola_c *ws);
+int wsola_push(wsola_c *ws, const float *in, uint32_t num); /* 0 success, -1 fail */
+void wsola_end(wsola_c *ws); /* end of the input */
+uint32_t wsola_pull(wsola_c *ws, float *out, uint32_t num, double speed); /* returns the samples written, speed > 0 */
+int wsola_scale(wsola_c *ws, const float *in, uint32_t in_num, float *out, uint32_t out_num); /* in stretched to exactly out_num samples, 0 success, -1 input shorter than a frame */
+void wsola_release(wsola_c *ws);
+void wsola_conceal(uint8_t *pBuf, uint16_t bit_per_sample, uint32_t sample_rate, lost_gap_list_c *list);
+
+#endif